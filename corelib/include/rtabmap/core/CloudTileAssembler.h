@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_INCLUDE_RTABMAP_CORE_CLOUDTILEASSEMBLER_H_
+#define CORELIB_INCLUDE_RTABMAP_CORE_CLOUDTILEASSEMBLER_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/pcl_base.h>
+#include <rtabmap/core/ProgressState.h>
+#include <map>
+#include <string>
+
+namespace rtabmap {
+
+/**
+ * Out-of-core assembly of large point clouds. Clouds (already in map frame)
+ * are voxelized on the fly in spatial tiles, so that each node can be
+ * released after being added. When the voxels in RAM exceed the memory
+ * budget, the biggest tiles are spilled to temporary files. The result
+ * is written tile by tile, so only one tile is loaded at the same time.
+ */
+class RTABMAP_EXP CloudTileAssembler {
+public:
+	/**
+	 * @param voxelSize voxel size of the assembled cloud, 0 to keep all points.
+	 * @param tileSize size of the spatial tiles (m).
+	 * @param memoryBudget maximum memory (MB) used by voxels kept in RAM.
+	 * @param tmpDirectory directory where tiles are spilled.
+	 */
+	CloudTileAssembler(
+			float voxelSize,
+			float tileSize = 10.0f,
+			int memoryBudget = 1024,
+			const std::string & tmpDirectory = ".");
+	virtual ~CloudTileAssembler();
+
+	void addCloud(
+			const pcl::PointCloud<pcl::PointXYZRGBNormal> & cloud,
+			const pcl::IndicesPtr & indices = pcl::IndicesPtr());
+
+	/**
+	 * Write the assembled cloud in a binary PLY file, tile by tile.
+	 * Spilled files are removed afterwards, the assembler is empty after this call.
+	 * @return number of points written, -1 on error (including a failed spill, see spillFailed()).
+	 */
+	long writePLY(const std::string & path, bool withNormals = true, const ProgressState * state = 0);
+
+	void clear();
+
+	size_t memoryUsed() const; // bytes
+	int tiles() const;
+	int spilledTiles() const {return (int)spilledTiles_.size();}
+	unsigned long spilledVoxels() const {return spilledVoxels_;}
+	bool spillFailed() const {return spillFailed_;}
+	unsigned long rejectedPoints() const {return rejectedPoints_;} // too far from origin to be keyed
+
+private:
+	struct Voxel
+	{
+		Voxel() : x(0), y(0), z(0), r(0), g(0), b(0), nx(0), ny(0), nz(0), count(0) {}
+		double x, y, z;
+		float r, g, b;
+		float nx, ny, nz;
+		int count;
+		void add(const Voxel & v);
+	};
+	typedef std::map<long long, Voxel> Tile;
+
+	bool tileKey(float x, float y, float z, long long & key) const;
+	bool voxelKey(float x, float y, float z, long long & key) const;
+	std::string spillPath(long long tileKey) const;
+	void spill();
+	bool loadSpilled(long long tileKey, Tile & tile) const;
+
+private:
+	float voxelSize_;
+	float tileSize_;
+	size_t memoryBudget_;
+	std::string tmpDirectory_;
+	std::map<long long, Tile> tiles_;
+	size_t voxelsInRAM_;
+	std::map<long long, unsigned long> spilledTiles_; // tile key, voxels spilled
+	unsigned long spilledVoxels_;
+	unsigned long pointIndex_; // used as voxel key when voxel size is 0
+	bool spillFailed_;
+	unsigned long rejectedPoints_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORELIB_INCLUDE_RTABMAP_CORE_CLOUDTILEASSEMBLER_H_ */
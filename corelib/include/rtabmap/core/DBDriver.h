@@ -77,7 +77,10 @@ public:
 	void asyncSave(Signature * s); //ownership transferred
 	void asyncSave(VisualWord * vw); //ownership transferred
 	void emptyTrashes(bool async = false);
-	double getEmptyTrashesTime() const {return _emptyTrashesTime;}
+	double getEmptyTrashesTime() const;
+	double getMaxCommitTime() const; // longest transaction of the last emptyTrashes()
+	int getTrashesSize() const; // nodes and words waiting to be saved
+	bool isGroupCommitEnabled() const {return _groupCommitSize > 0;}
 	void setTimestampUpdateEnabled(bool enabled) {_timestampUpdate = enabled;} // used on Update Signature and Word queries
 
 	// Warning: the following functions don't look in the trash, direct database modifications
@@ -85,6 +88,7 @@ public:
 			const std::string & fileName,
 			const std::set<int> & ids = std::set<int>(),
 			const std::map<int, Signature *> & otherSignatures = std::map<int, Signature *>());
+	// Links: the trash is saved first if one of the nodes is still in it
 	void addLink(const Link & link);
 	void removeLink(int from, int to);
 	void updateLink(const Link & link);
@@ -170,10 +174,12 @@ public:
 	bool getLaserScanInfo(int signatureId, LaserScan & info) const;
 	bool getNodeInfo(int signatureId, Transform & pose, int & mapId, int & weight, std::string & label, double & stamp, Transform & groundTruthPose, std::vector<float> & velocity, GPS & gps, EnvSensors & sensors) const;
 	void loadLinks(int signatureId, std::multimap<int, Link> & links, Link::Type type = Link::kUndef) const;
+	void loadLinkTypes(int signatureId, std::multimap<int, Link::Type> & links, bool withLandmarks = false) const; // <to id, type>, transforms are not loaded
 	void getWeight(int signatureId, int & weight) const;
 	void getLastNodeIds(std::set<int> & ids) const;
 	void getAllNodeIds(std::set<int> & ids, bool ignoreChildren = false, bool ignoreBadSignatures = false) const;
 	void getAllLinks(std::multimap<int, Link> & links, bool ignoreNullLinks = true, bool withLandmarks = false) const;
+	void getAllLinkTypes(std::multimap<int, std::pair<int, Link::Type> > & links, bool withLandmarks = false) const; // <from id, <to id, type> >, transforms are not loaded
 	void getLastNodeId(int & id) const;
 	void getLastMapId(int & mapId) const;
 	void getLastWordId(int & id) const;
@@ -269,6 +275,7 @@ protected:
 	virtual void loadSignaturesQuery(const std::list<int> & ids, std::list<Signature *> & signatures) const = 0;
 	virtual void loadWordsQuery(const std::set<int> & wordIds, std::list<VisualWord *> & vws) const = 0;
 	virtual void loadLinksQuery(int signatureId, std::multimap<int, Link> & links, Link::Type type = Link::kUndef) const = 0;
+	virtual void loadLinkTypesQuery(int signatureId, std::multimap<int, Link::Type> & links, bool withLandmarks) const = 0;
 
 	virtual void loadNodeDataQuery(std::list<Signature *> & signatures, bool images=true, bool scan=true, bool userData=true, bool occupancyGrid=true) const = 0;
 	virtual bool getCalibrationQuery(int signatureId, std::vector<CameraModel> & models, StereoCameraModel & stereoModel) const = 0;
@@ -277,6 +284,7 @@ protected:
 	virtual void getLastNodeIdsQuery(std::set<int> & ids) const = 0;
 	virtual void getAllNodeIdsQuery(std::set<int> & ids, bool ignoreChildren, bool ignoreBadSignatures) const = 0;
 	virtual void getAllLinksQuery(std::multimap<int, Link> & links, bool ignoreNullLinks, bool withLandmarks) const = 0;
+	virtual void getAllLinkTypesQuery(std::multimap<int, std::pair<int, Link::Type> > & links, bool withLandmarks) const = 0;
 	virtual void getLastIdQuery(const std::string & tableName, int & id, const std::string & fieldName="id") const = 0;
 	virtual void getInvertedIndexNiQuery(int signatureId, int & ni) const = 0;
 	virtual void getNodesObservingLandmarkQuery(int landmarkId, std::map<int, Link> & nodes) const = 0;
@@ -291,6 +299,9 @@ private:
 	//thread stuff
 	virtual void mainLoop();
 
+private:
+	void saveTrashesIfLinked(int from, int to);
+
 private:
 	UMutex _transactionMutex;
 	std::map<int, Signature *> _trashSignatures;//<id, Signature*>
@@ -298,7 +309,9 @@ private:
 	UMutex _trashesMutex;
 	UMutex _dbSafeAccessMutex;
 	USemaphore _addSem;
-	double _emptyTrashesTime;
+	double _emptyTrashesTime; // protected by _trashesMutex
+	double _maxCommitTime; // protected by _trashesMutex
+	unsigned long _groupCommitSize; // bytes
 	std::string _url;
 	bool _timestampUpdate;
 };
@@ -49,6 +49,13 @@ public:
 	void setCacheSize(unsigned int cacheSize);
 	void setSynchronous(int synchronous);
 	void setTempStore(int tempStore);
+	void setMmapSize(int mmapSize); // MB
+	void setReadOnly(bool readOnly);
+	bool isReadOnly() const {return _readOnly;}
+	void setStatementCache(bool enabled); // enabled by default, statements are prepared on each call if disabled
+	bool isStatementCacheEnabled() const {return _stmtCacheEnabled;}
+	unsigned long getStatementCacheHits() const {return _stmtCacheHits;}
+	unsigned long getStatementCacheMisses() const {return _stmtCacheMisses;}
 
 protected:
 	virtual bool connectDatabaseQuery(const std::string & url, bool overwritten = false);
@@ -135,6 +142,7 @@ protected:
 	virtual void loadSignaturesQuery(const std::list<int> & ids, std::list<Signature *> & signatures) const;
 	virtual void loadWordsQuery(const std::set<int> & wordIds, std::list<VisualWord *> & vws) const;
 	virtual void loadLinksQuery(int signatureId, std::multimap<int, Link> & links, Link::Type type = Link::kUndef) const;
+	virtual void loadLinkTypesQuery(int signatureId, std::multimap<int, Link::Type> & links, bool withLandmarks) const;
 
 	virtual void loadNodeDataQuery(std::list<Signature *> & signatures, bool images=true, bool scan=true, bool userData=true, bool occupancyGrid=true) const;
 	virtual bool getCalibrationQuery(int signatureId, std::vector<CameraModel> & models, StereoCameraModel & stereoModel) const;
@@ -143,6 +151,7 @@ protected:
 	virtual void getLastNodeIdsQuery(std::set<int> & ids) const;
 	virtual void getAllNodeIdsQuery(std::set<int> & ids, bool ignoreChildren, bool ignoreBadSignatures) const;
 	virtual void getAllLinksQuery(std::multimap<int, Link> & links, bool ignoreNullLinks, bool withLandmarks) const;
+	virtual void getAllLinkTypesQuery(std::multimap<int, std::pair<int, Link::Type> > & links, bool withLandmarks) const;
 	virtual void getLastIdQuery(const std::string & tableName, int & id, const std::string & fieldName="id") const;
 	virtual void getInvertedIndexNiQuery(int signatureId, int & ni) const;
 	virtual void getNodesObservingLandmarkQuery(int landmarkId, std::map<int, Link> & nodes) const;
@@ -184,6 +193,11 @@ private:
 	void loadLinksQuery(std::list<Signature *> & signatures) const;
 	int loadOrSaveDb(sqlite3 *pInMemory, const std::string & fileName, int isSave) const;
 
+	// Prepared statements kept for the lifetime of the connection. The
+	// query string (depending on the database version) is the key.
+	sqlite3_stmt * getCachedStatement(const std::string & query) const;
+	void releaseCachedStatement(sqlite3_stmt * ppStmt) const;
+
 protected:
 	sqlite3 * _ppDb;
 	std::string _version;
@@ -195,6 +209,13 @@ private:
 	int _journalMode;
 	int _synchronous;
 	int _tempStore;
+	int _mmapSize;
+	bool _readOnly;
+
+	bool _stmtCacheEnabled;
+	mutable std::map<std::string, sqlite3_stmt *> _stmtCache;
+	mutable unsigned long _stmtCacheHits;
+	mutable unsigned long _stmtCacheMisses;
 };
 
 }
@@ -42,6 +42,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace rtabmap {
 
 class DBDriver;
+class DBReaderPrefetcher;
 
 class RTABMAP_EXP DBReader : public Camera {
 public:
@@ -71,6 +72,19 @@ public:
 	virtual std::string getSerial() const;
 	virtual bool odomProvided() const {return !_odometryIgnored;}
 
+	/**
+	 * Open the database read-only (immutable, no locking) with "mmapSize" MB
+	 * of the file memory-mapped (0=mmap disabled). Should be called before init().
+	 */
+	void setReadOnly(bool enabled, int mmapSize = 0);
+	/**
+	 * Number of nodes loaded ahead (in id order) on a background
+	 * thread (0=disabled). If decodeThreads>0, data of the loaded nodes
+	 * are decompressed in parallel by that number of threads. Frames are
+	 * still returned in id order. Should be called before init().
+	 */
+	void setPrefetchSize(int size, int decodeThreads = 0);
+
 protected:
 	virtual SensorData captureImage(CameraInfo * info = 0);
 
@@ -95,6 +109,12 @@ private:
 	double _previousStamp;
 	int _previousMapID;
 	bool _calibrated;
+
+	bool _readOnly;
+	int _mmapSize;
+	int _prefetchSize;
+	int _decodeThreads;
+	DBReaderPrefetcher * _prefetcher;
 };
 
 } /* namespace rtabmap */
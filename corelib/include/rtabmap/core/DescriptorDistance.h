@@ -0,0 +1,53 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_DESCRIPTORDISTANCE_H_
+#define CORELIB_DESCRIPTORDISTANCE_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+namespace rtabmap {
+
+/**
+ * Distance kernels between descriptors, vectorized with SSE2 on x86
+ * and NEON on ARM when available (scalar code otherwise).
+ */
+
+// Squared euclidean distance between float vectors
+float RTABMAP_EXP descriptorDistanceL2Sqr(const float * a, const float * b, int size);
+
+// Dot product between float vectors
+float RTABMAP_EXP descriptorDotProduct(const float * a, const float * b, int size);
+
+// Hamming distance between binary descriptors of "size" bytes. On x86, the
+// POPCNT instruction or a SSSE3 nibble lookup table is used, selected at
+// run time when not enabled at compile time.
+int RTABMAP_EXP descriptorDistanceHamming(const unsigned char * a, const unsigned char * b, int size);
+
+} // namespace rtabmap
+
+#endif /* CORELIB_DESCRIPTORDISTANCE_H_ */
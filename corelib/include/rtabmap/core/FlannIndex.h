@@ -71,6 +71,17 @@ public:
 
 	bool isBuilt();
 
+	// Save the built index (not the features) to a file.
+	bool save(const std::string & path) const;
+	// Load an index saved with save(), "features" should be the
+	// same matrix used to build the saved index. The index keeps
+	// a reference to it like the build functions.
+	bool load(
+			const std::string & path,
+			const cv::Mat & features,
+			bool useDistanceL1 = false,
+			float rebalancingFactor = 2.0f);
+
 	int featuresType() const {return featuresType_;}
 	int featuresDim() const {return featuresDim_;}
 
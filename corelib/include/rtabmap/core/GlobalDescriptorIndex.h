@@ -0,0 +1,102 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_GLOBALDESCRIPTORINDEX_H_
+#define CORELIB_GLOBALDESCRIPTORINDEX_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+#include <list>
+#include <map>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace rtabmap {
+
+/**
+ * Global descriptors (e.g., NetVLAD from PyDescriptor) of a set of nodes kept
+ * in a contiguous float matrix, one row per node, searched by brute force with
+ * the SIMD kernels of DescriptorDistance.h. Adding or removing a node is O(dim)
+ * (the last row is moved in place of the removed one), so that the index can
+ * follow the nodes entering and leaving the Working Memory.
+ *
+ * Scores are higher for more similar descriptors: the inner product, or
+ * the negative squared L2 distance.
+ */
+class RTABMAP_EXP GlobalDescriptorIndex
+{
+public:
+	enum Metric {kInnerProduct, kL2};
+
+public:
+	// If normalized, descriptors and queries are L2 normalized, so that
+	// the inner product is the cosine similarity.
+	GlobalDescriptorIndex(Metric metric = kInnerProduct, bool normalized = true);
+	virtual ~GlobalDescriptorIndex();
+
+	void clear();
+
+	// The descriptor is converted to a row of CV_32FC1. Return false if the id
+	// is already indexed or if the size is not the same than other descriptors.
+	bool add(int id, const cv::Mat & descriptor);
+	bool remove(int id);
+	bool contains(int id) const {return rows_.find(id) != rows_.end();}
+
+	Metric metric() const {return metric_;}
+	bool isNormalized() const {return normalized_;}
+	int size() const {return (int)ids_.size();}
+	int dim() const {return data_.cols;}
+	const std::vector<int> & ids() const {return ids_;} // row order
+
+	// return Bytes
+	unsigned long memoryUsed() const;
+
+	// For each query row, ids (CV_32SC1) and scores (CV_32FC1) of the k best
+	// nodes sorted by decreasing score. Ids are -1 if less than k nodes are indexed.
+	void knnSearch(
+			const cv::Mat & queries,
+			cv::Mat & ids,
+			cv::Mat & scores,
+			int k) const;
+
+	// Scores of the query with the nodes of the list, nodes not indexed are ignored.
+	std::map<int, float> scores(const cv::Mat & query, const std::list<int> & ids) const;
+
+private:
+	cv::Mat prepare(const cv::Mat & descriptor) const;
+	float score(const float * a, const float * b) const;
+
+private:
+	Metric metric_;
+	bool normalized_;
+	cv::Mat data_; // first ids_.size() rows are used, others are reserved
+	std::vector<int> ids_; // <row, id>
+	std::map<int, int> rows_; // <id, row>
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORELIB_GLOBALDESCRIPTORINDEX_H_ */
@@ -0,0 +1,88 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_INCLUDE_RTABMAP_CORE_LOCALIZATIONSNAPSHOT_H_
+#define CORELIB_INCLUDE_RTABMAP_CORE_LOCALIZATIONSNAPSHOT_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <list>
+#include <map>
+#include <string>
+
+namespace rtabmap {
+
+class DBDriver;
+class Signature;
+class VisualWord;
+class VWDictionary;
+
+/**
+ * Binary snapshot of the nodes (poses, links, words, calibration), of the
+ * vocabulary and of its inverted index loaded in the working memory of a
+ * database. Sections are stored contiguously so that they are copied from the
+ * memory-mapped file without parsing on startup in localization mode. The search
+ * index of the vocabulary is saved beside the snapshot ("path.flann") when the
+ * dictionary strategy supports it. The snapshot keeps a fingerprint of the
+ * database it was generated from (last node, map and word IDs, nodes and words
+ * counts, file size and modification time), it is rejected if the database has
+ * been modified afterwards.
+ */
+class RTABMAP_EXP LocalizationSnapshot {
+public:
+	static const int kVersion;
+
+	/**
+	 * @param allNodesInWM true if the signatures were loaded with Mem/InitWMWithAllNodes.
+	 */
+	static bool save(
+			const std::string & path,
+			const DBDriver & dbDriver,
+			const std::map<int, Signature *> & signatures,
+			const VWDictionary & dictionary,
+			bool allNodesInWM);
+
+	/**
+	 * Returned signatures and words must be freed after usage. Nothing is
+	 * returned if the snapshot doesn't match the database or the options.
+	 * Words already have their references to the returned signatures.
+	 * @param indexPath the search index saved with the snapshot, empty if
+	 *        there is none (see VWDictionary::loadIndex()).
+	 */
+	static bool load(
+			const std::string & path,
+			const DBDriver & dbDriver,
+			bool allNodesInWM,
+			bool incrementalDictionary,
+			std::list<Signature *> & signatures,
+			std::list<VisualWord *> & words,
+			std::string & indexPath);
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORELIB_INCLUDE_RTABMAP_CORE_LOCALIZATIONSNAPSHOT_H_ */
@@ -58,6 +58,7 @@ class RegistrationIcp;
 class Stereo;
 class OccupancyGrid;
 class MarkerDetector;
+class GlobalDescriptorIndex;
 
 class RTABMAP_EXP Memory
 {
@@ -180,6 +181,9 @@ public:
 	std::string getDatabaseVersion() const;
 	std::string getDatabaseUrl() const;
 	double getDbSavingTime() const;
+	double getDbMaxCommitTime() const;
+	int getDbTrashSize() const;
+	bool isDbWriteBehind() const;
 	int getMapId(int id, bool lookInDatabase = false) const;
 	Transform getOdomPose(int signatureId, bool lookInDatabase = false) const;
 	Transform getGroundTruthPose(int signatureId, bool lookInDatabase = false) const;
@@ -219,6 +223,8 @@ public:
 	int getLastGlobalLoopClosureId() const {return _lastGlobalLoopClosureId;}
 	const Feature2D * getFeature2D() const {return _feature2D;}
 	bool isGraphReduced() const {return _reduceGraph;}
+	unsigned int getGraphRevision() const {return _graphRevision;}
+	unsigned int getGraphRevision(int id) const; // 0 if the node and its links didn't change since the memory has been initialized
 	const std::vector<double> & getOdomMaxInf() const {return _odomMaxInf;}
 	bool isOdomGravityUsed() const {return _useOdometryGravity;}
 
@@ -226,6 +232,7 @@ public:
 	virtual void dumpMemory(std::string directory) const;
 	virtual void dumpSignatures(const char * fileNameSign, bool words3D) const;
 	void dumpDictionary(const char * fileNameRef, const char * fileNameDesc) const;
+	bool saveLocalizationSnapshot(const std::string & path) const;
 	unsigned long getMemoryUsed() const; //Bytes
 
 	void generateGraph(const std::string & fileName, const std::set<int> & ids = std::set<int>());
@@ -250,14 +257,61 @@ public:
 			RegistrationInfo * info = 0);
 
 private:
+	// Transfer priority of WM nodes: less weighted first, then oldest, then smallest id
+	class WeightAgeIdKey
+	{
+	public:
+		WeightAgeIdKey(int w, double a, int i) :
+			weight(w),
+			age(a),
+			id(i){}
+		bool operator<(const WeightAgeIdKey & k) const
+		{
+			if(weight < k.weight)
+			{
+				return true;
+			}
+			else if(weight == k.weight)
+			{
+				if(age < k.age)
+				{
+					return true;
+				}
+				else if(age == k.age)
+				{
+					if(id < k.id)
+					{
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+		int weight, age, id;
+	};
+
 	void preUpdate();
 	void addSignatureToStm(Signature * signature, const cv::Mat & covariance);
 	void clear();
 	void loadDataFromDb(bool postInitClosingEvents);
 	void moveToTrash(Signature * s, bool keepLinkedToGraph = true, std::list<int> * deletedWords = 0);
+	void loadLtmTopology();
+	void clearLtmTopology();
+	void compactLtmTopology();
+	bool getLtmTopology(int id, bool withLandmarks, std::vector<std::pair<int, Link::Type> > & neighbors, std::vector<int> & landmarks) const;
+	void updateLtmTopology(const Signature & s);
+	void updateLtmTopology(const Link & link);
+	void updateGraphRevision(int id);
+	void updateGraphRevision(const Signature & s); // the node and the nodes linked to it
 
 	void moveSignatureToWMFromSTM(int id, int * reducedTo = 0);
 	void addSignatureToWmFromLTM(Signature * signature);
+	void addToWorkingMem(int id, double age, int weight);
+	void removeFromWorkingMem(int id);
+	void indexGlobalDescriptor(const Signature * s);
+	std::map<int, float> computeWordsLikelihood(const Signature * signature, const std::list<int> & ids);
+	void updateWeight(Signature * s, int weight);
+	void rebuildTransferIndex();
 	Signature * _getSignature(int id) const;
 	std::list<Signature *> getRemovableSignatures(int count,
 			const std::set<int> & ignoredIds = std::set<int>());
@@ -295,6 +349,8 @@ private:
 	std::string _rgbCompressionFormat;
 	bool _incrementalMemory;
 	bool _localizationDataSaved;
+	bool _localizationFastPath;
+	std::string _localizationSnapshotPath;
 	bool _reduceGraph;
 	int _maxStMemSize;
 	float _recentWmRatio;
@@ -324,6 +380,9 @@ private:
 	bool _imagesAlreadyRectified;
 	bool _rectifyOnlyFeatures;
 	bool _covOffDiagonalIgnored;
+	bool _topologyCached;
+	int _globalDescriptorLikelihood;
+	int _globalDescriptorTopK;
 	bool _detectMarkers;
 	float _markerLinVariance;
 	float _markerAngVariance;
@@ -331,9 +390,12 @@ private:
 	int _idCount;
 	int _idMapCount;
 	Signature * _lastSignature;
+	std::pair<int, int> _lastFastPathUnmatchedWords; // <node id, features quantized without matching word> of the last node created by the localization fast path
 	int _lastGlobalLoopClosureId;
 	bool _memoryChanged; // False by default, become true only when Memory::update() is called.
 	bool _linksChanged; // False by default, become true when links are modified.
+	unsigned int _graphRevision; // incremented each time a node or a link is added, modified or removed, never reset
+	std::map<int, unsigned int> _nodeRevisions; // <id, _graphRevision of the last change of the node or of its links>
 	int _signaturesAdded;
 	bool _allNodesInWM;
 	GPS _gpsOrigin;
@@ -344,13 +406,27 @@ private:
 	std::map<int, Signature *> _signatures; // TODO : check if a signature is already added? although it is not supposed to occur...
 	std::set<int> _stMem; // id
 	std::map<int, double> _workingMem; // id,age
+	std::set<WeightAgeIdKey> _transferIndex; // WM nodes sorted by transfer priority
+	std::map<int, std::set<WeightAgeIdKey>::iterator> _transferIndexIters; // <id, entry in _transferIndex>
+	int _recentWmBoundaryId; // _lastGlobalLoopClosureId when _recentWmCount was computed
+	int _recentWmCount; // nodes in WM from _recentWmBoundaryId to the most recent one
 	std::map<int, Transform> _groundTruths;
 	std::map<int, std::string> _labels;
 	std::map<int, std::set<int> > _landmarksIndex;         // <nodeId, landmarkIds>
 	std::map<int, std::set<int> > _landmarksInvertedIndex; // <landmarkId, nodeIds>
 
+	// Compact adjacency (CSR) of the nodes in database: row i of node _ltmTopologyIds[i] is
+	// [_ltmTopologyOffsets[i], _ltmTopologyOffsets[i+1]) in _ltmTopologyNeighbors/_ltmTopologyTypes
+	bool _ltmTopologyLoaded;
+	std::vector<int> _ltmTopologyIds; // sorted
+	std::vector<unsigned int> _ltmTopologyOffsets;
+	std::vector<int> _ltmTopologyNeighbors; // landmarks are negative
+	std::vector<unsigned char> _ltmTopologyTypes;
+	std::map<int, std::vector<std::pair<int, unsigned char> > > _ltmTopologyUpdated; // rows modified since last compaction
+
 	//Keypoint stuff
 	VWDictionary * _vwd;
+	GlobalDescriptorIndex * _globalDescriptorIndex; // first global descriptor of the nodes in WM
 	Feature2D * _feature2D;
 	float _badSignRatio;
 	bool _tfIdfLikelihoodUsed;
@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/Transform.h>
 #include <rtabmap/core/SensorData.h>
 #include <rtabmap/core/Parameters.h>
+#include <set>
 
 namespace rtabmap {
 
@@ -87,6 +88,7 @@ private:
 	void initKalmanFilter(const Transform & initialPose = Transform::getIdentity(), float vx=0.0f, float vy=0.0f, float vz=0.0f, float vroll=0.0f, float vpitch=0.0f, float vyaw=0.0f);
 	void predictKalmanFilter(float dt, float * vx=0, float * vy=0, float * vz=0, float * vroll=0, float * vpitch=0, float * vyaw=0);
 	void updateKalmanFilter(float & vx, float & vy, float & vz, float & vroll, float & vpitch, float & vyaw);
+	void exportTrace();
 
 private:
 	int _resetCountdown;
@@ -107,6 +109,11 @@ private:
 	bool _alignWithGround;
 	bool _publishRAMUsage;
 	bool _imagesAlreadyRectified;
+	int _traceFrames;
+	int _traceFrameCount;
+	int _traceExported;
+	bool _traceEnabled; // UProfiler enabled by this instance
+	std::set<unsigned long> _traceThreads; // threads in which process() has been called while tracing
 	Transform _pose;
 	int _resetCurrentCount;
 	double previousStamp_;
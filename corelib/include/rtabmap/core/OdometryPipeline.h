@@ -0,0 +1,135 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_INCLUDE_RTABMAP_CORE_ODOMETRYPIPELINE_H_
+#define CORELIB_INCLUDE_RTABMAP_CORE_ODOMETRYPIPELINE_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include "rtabmap/core/SensorData.h"
+#include "rtabmap/core/CameraInfo.h"
+#include "rtabmap/core/OdometryInfo.h"
+#include "rtabmap/core/Transform.h"
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/USemaphore.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <list>
+#include <map>
+#include <string>
+
+namespace rtabmap {
+
+class CameraThread;
+class Odometry;
+class OdometryPipelineStage;
+
+/**
+ * Run data acquisition (Camera::takeImage() and CameraThread::postUpdate()) and
+ * odometry on their own threads, connected by bounded queues. The caller takes
+ * the frames with their odometry pose in acquisition order with take(), then
+ * calls Rtabmap::process() on its thread. In max speed mode, a stage waits when
+ * the next queue is full, so no frames are lost. Otherwise, when mapping is slower
+ * than the input rate, the oldest frame waiting for mapping is dropped. Frames
+ * on which odometry has been reset (covariance >= 9999) are never dropped.
+ */
+class RTABMAP_EXP OdometryPipeline
+{
+public:
+	struct Frame
+	{
+		SensorData data;
+		CameraInfo cameraInfo;
+		OdometryInfo odomInfo;
+		Transform pose; // odometry pose, or CameraInfo::odomPose if there is no odometry
+		cv::Mat covariance;
+		std::vector<float> velocity;
+	};
+
+public:
+	/**
+	 * @param camera CameraThread (not started) used to take and post-process the data. Ownership is not transferred.
+	 * @param odometry If null, the odometry provided by the camera (CameraInfo::odomPose) is used. Ownership is not transferred.
+	 * @param queueSize Maximum frames waiting between two stages.
+	 * @param maxSpeed See class description.
+	 */
+	OdometryPipeline(CameraThread * camera, Odometry * odometry = 0, int queueSize = 5, bool maxSpeed = true);
+	virtual ~OdometryPipeline();
+
+	// Skip # frames after each frame taken, skipped frames are not post-processed and not sent to odometry
+	void setFramesSkipped(int frames) {_framesSkipped = frames;}
+	// Clear the laser scan of the data before CameraThread::postUpdate(), so that it is regenerated from depth
+	void setLaserScanRegenerated(bool enabled) {_laserScanRegenerated = enabled;}
+
+	void start();
+	void stop();
+
+	/**
+	 * Blocking until the next frame is ready. Return false when there are no more frames.
+	 */
+	bool take(Frame & frame);
+
+	int getDroppedFrames() const {return _droppedFrames;}
+
+	/**
+	 * Ratio of time spent processing (not waiting on the queues) since start()
+	 * for "Acquisition", "Odometry" and "Mapping" (time outside take()) stages.
+	 */
+	std::map<std::string, float> getUtilization() const;
+
+private:
+	friend class OdometryPipelineStage;
+	bool acquire();
+	bool processOdometry();
+	void push(int queue, Frame * frame);
+	bool pop(int queue, Frame *& frame);
+	void wakeUp();
+
+private:
+	CameraThread * _camera;
+	Odometry * _odometry;
+	int _queueSize;
+	bool _maxSpeed;
+	int _framesSkipped;
+	bool _laserScanRegenerated;
+	OdometryPipelineStage * _acquisitionThread;
+	OdometryPipelineStage * _odometryThread;
+	std::list<Frame*> _queues[2]; // acquisition -> odometry -> mapping, null frame is end of data
+	UMutex _queuesMutex;
+	USemaphore _queuesFree[2];
+	USemaphore _queuesReady[2];
+	bool _stopping;
+	bool _finished;
+	int _droppedFrames;
+	mutable UTimer _timer;
+	mutable UMutex _timeMutex;
+	double _busyTime[2];
+	double _waitingTime; // in take()
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORELIB_INCLUDE_RTABMAP_CORE_ODOMETRYPIPELINE_H_ */
@@ -91,6 +91,10 @@ public:
 	bool priorsIgnored() const {return priorsIgnored_;}
 	bool landmarksIgnored() const {return landmarksIgnored_;}
 	float gravitySigma() const {return gravitySigma_;}
+	bool isIncremental() const {return incremental_;}
+	bool isHierarchical() const {return hierarchical_;}
+	int hierarchicalMaxSize() const {return hierarchicalMaxSize_;}
+	bool isHierarchicalCompareFlat() const {return hierarchicalCompareFlat_;}
 
 	// setters
 	void setIterations(int iterations) {iterations_ = iterations;}
@@ -101,6 +105,10 @@ public:
 	void setPriorsIgnored(bool enabled) {priorsIgnored_ = enabled;}
 	void setLandmarksIgnored(bool enabled) {landmarksIgnored_ = enabled;}
 	void setGravitySigma(float value) {gravitySigma_ = value;}
+	void setIncremental(bool enabled) {incremental_ = enabled;}
+	void setHierarchical(bool enabled) {hierarchical_ = enabled;}
+	void setHierarchicalMaxSize(int value) {hierarchicalMaxSize_ = value;}
+	void setHierarchicalCompareFlat(bool enabled) {hierarchicalCompareFlat_ = enabled;}
 
 	virtual void parseParameters(const ParametersMap & parameters);
 
@@ -120,6 +128,42 @@ public:
 				double * finalError = 0,
 				int * iterationsDone = 0);
 
+	// Persistent incremental optimization: the graph is kept between calls, only
+	// the difference with the previous graph is applied and optimization starts
+	// from the previous solution. Default implementation is batch optimization.
+	virtual std::map<int, Transform> optimizePersistent(
+				int rootId,
+				const std::map<int, Transform> & poses,
+				const std::multimap<int, Link> & constraints,
+				cv::Mat & outputCovariance,
+				double * finalError = 0,
+				int * iterationsDone = 0);
+	virtual void resetPersistent() {}
+	virtual double persistentUpdateTime() const {return 0.0;} // seconds, last graph update of optimizePersistent()
+
+	// Hierarchical optimization: the graph is partitioned in sub-maps (maps/sessions
+	// connected by neighbor links, split in chunks of at most hierarchicalMaxSize() poses),
+	// sub-maps are optimized independently in parallel, then the graph of their
+	// anchors linked by the inter sub-map links is optimized and the correction
+	// of each anchor is propagated to its sub-map. Flat optimization is done
+	// if there is only one sub-map or if the graph has priors, gravity or landmarks.
+	std::map<int, Transform> optimizeHierarchical(
+				int rootId,
+				const std::map<int, Transform> & poses,
+				const std::multimap<int, Link> & constraints,
+				cv::Mat & outputCovariance,
+				double * finalError = 0,
+				int * iterationsDone = 0);
+	// statistics of the last optimizeHierarchical() call
+	int hierarchicalPartitions() const {return hierarchicalPartitions_;}
+	double hierarchicalSubmapsTime() const {return hierarchicalSubmapsTime_;} // seconds
+	double hierarchicalSeparatorsTime() const {return hierarchicalSeparatorsTime_;} // seconds
+	double hierarchicalSubmapsError() const {return hierarchicalSubmapsError_;}
+	double hierarchicalSeparatorsError() const {return hierarchicalSeparatorsError_;}
+	double hierarchicalFlatError() const {return hierarchicalFlatError_;} // error of all links at the hierarchical solution, as minimized by flat optimization
+	double hierarchicalReferenceError() const {return hierarchicalReferenceError_;} // error of flat optimization, -1 if not computed (see isHierarchicalCompareFlat())
+	double hierarchicalReferenceTime() const {return hierarchicalReferenceTime_;} // seconds
+
 	// inherited classes should implement one of these methods
 	virtual std::map<int, Transform> optimize(
 				int rootId,
@@ -190,6 +234,20 @@ private:
 	bool priorsIgnored_;
 	bool landmarksIgnored_;
 	float gravitySigma_;
+	bool incremental_;
+	bool hierarchical_;
+	int hierarchicalMaxSize_;
+	bool hierarchicalCompareFlat_;
+	ParametersMap parameters_; // to create sub-map optimizers
+
+	int hierarchicalPartitions_;
+	double hierarchicalSubmapsTime_;
+	double hierarchicalSeparatorsTime_;
+	double hierarchicalSubmapsError_;
+	double hierarchicalFlatError_;
+	double hierarchicalSeparatorsError_;
+	double hierarchicalReferenceError_;
+	double hierarchicalReferenceTime_;
 };
 
 } /* namespace rtabmap */
@@ -177,6 +177,7 @@ class RTABMAP_EXP Parameters
     RTABMAP_PARAM(Rtabmap, PublishRAMUsage,              bool, false, "Publishing RAM usage in statistics (may add a small overhead to get info from the system).");
     RTABMAP_PARAM(Rtabmap, ComputeRMSE,                  bool, true,  "Compute root mean square error (RMSE) and publish it in statistics, if ground truth is provided.");
     RTABMAP_PARAM(Rtabmap, SaveWMState,                  bool, false, "Save working memory state after each update in statistics.");
+    RTABMAP_PARAM(Rtabmap, TraceFrames,                  int, 0,      uFormat("Enable profiling zones and export them every X processed frames (0 means disabled) in \"%s\": as Chrome trace (rtabmap_trace_#.json, open in chrome://tracing) and as folded stacks for flame graphs (rtabmap_trace_#.folded). Zones of the threads running the map update are exported, with zones of worker threads not traced by odometry.", kRtabmapWorkingDirectory().c_str()));
     RTABMAP_PARAM(Rtabmap, TimeThr,                      float, 0,    "Maximum time allowed for map update (ms) (0 means infinity). When map update time exceeds this fixed time threshold, some nodes in Working Memory (WM) are transferred to Long-Term Memory to limit the size of the WM and decrease the update time.");
     RTABMAP_PARAM(Rtabmap, MemoryThr,                    int, 0,      uFormat("Maximum nodes in the Working Memory (0 means infinity). Similar to \"%s\", when the number of nodes in Working Memory (WM) exceeds this treshold, some nodes are transferred to Long-Term Memory to keep WM size fixed.", kRtabmapTimeThr().c_str()));
     RTABMAP_PARAM(Rtabmap, DetectionRate,                float, 1,    "Detection rate (Hz). RTAB-Map will filter input images to satisfy this rate.");
@@ -210,6 +211,8 @@ class RTABMAP_EXP Parameters
     RTABMAP_PARAM(Mem, STMSize,                   unsigned int, 10, "Short-term memory size.");
     RTABMAP_PARAM(Mem, IncrementalMemory,           bool, true,     "SLAM mode, otherwise it is Localization mode.");
     RTABMAP_PARAM(Mem, LocalizationDataSaved,       bool, false,     uFormat("Save localization data during localization session (when %s=false). When enabled, the database will then also grow in localization mode. This mode would be used only for debugging purpose.", kMemIncrementalMemory().c_str()).c_str());
+    RTABMAP_PARAM_STR(Mem, LocalizationSnapshot,    "",             uFormat("Path to a localization snapshot generated from the database with rtabmap-localization_snapshot. In localization mode (%s=false), nodes and words of the working memory are loaded from the snapshot instead of the database. The snapshot is ignored if the database has been modified since it has been generated.", kMemIncrementalMemory().c_str()).c_str());
+    RTABMAP_PARAM(Mem, LocalizationFastPath,        bool, false,    uFormat("In localization mode (%s=false), skip the work only needed to keep new nodes: features of the new node are quantized against the current dictionary without adding new words or references, its sensor data is not compressed (unless %s=true) and the likelihood is computed from the inverted index of the dictionary. Note that the published node data will only contain raw data.", kMemIncrementalMemory().c_str(), kMemLocalizationDataSaved().c_str()).c_str());
     RTABMAP_PARAM(Mem, ReduceGraph,                 bool, false,    "Reduce graph. Merge nodes when loop closures are added (ignoring those with user data set).");
     RTABMAP_PARAM(Mem, RecentWmRatio,               float, 0.2,     "Ratio of locations after the last loop closure in WM that cannot be transferred.");
     RTABMAP_PARAM(Mem, TransferSortingByWeightId,   bool, false,    "On transfer, signatures are sorted by weight->ID only (i.e. the oldest of the lowest weighted signatures are transferred first). If false, the signatures are sorted by weight->Age->ID (i.e. the oldest inserted in WM of the lowest weighted signatures are transferred first). Note that retrieval updates the age, not the ID.");
@@ -230,13 +233,23 @@ class RTABMAP_EXP Parameters
     RTABMAP_PARAM(Mem, UseOdomFeatures,             bool, true,     "Use odometry features instead of regenerating them.");
     RTABMAP_PARAM(Mem, UseOdomGravity,              bool, false,    uFormat("Use odometry instead of IMU orientation to add gravity links to new nodes created. We assume that odometry is already aligned with gravity (e.g., we are using a VIO approach). Gravity constraints are used by graph optimization only if \"%s\" is not zero.", kOptimizerGravitySigma().c_str()));
     RTABMAP_PARAM(Mem, CovOffDiagIgnored,           bool, true,     "Ignore off diagonal values of the covariance matrix.");
+    RTABMAP_PARAM(Mem, TopologyCached,              bool, true,     "Keep in RAM a compact adjacency (neighbor ids and link types) of all nodes in the database, so that graph traversals through nodes in Long-Term Memory don't query the database.");
+    RTABMAP_PARAM(Mem, GlobalDescriptorLikelihood,  int, 0,         uFormat("Use the global descriptors of the nodes (e.g., from PyDescriptor) for loop closure detection. The first global descriptor of each node in Working Memory is L2 normalized and kept in a contiguous matrix searched with SIMD inner products. 0=disabled, 1=the likelihood is the cosine similarity of the global descriptors instead of the visual words likelihood, 2=pre-filter: the visual words likelihood is only computed for the \"%s\" most similar nodes (likelihood of the other nodes is 0). Nodes without global descriptor have a likelihood of 0 with 1 and always get the visual words likelihood with 2. If the new node doesn't have a global descriptor, the visual words likelihood is computed for all nodes.", kMemGlobalDescriptorTopK().c_str()));
+    RTABMAP_PARAM(Mem, GlobalDescriptorTopK,        int, 50,        uFormat("Number of nodes kept by the global descriptor pre-filter (%s=2).", kMemGlobalDescriptorLikelihood().c_str()));
 
     // KeypointMemory (Keypoint-based)
-    RTABMAP_PARAM(Kp, NNStrategy,               int, 1,       "kNNFlannNaive=0, kNNFlannKdTree=1, kNNFlannLSH=2, kNNBruteForce=3, kNNBruteForceGPU=4");
+    RTABMAP_PARAM(Kp, NNStrategy,               int, 1,       "kNNFlannNaive=0, kNNFlannKdTree=1, kNNFlannLSH=2, kNNBruteForce=3, kNNBruteForceGPU=4, kNNVocabularyTree=5. The vocabulary tree is used only with a fixed dictionary (brute force is done otherwise), it is loaded from \"<dictionary>.tree\" if it exists (see rtabmap-vocabulary_tree tool), otherwise it is built when the dictionary is loaded.");
     RTABMAP_PARAM(Kp, IncrementalDictionary,    bool, true,   "");
     RTABMAP_PARAM(Kp, IncrementalFlann,         bool, true,   uFormat("When using FLANN based strategy, add/remove points to its index without always rebuilding the index (the index is built only when the dictionary increases of the factor \"%s\" in size).", kKpFlannRebalancingFactor().c_str()));
     RTABMAP_PARAM(Kp, FlannRebalancingFactor,   float, 2.0,   uFormat("Factor used when rebuilding the incremental FLANN index (see \"%s\"). Set <=1 to disable.", kKpIncrementalFlann().c_str()));
     RTABMAP_PARAM(Kp, ByteToFloat,              bool, false,  uFormat("For %s=1, binary descriptors are converted to float by converting each byte to float instead of converting each bit to float. When converting bytes instead of bits, less memory is used and search is faster at the cost of slightly less accurate matching.", kKpNNStrategy().c_str()));
+    RTABMAP_PARAM(Kp, PQSubQuantizers,          int, 0,       uFormat("Product quantization of the dictionary: number of sub-quantizers used to encode each visual word (one byte per sub-quantizer). Float descriptors are then searched with asymmetric distances on the codes instead of the index of \"%s\", which is used only until the dictionary has enough words to train the codebooks (40 x \"%s\"). Descriptor size should be a multiple of this value. 0 means disabled.", kKpNNStrategy().c_str(), kKpPQCentroids().c_str()));
+    RTABMAP_PARAM(Kp, PQCentroids,              int, 256,     uFormat("Number of centroids [2-256] of each sub-quantizer codebook (see \"%s\").", kKpPQSubQuantizers().c_str()));
+    RTABMAP_PARAM(Kp, PQCoarseCentroids,        int, 0,       uFormat("Number of centroids of the coarse quantizer (inverted lists) used with \"%s\" (IVF-ADC). Words are assigned to their nearest coarse centroid and only the lists of the \"%s\" centroids nearest to the query are searched. A value around the square root of the dictionary size is a good start. 0 means an exhaustive search of all codes.", kKpPQSubQuantizers().c_str(), kKpPQNProbe().c_str()));
+    RTABMAP_PARAM(Kp, PQNProbe,                 int, 8,       uFormat("Number of inverted lists searched per query when \"%s\" > 0. Higher values increase recall but search more codes.", kKpPQCoarseCentroids().c_str()));
+    RTABMAP_PARAM(Kp, PQRerank,                 int, 16,      uFormat("Number of nearest candidates found with quantized distances that are re-ranked with exact distances on their raw descriptors (see \"%s\"). 0 means no re-ranking.", kKpPQSubQuantizers().c_str()));
+    RTABMAP_PARAM(Kp, PQPagedDescriptors,       bool, false,  uFormat("With \"%s\" enabled and a fixed dictionary loaded from a database (\"%s\"), raw descriptors of the visual words are released from memory once quantized and are loaded back from the dictionary database only for re-ranking (see \"%s\").", kKpPQSubQuantizers().c_str(), kKpDictionaryPath().c_str(), kKpPQRerank().c_str()));
+    RTABMAP_PARAM(Kp, PQPagedCacheSize,         int, 10000,   uFormat("Maximum number of paged descriptors (see \"%s\") kept in memory once loaded back for re-ranking. The least recently used are released first. 0 means they are loaded back for every search.", kKpPQPagedDescriptors().c_str()));
     RTABMAP_PARAM(Kp, MaxDepth,                 float, 0,     "Filter extracted keypoints by depth (0=inf).");
     RTABMAP_PARAM(Kp, MinDepth,                 float, 0,     "Filter extracted keypoints by depth.");
     RTABMAP_PARAM(Kp, MaxFeatures,              int, 500,     "Maximum features extracted from the images (0 means not bounded, <0 means no extraction).");
@@ -260,11 +273,15 @@ class RTABMAP_EXP Parameters
     RTABMAP_PARAM(Kp, GridCols,                 int, 1,       uFormat("Number of columns of the grid used to extract uniformly \"%s / grid cells\" features from each cell.", kKpMaxFeatures().c_str()));
 
     //Database
+    RTABMAP_PARAM(Db, GroupCommitSize,     int, 0,           "Write-behind: maximum size (KB) of the nodes and words saved per transaction when the trash is emptied. Database reads can be done between transactions, so the trash doesn't need to be flushed before retrieval. Nodes and words added to the trash while it is emptied are saved on the next emptying. 0 means all the trash is saved in a single transaction.");
     RTABMAP_PARAM(DbSqlite3, InMemory,     bool, false,      "Using database in the memory instead of a file on the hard disk.");
     RTABMAP_PARAM(DbSqlite3, CacheSize, unsigned int, 10000, "Sqlite cache size (default is 2000).");
-    RTABMAP_PARAM(DbSqlite3, JournalMode,  int, 3,           "0=DELETE, 1=TRUNCATE, 2=PERSIST, 3=MEMORY, 4=OFF (see sqlite3 doc : \"PRAGMA journal_mode\")");
+    RTABMAP_PARAM(DbSqlite3, JournalMode,  int, 3,           "0=DELETE, 1=TRUNCATE, 2=PERSIST, 3=MEMORY, 4=OFF, 5=WAL (see sqlite3 doc : \"PRAGMA journal_mode\")");
     RTABMAP_PARAM(DbSqlite3, Synchronous,  int, 0,           "0=OFF, 1=NORMAL, 2=FULL (see sqlite3 doc : \"PRAGMA synchronous\")");
     RTABMAP_PARAM(DbSqlite3, TempStore,    int, 2,           "0=DEFAULT, 1=FILE, 2=MEMORY (see sqlite3 doc : \"PRAGMA temp_store\")");
+    RTABMAP_PARAM(DbSqlite3, MmapSize,     int, 0,           "Maximum size (MB) of the database file that can be memory-mapped (0=disabled, see sqlite3 doc : \"PRAGMA mmap_size\").");
+    RTABMAP_PARAM(DbSqlite3, ReadOnly,     bool, false,      "Open an existing database read-only with immutable and nolock flags. The file must not be modified by another process while opened. Ignored if the database is in memory.");
+    RTABMAP_PARAM(DbSqlite3, StatementCache, bool, true,     "Keep the prepared statements of the frequent queries to reuse them on next calls instead of preparing them again.");
 
     // Keypoints descriptors/detectors
     RTABMAP_PARAM(SURF, Extended,          bool, false,  "Extended descriptor flag (true - use extended 128-element descriptors; false - use 64-element descriptors).");
@@ -407,6 +424,10 @@ class RTABMAP_EXP Parameters
     RTABMAP_PARAM(Optimizer, Robust,          bool, false,     uFormat("Robust graph optimization using Vertigo (only work for g2o and GTSAM optimization strategies). Not compatible with \"%s\" if enabled.", kRGBDOptimizeMaxError().c_str()));
     RTABMAP_PARAM(Optimizer, PriorsIgnored,   bool, true,      "Ignore prior constraints (global pose or GPS) while optimizing. Currently only g2o and gtsam optimization supports this.");
     RTABMAP_PARAM(Optimizer, LandmarksIgnored,   bool, false,  "Ignore landmark constraints while optimizing. Currently only g2o and gtsam optimization supports this.");
+    RTABMAP_PARAM(Optimizer, Hierarchical,    bool, false,     "Partition the graph in sub-maps (maps connected by neighbor links, see also Optimizer/HierarchicalMaxSize) optimized independently in parallel, then optimize the graph of the sub-map anchors linked by the inter sub-map links and propagate the corrections. Approximate solution for very large multi-session graphs. Graphs with priors, gravity or landmarks constraints are optimized flat.");
+    RTABMAP_PARAM(Optimizer, HierarchicalMaxSize, int, 5000,   "Maximum poses per sub-map when Optimizer/Hierarchical is enabled, larger maps are split in chunks along their neighbor links. 0 means no limit (partition only by map).");
+    RTABMAP_PARAM(Optimizer, HierarchicalCompareFlat, bool, false, "When Optimizer/Hierarchical is enabled, also optimize the whole graph flat after each hierarchical optimization to report its error and time in statistics (Loop/Optimization_reference_error, Timing/Map_optimization_reference). For evaluation only, the flat result is not used.");
+    RTABMAP_PARAM(Optimizer, Incremental,     bool, false,     "Keep the graph in the optimizer between map updates: only added/removed poses and links are applied to it, and optimization starts from the previous solution. Only the graph of the current map is kept, other graphs (e.g., proximity sub-graphs, global graph) are always optimized in batch. Currently only g2o and GTSAM (with iSAM2) support it (graphs with priors, gravity or landmarks constraints are still optimized in batch), other strategies always do batch optimization.");
     RTABMAP_PARAM(Optimizer, GravitySigma,    float, 0.0,      uFormat("Gravity sigma value (>=0, typically between 0.1 and 0.3). Optimization is done while preserving gravity orientation of the poses. This should be used only with visual/lidar inertial odometry approaches, for which we assume that all odometry poses are aligned with gravity. Set to 0 to disable gravity constraints. Currently supported only with g2o and GTSAM optimization strategies (see %s).", kOptimizerStrategy().c_str()));
 
 #ifdef RTABMAP_ORB_SLAM2
@@ -420,6 +441,8 @@ class RTABMAP_EXP Parameters
     RTABMAP_PARAM(g2o, Baseline,          double, 0.075,   "When doing bundle adjustment with RGB-D data, we can set a fake baseline (m) to do stereo bundle adjustment (if 0, mono bundle adjustment is done). For stereo data, the baseline in the calibration is used directly.");
 
     RTABMAP_PARAM(GTSAM, Optimizer,       int, 1,          "0=Levenberg 1=GaussNewton 2=Dogleg");
+    RTABMAP_PARAM(GTSAM, IncrementalRelinearizeThreshold, double, 0.01, uFormat("iSAM2 relinearization threshold used when %s=true: only poses whose linear delta is over this threshold are relinearized. With %s=0, iSAM2 uses GaussNewton steps.", kOptimizerIncremental().c_str(), kGTSAMOptimizer().c_str()));
+    RTABMAP_PARAM(GTSAM, IncrementalRelinearizeSkip,      int,    1,    uFormat("iSAM2 relinearization is checked only every X updates when %s=true. Updates adding loop closures always force a relinearization check.", kOptimizerIncremental().c_str()));
 
     // Odometry
     RTABMAP_PARAM(Odom, Strategy,               int, 0,       "0=Frame-to-Map (F2M) 1=Frame-to-Frame (F2F) 2=Fovis 3=viso2 4=DVO-SLAM 5=ORB_SLAM2 6=OKVIS 7=LOAM 8=MSCKF_VIO 9=VINS-Fusion");
@@ -442,6 +465,7 @@ class RTABMAP_EXP Parameters
     RTABMAP_PARAM(Odom, ScanKeyFrameThr,        float, 0.9,   "[Geometry] Create a new keyframe when the number of ICP inliers drops under this ratio of points in last frame's scan. Setting the value to 0 means that a keyframe is created for each processed frame.");
     RTABMAP_PARAM(Odom, ImageDecimation,        int, 1,       "Decimation of the images before registration. Negative decimation is done from RGB size instead of depth size (if depth is smaller than RGB, it may be interpolated depending of the decimation value).");
     RTABMAP_PARAM(Odom, AlignWithGround,        bool, false,  "Align odometry with the ground on initialization.");
+    RTABMAP_PARAM(Odom, TraceFrames,            int, 0,       "Enable profiling zones and export them every X processed frames (0 means disabled) in the current directory: as Chrome trace (odom_trace_#.json, open in chrome://tracing) and as folded stacks for flame graphs (odom_trace_#.folded). Zones of the threads running odometry are exported, with zones of worker threads not traced by the map update.");
 
     // Odometry Frame-to-Map
     RTABMAP_PARAM(OdomF2M, MaxSize,             int, 2000,    "[Visual] Local map size: If > 0 (example 5000), the odometry will maintain a local map of X maximum words.");
@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_SRC_PRODUCTQUANTIZER_H_
+#define CORELIB_SRC_PRODUCTQUANTIZER_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace rtabmap {
+
+/**
+ * Product quantization of float descriptors (Jegou et al., "Product
+ * Quantization for Nearest Neighbor Search", TPAMI 2011). Descriptors
+ * are split in sub-vectors, each one encoded by the index of its
+ * nearest centroid in a k-means codebook, so that a descriptor is
+ * stored in "subQuantizers" bytes. Search is done with asymmetric
+ * distances: the query is not quantized and distances to the codes
+ * are sums of the squared distances to their centroids.
+ *
+ * With a coarse quantizer (IVF-ADC), features are first assigned to
+ * their nearest coarse centroid, the residual to that centroid is
+ * encoded and the code is added to the inverted list of the centroid.
+ * A search then only scans the lists of the "nprobe" coarse centroids
+ * nearest to the query. Without coarse quantizer, all codes are
+ * in a single list and the search is exhaustive.
+ */
+class RTABMAP_EXP ProductQuantizer
+{
+public:
+	ProductQuantizer();
+	virtual ~ProductQuantizer();
+
+	void release();
+
+	// Learn the codebooks with k-means on CV_32F features (one per row).
+	// The features dimension should be a multiple of subQuantizers and
+	// centroids should be between 2 and 256. At most maxSamples rows are used.
+	// If coarseCentroids > 0, a coarse quantizer of that size is learned
+	// first and the codebooks are learned on the residuals.
+	bool train(
+			const cv::Mat & features,
+			int subQuantizers,
+			int centroids = 256,
+			int iterations = 10,
+			int maxSamples = 65536,
+			int coarseCentroids = 0);
+	bool isTrained() const {return !codebooks_.empty();}
+
+	int subQuantizers() const {return subQuantizers_;}
+	int centroids() const {return centroids_;}
+	int coarseCentroids() const {return coarseCentroids_.rows;}
+	int featuresDim() const {return featuresDim_;}
+	unsigned int indexedFeatures() const;
+
+	// return Bytes
+	unsigned long memoryUsed() const;
+
+	// codes are CV_8UC1, one row of subQuantizers bytes per feature,
+	// lists are the coarse centroids (inverted lists) of the features (0 without coarse quantizer)
+	void encode(const cv::Mat & features, cv::Mat & codes, std::vector<int> & lists) const;
+	cv::Mat decode(const cv::Mat & codes, const std::vector<int> & lists) const;
+
+	// Indices of removed features are reused by the next added features
+	std::vector<unsigned int> addPoints(const cv::Mat & features);
+	void removePoint(unsigned int index);
+
+	// return approximated squared distances (CV_32FC1) and indices (CV_32SC1),
+	// -1 is set when less than knn features are found. Only the inverted
+	// lists of the nprobe nearest coarse centroids are searched.
+	void knnSearch(
+			const cv::Mat & query,
+			cv::Mat & indices,
+			cv::Mat & dists,
+			int knn,
+			int nprobe = 1) const;
+
+private:
+	int nearestCoarseCentroid(const float * feature) const;
+	void computeDistanceTable(const float * feature, float * table) const;
+
+private:
+	int subQuantizers_;
+	int centroids_;
+	int featuresDim_;
+	int subDim_;
+	cv::Mat coarseCentroids_; // one row of featuresDim per coarse centroid, CV_32FC1 (empty without coarse quantizer)
+	cv::Mat codebooks_; // (subQuantizers x centroids) rows of subDim, CV_32FC1
+	cv::Mat codes_; // one row per index, CV_8UC1
+	std::vector<std::vector<unsigned int> > lists_; // inverted lists of indices
+	std::vector<int> indexList_; // list of each index, -1 if removed
+	std::vector<unsigned int> indexPosition_; // position of each index in its list
+	std::vector<unsigned int> freeIndices_; // removed indices to reuse
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORELIB_SRC_PRODUCTQUANTIZER_H_ */
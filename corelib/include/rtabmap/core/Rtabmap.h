@@ -243,12 +243,14 @@ private:
 			cv::Mat & covariance,
 			std::multimap<int, Link> * constraints = 0,
 			double * error = 0,
-			int * iterationsDone = 0) const;
+			int * iterationsDone = 0,
+			bool persistent = false) const; // persistent: graph of the current map, see Optimizer::optimizePersistent()
 	void updateGoalIndex();
 	bool computePath(int targetNode, std::map<int, Transform> nodes, const std::multimap<int, rtabmap::Link> & constraints);
 
 	void setupLogFiles(bool overwrite = false);
 	void flushStatisticLogs();
+	void exportTrace();
 
 private:
 	// Modifiable parameters
@@ -259,6 +261,7 @@ private:
 	bool _publishRAMUsage;
 	bool _computeRMSE;
 	bool _saveWMState;
+	int _traceFrames;
 	float _maxTimeAllowed; // in ms
 	unsigned int _maxMemoryAllowed; // signatures count in WM
 	float _loopThr;
@@ -330,6 +333,10 @@ private:
 	Statistics statistics_;
 
 	std::string _wDir;
+	int _traceFrameCount;
+	int _traceExported;
+	bool _traceEnabled; // UProfiler enabled by this instance
+	std::set<unsigned long> _traceThreads; // threads in which process() has been called while tracing
 
 	std::map<int, Transform> _optimizedPoses;
 	std::multimap<int, Link> _constraints;
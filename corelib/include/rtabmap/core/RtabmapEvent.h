@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UVariant.h>
 #include "rtabmap/core/Statistics.h"
 #include "rtabmap/core/Parameters.h"
+#include <set>
 
 namespace rtabmap
 {
@@ -67,7 +68,7 @@ public:
 			kCmdGenerateDOTGraph, // params: [bool] global, [string] path, if global=false: [int] id, [int] margin
 			kCmdExportPoses,      // params: [bool] global, [bool] optimized, [string] path, [int] type (0=raw format, 1=RGBD-SLAM format, 2=KITTI format, 3=TORO, 4=g2o)
 			kCmdCleanDataBuffer,
-			kCmdPublish3DMap,     // params: [bool] global, [bool] optimized, [bool] graphOnly
+			kCmdPublish3DMap,     // params: [bool] global, [bool] optimized, [bool] graphOnly, [int] since revision (optional, only nodes added or modified after that revision are published with data)
 			kCmdTriggerNewMap,
 			kCmdPause,
 			kCmdResume,
@@ -177,7 +178,32 @@ public:
 		UEvent(0),
 		_signatures(signatures),
 		_poses(poses),
-		_constraints(constraints)
+		_constraints(constraints),
+		_revision(0),
+		_delta(false)
+	{}
+	/**
+	 * Delta map: signatures only contain nodes added or modified since the revision
+	 * requested, poses and constraints are the ones of the whole graph.
+	 * If delta is false, all nodes are included (e.g., the requested revision is
+	 * older than the last memory reset). Nodes with data are the same as a full map
+	 * (WM+STM, or all nodes for the global map), removed ids are nodes that left
+	 * both the graph and these nodes.
+	 */
+	RtabmapEvent3DMap(
+			const std::map<int, Signature> & signatures,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & constraints,
+			int revision,
+			bool delta,
+			const std::set<int> & removedIds) :
+		UEvent(0),
+		_signatures(signatures),
+		_poses(poses),
+		_constraints(constraints),
+		_revision(revision),
+		_delta(delta),
+		_removedIds(removedIds)
 	{}
 
 	virtual ~RtabmapEvent3DMap() {}
@@ -185,6 +211,9 @@ public:
 	const std::map<int, Signature> & getSignatures() const {return _signatures;}
 	const std::map<int, Transform> & getPoses() const {return _poses;}
 	const std::multimap<int, Link> & getConstraints() const {return _constraints;}
+	int getRevision() const {return _revision;}
+	bool isDelta() const {return _delta;}
+	const std::set<int> & getRemovedIds() const {return _removedIds;}
 
 	virtual std::string getClassName() const {return std::string("RtabmapEvent3DMap");}
 
@@ -192,6 +221,9 @@ private:
 	std::map<int, Signature> _signatures;
 	std::map<int, Transform> _poses;
 	std::multimap<int, Link> _constraints;
+	int _revision;
+	bool _delta;
+	std::set<int> _removedIds;
 };
 
 class RtabmapGlobalPathEvent : public UEvent
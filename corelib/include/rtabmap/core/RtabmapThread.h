@@ -105,7 +105,8 @@ private:
 	void addData(const OdometryEvent & odomEvent);
 	bool getData(OdometryEvent & data);
 	void pushNewState(State newState, const ParametersMap & parameters = ParametersMap());
-	void publishMap(bool optimized, bool full, bool graphOnly) const;
+	void publishMap(bool optimized, bool full, bool graphOnly, int sinceRevision = -1);
+	void resetMapRevisions();
 
 private:
 	UMutex _stateMutex;
@@ -129,6 +130,16 @@ private:
 
 	cv::Mat _userData;
 	UMutex _userDataMutex;
+
+	// Delta map publishing
+	int _mapRevision;
+	int _mapRevisionReset; // revisions before are not valid anymore
+	std::map<int, std::pair<int, unsigned int> > _nodeRevisions[2]; // local, global: <id, <revision, memory graph revision of the node> >
+	std::map<int, int> _removedNodeRevisions[2]; // local, global: <id, revision>
+	std::map<int, Transform> _globalOptimizedPoses; // last optimized global graph published
+	std::multimap<int, Link> _globalOptimizedConstraints;
+	unsigned int _globalOptimizedRevision; // memory graph revision of _globalOptimizedPoses
+	bool _globalOptimizedValid;
 };
 
 } /* namespace rtabmap */
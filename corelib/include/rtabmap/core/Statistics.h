@@ -73,6 +73,11 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Loop, Optimization_max_error_ratio, );
 	RTABMAP_STATS(Loop, Optimization_error, );
 	RTABMAP_STATS(Loop, Optimization_iterations, );
+	RTABMAP_STATS(Loop, Optimization_partitions, );
+	RTABMAP_STATS(Loop, Optimization_submaps_error, );
+	RTABMAP_STATS(Loop, Optimization_separators_error, );
+	RTABMAP_STATS(Loop, Optimization_flat_error, );
+	RTABMAP_STATS(Loop, Optimization_reference_error, );
 	RTABMAP_STATS(Loop, Linear_variance,);
 	RTABMAP_STATS(Loop, Angular_variance,);
 	RTABMAP_STATS(Loop, Landmark_detected,);
@@ -152,6 +157,7 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Memory, RAM_usage, MB);
 	RTABMAP_STATS(Memory, RAM_estimated, MB);
 	RTABMAP_STATS(Memory, Triangulated_points, );
+	RTABMAP_STATS(Memory, Database_write_queue,);
 
 	RTABMAP_STATS(Timing, Memory_update, ms);
 	RTABMAP_STATS(Timing, Neighbor_link_refining, ms);
@@ -162,6 +168,10 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Timing, Reactivation, ms);
 	RTABMAP_STATS(Timing, Add_loop_closure_link, ms);
 	RTABMAP_STATS(Timing, Map_optimization, ms);
+	RTABMAP_STATS(Timing, Map_optimization_update, ms);
+	RTABMAP_STATS(Timing, Map_optimization_submaps, ms);
+	RTABMAP_STATS(Timing, Map_optimization_separators, ms);
+	RTABMAP_STATS(Timing, Map_optimization_reference, ms);
 	RTABMAP_STATS(Timing, Likelihood_computation, ms);
 	RTABMAP_STATS(Timing, Posterior_computation, ms);
 	RTABMAP_STATS(Timing, Hypotheses_creation, ms);
@@ -172,6 +182,7 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Timing, Forgetting, ms);
 	RTABMAP_STATS(Timing, Joining_trash, ms);
 	RTABMAP_STATS(Timing, Emptying_trash, ms);
+	RTABMAP_STATS(Timing, Database_commit_max, ms);
 	RTABMAP_STATS(Timing, Finalizing_statistics, ms);
 	RTABMAP_STATS(Timing, RAM_estimation, ms);
 
@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_INCLUDE_RTABMAP_CORE_TSDFVOLUME_H_
+#define CORELIB_INCLUDE_RTABMAP_CORE_TSDFVOLUME_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/SensorData.h>
+#include <rtabmap/core/Transform.h>
+#include <rtabmap/core/ProgressState.h>
+#include <pcl/PolygonMesh.h>
+#include <opencv2/core/core.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Truncated signed distance function (TSDF) volume, CPU only. Voxels are
+ * allocated by blocks (blockSize^3 voxels) in a hash map, only around
+ * observed surfaces. Depth images are integrated in parallel over the
+ * touched blocks (OpenMP). The mesh is extracted with marching cubes per
+ * block, vertices on block borders are shared so the surface is
+ * continuous between blocks.
+ */
+class RTABMAP_EXP TSDFVolume {
+public:
+	/**
+	 * @param voxelSize voxel size (m).
+	 * @param truncationDistance truncation distance (m), 0 means 4 x voxelSize.
+	 * @param maxDepth ignore depth values over this distance (m), 0 means no limit.
+	 * @param blockSize block size in voxels.
+	 * @param maxWeight maximum integration weight of a voxel.
+	 */
+	TSDFVolume(
+			float voxelSize = 0.01f,
+			float truncationDistance = 0.0f,
+			float maxDepth = 4.0f,
+			int blockSize = 8,
+			float maxWeight = 100.0f);
+	virtual ~TSDFVolume() {}
+
+	/**
+	 * Integrate depth (and RGB if set) of uncompressed sensor data.
+	 * Multi-camera data are supported.
+	 * @param pose pose of the base frame in map frame.
+	 * @return true if depth has been integrated.
+	 */
+	bool integrate(const SensorData & data, const Transform & pose);
+	bool integrate(
+			const cv::Mat & depth,             // CV_32FC1 (m) or CV_16UC1 (mm)
+			const cv::Mat & rgb,               // CV_8UC3 (BGR), CV_8UC1 or empty
+			const CameraModel & model,         // calibration of the depth image
+			const Transform & cameraPose);     // pose of the camera in map frame (optical frame)
+
+	/**
+	 * Extract the surface with marching cubes. The cloud of the mesh is
+	 * pcl::PointXYZRGBNormal, normals are area-weighted vertex normals.
+	 */
+	pcl::PolygonMesh::Ptr extractMesh(const ProgressState * state = 0) const;
+
+	void clear();
+
+	int blocks() const {return (int)blocks_.size();}
+	int integrations() const {return integrations_;}
+	unsigned long memoryUsed() const; // bytes
+
+private:
+	struct Voxel
+	{
+		Voxel() : tsdf(1.0f), weight(0.0f), colorWeight(0.0f), r(0), g(0), b(0) {}
+		float tsdf;
+		float weight;
+		float colorWeight; // color is only integrated near the surface
+		unsigned char r, g, b;
+	};
+	typedef std::vector<Voxel> Block;
+
+	long long blockKey(int x, int y, int z) const;
+	void blockCoordinates(long long key, int & x, int & y, int & z) const;
+
+private:
+	float voxelSize_;
+	float truncationDistance_;
+	float maxDepth_;
+	int blockSize_;
+	float maxWeight_;
+	std::unordered_map<long long, Block> blocks_;
+	int integrations_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORELIB_INCLUDE_RTABMAP_CORE_TSDFVOLUME_H_ */
@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <opencv2/features2d/features2d.hpp>
 #include <list>
 #include <set>
+#include <map>
 #include "rtabmap/core/Parameters.h"
 
 namespace rtabmap
@@ -42,6 +43,8 @@ namespace rtabmap
 class DBDriver;
 class VisualWord;
 class FlannIndex;
+class ProductQuantizer;
+class VocabularyTree;
 
 class RTABMAP_EXP VWDictionary
 {
@@ -52,6 +55,7 @@ public:
 		kNNFlannLSH,
 		kNNBruteForce,
 		kNNBruteForceGPU,
+		kNNVocabularyTree,
 		kNNUndef};
 	static const int ID_START;
 	static const int ID_INVALID;
@@ -68,6 +72,8 @@ public:
 			return "BRUTE FORCE";
 		case kNNBruteForceGPU:
 			return "BRUTE FORCE GPU";
+		case kNNVocabularyTree:
+			return "VOCABULARY TREE";
 		default:
 			return "Unknown";
 		}
@@ -105,11 +111,18 @@ public:
 	bool setNNStrategy(NNStrategy strategy); // Return true if the search tree has been re-initialized
 	bool isIncremental() const {return _incrementalDictionary;}
 	bool isIncrementalFlann() const {return _incrementalFlann;}
+	bool isQuantized() const; // product quantization is used for search
+	bool isDescriptorsPaged() const {return _pagedDriver != 0;} // some word descriptors are not in memory
 	void setIncrementalDictionary();
 	void setFixedDictionary(const std::string & dictionaryPath);
 
 	void exportDictionary(const char * fileNameReferences, const char * fileNameDescriptors) const;
 
+	// Search index of an incremental dictionary with a FLANN strategy, loadIndex()
+	// can replace update() if the words are the same than when the index was saved.
+	bool saveIndex(const std::string & path) const;
+	bool loadIndex(const std::string & path);
+
 	void clear(bool printWarningsIfNotEmpty = true);
 	std::vector<VisualWord *> getUnusedWords() const;
 	std::vector<int> getUnusedWordIds() const;
@@ -124,6 +137,12 @@ public:
 protected:
 	int getNextId();
 
+private:
+	bool updateProductQuantization();
+	cv::Mat createDataTree(bool & useDistanceL1) const; // rows ordered by word id
+	bool isIndexSerializable() const;
+	void searchQuantized(const cv::Mat & query, std::vector<std::vector<cv::DMatch> > & matches, int k) const;
+
 protected:
 	std::map<int, VisualWord *> _visualWords; //<id,VisualWord*>
 	int _totalActiveReferences; // keep track of all references for updating the common signature
@@ -139,7 +158,19 @@ private:
 	bool _newWordsComparedTogether;
 	int _lastWordId;
 	bool useDistanceL1_;
+	int _pqSubQuantizers;
+	int _pqCentroids;
+	int _pqCoarseCentroids;
+	int _pqNProbe;
+	int _pqRerank;
+	bool _pqPagedDescriptors;
+	int _pqPagedCacheSize;
 	FlannIndex * _flannIndex;
+	ProductQuantizer * _productQuantizer;
+	VocabularyTree * _vocabularyTree; // only for fixed dictionaries, built on _dataTree
+	DBDriver * _pagedDriver; // dictionary database kept opened to load back paged descriptors
+	mutable std::list<int> _pagedCacheUsage; // paged descriptors loaded back, most recently used first
+	mutable std::map<int, std::pair<cv::Mat, std::list<int>::iterator> > _pagedCache; // <id, <descriptor, position in usage> >
 	cv::Mat _dataTree;
 	NNStrategy _strategy;
 	std::map<int ,int> _mapIndexId;
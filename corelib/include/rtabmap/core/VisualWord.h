@@ -41,13 +41,14 @@ public:
 	VisualWord(int id, const cv::Mat & descriptor, int signatureId = 0);
 	~VisualWord();
 
-	void addRef(int signatureId);
+	void addRef(int signatureId, int occurrences = 1);
 	int removeAllRef(int signatureId);
 	unsigned long getMemoryUsed() const;
 
 	int getTotalReferences() const {return _totalReferences;}
 	int id() const {return _id;}
 	const cv::Mat & getDescriptor() const {return _descriptor;}
+	void releaseDescriptor() {_descriptor = cv::Mat();} // only for words already saved in a database
 	const std::map<int, int> & getReferences() const {return _references;} // (signature id , occurrence in the signature)
 
 	bool isSaved() const {return _saved;}
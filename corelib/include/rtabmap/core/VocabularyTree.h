@@ -0,0 +1,122 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CORELIB_VOCABULARYTREE_H_
+#define CORELIB_VOCABULARYTREE_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+#include <vector>
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+namespace rtabmap {
+
+/**
+ * Hierarchical k-means tree (Nister and Stewenius, "Scalable Recognition
+ * with a Vocabulary Tree", CVPR 2006), as used by DBoW. Float descriptors
+ * (CV_32FC1) are clustered with k-means and squared L2 distance, binary
+ * descriptors (CV_8UC1) with k-majority and Hamming distance. A query
+ * descends the tree to the nearest child at each level, then is compared
+ * to the features of the leaf reached, so search is O(depth x branching
+ * + leaf size) instead of O(features).
+ */
+class RTABMAP_EXP VocabularyTree
+{
+public:
+	VocabularyTree();
+	virtual ~VocabularyTree();
+
+	void release();
+
+	// The features are not copied, they should not be modified while the tree is used.
+	// Leaves have at most leafMaxSize features or are at maxDepth (0=no max depth).
+	void build(
+			const cv::Mat & features,
+			int branching = 10,
+			int leafMaxSize = 10,
+			int maxDepth = 0,
+			int iterations = 10);
+	bool isBuilt() const {return !nodes_.empty();}
+
+	int featuresType() const {return features_.type();}
+	int featuresDim() const {return features_.cols;}
+	unsigned int indexedFeatures() const {return features_.rows;}
+	int branching() const {return branching_;}
+	int depth() const;
+	int leaves() const;
+
+	// return Bytes (features not included)
+	unsigned long memoryUsed() const;
+
+	// Centroid of each leaf (in leaf order). The tree then indexes these
+	// centroids instead of the features, each leaf having one centroid.
+	// Used to create a vocabulary where the leaves are the words.
+	cv::Mat convertLeavesToWords();
+
+	// Return squared L2 distances for float descriptors and Hamming
+	// distances for binary descriptors (queryIdx=query row, trainIdx=feature row).
+	void knnSearch(
+			const cv::Mat & query,
+			std::vector<std::vector<cv::DMatch> > & matches,
+			int knn) const;
+
+	bool save(const std::string & path) const;
+	// The features should be the same (and in same order) than
+	// the ones used when the tree was built.
+	bool load(const std::string & path, const cv::Mat & features);
+
+private:
+	struct Node
+	{
+		std::vector<int> children; // node indices
+		std::vector<int> features; // feature rows, only for leaves
+	};
+
+	float distance(const unsigned char * a, const unsigned char * b) const;
+	void cluster(
+			const std::vector<int> & rows,
+			int k,
+			int iterations,
+			cv::RNG & rng,
+			cv::Mat & centers,
+			std::vector<int> & labels) const;
+	void computeCentroids(
+			const std::vector<int> & rows,
+			const std::vector<int> & labels,
+			cv::Mat & centers) const;
+
+private:
+	cv::Mat features_;
+	cv::Mat centroids_; // one row per node, same type than features
+	std::vector<Node> nodes_; // nodes_[0] is the root
+	int branching_;
+};
+
+} /* namespace rtabmap */
+
+#endif /* CORELIB_VOCABULARYTREE_H_ */
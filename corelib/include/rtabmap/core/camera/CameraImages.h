@@ -38,6 +38,8 @@ class UDirectory;
 namespace rtabmap
 {
 
+class CameraImagesReadAhead;
+
 class RTABMAP_EXP CameraImages :
 	public Camera
 {
@@ -114,6 +116,19 @@ public:
 		_depthScaleFactor=depthScaleFactor;
 	}
 
+	/**
+	 * Decode images (and scans) in "threads" background threads, up to "queueSize" frames
+	 * ahead of capture. Set before init(). Only used when files are read in order
+	 * (start index >= 0 and directory not refreshed). 0 thread means images are decoded on capture.
+	 */
+	virtual void setReadAhead(int threads, int queueSize = 10)
+	{
+		_readAheadThreads = threads;
+		_readAheadSize = queueSize;
+	}
+	int getReadAheadThreads() const {return _readAheadThreads;}
+	int getReadAheadSize() const {return _readAheadSize;}
+
 protected:
 	virtual SensorData captureImage(CameraInfo * info = 0);
 	bool readPoses(
@@ -123,6 +138,16 @@ protected:
 			int format,
 			double maxTimeDiff) const;
 
+private:
+	friend class CameraImagesReadAhead;
+	void loadData(
+			const std::string & imageFilePath,
+			const std::string & scanFilePath,
+			const CameraModel & model,
+			cv::Mat & img,
+			LaserScan & scan,
+			cv::Mat & depthFromScan) const;
+
 private:
 	std::string _path;
 	int _startAt;
@@ -167,6 +192,10 @@ private:
 
 	UTimer _captureTimer;
 	double _captureDelay;
+
+	int _readAheadThreads;
+	int _readAheadSize;
+	CameraImagesReadAhead * _readAhead;
 };
 
 
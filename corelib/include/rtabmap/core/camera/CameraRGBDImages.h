@@ -53,6 +53,7 @@ public:
 
 	virtual void setStartIndex(int index) {CameraImages::setStartIndex(index);cameraDepth_.setStartIndex(index);} // negative means last
 	virtual void setMaxFrames(int value) {CameraImages::setMaxFrames(value);cameraDepth_.setMaxFrames(value);}
+	virtual void setReadAhead(int threads, int queueSize = 10) {CameraImages::setReadAhead(threads, queueSize);cameraDepth_.setReadAhead(threads, queueSize);}
 
 protected:
 	virtual SensorData captureImage(CameraInfo * info = 0);
@@ -63,6 +63,7 @@ public:
 
 	virtual void setStartIndex(int index) {CameraImages::setStartIndex(index);camera2_->setStartIndex(index);} // negative means last
 	virtual void setMaxFrames(int value) {CameraImages::setMaxFrames(value);camera2_->setMaxFrames(value);}
+	virtual void setReadAhead(int threads, int queueSize = 10) {CameraImages::setReadAhead(threads, queueSize);if(camera2_) camera2_->setReadAhead(threads, queueSize);}
 
 protected:
 	virtual SensorData captureImage(CameraInfo * info = 0);
@@ -32,6 +32,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <rtabmap/core/Optimizer.h>
 
+namespace g2o {
+class SparseOptimizer;
+}
+
 namespace rtabmap {
 
 class RTABMAP_EXP OptimizerG2O : public Optimizer
@@ -48,11 +52,15 @@ public:
 		optimizer_(Parameters::defaultg2oOptimizer()),
 		pixelVariance_(Parameters::defaultg2oPixelVariance()),
 		robustKernelDelta_(Parameters::defaultg2oRobustKernelDelta()),
-		baseline_(Parameters::defaultg2oBaseline())
+		baseline_(Parameters::defaultg2oBaseline()),
+		incOptimizer_(0),
+		incRootId_(0),
+		incSlam2d_(false),
+		incUpdateTime_(0.0)
 	{
 		parseParameters(parameters);
 	}
-	virtual ~OptimizerG2O() {}
+	virtual ~OptimizerG2O();
 
 	virtual Type type() const {return kTypeG2O;}
 
@@ -67,6 +75,16 @@ public:
 				double * finalError = 0,
 				int * iterationsDone = 0);
 
+	virtual std::map<int, Transform> optimizePersistent(
+				int rootId,
+				const std::map<int, Transform> & poses,
+				const std::multimap<int, Link> & edgeConstraints,
+				cv::Mat & outputCovariance,
+				double * finalError = 0,
+				int * iterationsDone = 0);
+	virtual void resetPersistent();
+	virtual double persistentUpdateTime() const {return incUpdateTime_;}
+
 	virtual std::map<int, Transform> optimizeBA(
 			int rootId,
 			const std::map<int, Transform> & poses,
@@ -87,6 +105,12 @@ private:
 	double pixelVariance_;
 	double robustKernelDelta_;
 	double baseline_;
+
+	// persistent graph of optimizePersistent()
+	g2o::SparseOptimizer * incOptimizer_;
+	int incRootId_;
+	bool incSlam2d_;
+	double incUpdateTime_;
 };
 
 } /* namespace rtabmap */
@@ -32,6 +32,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <rtabmap/core/Optimizer.h>
 
+namespace gtsam {
+class ISAM2;
+}
+
 namespace rtabmap {
 
 class RTABMAP_EXP OptimizerGTSAM : public Optimizer
@@ -42,11 +46,18 @@ public:
 public:
 	OptimizerGTSAM(const ParametersMap & parameters = ParametersMap()) :
 		Optimizer(parameters),
-		optimizer_(Parameters::defaultGTSAMOptimizer())
+		optimizer_(Parameters::defaultGTSAMOptimizer()),
+		relinearizeThreshold_(Parameters::defaultGTSAMIncrementalRelinearizeThreshold()),
+		relinearizeSkip_(Parameters::defaultGTSAMIncrementalRelinearizeSkip()),
+		isam_(0),
+		isamRootId_(0),
+		isamRootFactor_(0),
+		isamSlam2d_(false),
+		isamUpdateTime_(0.0)
 	{
 		parseParameters(parameters);
 	}
-	virtual ~OptimizerGTSAM() {}
+	virtual ~OptimizerGTSAM();
 
 	virtual Type type() const {return kTypeGTSAM;}
 
@@ -61,8 +72,29 @@ public:
 			double * finalError = 0,
 			int * iterationsDone = 0);
 
+	virtual std::map<int, Transform> optimizePersistent(
+			int rootId,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & edgeConstraints,
+			cv::Mat & outputCovariance,
+			double * finalError = 0,
+			int * iterationsDone = 0);
+	virtual void resetPersistent();
+	virtual double persistentUpdateTime() const {return isamUpdateTime_;}
+
 private:
 	int optimizer_;
+	double relinearizeThreshold_;
+	int relinearizeSkip_;
+
+	// persistent iSAM2 graph of optimizePersistent()
+	gtsam::ISAM2 * isam_;
+	std::map<std::pair<int, int>, std::pair<size_t, Link> > isamLinks_; // <from, to>, <factor index, link>
+	std::map<int, size_t> isamParkedPoses_; // poses not in the graph anymore, <id, factor index of their prior>
+	int isamRootId_;
+	size_t isamRootFactor_;
+	bool isamSlam2d_;
+	double isamUpdateTime_;
 };
 
 } /* namespace rtabmap */
@@ -144,6 +144,7 @@ void BayesFilter::reset()
 
 const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory, const std::map<int, float> & likelihood)
 {
+	UPROFILER_ZONE("BayesFilter::computePosterior");
 	ULOGGER_DEBUG("");
 
 	if(!memory)
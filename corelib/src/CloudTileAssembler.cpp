@@ -0,0 +1,418 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/CloudTileAssembler.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UMath.h>
+#include <stdio.h>
+#include <cmath>
+
+namespace rtabmap {
+
+// 21 bits per axis, cells in [-2^20, 2^20[
+static const long long kKeyOffset = 1<<20;
+static const long long kKeyMask = (1<<21)-1;
+
+static bool packKey(double x, double y, double z, long long & key)
+{
+	if(!(x >= -kKeyOffset && x < kKeyOffset &&
+		 y >= -kKeyOffset && y < kKeyOffset &&
+		 z >= -kKeyOffset && z < kKeyOffset))
+	{
+		// would alias with another cell
+		return false;
+	}
+	key = ((((long long)x+kKeyOffset)&kKeyMask)<<42) | ((((long long)y+kKeyOffset)&kKeyMask)<<21) | (((long long)z+kKeyOffset)&kKeyMask);
+	return true;
+}
+
+void CloudTileAssembler::Voxel::add(const Voxel & v)
+{
+	x+=v.x; y+=v.y; z+=v.z;
+	r+=v.r; g+=v.g; b+=v.b;
+	nx+=v.nx; ny+=v.ny; nz+=v.nz;
+	count+=v.count;
+}
+
+CloudTileAssembler::CloudTileAssembler(
+		float voxelSize,
+		float tileSize,
+		int memoryBudget,
+		const std::string & tmpDirectory) :
+	voxelSize_(voxelSize),
+	tileSize_(tileSize),
+	memoryBudget_(size_t(memoryBudget)*1024*1024),
+	tmpDirectory_(tmpDirectory),
+	voxelsInRAM_(0),
+	spilledVoxels_(0),
+	pointIndex_(0),
+	spillFailed_(false),
+	rejectedPoints_(0)
+{
+	UASSERT(voxelSize_ >= 0.0f);
+	UASSERT(tileSize_ > 0.0f);
+	UASSERT(memoryBudget > 0);
+	if(voxelSize_ > 0.0f)
+	{
+		// tiles should contain a whole number of voxels
+		tileSize_ = std::max(1.0f, std::round(tileSize_/voxelSize_))*voxelSize_;
+	}
+}
+
+CloudTileAssembler::~CloudTileAssembler()
+{
+	clear();
+}
+
+void CloudTileAssembler::clear()
+{
+	for(std::map<long long, unsigned long>::iterator iter=spilledTiles_.begin(); iter!=spilledTiles_.end(); ++iter)
+	{
+		UFile::erase(spillPath(iter->first));
+	}
+	spilledTiles_.clear();
+	tiles_.clear();
+	voxelsInRAM_ = 0;
+	spilledVoxels_ = 0;
+	pointIndex_ = 0;
+	spillFailed_ = false;
+	rejectedPoints_ = 0;
+}
+
+size_t CloudTileAssembler::memoryUsed() const
+{
+	// approximation of a std::map node
+	return voxelsInRAM_ * (sizeof(Tile::value_type) + 4*sizeof(void*));
+}
+
+int CloudTileAssembler::tiles() const
+{
+	std::set<long long> keys = uKeysSet(tiles_);
+	for(std::map<long long, unsigned long>::const_iterator iter=spilledTiles_.begin(); iter!=spilledTiles_.end(); ++iter)
+	{
+		keys.insert(iter->first);
+	}
+	return (int)keys.size();
+}
+
+bool CloudTileAssembler::tileKey(float x, float y, float z, long long & key) const
+{
+	return packKey(
+			std::floor(double(x)/tileSize_),
+			std::floor(double(y)/tileSize_),
+			std::floor(double(z)/tileSize_),
+			key);
+}
+
+bool CloudTileAssembler::voxelKey(float x, float y, float z, long long & key) const
+{
+	return packKey(
+			std::floor(double(x)/voxelSize_),
+			std::floor(double(y)/voxelSize_),
+			std::floor(double(z)/voxelSize_),
+			key);
+}
+
+std::string CloudTileAssembler::spillPath(long long tileKey) const
+{
+	return uFormat("%s/rtabmap_tile_%p_%llx.bin", tmpDirectory_.c_str(), (const void*)this, tileKey);
+}
+
+void CloudTileAssembler::addCloud(
+		const pcl::PointCloud<pcl::PointXYZRGBNormal> & cloud,
+		const pcl::IndicesPtr & indices)
+{
+	size_t size = indices.get() && !indices->empty()?indices->size():cloud.size();
+	long long previousTileKey = 0;
+	Tile * tile = 0;
+	unsigned long rejected = 0;
+	for(size_t i=0; i<size; ++i)
+	{
+		const pcl::PointXYZRGBNormal & pt = indices.get() && !indices->empty()?cloud.at(indices->at(i)):cloud.at(i);
+		if(!pcl::isFinite(pt))
+		{
+			continue;
+		}
+
+		float x=pt.x, y=pt.y, z=pt.z;
+		long long vKey;
+		if(voxelSize_ > 0.0f)
+		{
+			// tile of the voxel, not of the point, so that a voxel is never split between two tiles
+			if(!voxelKey(x, y, z, vKey))
+			{
+				++rejected;
+				continue;
+			}
+			x = (std::floor(x/voxelSize_)+0.5f)*voxelSize_;
+			y = (std::floor(y/voxelSize_)+0.5f)*voxelSize_;
+			z = (std::floor(z/voxelSize_)+0.5f)*voxelSize_;
+		}
+		else
+		{
+			vKey = (long long)pointIndex_++;
+		}
+		long long tKey;
+		if(!tileKey(x, y, z, tKey))
+		{
+			++rejected;
+			continue;
+		}
+		if(tile == 0 || tKey != previousTileKey)
+		{
+			tile = &tiles_[tKey];
+			previousTileKey = tKey;
+		}
+
+		Voxel v;
+		v.x = pt.x; v.y = pt.y; v.z = pt.z;
+		v.r = pt.r; v.g = pt.g; v.b = pt.b;
+		if(uIsFinite(pt.normal_x) && uIsFinite(pt.normal_y) && uIsFinite(pt.normal_z))
+		{
+			v.nx = pt.normal_x; v.ny = pt.normal_y; v.nz = pt.normal_z;
+		}
+		v.count = 1;
+		std::pair<Tile::iterator, bool> inserted = tile->insert(std::make_pair(vKey, v));
+		if(inserted.second)
+		{
+			++voxelsInRAM_;
+		}
+		else
+		{
+			inserted.first->second.add(v);
+		}
+	}
+
+	if(rejected)
+	{
+		UWARN("%ld points rejected, they are too far from the origin for voxel size %f m and tile size %f m (maximum %d cells per axis).",
+				(long)rejected, voxelSize_, tileSize_, (int)kKeyOffset);
+		rejectedPoints_ += rejected;
+	}
+
+	if(memoryUsed() > memoryBudget_ && !spillFailed_)
+	{
+		spill();
+	}
+}
+
+void CloudTileAssembler::spill()
+{
+	// Spill biggest tiles first, down to 75% of the budget
+	while(memoryUsed() > memoryBudget_*3/4 && !tiles_.empty())
+	{
+		std::map<long long, Tile>::iterator biggest = tiles_.begin();
+		for(std::map<long long, Tile>::iterator iter=tiles_.begin(); iter!=tiles_.end(); ++iter)
+		{
+			if(iter->second.size() > biggest->second.size())
+			{
+				biggest = iter;
+			}
+		}
+
+		std::string path = spillPath(biggest->first);
+		FILE * file = fopen(path.c_str(), "ab");
+		if(file == 0)
+		{
+			UERROR("Cannot open \"%s\" to spill tile, memory budget will be exceeded!", path.c_str());
+			return;
+		}
+		bool success = true;
+		for(Tile::iterator iter=biggest->second.begin(); iter!=biggest->second.end() && success; ++iter)
+		{
+			success = fwrite(&iter->first, sizeof(long long), 1, file) == 1 &&
+					  fwrite(&iter->second, sizeof(Voxel), 1, file) == 1;
+		}
+		success = fclose(file) == 0 && success;
+		if(!success)
+		{
+			// The spilled file may be partially written, the assembled cloud
+			// cannot be trusted anymore: keep the tile in RAM, stop spilling
+			// and make writePLY() fail.
+			UERROR("Failed writing \"%s\" to spill tile (disk full?), the export will fail!", path.c_str());
+			spillFailed_ = true;
+			return;
+		}
+
+		UDEBUG("Spilled tile %llx (%d voxels) to %s", biggest->first, (int)biggest->second.size(), path.c_str());
+		spilledTiles_[biggest->first] += biggest->second.size();
+		spilledVoxels_ += biggest->second.size();
+		voxelsInRAM_ -= biggest->second.size();
+		tiles_.erase(biggest);
+	}
+}
+
+bool CloudTileAssembler::loadSpilled(long long tileKey, Tile & tile) const
+{
+	std::string path = spillPath(tileKey);
+	FILE * file = fopen(path.c_str(), "rb");
+	if(file == 0)
+	{
+		UERROR("Cannot open spilled tile \"%s\"!", path.c_str());
+		return false;
+	}
+	long long key;
+	Voxel v;
+	while(fread(&key, sizeof(long long), 1, file) == 1 &&
+		  fread(&v, sizeof(Voxel), 1, file) == 1)
+	{
+		std::pair<Tile::iterator, bool> inserted = tile.insert(std::make_pair(key, v));
+		if(!inserted.second)
+		{
+			inserted.first->second.add(v);
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+long CloudTileAssembler::writePLY(const std::string & path, bool withNormals, const ProgressState * state)
+{
+	if(spillFailed_)
+	{
+		UERROR("Cannot write \"%s\", spilling tiles failed.", path.c_str());
+		clear();
+		return -1;
+	}
+
+	FILE * file = fopen(path.c_str(), "wb");
+	if(file == 0)
+	{
+		UERROR("Cannot open \"%s\" for writing!", path.c_str());
+		return -1;
+	}
+
+	// The number of points is not known before all tiles are merged, a
+	// fixed width placeholder is written and updated at the end.
+	fprintf(file, "ply\nformat binary_little_endian 1.0\ncomment Generated by RTAB-Map\nelement vertex ");
+	long countPos = ftell(file);
+	fprintf(file, "%010lu\n", 0ul);
+	fprintf(file, "property float x\nproperty float y\nproperty float z\n");
+	fprintf(file, "property uchar red\nproperty uchar green\nproperty uchar blue\n");
+	if(withNormals)
+	{
+		fprintf(file, "property float nx\nproperty float ny\nproperty float nz\n");
+	}
+	fprintf(file, "end_header\n");
+
+	std::set<long long> keys = uKeysSet(tiles_);
+	for(std::map<long long, unsigned long>::iterator iter=spilledTiles_.begin(); iter!=spilledTiles_.end(); ++iter)
+	{
+		keys.insert(iter->first);
+	}
+
+	unsigned long written = 0;
+	int tileIndex = 0;
+	bool success = true;
+	for(std::set<long long>::iterator kter=keys.begin(); kter!=keys.end() && success; ++kter, ++tileIndex)
+	{
+		Tile tile;
+		if(spilledTiles_.find(*kter) != spilledTiles_.end())
+		{
+			success = loadSpilled(*kter, tile);
+			UFile::erase(spillPath(*kter));
+		}
+		std::map<long long, Tile>::iterator iter = tiles_.find(*kter);
+		if(iter != tiles_.end())
+		{
+			voxelsInRAM_ -= iter->second.size();
+			if(tile.empty())
+			{
+				tile.swap(iter->second);
+			}
+			else
+			{
+				for(Tile::iterator jter=iter->second.begin(); jter!=iter->second.end(); ++jter)
+				{
+					std::pair<Tile::iterator, bool> inserted = tile.insert(*jter);
+					if(!inserted.second)
+					{
+						inserted.first->second.add(jter->second);
+					}
+				}
+			}
+			tiles_.erase(iter);
+		}
+
+		for(Tile::iterator jter=tile.begin(); jter!=tile.end() && success; ++jter)
+		{
+			const Voxel & v = jter->second;
+			UASSERT(v.count > 0);
+			float xyz[3] = {float(v.x/v.count), float(v.y/v.count), float(v.z/v.count)};
+			unsigned char rgb[3] = {
+					(unsigned char)std::min(255.0f, std::round(v.r/v.count)),
+					(unsigned char)std::min(255.0f, std::round(v.g/v.count)),
+					(unsigned char)std::min(255.0f, std::round(v.b/v.count))};
+			success = fwrite(xyz, sizeof(float), 3, file) == 3 && fwrite(rgb, 1, 3, file) == 3;
+			if(success && withNormals)
+			{
+				float n[3] = {v.nx, v.ny, v.nz};
+				float norm = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+				if(norm > 0.0f)
+				{
+					n[0]/=norm; n[1]/=norm; n[2]/=norm;
+				}
+				success = fwrite(n, sizeof(float), 3, file) == 3;
+			}
+			++written;
+		}
+
+		if(state)
+		{
+			if(state->isCanceled())
+			{
+				success = false;
+			}
+			else
+			{
+				state->callback(uFormat("Written tile %d/%d (%ld points)", tileIndex+1, (int)keys.size(), (long)written));
+			}
+		}
+	}
+
+	if(success)
+	{
+		fseek(file, countPos, SEEK_SET);
+		fprintf(file, "%010lu", written);
+	}
+	fclose(file);
+	clear();
+
+	if(!success)
+	{
+		UERROR("Failed writing \"%s\"!", path.c_str());
+		UFile::erase(path);
+		return -1;
+	}
+	return (long)written;
+}
+
+} /* namespace rtabmap */
@@ -46,6 +46,8 @@ DBDriver * DBDriver::create(const ParametersMap & parameters)
 
 DBDriver::DBDriver(const ParametersMap & parameters) :
 	_emptyTrashesTime(0),
+	_maxCommitTime(0),
+	_groupCommitSize(Parameters::defaultDbGroupCommitSize()*1024),
 	_timestampUpdate(true)
 {
 	this->parseParameters(parameters);
@@ -59,6 +61,12 @@ DBDriver::~DBDriver()
 
 void DBDriver::parseParameters(const ParametersMap & parameters)
 {
+	ParametersMap::const_iterator iter;
+	if((iter=parameters.find(Parameters::kDbGroupCommitSize())) != parameters.end())
+	{
+		int size = std::atoi((*iter).second.c_str());
+		_groupCommitSize = size>0?(unsigned long)size*1024:0;
+	}
 }
 
 void DBDriver::closeConnection(bool save, const std::string & outputUrl)
@@ -319,23 +327,62 @@ void DBDriver::emptyTrashes(bool async)
 
 	UTimer totalTime;
 	totalTime.start();
+	double maxCommitTime = 0.0;
 
-	std::map<int, Signature*> signatures;
-	std::map<int, VisualWord*> visualWords;
+	// Only the nodes/words already in the trash are saved by this call, the ones
+	// added while saving are left for the next call, so that a busy mapper
+	// cannot keep the group commits going indefinitely
 	_trashesMutex.lock();
-	{
-		ULOGGER_DEBUG("signatures=%d, visualWords=%d", _trashSignatures.size(), _trashVisualWords.size());
-		signatures = _trashSignatures;
-		visualWords = _trashVisualWords;
-		_trashSignatures.clear();
-		_trashVisualWords.clear();
-
-		_dbSafeAccessMutex.lock();
-	}
+	unsigned int signaturesLeft = (unsigned int)_trashSignatures.size();
+	unsigned int visualWordsLeft = (unsigned int)_trashVisualWords.size();
 	_trashesMutex.unlock();
 
-	if(signatures.size() || visualWords.size())
+	while(1)
 	{
+		std::map<int, Signature*> signatures;
+		std::map<int, VisualWord*> visualWords;
+		_trashesMutex.lock();
+		{
+			ULOGGER_DEBUG("signatures=%d, visualWords=%d", _trashSignatures.size(), _trashVisualWords.size());
+			if(_groupCommitSize == 0)
+			{
+				signatures = _trashSignatures;
+				visualWords = _trashVisualWords;
+				_trashSignatures.clear();
+				_trashVisualWords.clear();
+			}
+			else
+			{
+				// Group commit: take the oldest nodes/words up to the size budget,
+				// the others stay in the trash (and can still be loaded from it)
+				unsigned long bytes = 0;
+				while(signaturesLeft && _trashSignatures.size() && bytes < _groupCommitSize)
+				{
+					bytes += _trashSignatures.begin()->second->getMemoryUsed();
+					signatures.insert(*_trashSignatures.begin());
+					_trashSignatures.erase(_trashSignatures.begin());
+					--signaturesLeft;
+				}
+				while(visualWordsLeft && _trashVisualWords.size() && bytes < _groupCommitSize)
+				{
+					bytes += _trashVisualWords.begin()->second->getMemoryUsed();
+					visualWords.insert(*_trashVisualWords.begin());
+					_trashVisualWords.erase(_trashVisualWords.begin());
+					--visualWordsLeft;
+				}
+			}
+
+			_dbSafeAccessMutex.lock();
+		}
+		_trashesMutex.unlock();
+
+		if(signatures.empty() && visualWords.empty())
+		{
+			_dbSafeAccessMutex.unlock();
+			break;
+		}
+
+		UTimer commitTimer;
 		this->beginTransaction();
 		UTimer timer;
 		timer.start();
@@ -371,12 +418,51 @@ void DBDriver::emptyTrashes(bool async)
 		}
 
 		this->commit();
+		_dbSafeAccessMutex.unlock();
+
+		double commitTime = commitTimer.ticks();
+		if(commitTime > maxCommitTime)
+		{
+			maxCommitTime = commitTime;
+		}
+
+		if(_groupCommitSize == 0)
+		{
+			break;
+		}
 	}
 
-	_emptyTrashesTime = totalTime.ticks();
-	ULOGGER_DEBUG("Total time emptying trashes = %fs...", _emptyTrashesTime);
+	double emptyTrashesTime = totalTime.ticks();
+	_trashesMutex.lock();
+	_emptyTrashesTime = emptyTrashesTime;
+	_maxCommitTime = maxCommitTime;
+	_trashesMutex.unlock();
+	ULOGGER_DEBUG("Total time emptying trashes = %fs (longest transaction = %fs)...", emptyTrashesTime, maxCommitTime);
+}
 
-	_dbSafeAccessMutex.unlock();
+double DBDriver::getEmptyTrashesTime() const
+{
+	_trashesMutex.lock();
+	double time = _emptyTrashesTime;
+	_trashesMutex.unlock();
+	return time;
+}
+
+double DBDriver::getMaxCommitTime() const
+{
+	_trashesMutex.lock();
+	double time = _maxCommitTime;
+	_trashesMutex.unlock();
+	return time;
+}
+
+int DBDriver::getTrashesSize() const
+{
+	int size = 0;
+	_trashesMutex.lock();
+	size = (int)(_trashSignatures.size() + _trashVisualWords.size());
+	_trashesMutex.unlock();
+	return size;
 }
 
 void DBDriver::asyncSave(Signature * s)
@@ -464,18 +550,39 @@ void DBDriver::saveOrUpdate(const std::vector<VisualWord *> & words) const
 	}
 }
 
+// A node waiting in the trash (write-behind) would overwrite a link modified
+// directly in the database when it is saved, so save the trash first. Nodes
+// already taken by a group commit are written while _dbSafeAccessMutex is
+// locked, so the link query is done after them.
+void DBDriver::saveTrashesIfLinked(int from, int to)
+{
+	_trashesMutex.lock();
+	bool pending = _trashSignatures.find(from) != _trashSignatures.end() ||
+			_trashSignatures.find(to) != _trashSignatures.end();
+	_trashesMutex.unlock();
+	if(pending)
+	{
+		UDEBUG("Link %d->%d modified while a node is waiting to be saved, emptying the trash first.", from, to);
+		this->join();
+		this->emptyTrashes();
+	}
+}
+
 void DBDriver::addLink(const Link & link)
 {
+	saveTrashesIfLinked(link.from(), link.to());
 	_dbSafeAccessMutex.lock();
 	this->addLinkQuery(link);
 	_dbSafeAccessMutex.unlock();
 }
 void DBDriver::removeLink(int from, int to)
 {
+	saveTrashesIfLinked(from, to);
 	this->executeNoResult(uFormat("DELETE FROM Link WHERE from_id=%d and to_id=%d", from, to).c_str());
 }
 void DBDriver::updateLink(const Link & link)
 {
+	saveTrashesIfLinked(link.from(), link.to());
 	_dbSafeAccessMutex.lock();
 	this->updateLinkQuery(link);
 	_dbSafeAccessMutex.unlock();
@@ -846,6 +953,42 @@ void DBDriver::loadLinks(int signatureId, std::multimap<int, Link> & links, Link
 	}
 }
 
+void DBDriver::loadLinkTypes(int signatureId, std::multimap<int, Link::Type> & links, bool withLandmarks) const
+{
+	bool found = false;
+	// look in the trash
+	_trashesMutex.lock();
+	if(uContains(_trashSignatures, signatureId))
+	{
+		const Signature * s = _trashSignatures.at(signatureId);
+		UASSERT(s != 0);
+		for(std::map<int, Link>::const_iterator nIter = s->getLinks().begin();
+				nIter!=s->getLinks().end();
+				++nIter)
+		{
+			links.insert(std::make_pair(nIter->first, nIter->second.type()));
+		}
+		if(withLandmarks)
+		{
+			for(std::map<int, Link>::const_iterator nIter = s->getLandmarks().begin();
+					nIter!=s->getLandmarks().end();
+					++nIter)
+			{
+				links.insert(std::make_pair(nIter->first, nIter->second.type()));
+			}
+		}
+		found = true;
+	}
+	_trashesMutex.unlock();
+
+	if(!found)
+	{
+		_dbSafeAccessMutex.lock();
+		this->loadLinkTypesQuery(signatureId, links, withLandmarks);
+		_dbSafeAccessMutex.unlock();
+	}
+}
+
 void DBDriver::getWeight(int signatureId, int & weight) const
 {
 	bool found = false;
@@ -951,6 +1094,36 @@ void DBDriver::getAllLinks(std::multimap<int, Link> & links, bool ignoreNullLink
 	_trashesMutex.unlock();
 }
 
+void DBDriver::getAllLinkTypes(std::multimap<int, std::pair<int, Link::Type> > & links, bool withLandmarks) const
+{
+	_dbSafeAccessMutex.lock();
+	this->getAllLinkTypesQuery(links, withLandmarks);
+	_dbSafeAccessMutex.unlock();
+
+	// look in the trash
+	_trashesMutex.lock();
+	for(std::map<int, Signature*>::const_iterator iter=_trashSignatures.begin(); iter!=_trashSignatures.end(); ++iter)
+	{
+		links.erase(iter->first);
+		for(std::map<int, Link>::const_iterator jter=iter->second->getLinks().begin();
+			jter!=iter->second->getLinks().end();
+			++jter)
+		{
+			links.insert(std::make_pair(iter->first, std::make_pair(jter->first, jter->second.type())));
+		}
+		if(withLandmarks)
+		{
+			for(std::map<int, Link>::const_iterator jter=iter->second->getLandmarks().begin();
+				jter!=iter->second->getLandmarks().end();
+				++jter)
+			{
+				links.insert(std::make_pair(iter->first, std::make_pair(jter->first, jter->second.type())));
+			}
+		}
+	}
+	_trashesMutex.unlock();
+}
+
 void DBDriver::getLastNodeId(int & id) const
 {
 	// look in the trash
@@ -49,7 +49,12 @@ DBDriverSqlite3::DBDriverSqlite3(const ParametersMap & parameters) :
 	_cacheSize(Parameters::defaultDbSqlite3CacheSize()),
 	_journalMode(Parameters::defaultDbSqlite3JournalMode()),
 	_synchronous(Parameters::defaultDbSqlite3Synchronous()),
-	_tempStore(Parameters::defaultDbSqlite3TempStore())
+	_tempStore(Parameters::defaultDbSqlite3TempStore()),
+	_mmapSize(Parameters::defaultDbSqlite3MmapSize()),
+	_readOnly(Parameters::defaultDbSqlite3ReadOnly()),
+	_stmtCacheEnabled(true),
+	_stmtCacheHits(0),
+	_stmtCacheMisses(0)
 {
 	ULOGGER_DEBUG("treadSafe=%d", sqlite3_threadsafe());
 	this->parseParameters(parameters);
@@ -79,10 +84,22 @@ void DBDriverSqlite3::parseParameters(const ParametersMap & parameters)
 	{
 		this->setTempStore(std::atoi((*iter).second.c_str()));
 	}
+	if((iter=parameters.find(Parameters::kDbSqlite3MmapSize())) != parameters.end())
+	{
+		this->setMmapSize(std::atoi((*iter).second.c_str()));
+	}
+	if((iter=parameters.find(Parameters::kDbSqlite3ReadOnly())) != parameters.end())
+	{
+		this->setReadOnly(uStr2Bool((*iter).second.c_str()));
+	}
 	if((iter=parameters.find(Parameters::kDbSqlite3InMemory())) != parameters.end())
 	{
 		this->setDbInMemory(uStr2Bool((*iter).second.c_str()));
 	}
+	if((iter=parameters.find(Parameters::kDbSqlite3StatementCache())) != parameters.end())
+	{
+		this->setStatementCache(uStr2Bool((*iter).second.c_str()));
+	}
 	DBDriver::parseParameters(parameters);
 }
 
@@ -99,13 +116,24 @@ void DBDriverSqlite3::setCacheSize(unsigned int cacheSize)
 
 void DBDriverSqlite3::setJournalMode(int journalMode)
 {
-	if(journalMode >= 0 && journalMode < 5)
+	if(journalMode >= 0 && journalMode < 6)
 	{
 		_journalMode = journalMode;
 		if(this->isConnected())
 		{
 			switch(_journalMode)
 			{
+			case 5:
+				if(_dbInMemory || this->getUrl().empty())
+				{
+					UWARN("WAL journal mode cannot be used with a database in memory, MEMORY journal mode is used instead.");
+					this->executeNoResultQuery("PRAGMA journal_mode = MEMORY;");
+				}
+				else
+				{
+					this->executeNoResultQuery("PRAGMA journal_mode = WAL;");
+				}
+				break;
 			case 4:
 				this->executeNoResultQuery("PRAGMA journal_mode = OFF;");
 				break;
@@ -187,6 +215,44 @@ void DBDriverSqlite3::setTempStore(int tempStore)
 	}
 }
 
+void DBDriverSqlite3::setMmapSize(int mmapSize)
+{
+	if(mmapSize >= 0)
+	{
+		_mmapSize = mmapSize;
+		if(this->isConnected())
+		{
+			std::string query = uFormat("PRAGMA mmap_size = %lld;", (long long)_mmapSize*1024LL*1024LL);
+			this->executeNoResultQuery(query.c_str());
+		}
+	}
+	else
+	{
+		ULOGGER_ERROR("Wrong mmap size (%d)", mmapSize);
+	}
+}
+
+void DBDriverSqlite3::setReadOnly(bool readOnly)
+{
+	UDEBUG("readOnly=%d", readOnly?1:0);
+	if(readOnly != _readOnly)
+	{
+		if(this->isConnected())
+		{
+			// Hard reset...
+			join(true);
+			this->emptyTrashes();
+			this->closeConnection();
+			_readOnly = readOnly;
+			this->openConnection(this->getUrl());
+		}
+		else
+		{
+			_readOnly = readOnly;
+		}
+	}
+}
+
 void DBDriverSqlite3::setDbInMemory(bool dbInMemory)
 {
 	UDEBUG("dbInMemory=%d", dbInMemory?1:0);
@@ -346,8 +412,38 @@ bool DBDriverSqlite3::connectDatabaseQuery(const std::string & url, bool overwri
 		}
 		rc = sqlite3_open_v2(":memory:", &_ppDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0);
 	}
+	else if(_readOnly && dbFileExist && UFile::exists(url+"-wal"))
+	{
+		// Changes not yet checkpointed in the WAL file would be ignored with the immutable flag
+		UWARN("Database \"%s\" has a WAL file (it may be opened by another process), opening it read-only without the immutable flag.", url.c_str());
+		rc = sqlite3_open_v2(url.c_str(), &_ppDb, SQLITE_OPEN_READONLY, 0);
+	}
+	else if(_readOnly && dbFileExist)
+	{
+		ULOGGER_INFO("Using database \"%s\" from the hard drive (read-only).", url.c_str());
+		// Escape characters having a meaning in URI filenames
+		std::string path;
+		for(unsigned int i=0; i<url.size(); ++i)
+		{
+			if(url[i] == '%' || url[i] == '?' || url[i] == '#')
+			{
+				path += uFormat("%%%02X", (unsigned char)url[i]);
+			}
+			else
+			{
+				path += url[i];
+			}
+		}
+		// immutable: no locking or change detection, the file is assumed to not change while opened
+		std::string uri = "file:" + path + "?immutable=1&nolock=1";
+		rc = sqlite3_open_v2(uri.c_str(), &_ppDb, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, 0);
+	}
 	else
 	{
+		if(_readOnly)
+		{
+			UWARN("Database \"%s\" doesn't exist, it cannot be opened read-only. Ignoring %s parameter.", url.c_str(), Parameters::kDbSqlite3ReadOnly().c_str());
+		}
 		ULOGGER_INFO("Using database \"%s\" from the hard drive.", url.c_str());
 		rc = sqlite3_open_v2(url.c_str(), &_ppDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0);
 	}
@@ -402,9 +498,16 @@ bool DBDriverSqlite3::connectDatabaseQuery(const std::string & url, bool overwri
 
 	//Set database optimizations
 	this->setCacheSize(_cacheSize); // this will call the SQL
-	this->setJournalMode(_journalMode); // this will call the SQL
-	this->setSynchronous(_synchronous); // this will call the SQL
+	if(sqlite3_db_readonly(_ppDb, "main") != 1)
+	{
+		this->setJournalMode(_journalMode); // this will call the SQL
+		this->setSynchronous(_synchronous); // this will call the SQL
+	}
 	this->setTempStore(_tempStore); // this will call the SQL
+	if(_mmapSize > 0 && !_dbInMemory)
+	{
+		this->setMmapSize(_mmapSize); // this will call the SQL
+	}
 
 	return true;
 }
@@ -413,6 +516,11 @@ void DBDriverSqlite3::disconnectDatabaseQuery(bool save, const std::string & out
 	UDEBUG("");
 	if(_ppDb)
 	{
+		UDEBUG("Statement cache: %d statements, hits=%ld misses=%ld", (int)_stmtCache.size(), _stmtCacheHits, _stmtCacheMisses);
+		_stmtCache.clear(); // finalized below
+		_stmtCacheHits = 0;
+		_stmtCacheMisses = 0;
+
 		int rc = SQLITE_OK;
 		// make sure that all statements are finalized
 		sqlite3_stmt * pStmt;
@@ -467,6 +575,59 @@ void DBDriverSqlite3::disconnectDatabaseQuery(bool save, const std::string & out
 	}
 }
 
+void DBDriverSqlite3::setStatementCache(bool enabled)
+{
+	if(!enabled && _ppDb)
+	{
+		for(std::map<std::string, sqlite3_stmt *>::iterator iter=_stmtCache.begin(); iter!=_stmtCache.end(); ++iter)
+		{
+			int rc = sqlite3_finalize(iter->second);
+			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		}
+		_stmtCache.clear();
+	}
+	_stmtCacheEnabled = enabled;
+}
+
+sqlite3_stmt * DBDriverSqlite3::getCachedStatement(const std::string & query) const
+{
+	UASSERT(_ppDb != 0);
+	if(!_stmtCacheEnabled)
+	{
+		++_stmtCacheMisses;
+		sqlite3_stmt * ppStmt = 0;
+		int rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		return ppStmt;
+	}
+	std::map<std::string, sqlite3_stmt *>::iterator iter = _stmtCache.find(query);
+	if(iter != _stmtCache.end())
+	{
+		++_stmtCacheHits;
+		return iter->second;
+	}
+	++_stmtCacheMisses;
+	sqlite3_stmt * ppStmt = 0;
+	int rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+	_stmtCache.insert(std::make_pair(query, ppStmt));
+	return ppStmt;
+}
+
+void DBDriverSqlite3::releaseCachedStatement(sqlite3_stmt * ppStmt) const
+{
+	if(!_stmtCacheEnabled)
+	{
+		int rc = sqlite3_finalize(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		return;
+	}
+	int rc = sqlite3_reset(ppStmt);
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+	rc = sqlite3_clear_bindings(ppStmt);
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+}
+
 bool DBDriverSqlite3::isConnectedQuery() const
 {
 	return _ppDb != 0;
@@ -2177,46 +2338,43 @@ bool DBDriverSqlite3::getNodeInfoQuery(int signatureId,
 		{
 			query << "SELECT pose, map_id, weight, label, stamp, ground_truth_pose, velocity, gps, env_sensors "
 					 "FROM Node "
-					 "WHERE id = " << signatureId <<
-					 ";";
+					 "WHERE id = ?;";
 		}
 		else if(uStrNumCmp(_version, "0.14.0") >= 0)
 		{
 			query << "SELECT pose, map_id, weight, label, stamp, ground_truth_pose, velocity, gps "
 					 "FROM Node "
-					 "WHERE id = " << signatureId <<
-					 ";";
+					 "WHERE id = ?;";
 		}
 		else if(uStrNumCmp(_version, "0.13.0") >= 0)
 		{
 			query << "SELECT pose, map_id, weight, label, stamp, ground_truth_pose, velocity "
 					 "FROM Node "
-					 "WHERE id = " << signatureId <<
-					 ";";
+					 "WHERE id = ?;";
 		}
 		else if(uStrNumCmp(_version, "0.11.1") >= 0)
 		{
 			query << "SELECT pose, map_id, weight, label, stamp, ground_truth_pose "
 					 "FROM Node "
-					 "WHERE id = " << signatureId <<
-					 ";";
+					 "WHERE id = ?;";
 		}
 		else if(uStrNumCmp(_version, "0.8.5") >= 0)
 		{
 			query << "SELECT pose, map_id, weight, label, stamp "
 					 "FROM Node "
-					 "WHERE id = " << signatureId <<
-					 ";";
+					 "WHERE id = ?;";
 		}
 		else
 		{
 			query << "SELECT pose, map_id, weight "
 					 "FROM Node "
-					 "WHERE id = " << signatureId <<
-					 ";";
+					 "WHERE id = ?;";
 		}
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = getCachedStatement(query.str());
+
+		// bind id
+		rc = sqlite3_bind_int(ppStmt, 1, signatureId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 
 		const void * data = 0;
@@ -2309,9 +2467,8 @@ bool DBDriverSqlite3::getNodeInfoQuery(int signatureId,
 		}
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement for the next call
+		releaseCachedStatement(ppStmt);
 	}
 	return found;
 }
@@ -2557,6 +2714,94 @@ void DBDriverSqlite3::getAllLinksQuery(std::multimap<int, Link> & links, bool ig
 	}
 }
 
+void DBDriverSqlite3::getAllLinkTypesQuery(std::multimap<int, std::pair<int, Link::Type> > & links, bool withLandmarks) const
+{
+	links.clear();
+	if(_ppDb)
+	{
+		UTimer timer;
+		timer.start();
+		int rc = SQLITE_OK;
+		sqlite3_stmt * ppStmt = 0;
+		std::stringstream query;
+
+		query << "SELECT from_id, to_id, type FROM Link";
+		if(uStrNumCmp(_version, "0.18.3") >= 0 && !withLandmarks)
+		{
+			query << " WHERE type!=" << Link::kLandmark;
+		}
+		query << " ORDER BY from_id, to_id";
+
+		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+
+		// Process the result if one
+		rc = sqlite3_step(ppStmt);
+		while(rc == SQLITE_ROW)
+		{
+			int fromId = sqlite3_column_int(ppStmt, 0);
+			int toId = sqlite3_column_int(ppStmt, 1);
+			int type = sqlite3_column_int(ppStmt, 2);
+			if(uStrNumCmp(_version, "0.7.4") < 0)
+			{
+				// neighbor is 0, loop closures are 1 and 2 (child)
+				type = type==0?Link::kNeighbor:Link::kGlobalClosure;
+			}
+			links.insert(links.end(), std::make_pair(fromId, std::make_pair(toId, (Link::Type)type)));
+			rc = sqlite3_step(ppStmt);
+		}
+
+		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+
+		// Finalize (delete) the statement
+		rc = sqlite3_finalize(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		UDEBUG("Time=%fs (%d links)", timer.ticks(), (int)links.size());
+	}
+}
+
+void DBDriverSqlite3::loadLinkTypesQuery(int signatureId, std::multimap<int, Link::Type> & links, bool withLandmarks) const
+{
+	if(_ppDb)
+	{
+		int rc = SQLITE_OK;
+		sqlite3_stmt * ppStmt = 0;
+		std::stringstream query;
+
+		query << "SELECT to_id, type FROM Link WHERE from_id = ?";
+		if(uStrNumCmp(_version, "0.18.3") >= 0 && !withLandmarks)
+		{
+			query << " AND type != " << Link::kLandmark;
+		}
+		query << " ORDER BY to_id";
+
+		ppStmt = getCachedStatement(query.str());
+
+		// bind id
+		rc = sqlite3_bind_int(ppStmt, 1, signatureId);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+
+		// Process the result if one
+		rc = sqlite3_step(ppStmt);
+		while(rc == SQLITE_ROW)
+		{
+			int toId = sqlite3_column_int(ppStmt, 0);
+			int type = sqlite3_column_int(ppStmt, 1);
+			if(uStrNumCmp(_version, "0.7.4") < 0)
+			{
+				// neighbor is 0, loop closures are 1 and 2 (child)
+				type = type==0?Link::kNeighbor:Link::kGlobalClosure;
+			}
+			links.insert(links.end(), std::make_pair(toId, (Link::Type)type));
+			rc = sqlite3_step(ppStmt);
+		}
+		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+
+		// Reset the statement for the next call
+		releaseCachedStatement(ppStmt);
+	}
+}
+
 void DBDriverSqlite3::getLastIdQuery(const std::string & tableName, int & id, const std::string & fieldName) const
 {
 	if(_ppDb)
@@ -2611,16 +2856,19 @@ void DBDriverSqlite3::getInvertedIndexNiQuery(int nodeId, int & ni) const
 		{
 			query << "SELECT count(word_id) "
 				  << "FROM Feature "
-				  << "WHERE node_id=" << nodeId << ";";
+				  << "WHERE node_id=?;";
 		}
 		else
 		{
 			query << "SELECT count(word_id) "
 				  << "FROM Map_Node_Word "
-				  << "WHERE node_id=" << nodeId << ";";
+				  << "WHERE node_id=?;";
 		}
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = getCachedStatement(query.str());
+
+		// bind id
+		rc = sqlite3_bind_int(ppStmt, 1, nodeId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 
 
@@ -2638,9 +2886,8 @@ void DBDriverSqlite3::getInvertedIndexNiQuery(int nodeId, int & ni) const
 		}
 
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement for the next call
+		releaseCachedStatement(ppStmt);
 		ULOGGER_DEBUG("Time=%fs", timer.ticks());
 	}
 }
@@ -2806,11 +3053,12 @@ void DBDriverSqlite3::getWeightQuery(int nodeId, int & weight) const
 		sqlite3_stmt * ppStmt = 0;
 		std::stringstream query;
 
-		query << "SELECT weight FROM node WHERE id =  "
-			  << nodeId
-			  << ";";
+		query << "SELECT weight FROM node WHERE id = ?;";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = getCachedStatement(query.str());
+
+		// bind id
+		rc = sqlite3_bind_int(ppStmt, 1, nodeId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 
 
@@ -2823,9 +3071,8 @@ void DBDriverSqlite3::getWeightQuery(int nodeId, int & weight) const
 		}
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement for the next call
+		releaseCachedStatement(ppStmt);
 	}
 }
 
@@ -3729,7 +3976,7 @@ void DBDriverSqlite3::loadLinksQuery(
 		{
 			query << "SELECT to_id, type, transform FROM Link ";
 		}
-		query << "WHERE from_id = " << signatureId;
+		query << "WHERE from_id = ?";
 		if(typeIn < Link::kEnd)
 		{
 			if(uStrNumCmp(_version, "0.7.4") >= 0)
@@ -3752,7 +3999,10 @@ void DBDriverSqlite3::loadLinksQuery(
 
 		query << " ORDER BY to_id";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = getCachedStatement(query.str());
+
+		// bind id
+		rc = sqlite3_bind_int(ppStmt, 1, signatureId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 
 		int toId = -1;
@@ -3841,9 +4091,8 @@ void DBDriverSqlite3::loadLinksQuery(
 
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error (%s): %s", _version.c_str(), sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement for the next call
+		releaseCachedStatement(ppStmt);
 
 		if(links.size() == 0)
 		{
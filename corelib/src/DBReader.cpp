@@ -33,6 +33,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UEventsManager.h>
+#include <rtabmap/utilite/UThread.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/USemaphore.h>
 
 #include "rtabmap/core/CameraEvent.h"
 #include "rtabmap/core/RtabmapEvent.h"
@@ -42,6 +45,232 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rtabmap {
 
+class DBReaderPrefetcher;
+
+/**
+ * Decompress the data of nodes loaded by DBReaderPrefetcher.
+ */
+class DBReaderDecoder : public UThread
+{
+public:
+	DBReaderDecoder(DBReaderPrefetcher * prefetcher) : prefetcher_(prefetcher) {}
+	virtual ~DBReaderDecoder() {this->join(true);}
+protected:
+	virtual void mainLoopKill();
+	virtual void mainLoop();
+private:
+	DBReaderPrefetcher * prefetcher_;
+};
+
+/**
+ * Load nodes (with their compressed data and links) ahead
+ * of DBReader in id order, up to "size" nodes in advance. If
+ * decoders are used, data of the loaded nodes are decompressed
+ * in parallel, then reordered to be returned in id order.
+ */
+class DBReaderPrefetcher : public UThread
+{
+public:
+	DBReaderPrefetcher(DBDriver * driver, const std::vector<int> & ids, int size, int decoders) :
+		driver_(driver),
+		ids_(ids),
+		index_(0),
+		nextIndex_(0),
+		freeSlots_(size)
+	{
+		UASSERT(driver_ != 0);
+		UASSERT(size > 0);
+		for(int i=0; i<decoders; ++i)
+		{
+			decoders_.push_back(new DBReaderDecoder(this));
+		}
+	}
+	virtual ~DBReaderPrefetcher()
+	{
+		// kill all decoders before joining them, so that they all wake up
+		for(unsigned int i=0; i<decoders_.size(); ++i)
+		{
+			decoders_[i]->kill();
+		}
+		for(unsigned int i=0; i<decoders_.size(); ++i)
+		{
+			delete decoders_[i];
+		}
+		this->join(true);
+		for(std::map<unsigned int, Item>::iterator iter=buffer_.begin(); iter!=buffer_.end(); ++iter)
+		{
+			delete iter->second.s;
+		}
+	}
+
+	void startAll()
+	{
+		for(unsigned int i=0; i<decoders_.size(); ++i)
+		{
+			decoders_[i]->start();
+		}
+		this->start();
+	}
+
+	// Blocking until the next node is loaded (and decoded). Nodes are returned in
+	// the same order than the ids given in the constructor. Returned signature (null
+	// if it could not be loaded) must be freed after usage. "decodeTime" is set
+	// to -1 if the data are not already decompressed.
+	Signature * take(double & decodeTime, int & buffered)
+	{
+		Signature * s = 0;
+		decodeTime = -1.0;
+		buffered = 0;
+		while(1)
+		{
+			bufferMutex_.lock();
+			std::map<unsigned int, Item>::iterator iter = buffer_.find(nextIndex_);
+			if(iter != buffer_.end() && iter->second.ready)
+			{
+				s = iter->second.s;
+				decodeTime = iter->second.decodeTime;
+				buffer_.erase(iter);
+				++nextIndex_;
+				for(iter=buffer_.begin(); iter!=buffer_.end(); ++iter)
+				{
+					buffered += iter->second.ready?1:0;
+				}
+				bufferMutex_.unlock();
+				freeSlots_.release();
+				break;
+			}
+			bool done = !this->isRunning() && iter == buffer_.end();
+			bufferMutex_.unlock();
+			if(done)
+			{
+				break;
+			}
+			dataReady_.acquire();
+		}
+		return s;
+	}
+
+	// Called by decoders, blocking until there is something to decode
+	bool decodeNext()
+	{
+		toDecode_.acquire();
+		Signature * s = 0;
+		unsigned int index = 0;
+		bufferMutex_.lock();
+		if(!decodeQueue_.empty())
+		{
+			index = decodeQueue_.front();
+			decodeQueue_.pop_front();
+			s = buffer_.at(index).s;
+		}
+		bufferMutex_.unlock();
+
+		if(s == 0)
+		{
+			return false;
+		}
+
+		UTimer timer;
+		s->sensorData().uncompressData();
+		double decodeTime = timer.ticks();
+
+		bufferMutex_.lock();
+		buffer_.at(index).ready = true;
+		buffer_.at(index).decodeTime = decodeTime;
+		bufferMutex_.unlock();
+		dataReady_.release();
+		return true;
+	}
+
+	void releaseDecoder()
+	{
+		toDecode_.release();
+	}
+
+protected:
+	virtual void mainLoopKill()
+	{
+		freeSlots_.release();
+		dataReady_.release();
+	}
+
+	virtual void mainLoop()
+	{
+		if(index_ >= ids_.size())
+		{
+			this->kill();
+			return;
+		}
+
+		freeSlots_.acquire();
+		if(this->isKilled())
+		{
+			return;
+		}
+
+		std::list<int> signIds;
+		signIds.push_back(ids_[index_]);
+		std::list<Signature *> signatures;
+		driver_->loadSignatures(signIds, signatures);
+		Item item;
+		if(!signatures.empty())
+		{
+			driver_->loadNodeData(signatures);
+			item.s = signatures.front();
+		}
+		item.ready = item.s == 0 || decoders_.empty();
+
+		bufferMutex_.lock();
+		buffer_.insert(std::make_pair(index_, item));
+		if(!item.ready)
+		{
+			decodeQueue_.push_back(index_);
+		}
+		bufferMutex_.unlock();
+		++index_;
+
+		if(item.ready)
+		{
+			dataReady_.release();
+		}
+		else
+		{
+			toDecode_.release();
+		}
+	}
+
+private:
+	struct Item
+	{
+		Item() : s(0), ready(false), decodeTime(-1.0) {}
+		Signature * s;
+		bool ready;
+		double decodeTime;
+	};
+
+	DBDriver * driver_;
+	std::vector<int> ids_;
+	unsigned int index_;
+	unsigned int nextIndex_;
+	std::map<unsigned int, Item> buffer_; // reorder buffer <index, item>
+	std::list<unsigned int> decodeQueue_;
+	std::vector<DBReaderDecoder*> decoders_;
+	UMutex bufferMutex_;
+	USemaphore freeSlots_;
+	USemaphore toDecode_;
+	USemaphore dataReady_;
+};
+
+void DBReaderDecoder::mainLoopKill()
+{
+	prefetcher_->releaseDecoder();
+}
+
+void DBReaderDecoder::mainLoop()
+{
+	prefetcher_->decodeNext();
+}
+
 DBReader::DBReader(const std::string & databasePath,
 				   float frameRate,
 				   bool odometryIgnored,
@@ -63,7 +292,12 @@ DBReader::DBReader(const std::string & databasePath,
 	_previousMapId(-1),
 	_previousStamp(0),
 	_previousMapID(0),
-	_calibrated(false)
+	_calibrated(false),
+	_readOnly(false),
+	_mmapSize(0),
+	_prefetchSize(0),
+	_decodeThreads(0),
+	_prefetcher(0)
 {
 	if(_stopId>0 && _stopId<_startId)
 	{
@@ -92,7 +326,12 @@ DBReader::DBReader(const std::list<std::string> & databasePaths,
 	_previousMapId(-1),
 	_previousStamp(0),
 	_previousMapID(0),
-	_calibrated(false)
+	_calibrated(false),
+	_readOnly(false),
+	_mmapSize(0),
+	_prefetchSize(0),
+	_decodeThreads(0),
+	_prefetcher(0)
 {
 	if(_stopId>0 && _stopId<_startId)
 	{
@@ -102,6 +341,7 @@ DBReader::DBReader(const std::list<std::string> & databasePaths,
 
 DBReader::~DBReader()
 {
+	delete _prefetcher;
 	if(_dbDriver)
 	{
 		_dbDriver->closeConnection();
@@ -109,10 +349,24 @@ DBReader::~DBReader()
 	}
 }
 
+void DBReader::setReadOnly(bool enabled, int mmapSize)
+{
+	_readOnly = enabled;
+	_mmapSize = mmapSize;
+}
+
+void DBReader::setPrefetchSize(int size, int decodeThreads)
+{
+	_prefetchSize = size;
+	_decodeThreads = decodeThreads;
+}
+
 bool DBReader::init(
 		const std::string & calibrationFolder,
 		const std::string & cameraName)
 {
+	delete _prefetcher;
+	_prefetcher = 0;
 	if(_dbDriver)
 	{
 		_dbDriver->closeConnection();
@@ -142,6 +396,11 @@ bool DBReader::init(
 
 	rtabmap::ParametersMap parameters;
 	parameters.insert(rtabmap::ParametersPair(rtabmap::Parameters::kDbSqlite3InMemory(), "false"));
+	if(_readOnly)
+	{
+		parameters.insert(rtabmap::ParametersPair(rtabmap::Parameters::kDbSqlite3ReadOnly(), "true"));
+		parameters.insert(rtabmap::ParametersPair(rtabmap::Parameters::kDbSqlite3MmapSize(), uNumber2Str(_mmapSize)));
+	}
 	_dbDriver = DBDriver::create(parameters);
 	if(!_dbDriver)
 	{
@@ -207,6 +466,12 @@ bool DBReader::init(
 		_calibrated = true; // database is empty, make sure calibration warning is not shown.
 	}
 
+	if(_prefetchSize > 0 && _currentId != _ids.end())
+	{
+		_prefetcher = new DBReaderPrefetcher(_dbDriver, std::vector<int>(_currentId, _ids.end()), _prefetchSize, _decodeThreads);
+		_prefetcher->startAll();
+	}
+
 	_timer.start();
 
 	return true;
@@ -331,16 +596,41 @@ SensorData DBReader::getNextData(CameraInfo * info)
 	{
 		if(_currentId != _ids.end())
 		{
-			std::list<int> signIds;
-			signIds.push_back(*_currentId);
-			std::list<Signature *> signatures;
-			_dbDriver->loadSignatures(signIds, signatures);
-			if(signatures.empty())
+			Signature * s  = 0;
+			double decodeTime = -1.0;
+			int buffered = 0;
+			if(_prefetcher)
 			{
-				return data;
+				s = _prefetcher->take(decodeTime, buffered);
+				if(s == 0)
+				{
+					UERROR("Node %d could not be loaded from the database, skipping it.", *_currentId);
+					++_currentId;
+					return data;
+				}
+				if(s->id() != *_currentId)
+				{
+					UERROR("Prefetched node %d is not the expected node %d, stopping.", s->id(), *_currentId);
+					delete s;
+					_currentId = _ids.end();
+					return data;
+				}
+			}
+			else
+			{
+				std::list<int> signIds;
+				signIds.push_back(*_currentId);
+				std::list<Signature *> signatures;
+				_dbDriver->loadSignatures(signIds, signatures);
+				if(signatures.empty())
+				{
+					UERROR("Node %d could not be loaded from the database, skipping it.", *_currentId);
+					++_currentId;
+					return data;
+				}
+				_dbDriver->loadNodeData(signatures);
+				s = signatures.front();
 			}
-			_dbDriver->loadNodeData(signatures);
-			Signature * s  = signatures.front();
 			data = s->sensorData();
 
 			// info
@@ -348,8 +638,26 @@ SensorData DBReader::getNextData(CameraInfo * info)
 			Transform globalPose;
 			cv::Mat globalPoseCov;
 
+			// Links are already loaded with the signature
 			std::multimap<int, Link> priorLinks;
-			_dbDriver->loadLinks(*_currentId, priorLinks, Link::kPosePrior);
+			std::multimap<int, Link> gravityLinks;
+			std::multimap<int, Link> links;
+			for(std::multimap<int, Link>::const_iterator iter=s->getLinks().begin(); iter!=s->getLinks().end(); ++iter)
+			{
+				if(iter->second.type() == Link::kPosePrior)
+				{
+					priorLinks.insert(*iter);
+				}
+				else if(iter->second.type() == Link::kGravity)
+				{
+					gravityLinks.insert(*iter);
+				}
+				else if(iter->second.type() == Link::kNeighbor)
+				{
+					links.insert(*iter);
+				}
+			}
+
 			if( priorLinks.size() &&
 				!priorLinks.begin()->second.transform().isNull() &&
 				priorLinks.begin()->second.infMatrix().cols == 6 &&
@@ -368,8 +676,6 @@ SensorData DBReader::getNextData(CameraInfo * info)
 			}
 
 			Transform gravityTransform;
-			std::multimap<int, Link> gravityLinks;
-			_dbDriver->loadLinks(*_currentId, gravityLinks, Link::kGravity);
 			if( gravityLinks.size() &&
 				!gravityLinks.begin()->second.transform().isNull() &&
 				gravityLinks.begin()->second.infMatrix().cols == 6 &&
@@ -381,8 +687,6 @@ SensorData DBReader::getNextData(CameraInfo * info)
 			cv::Mat infMatrix = cv::Mat::eye(6,6,CV_64FC1);
 			if(!_odometryIgnored)
 			{
-				std::multimap<int, Link> links;
-				_dbDriver->loadLinks(*_currentId, links, Link::kNeighbor);
 				if(links.size() && links.begin()->first < *_currentId)
 				{
 					// assume the first is the backward neighbor, take its variance
@@ -452,7 +756,17 @@ SensorData DBReader::getNextData(CameraInfo * info)
 				_previousMapID = s->mapId();
 			}
 
-			data.uncompressData();
+			if(decodeTime < 0.0)
+			{
+				UTimer decodeTimer;
+				data.uncompressData();
+				decodeTime = decodeTimer.ticks();
+			}
+			if(info)
+			{
+				info->timeDecoding = decodeTime;
+				info->bufferedFrames = buffered;
+			}
 			if(data.cameraModels().size() > 1 &&
 				_cameraIndex >= 0)
 			{
@@ -0,0 +1,277 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/DescriptorDistance.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RTABMAP_DESCRIPTOR_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RTABMAP_DESCRIPTOR_NEON
+#endif
+
+#if defined(__POPCNT__) || (defined(_MSC_VER) && defined(_M_X64) && defined(__AVX__))
+#include <nmmintrin.h>
+#define RTABMAP_DESCRIPTOR_POPCNT
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define RTABMAP_DESCRIPTOR_SSSE3
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+// POPCNT/SSSE3 not enabled at compile time (no -march flag), the Hamming kernel is selected at run time
+#include <tmmintrin.h>
+#define RTABMAP_DESCRIPTOR_X86_DISPATCH
+#endif
+
+#ifdef _MSC_VER
+typedef unsigned __int64 uint64_type;
+#else
+#include <stdint.h>
+typedef uint64_t uint64_type;
+#endif
+
+namespace rtabmap {
+
+namespace {
+
+inline int popcount64(uint64_type v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(v);
+#else
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+#ifdef RTABMAP_DESCRIPTOR_SSE2
+inline float horizontalSum(__m128 v)
+{
+	__m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(v, shuffled);
+	shuffled = _mm_movehl_ps(shuffled, sums);
+	sums = _mm_add_ss(sums, shuffled);
+	return _mm_cvtss_f32(sums);
+}
+#endif
+
+#ifdef RTABMAP_DESCRIPTOR_NEON
+inline float horizontalSum(float32x4_t v)
+{
+	float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+	return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+#endif
+
+int hammingScalar(const unsigned char * a, const unsigned char * b, int size, int i)
+{
+	int sum = 0;
+	for(; i+8<=size; i+=8)
+	{
+		uint64_type va, vb;
+		memcpy(&va, a+i, 8);
+		memcpy(&vb, b+i, 8);
+		sum += popcount64(va ^ vb);
+	}
+	for(; i<size; ++i)
+	{
+		sum += popcount64((uint64_type)(a[i] ^ b[i]));
+	}
+	return sum;
+}
+
+#if defined(RTABMAP_DESCRIPTOR_POPCNT) || defined(RTABMAP_DESCRIPTOR_X86_DISPATCH)
+// Hardware population count on 64 bits words
+#ifdef RTABMAP_DESCRIPTOR_X86_DISPATCH
+__attribute__((target("popcnt")))
+#endif
+int hammingPopcnt(const unsigned char * a, const unsigned char * b, int size)
+{
+	int i = 0;
+	int sum = 0;
+	for(; i+8<=size; i+=8)
+	{
+		uint64_type va, vb;
+		memcpy(&va, a+i, 8);
+		memcpy(&vb, b+i, 8);
+#if defined(_MSC_VER)
+		sum += (int)_mm_popcnt_u64(va ^ vb);
+#else
+		sum += __builtin_popcountll(va ^ vb);
+#endif
+	}
+	return sum + hammingScalar(a, b, size, i);
+}
+#endif
+
+#if defined(RTABMAP_DESCRIPTOR_SSSE3) || defined(RTABMAP_DESCRIPTOR_X86_DISPATCH)
+// Bits of each nibble counted with a 16 entries lookup table (pshufb),
+// then bytes are summed with psadbw
+#ifdef RTABMAP_DESCRIPTOR_X86_DISPATCH
+__attribute__((target("ssse3")))
+#endif
+int hammingSsse3(const unsigned char * a, const unsigned char * b, int size)
+{
+	const __m128i lookup = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m128i lowMask = _mm_set1_epi8(0x0F);
+	__m128i acc = _mm_setzero_si128();
+	int i = 0;
+	for(; i+16<=size; i+=16)
+	{
+		__m128i v = _mm_xor_si128(
+				_mm_loadu_si128((const __m128i*)(a+i)),
+				_mm_loadu_si128((const __m128i*)(b+i)));
+		__m128i low = _mm_and_si128(v, lowMask);
+		__m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), lowMask);
+		__m128i bits = _mm_add_epi8(_mm_shuffle_epi8(lookup, low), _mm_shuffle_epi8(lookup, high));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(bits, _mm_setzero_si128()));
+	}
+	int sum = _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc));
+	return sum + hammingScalar(a, b, size, i);
+}
+#endif
+
+#ifdef RTABMAP_DESCRIPTOR_X86_DISPATCH
+typedef int (*HammingKernel)(const unsigned char *, const unsigned char *, int);
+
+int hammingGeneric(const unsigned char * a, const unsigned char * b, int size)
+{
+	return hammingScalar(a, b, size, 0);
+}
+
+HammingKernel selectHammingKernel()
+{
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("popcnt"))
+	{
+		return hammingPopcnt;
+	}
+	if(__builtin_cpu_supports("ssse3"))
+	{
+		return hammingSsse3;
+	}
+	return hammingGeneric;
+}
+#endif
+
+} // namespace
+
+float descriptorDistanceL2Sqr(const float * a, const float * b, int size)
+{
+	int i = 0;
+	float sum = 0.0f;
+#if defined(RTABMAP_DESCRIPTOR_SSE2)
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for(; i+8<=size; i+=8)
+	{
+		__m128 d0 = _mm_sub_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
+		__m128 d1 = _mm_sub_ps(_mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4));
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+	}
+	sum = horizontalSum(_mm_add_ps(acc0, acc1));
+#elif defined(RTABMAP_DESCRIPTOR_NEON)
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+	for(; i+8<=size; i+=8)
+	{
+		float32x4_t d0 = vsubq_f32(vld1q_f32(a+i), vld1q_f32(b+i));
+		float32x4_t d1 = vsubq_f32(vld1q_f32(a+i+4), vld1q_f32(b+i+4));
+		acc0 = vmlaq_f32(acc0, d0, d0);
+		acc1 = vmlaq_f32(acc1, d1, d1);
+	}
+	sum = horizontalSum(vaddq_f32(acc0, acc1));
+#endif
+	for(; i<size; ++i)
+	{
+		float d = a[i] - b[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+float descriptorDotProduct(const float * a, const float * b, int size)
+{
+	int i = 0;
+	float sum = 0.0f;
+#if defined(RTABMAP_DESCRIPTOR_SSE2)
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for(; i+8<=size; i+=8)
+	{
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4)));
+	}
+	sum = horizontalSum(_mm_add_ps(acc0, acc1));
+#elif defined(RTABMAP_DESCRIPTOR_NEON)
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+	for(; i+8<=size; i+=8)
+	{
+		acc0 = vmlaq_f32(acc0, vld1q_f32(a+i), vld1q_f32(b+i));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(a+i+4), vld1q_f32(b+i+4));
+	}
+	sum = horizontalSum(vaddq_f32(acc0, acc1));
+#endif
+	for(; i<size; ++i)
+	{
+		sum += a[i]*b[i];
+	}
+	return sum;
+}
+
+int descriptorDistanceHamming(const unsigned char * a, const unsigned char * b, int size)
+{
+#if defined(RTABMAP_DESCRIPTOR_POPCNT)
+	return hammingPopcnt(a, b, size);
+#elif defined(RTABMAP_DESCRIPTOR_SSSE3)
+	return hammingSsse3(a, b, size);
+#elif defined(RTABMAP_DESCRIPTOR_X86_DISPATCH)
+	static const HammingKernel kernel = selectHammingKernel();
+	return kernel(a, b, size);
+#else
+	int i = 0;
+	int sum = 0;
+#if defined(RTABMAP_DESCRIPTOR_NEON)
+	uint32x4_t acc = vdupq_n_u32(0);
+	for(; i+16<=size; i+=16)
+	{
+		uint8x16_t bits = vcntq_u8(veorq_u8(vld1q_u8(a+i), vld1q_u8(b+i)));
+		acc = vpadalq_u16(acc, vpaddlq_u8(bits));
+	}
+	uint64x2_t acc64 = vpaddlq_u32(acc);
+	sum = (int)(vgetq_lane_u64(acc64, 0) + vgetq_lane_u64(acc64, 1));
+#endif
+	return sum + hammingScalar(a, b, size, i);
+#endif
+}
+
+} // namespace rtabmap
@@ -36,6 +36,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/utilite/UMath.h"
 #include "rtabmap/utilite/ULogger.h"
 #include "rtabmap/utilite/UTimer.h"
+#include "rtabmap/utilite/UProfiler.h"
 #include <opencv2/imgproc/imgproc_c.h>
 #include <opencv2/core/version.hpp>
 #include <opencv2/opencv_modules.hpp>
@@ -656,6 +657,7 @@ Feature2D * Feature2D::create(Feature2D::Type type, const ParametersMap & parame
 
 std::vector<cv::KeyPoint> Feature2D::generateKeypoints(const cv::Mat & image, const cv::Mat & maskIn)
 {
+	UPROFILER_ZONE("Feature2D::generateKeypoints");
 	UASSERT(!image.empty());
 	UASSERT(image.type() == CV_8UC1);
 
@@ -760,6 +762,7 @@ cv::Mat Feature2D::generateDescriptors(
 		const cv::Mat & image,
 		std::vector<cv::KeyPoint> & keypoints) const
 {
+	UPROFILER_ZONE("Feature2D::generateDescriptors");
 	cv::Mat descriptors;
 	if(keypoints.size())
 	{
@@ -32,6 +32,32 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rtabmap {
 
+namespace {
+
+template<typename Distance>
+void * loadIndex(
+		const std::string & path,
+		const rtflann::Matrix<typename Distance::ElementType> & dataset,
+		rtflann::flann_algorithm_t type)
+{
+	rtflann::IndexParams params;
+	params["algorithm"] = type;
+	rtflann::Index<Distance> * index = new rtflann::Index<Distance>(dataset, params);
+	try
+	{
+		index->load(path);
+	}
+	catch(const rtflann::FLANNException & e)
+	{
+		UWARN("Failed to load FLANN index \"%s\": %s", path.c_str(), e.what());
+		delete index;
+		return 0;
+	}
+	return index;
+}
+
+}
+
 FlannIndex::FlannIndex():
 		index_(0),
 		nextIndex_(0),
@@ -365,6 +391,137 @@ bool FlannIndex::isBuilt()
 	return index_!=0;
 }
 
+bool FlannIndex::save(const std::string & path) const
+{
+	if(!index_)
+	{
+		UERROR("Index is not built, cannot save it to \"%s\"", path.c_str());
+		return false;
+	}
+	try
+	{
+		if(featuresType_ == CV_8UC1)
+		{
+			((rtflann::Index<rtflann::Hamming<unsigned char> >*)index_)->save(path);
+		}
+		else
+		{
+			if(useDistanceL1_)
+			{
+				((rtflann::Index<rtflann::L1<float> >*)index_)->save(path);
+			}
+			else if(featuresDim_ <= 3)
+			{
+				((rtflann::Index<rtflann::L2_Simple<float> >*)index_)->save(path);
+			}
+			else
+			{
+				((rtflann::Index<rtflann::L2<float> >*)index_)->save(path);
+			}
+		}
+	}
+	catch(const rtflann::FLANNException & e)
+	{
+		UERROR("Failed to save FLANN index \"%s\": %s", path.c_str(), e.what());
+		return false;
+	}
+	return true;
+}
+
+bool FlannIndex::load(
+		const std::string & path,
+		const cv::Mat & features,
+		bool useDistanceL1,
+		float rebalancingFactor)
+{
+	UDEBUG("");
+	this->release();
+	UASSERT(index_ == 0);
+	UASSERT(features.type() == CV_32FC1 || features.type() == CV_8UC1);
+
+	FILE * fin = fopen(path.c_str(), "rb");
+	if(fin == NULL)
+	{
+		UWARN("Cannot open FLANN index \"%s\"", path.c_str());
+		return false;
+	}
+	rtflann::IndexHeader header;
+	try
+	{
+		header = rtflann::load_header(fin);
+	}
+	catch(const rtflann::FLANNException & e)
+	{
+		UWARN("Failed to read FLANN index \"%s\": %s", path.c_str(), e.what());
+		fclose(fin);
+		return false;
+	}
+	fclose(fin);
+
+	if(header.h.rows != (size_t)features.rows ||
+	   header.h.cols != (size_t)features.cols ||
+	   header.h.data_type != (features.type() == CV_8UC1?rtflann::FLANN_UINT8:rtflann::FLANN_FLOAT32))
+	{
+		UWARN("FLANN index \"%s\" (%dx%d) doesn't match the features (%dx%d)",
+				path.c_str(), (int)header.h.rows, (int)header.h.cols, features.rows, features.cols);
+		return false;
+	}
+
+	featuresType_ = features.type();
+	featuresDim_ = features.cols;
+	useDistanceL1_ = useDistanceL1;
+	rebalancingFactor_ = rebalancingFactor;
+	isLSH_ = header.h.index_type == rtflann::FLANN_INDEX_LSH;
+	if(isLSH_)
+	{
+		// see buildLSHIndex()
+		useDistanceL1_ = true;
+	}
+
+	if(featuresType_ == CV_8UC1)
+	{
+		rtflann::Matrix<unsigned char> dataset(features.data, features.rows, features.cols);
+		index_ = loadIndex<rtflann::Hamming<unsigned char> >(path, dataset, header.h.index_type);
+	}
+	else
+	{
+		rtflann::Matrix<float> dataset((float*)features.data, features.rows, features.cols);
+		if(useDistanceL1_)
+		{
+			index_ = loadIndex<rtflann::L1<float> >(path, dataset, header.h.index_type);
+		}
+		else if(featuresDim_ <=3)
+		{
+			index_ = loadIndex<rtflann::L2_Simple<float> >(path, dataset, header.h.index_type);
+		}
+		else
+		{
+			index_ = loadIndex<rtflann::L2<float> >(path, dataset, header.h.index_type);
+		}
+	}
+	if(!index_)
+	{
+		this->release();
+		return false;
+	}
+
+	// same bookkeeping than the build functions
+	if(rebalancingFactor_ > 1.0f)
+	{
+		for(int i=0; i<features.rows; ++i)
+		{
+			addedDescriptors_.insert(std::make_pair(nextIndex_++, features.row(i)));
+		}
+	}
+	else
+	{
+		addedDescriptors_.insert(std::make_pair(nextIndex_, features));
+		nextIndex_ += features.rows;
+	}
+	UDEBUG("");
+	return true;
+}
+
 std::vector<unsigned int> FlannIndex::addPoints(const cv::Mat & features)
 {
 	if(!index_)
@@ -35,6 +35,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pcl/common/common.h>
 #include <pcl/common/transforms.h>
 #include <pcl/correspondence.h>
+#include <Eigen/Sparse>
 
 namespace rtabmap {
 
@@ -117,6 +118,57 @@ bool testAABBAABB(const AABB &a, const AABB &b)
     return true;
 };
 
+// Overlap between the clouds of a link
+struct LinkOverlap
+{
+	LinkOverlap() : i(-1), j(-1), n(0), Isum1(0), Isum2(0), IRsum1(0), IRsum2(0), IGsum1(0), IGsum2(0), IBsum1(0), IBsum2(0) {}
+	int i, j; // from, to indices
+	int n;    // correspondences
+	double Isum1, Isum2;
+	double IRsum1, IRsum2;
+	double IGsum1, IGsum2;
+	double IBsum1, IBsum2;
+};
+
+// Solve the symmetric sparse system, falling back to a dense solve if it is not positive definite
+void solveGains(
+		int size,
+		const std::vector<Eigen::Triplet<double> > & triplets,
+		const Eigen::VectorXd & b,
+		cv::Mat_<double> & x)
+{
+	Eigen::SparseMatrix<double> A(size, size);
+	A.setFromTriplets(triplets.begin(), triplets.end());
+	Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > solver(A);
+	Eigen::VectorXd sol;
+	if(solver.info() == Eigen::Success)
+	{
+		sol = solver.solve(b);
+	}
+	if(solver.info() != Eigen::Success || !sol.allFinite())
+	{
+		UWARN("Sparse gain system could not be solved, using dense solver.");
+		Eigen::MatrixXd Adense(A);
+		cv::Mat_<double> Acv(size, size);
+		cv::Mat_<double> bcv(size, 1);
+		for(int i=0; i<size; ++i)
+		{
+			bcv(i, 0) = b[i];
+			for(int j=0; j<size; ++j)
+			{
+				Acv(i, j) = Adense(i, j);
+			}
+		}
+		cv::solve(Acv, bcv, x);
+		return;
+	}
+	x = cv::Mat_<double>(size, 1);
+	for(int i=0; i<size; ++i)
+	{
+		x(i, 0) = sol[i];
+	}
+}
+
 /**
  * @see https://github.com/opencv/opencv/blob/master/modules/stitching/src/exposure_compensate.cpp
  */
@@ -138,12 +190,7 @@ void feedImpl(
 	UASSERT(indices.size() == 0 || clouds.size() == indices.size());
 
 	const int num_images = static_cast<int>(clouds.size());
-	cv::Mat_<int> N(num_images, num_images); N.setTo(0);
-	cv::Mat_<double> I(num_images, num_images); I.setTo(0);
-
-	cv::Mat_<double> IR(num_images, num_images); IR.setTo(0);
-	cv::Mat_<double> IG(num_images, num_images); IG.setTo(0);
-	cv::Mat_<double> IB(num_images, num_images); IB.setTo(0);
+	std::vector<int> Nii(num_images, 0);
 
 	// make id to index map
 	idToIndex.clear();
@@ -159,12 +206,12 @@ void feedImpl(
 		Eigen::Vector4f maxPt(0,0,0,0);
 		if(indices.empty() || indices.at(iter->first)->empty())
 		{
-			N(oi,oi) = iter->second->size();
+			Nii[oi] = iter->second->size();
 			pcl::getMinMax3D(*iter->second, minPt, maxPt);
 		}
 		else
 		{
-			N(oi,oi) = indices.at(iter->first)->size();
+			Nii[oi] = indices.at(iter->first)->size();
 			pcl::getMinMax3D(*iter->second, *indices.at(iter->first), minPt, maxPt);
 		}
 		minPt[0] -= maxCorrespondenceDistance;
@@ -177,174 +224,238 @@ void feedImpl(
 		++oi;
 	}
 
-	typename pcl::search::KdTree<PointT> kdtree;
-	int lastKdTreeId = 0;
+	// Links are grouped by consecutive source cloud, so that the kd-tree of
+	// the source cloud is built once per group. Groups are processed in parallel.
+	std::vector<std::multimap<int, Link>::const_iterator> validLinks;
+	std::vector<std::pair<int, int> > groups; // first link index, end link index
 	for(std::multimap<int, Link>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
 	{
-		if(uContains(idToIndex, iter->second.from()) && uContains(idToIndex, iter->second.to()))
+		if(uContains(idToIndex, iter->second.from()) && uContains(idToIndex, iter->second.to()) &&
+		   clouds.at(iter->second.from())->size() && clouds.at(iter->second.to())->size())
 		{
+			if(groups.empty() || validLinks.back()->second.from() != iter->second.from())
+			{
+				groups.push_back(std::make_pair((int)validLinks.size(), (int)validLinks.size()));
+			}
+			validLinks.push_back(iter);
+			groups.back().second = (int)validLinks.size();
+		}
+	}
+
+	std::vector<LinkOverlap> overlaps(validLinks.size());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(int g=0; g<(int)groups.size(); ++g)
+	{
+		typename pcl::search::KdTree<PointT> kdtree;
+		bool kdtreeSet = false;
+		for(int l=groups[g].first; l<groups[g].second; ++l)
+		{
+			std::multimap<int, Link>::const_iterator iter = validLinks[l];
 			const typename pcl::PointCloud<PointT>::Ptr & cloudFrom = clouds.at(iter->second.from());
 			const typename pcl::PointCloud<PointT>::Ptr & cloudTo = clouds.at(iter->second.to());
-			if(cloudFrom->size() && cloudTo->size())
+
+			//Are bounding boxes intersect?
+			std::pair<pcl::PointXYZ, pcl::PointXYZ> bbMinMaxFrom = boundingBoxes.at(iter->second.from());
+			std::pair<pcl::PointXYZ, pcl::PointXYZ> bbMinMaxTo = boundingBoxes.at(iter->second.to());
+			Eigen::Affine3f t = Transform::getIdentity().toEigen3f();
+			if(!iter->second.transform().isIdentity() && !iter->second.transform().isNull())
 			{
-				//Are bounding boxes intersect?
-				std::pair<pcl::PointXYZ, pcl::PointXYZ> bbMinMaxFrom = boundingBoxes.at(iter->second.from());
-				std::pair<pcl::PointXYZ, pcl::PointXYZ> bbMinMaxTo = boundingBoxes.at(iter->second.to());
-				Eigen::Affine3f t = Transform::getIdentity().toEigen3f();
-				if(!iter->second.transform().isIdentity() && !iter->second.transform().isNull())
-				{
-					t = iter->second.transform().toEigen3f();
-					bbMinMaxTo.first = pcl::transformPoint(bbMinMaxTo.first, t);
-					bbMinMaxTo.second = pcl::transformPoint(bbMinMaxTo.second, t);
-				}
-				AABB bbFrom(Eigen::Vector3f((bbMinMaxFrom.second.x + bbMinMaxFrom.first.x)/2.0f, (bbMinMaxFrom.second.y + bbMinMaxFrom.first.y)/2.0f, (bbMinMaxFrom.second.z + bbMinMaxFrom.first.z)/2.0f),
-						 Eigen::Vector3f((bbMinMaxFrom.second.x - bbMinMaxFrom.first.x)/2.0f, (bbMinMaxFrom.second.y - bbMinMaxFrom.first.y)/2.0f, (bbMinMaxFrom.second.z - bbMinMaxFrom.first.z)/2.0f));
-				AABB bbTo(Eigen::Vector3f((bbMinMaxTo.second.x + bbMinMaxTo.first.x)/2.0f, (bbMinMaxTo.second.y + bbMinMaxTo.first.y)/2.0f, (bbMinMaxTo.second.z + bbMinMaxTo.first.z)/2.0f),
-						 Eigen::Vector3f((bbMinMaxTo.second.x - bbMinMaxTo.first.x)/2.0f, (bbMinMaxTo.second.y - bbMinMaxTo.first.y)/2.0f, (bbMinMaxTo.second.z - bbMinMaxTo.first.z)/2.0f));
-				//UDEBUG("%d = %f,%f,%f %f,%f,%f", iter->second.from(), bbMinMaxFrom.first[0], bbMinMaxFrom.first[1], bbMinMaxFrom.first[2], bbMinMaxFrom.second[0], bbMinMaxFrom.second[1], bbMinMaxFrom.second[2]);
-				//UDEBUG("%d = %f,%f,%f %f,%f,%f", iter->second.to(), bbMinMaxTo.first[0], bbMinMaxTo.first[1], bbMinMaxTo.first[2], bbMinMaxTo.second[0], bbMinMaxTo.second[1], bbMinMaxTo.second[2]);
-				if(testAABBAABB(bbFrom, bbTo))
+				t = iter->second.transform().toEigen3f();
+				bbMinMaxTo.first = pcl::transformPoint(bbMinMaxTo.first, t);
+				bbMinMaxTo.second = pcl::transformPoint(bbMinMaxTo.second, t);
+			}
+			AABB bbFrom(Eigen::Vector3f((bbMinMaxFrom.second.x + bbMinMaxFrom.first.x)/2.0f, (bbMinMaxFrom.second.y + bbMinMaxFrom.first.y)/2.0f, (bbMinMaxFrom.second.z + bbMinMaxFrom.first.z)/2.0f),
+					 Eigen::Vector3f((bbMinMaxFrom.second.x - bbMinMaxFrom.first.x)/2.0f, (bbMinMaxFrom.second.y - bbMinMaxFrom.first.y)/2.0f, (bbMinMaxFrom.second.z - bbMinMaxFrom.first.z)/2.0f));
+			AABB bbTo(Eigen::Vector3f((bbMinMaxTo.second.x + bbMinMaxTo.first.x)/2.0f, (bbMinMaxTo.second.y + bbMinMaxTo.first.y)/2.0f, (bbMinMaxTo.second.z + bbMinMaxTo.first.z)/2.0f),
+					 Eigen::Vector3f((bbMinMaxTo.second.x - bbMinMaxTo.first.x)/2.0f, (bbMinMaxTo.second.y - bbMinMaxTo.first.y)/2.0f, (bbMinMaxTo.second.z - bbMinMaxTo.first.z)/2.0f));
+			//UDEBUG("%d = %f,%f,%f %f,%f,%f", iter->second.from(), bbMinMaxFrom.first[0], bbMinMaxFrom.first[1], bbMinMaxFrom.first[2], bbMinMaxFrom.second[0], bbMinMaxFrom.second[1], bbMinMaxFrom.second[2]);
+			//UDEBUG("%d = %f,%f,%f %f,%f,%f", iter->second.to(), bbMinMaxTo.first[0], bbMinMaxTo.first[1], bbMinMaxTo.first[2], bbMinMaxTo.second[0], bbMinMaxTo.second[1], bbMinMaxTo.second[2]);
+			if(testAABBAABB(bbFrom, bbTo))
+			{
+				if(!kdtreeSet)
 				{
-					if(lastKdTreeId <= 0 || lastKdTreeId!=iter->second.from())
+					if(indices.size() && indices.at(iter->second.from())->size())
 					{
-						//reconstruct kdtree
-						if(indices.size() && indices.at(iter->second.from())->size())
-						{
-							kdtree.setInputCloud(cloudFrom, indices.at(iter->second.from()));
-						}
-						else
-						{
-							kdtree.setInputCloud(cloudFrom);
-						}
+						kdtree.setInputCloud(cloudFrom, indices.at(iter->second.from()));
+					}
+					else
+					{
+						kdtree.setInputCloud(cloudFrom);
 					}
+					kdtreeSet = true;
+				}
 
-					pcl::Correspondences correspondences;
-					pcl::IndicesPtr indicesTo(new std::vector<int>);
-					std::set<int> addedFrom;
-					if(indices.size() && indices.at(iter->second.to())->size())
+				pcl::Correspondences correspondences;
+				std::set<int> addedFrom;
+				if(indices.size() && indices.at(iter->second.to())->size())
+				{
+					const pcl::IndicesPtr & indicesTo = indices.at(iter->second.to());
+					correspondences.resize(indicesTo->size());
+					int oi=0;
+					for(unsigned int i=0; i<indicesTo->size(); ++i)
 					{
-						const pcl::IndicesPtr & indicesTo = indices.at(iter->second.to());
-						correspondences.resize(indicesTo->size());
-						int oi=0;
-						for(unsigned int i=0; i<indicesTo->size(); ++i)
+						std::vector<int> k_indices;
+						std::vector<float> k_sqr_distances;
+						if(kdtree.radiusSearch(pcl::transformPoint(cloudTo->at(indicesTo->at(i)), t), maxCorrespondenceDistance, k_indices, k_sqr_distances, 1))
 						{
-							std::vector<int> k_indices;
-							std::vector<float> k_sqr_distances;
-							if(kdtree.radiusSearch(pcl::transformPoint(cloudTo->at(indicesTo->at(i)), t), maxCorrespondenceDistance, k_indices, k_sqr_distances, 1))
+							if(addedFrom.find(k_indices[0]) == addedFrom.end())
 							{
-								if(addedFrom.find(k_indices[0]) == addedFrom.end())
-								{
-									correspondences[oi].index_match = k_indices[0];
-									correspondences[oi].index_query = indicesTo->at(i);
-									correspondences[oi].distance = k_sqr_distances[0];
-									addedFrom.insert(k_indices[0]);
-									++oi;
-								}
+								correspondences[oi].index_match = k_indices[0];
+								correspondences[oi].index_query = indicesTo->at(i);
+								correspondences[oi].distance = k_sqr_distances[0];
+								addedFrom.insert(k_indices[0]);
+								++oi;
 							}
 						}
-						correspondences.resize(oi);
 					}
-					else
+					correspondences.resize(oi);
+				}
+				else
+				{
+					correspondences.resize(cloudTo->size());
+					int oi=0;
+					for(unsigned int i=0; i<cloudTo->size(); ++i)
 					{
-						correspondences.resize(cloudTo->size());
-						int oi=0;
-						for(unsigned int i=0; i<cloudTo->size(); ++i)
+						std::vector<int> k_indices;
+						std::vector<float> k_sqr_distances;
+						if(kdtree.radiusSearch(pcl::transformPoint(cloudTo->at(i), t), maxCorrespondenceDistance, k_indices, k_sqr_distances, 1))
 						{
-							std::vector<int> k_indices;
-							std::vector<float> k_sqr_distances;
-							if(kdtree.radiusSearch(pcl::transformPoint(cloudTo->at(i), t), maxCorrespondenceDistance, k_indices, k_sqr_distances, 1))
+							if(addedFrom.find(k_indices[0]) == addedFrom.end())
 							{
-								if(addedFrom.find(k_indices[0]) == addedFrom.end())
-								{
-									correspondences[oi].index_match = k_indices[0];
-									correspondences[oi].index_query = i;
-									correspondences[oi].distance = k_sqr_distances[0];
-									addedFrom.insert(k_indices[0]);
-									++oi;
-								}
+								correspondences[oi].index_match = k_indices[0];
+								correspondences[oi].index_query = i;
+								correspondences[oi].distance = k_sqr_distances[0];
+								addedFrom.insert(k_indices[0]);
+								++oi;
 							}
 						}
-						correspondences.resize(oi);
 					}
+					correspondences.resize(oi);
+				}
 
-					UDEBUG("%d->%d: correspondences = %d", iter->second.from(), iter->second.to(), (int)correspondences.size());
-					if(correspondences.size() && (minOverlap <= 0.0 ||
-							(double(correspondences.size()) / double(clouds.at(iter->second.from())->size()) >= minOverlap &&
-							 double(correspondences.size()) / double(clouds.at(iter->second.to())->size()) >= minOverlap)))
+				UDEBUG("%d->%d: correspondences = %d", iter->second.from(), iter->second.to(), (int)correspondences.size());
+				if(correspondences.size() && (minOverlap <= 0.0 ||
+						(double(correspondences.size()) / double(clouds.at(iter->second.from())->size()) >= minOverlap &&
+						 double(correspondences.size()) / double(clouds.at(iter->second.to())->size()) >= minOverlap)))
+				{
+					LinkOverlap & overlap = overlaps[l];
+					overlap.i = idToIndex.at(iter->second.from());
+					overlap.j = idToIndex.at(iter->second.to());
+					overlap.n = correspondences.size();
+					for (unsigned int c = 0; c < correspondences.size(); ++c)
 					{
-						int i = idToIndex.at(iter->second.from());
-						int j = idToIndex.at(iter->second.to());
-
-						double Isum1 = 0, Isum2 = 0;
-						double IRsum1 = 0, IRsum2 = 0;
-						double IGsum1 = 0, IGsum2 = 0;
-						double IBsum1 = 0, IBsum2 = 0;
-						for (unsigned int c = 0; c < correspondences.size(); ++c)
-						{
-							const PointT & pt1 = cloudFrom->at(correspondences.at(c).index_match);
-							const PointT & pt2 = cloudTo->at(correspondences.at(c).index_query);
-
-							Isum1 += std::sqrt(static_cast<double>(sqr(pt1.r) + sqr(pt1.g) + sqr(pt1.b)));
-							Isum2 += std::sqrt(static_cast<double>(sqr(pt2.r) + sqr(pt2.g) + sqr(pt2.b)));
-
-							IRsum1 += static_cast<double>(pt1.r);
-							IRsum2 += static_cast<double>(pt2.r);
-							IGsum1 += static_cast<double>(pt1.g);
-							IGsum2 += static_cast<double>(pt2.g);
-							IBsum1 += static_cast<double>(pt1.b);
-							IBsum2 += static_cast<double>(pt2.b);
-						}
-						N(i, j) = N(j, i) = correspondences.size();
-						I(i, j) = Isum1 / N(i, j);
-						I(j, i) = Isum2 / N(i, j);
-
-						IR(i, j) = IRsum1 / N(i, j);
-						IR(j, i) = IRsum2 / N(i, j);
-						IG(i, j) = IGsum1 / N(i, j);
-						IG(j, i) = IGsum2 / N(i, j);
-						IB(i, j) = IBsum1 / N(i, j);
-						IB(j, i) = IBsum2 / N(i, j);
+						const PointT & pt1 = cloudFrom->at(correspondences.at(c).index_match);
+						const PointT & pt2 = cloudTo->at(correspondences.at(c).index_query);
+
+						overlap.Isum1 += std::sqrt(static_cast<double>(sqr(pt1.r) + sqr(pt1.g) + sqr(pt1.b)));
+						overlap.Isum2 += std::sqrt(static_cast<double>(sqr(pt2.r) + sqr(pt2.g) + sqr(pt2.b)));
+
+						overlap.IRsum1 += static_cast<double>(pt1.r);
+						overlap.IRsum2 += static_cast<double>(pt2.r);
+						overlap.IGsum1 += static_cast<double>(pt1.g);
+						overlap.IGsum2 += static_cast<double>(pt2.g);
+						overlap.IBsum1 += static_cast<double>(pt1.b);
+						overlap.IBsum2 += static_cast<double>(pt2.b);
 					}
 				}
 			}
 		}
 	}
 
-	cv::Mat_<double> A(num_images, num_images); A.setTo(0);
-	cv::Mat_<double> b(num_images, 1); b.setTo(0);
-	cv::Mat_<double> AR(num_images, num_images); AR.setTo(0);
-	cv::Mat_<double> AG(num_images, num_images); AG.setTo(0);
-	cv::Mat_<double> AB(num_images, num_images); AB.setTo(0);
-	for (int i = 0; i < num_images; ++i)
+	// Keep the last overlap of each pair of clouds (in links order), oriented with i<j
+	std::map<std::pair<int, int>, LinkOverlap> pairs;
+	for(size_t l=0; l<overlaps.size(); ++l)
 	{
-		for (int j = 0; j < num_images; ++j)
+		LinkOverlap overlap = overlaps[l];
+		if(overlap.n == 0)
+		{
+			continue;
+		}
+		if(overlap.i == overlap.j)
+		{
+			Nii[overlap.i] = overlap.n;
+			continue;
+		}
+		if(overlap.i > overlap.j)
 		{
-			b(i, 0) += beta * N(i, j);
-			A(i, i) += beta * N(i, j);
-			AR(i, i) += beta * N(i, j);
-			AG(i, i) += beta * N(i, j);
-			AB(i, i) += beta * N(i, j);
-			if (j == i) continue;
-			A(i, i) += 2 * alpha * I(i, j) * I(i, j) * N(i, j);
-			A(i, j) -= 2 * alpha * I(i, j) * I(j, i) * N(i, j);
-
-			AR(i, i) += 2 * alpha * IR(i, j) * IR(i, j) * N(i, j);
-			AR(i, j) -= 2 * alpha * IR(i, j) * IR(j, i) * N(i, j);
-
-			AG(i, i) += 2 * alpha * IG(i, j) * IG(i, j) * N(i, j);
-			AG(i, j) -= 2 * alpha * IG(i, j) * IG(j, i) * N(i, j);
-
-			AB(i, i) += 2 * alpha * IB(i, j) * IB(i, j) * N(i, j);
-			AB(i, j) -= 2 * alpha * IB(i, j) * IB(j, i) * N(i, j);
+			std::swap(overlap.i, overlap.j);
+			std::swap(overlap.Isum1, overlap.Isum2);
+			std::swap(overlap.IRsum1, overlap.IRsum2);
+			std::swap(overlap.IGsum1, overlap.IGsum2);
+			std::swap(overlap.IBsum1, overlap.IBsum2);
 		}
+		pairs[std::make_pair(overlap.i, overlap.j)] = overlap;
 	}
 
-	cv::Mat_<double> gainsGray, gainsR, gainsG, gainsB;
-	cv::solve(A, b, gainsGray);
+	// Sparse normal equations: only overlapping clouds have off-diagonal terms
+	std::vector<double> diagA(num_images, 0.0);
+	std::vector<double> diagAR(num_images, 0.0);
+	std::vector<double> diagAG(num_images, 0.0);
+	std::vector<double> diagAB(num_images, 0.0);
+	Eigen::VectorXd b = Eigen::VectorXd::Zero(num_images);
+	std::vector<Eigen::Triplet<double> > tA, tAR, tAG, tAB;
+	for (int i = 0; i < num_images; ++i)
+	{
+		b[i] += beta * Nii[i];
+		diagA[i] += beta * Nii[i];
+		diagAR[i] += beta * Nii[i];
+		diagAG[i] += beta * Nii[i];
+		diagAB[i] += beta * Nii[i];
+	}
+	for(std::map<std::pair<int, int>, LinkOverlap>::iterator iter=pairs.begin(); iter!=pairs.end(); ++iter)
+	{
+		const LinkOverlap & o = iter->second;
+		int i = o.i;
+		int j = o.j;
+		double n = o.n;
+		double Iij = o.Isum1 / o.n;
+		double Iji = o.Isum2 / o.n;
+		double IRij = o.IRsum1 / o.n;
+		double IRji = o.IRsum2 / o.n;
+		double IGij = o.IGsum1 / o.n;
+		double IGji = o.IGsum2 / o.n;
+		double IBij = o.IBsum1 / o.n;
+		double IBji = o.IBsum2 / o.n;
+
+		b[i] += beta * n;
+		b[j] += beta * n;
+
+		diagA[i] += beta * n + 2 * alpha * Iij * Iij * n;
+		diagA[j] += beta * n + 2 * alpha * Iji * Iji * n;
+		tA.push_back(Eigen::Triplet<double>(i, j, -2 * alpha * Iij * Iji * n));
+		tA.push_back(Eigen::Triplet<double>(j, i, -2 * alpha * Iji * Iij * n));
+
+		diagAR[i] += beta * n + 2 * alpha * IRij * IRij * n;
+		diagAR[j] += beta * n + 2 * alpha * IRji * IRji * n;
+		tAR.push_back(Eigen::Triplet<double>(i, j, -2 * alpha * IRij * IRji * n));
+		tAR.push_back(Eigen::Triplet<double>(j, i, -2 * alpha * IRji * IRij * n));
+
+		diagAG[i] += beta * n + 2 * alpha * IGij * IGij * n;
+		diagAG[j] += beta * n + 2 * alpha * IGji * IGji * n;
+		tAG.push_back(Eigen::Triplet<double>(i, j, -2 * alpha * IGij * IGji * n));
+		tAG.push_back(Eigen::Triplet<double>(j, i, -2 * alpha * IGji * IGij * n));
+
+		diagAB[i] += beta * n + 2 * alpha * IBij * IBij * n;
+		diagAB[j] += beta * n + 2 * alpha * IBji * IBji * n;
+		tAB.push_back(Eigen::Triplet<double>(i, j, -2 * alpha * IBij * IBji * n));
+		tAB.push_back(Eigen::Triplet<double>(j, i, -2 * alpha * IBji * IBij * n));
+	}
+	for (int i = 0; i < num_images; ++i)
+	{
+		tA.push_back(Eigen::Triplet<double>(i, i, diagA[i]));
+		tAR.push_back(Eigen::Triplet<double>(i, i, diagAR[i]));
+		tAG.push_back(Eigen::Triplet<double>(i, i, diagAG[i]));
+		tAB.push_back(Eigen::Triplet<double>(i, i, diagAB[i]));
+	}
+	UDEBUG("Gain system: %d clouds, %d overlapping pairs", num_images, (int)pairs.size());
 
-	cv::solve(AR, b, gainsR);
-	cv::solve(AG, b, gainsG);
-	cv::solve(AB, b, gainsB);
+	cv::Mat_<double> gainsGray, gainsR, gainsG, gainsB;
+	solveGains(num_images, tA, b, gainsGray);
+	solveGains(num_images, tAR, b, gainsR);
+	solveGains(num_images, tAG, b, gainsG);
+	solveGains(num_images, tAB, b, gainsB);
 
 	gains = cv::Mat_<double>(gainsGray.rows, 4);
 	gainsGray.copyTo(gains.col(0));
@@ -0,0 +1,280 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/GlobalDescriptorIndex.h"
+#include "rtabmap/core/DescriptorDistance.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <algorithm>
+#include <math.h>
+
+#define QUERY_BATCH 16 // queries scored together, so that each row is read once per batch
+#define BLOCK_BYTES 65536 // rows scored per thread chunk, to stay in cache while the batch is scored
+#define MIN_CAPACITY 64
+
+namespace rtabmap {
+
+namespace {
+struct ScoreGreater
+{
+	ScoreGreater(const float * scores) : scores_(scores) {}
+	bool operator()(int a, int b) const {return scores_[a] > scores_[b];}
+	const float * scores_;
+};
+}
+
+GlobalDescriptorIndex::GlobalDescriptorIndex(Metric metric, bool normalized) :
+	metric_(metric),
+	normalized_(normalized)
+{
+}
+
+GlobalDescriptorIndex::~GlobalDescriptorIndex()
+{
+}
+
+void GlobalDescriptorIndex::clear()
+{
+	data_ = cv::Mat();
+	ids_.clear();
+	rows_.clear();
+}
+
+bool GlobalDescriptorIndex::add(int id, const cv::Mat & descriptor)
+{
+	if(descriptor.empty() || descriptor.channels() != 1)
+	{
+		UERROR("Global descriptor of node %d should be a single channel matrix.", id);
+		return false;
+	}
+	if(rows_.find(id) != rows_.end())
+	{
+		UWARN("Node %d is already indexed.", id);
+		return false;
+	}
+	cv::Mat row = prepare(descriptor.isContinuous()?descriptor.reshape(1, 1):descriptor.clone().reshape(1, 1));
+	if(!data_.empty() && row.cols != data_.cols)
+	{
+		UERROR("Global descriptor of node %d has size %d while indexed descriptors have size %d.", id, row.cols, data_.cols);
+		return false;
+	}
+
+	int size = (int)ids_.size();
+	if(data_.empty())
+	{
+		data_ = cv::Mat(MIN_CAPACITY, row.cols, CV_32FC1);
+	}
+	else if(size == data_.rows)
+	{
+		cv::Mat grown(data_.rows*2, data_.cols, CV_32FC1);
+		data_.copyTo(grown.rowRange(0, data_.rows));
+		data_ = grown;
+	}
+	row.copyTo(data_.row(size));
+	ids_.push_back(id);
+	rows_.insert(std::make_pair(id, size));
+	return true;
+}
+
+bool GlobalDescriptorIndex::remove(int id)
+{
+	std::map<int, int>::iterator iter = rows_.find(id);
+	if(iter == rows_.end())
+	{
+		return false;
+	}
+	int row = iter->second;
+	int last = (int)ids_.size()-1;
+	if(row != last)
+	{
+		// move the last row in the hole
+		data_.row(last).copyTo(data_.row(row));
+		ids_[row] = ids_[last];
+		rows_.at(ids_[row]) = row;
+	}
+	ids_.pop_back();
+	rows_.erase(iter);
+
+	if(ids_.empty())
+	{
+		data_ = cv::Mat();
+	}
+	else if(data_.rows > MIN_CAPACITY && (int)ids_.size() < data_.rows/4)
+	{
+		cv::Mat shrunk(data_.rows/2, data_.cols, CV_32FC1);
+		data_.rowRange(0, (int)ids_.size()).copyTo(shrunk.rowRange(0, (int)ids_.size()));
+		data_ = shrunk;
+	}
+	return true;
+}
+
+unsigned long GlobalDescriptorIndex::memoryUsed() const
+{
+	unsigned long memoryUsage = sizeof(GlobalDescriptorIndex);
+	memoryUsage += data_.total()*data_.elemSize();
+	memoryUsage += ids_.capacity()*sizeof(int);
+	memoryUsage += rows_.size() * (sizeof(int)*2+sizeof(std::map<int, int>::iterator)) + sizeof(std::map<int, int>);
+	return memoryUsage;
+}
+
+void GlobalDescriptorIndex::knnSearch(
+		const cv::Mat & queries,
+		cv::Mat & ids,
+		cv::Mat & scores,
+		int k) const
+{
+	UASSERT(k > 0);
+	ids = cv::Mat(queries.rows, k, CV_32SC1, cv::Scalar::all(-1));
+	scores = cv::Mat(queries.rows, k, CV_32FC1, cv::Scalar::all(0));
+	if(ids_.empty() || queries.empty())
+	{
+		return;
+	}
+	if(queries.cols != data_.cols || queries.channels() != 1)
+	{
+		UERROR("Query descriptors have size %d while indexed descriptors have size %d.", queries.cols, data_.cols);
+		return;
+	}
+
+	cv::Mat q = prepare(queries);
+	int n = (int)ids_.size();
+	int kk = k<n?k:n;
+	int rowsPerBlock = BLOCK_BYTES/(data_.cols*(int)sizeof(float));
+	if(rowsPerBlock < 1)
+	{
+		rowsPerBlock = 1;
+	}
+	int blocks = (n+rowsPerBlock-1)/rowsPerBlock;
+	std::vector<float> batchScores((size_t)(q.rows<QUERY_BATCH?q.rows:QUERY_BATCH)*n);
+	std::vector<int> order(n);
+	for(int b=0; b<q.rows; b+=QUERY_BATCH)
+	{
+		int batch = b+QUERY_BATCH<=q.rows?QUERY_BATCH:q.rows-b;
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for(int block=0; block<blocks; ++block)
+		{
+			int start = block*rowsPerBlock;
+			int end = start+rowsPerBlock<n?start+rowsPerBlock:n;
+			for(int j=0; j<batch; ++j)
+			{
+				const float * query = q.ptr<float>(b+j);
+				float * out = &batchScores[(size_t)j*n];
+				for(int i=start; i<end; ++i)
+				{
+					out[i] = score(query, data_.ptr<float>(i));
+				}
+			}
+		}
+
+		for(int j=0; j<batch; ++j)
+		{
+			const float * s = &batchScores[(size_t)j*n];
+			for(int i=0; i<n; ++i)
+			{
+				order[i] = i;
+			}
+			std::partial_sort(order.begin(), order.begin()+kk, order.end(), ScoreGreater(s));
+			int * idsPtr = ids.ptr<int>(b+j);
+			float * scoresPtr = scores.ptr<float>(b+j);
+			for(int l=0; l<kk; ++l)
+			{
+				idsPtr[l] = ids_[order[l]];
+				scoresPtr[l] = s[order[l]];
+			}
+		}
+	}
+}
+
+std::map<int, float> GlobalDescriptorIndex::scores(const cv::Mat & query, const std::list<int> & ids) const
+{
+	std::map<int, float> results;
+	if(ids_.empty() || query.empty())
+	{
+		return results;
+	}
+	if(query.total() != (size_t)data_.cols || query.channels() != 1)
+	{
+		UERROR("Query descriptor has size %d while indexed descriptors have size %d.", (int)query.total(), data_.cols);
+		return results;
+	}
+	cv::Mat q = prepare(query.isContinuous()?query.reshape(1, 1):query.clone().reshape(1, 1));
+	const float * queryPtr = q.ptr<float>(0);
+	for(std::list<int>::const_iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+	{
+		std::map<int, int>::const_iterator jter = rows_.find(*iter);
+		if(jter != rows_.end())
+		{
+			results.insert(results.end(), std::make_pair(*iter, score(queryPtr, data_.ptr<float>(jter->second))));
+		}
+	}
+	return results;
+}
+
+cv::Mat GlobalDescriptorIndex::prepare(const cv::Mat & descriptor) const
+{
+	cv::Mat out;
+	if(descriptor.type() != CV_32FC1)
+	{
+		descriptor.convertTo(out, CV_32F);
+	}
+	else if(normalized_)
+	{
+		out = descriptor.clone();
+	}
+	else
+	{
+		out = descriptor;
+	}
+	if(normalized_)
+	{
+		for(int i=0; i<out.rows; ++i)
+		{
+			float * ptr = out.ptr<float>(i);
+			float norm = sqrtf(descriptorDotProduct(ptr, ptr, out.cols));
+			if(norm > 0.0f)
+			{
+				for(int j=0; j<out.cols; ++j)
+				{
+					ptr[j] /= norm;
+				}
+			}
+		}
+	}
+	return out;
+}
+
+float GlobalDescriptorIndex::score(const float * a, const float * b) const
+{
+	if(metric_ == kL2)
+	{
+		return -descriptorDistanceL2Sqr(a, b, data_.cols);
+	}
+	return descriptorDotProduct(a, b, data_.cols);
+}
+
+} /* namespace rtabmap */
@@ -0,0 +1,911 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/LocalizationSnapshot.h"
+#include "rtabmap/core/DBDriver.h"
+#include "rtabmap/core/Signature.h"
+#include "rtabmap/core/VisualWord.h"
+#include "rtabmap/core/VWDictionary.h"
+#include "rtabmap/core/Compression.h"
+#include "rtabmap/core/Parameters.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UFile.h>
+#include <fstream>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace rtabmap {
+
+const int LocalizationSnapshot::kVersion = 3;
+
+namespace {
+
+const char kMagic[8] = {'R','T','A','B','S','N','A','P'};
+const int kEndianCheck = 0x01020304;
+
+enum CalibrationType {
+	kCalibrationNone = 0,
+	kCalibrationMono = 1,
+	kCalibrationStereo = 2
+};
+
+class SnapshotWriter
+{
+public:
+	SnapshotWriter(const std::string & path) : out_(path.c_str(), std::ios::out | std::ios::binary) {}
+	bool isOpen() const {return out_.is_open();}
+	bool good() const {return out_.good();}
+
+	void writeBytes(const void * data, size_t size)
+	{
+		if(size)
+		{
+			out_.write((const char *)data, size);
+		}
+	}
+	template<typename T>
+	void write(const T & value)
+	{
+		writeBytes(&value, sizeof(T));
+	}
+	template<typename T>
+	void writeVector(const std::vector<T> & values)
+	{
+		write<int>((int)values.size());
+		writeBytes(values.data(), values.size()*sizeof(T));
+	}
+	void writeString(const std::string & value)
+	{
+		write<int>((int)value.size());
+		writeBytes(value.data(), value.size());
+	}
+	void writeMat(const cv::Mat & mat)
+	{
+		UASSERT(mat.empty() || mat.isContinuous());
+		write<int>(mat.rows);
+		write<int>(mat.cols);
+		write<int>(mat.type());
+		writeBytes(mat.data, mat.total()*mat.elemSize());
+	}
+	void writeTransform(const Transform & t)
+	{
+		write<int>(t.isNull()?0:1);
+		if(!t.isNull())
+		{
+			writeBytes(t.data(), t.size()*sizeof(float));
+		}
+	}
+	void writeLink(const Link & link)
+	{
+		write<int>(link.from());
+		write<int>(link.to());
+		write<int>((int)link.type());
+		writeTransform(link.transform());
+		UASSERT(link.infMatrix().type() == CV_64FC1 && link.infMatrix().total() == 36);
+		writeBytes(link.infMatrix().data, 36*sizeof(double));
+		if(link.userDataCompressed().empty() && !link.userDataRaw().empty())
+		{
+			writeMat(compressData2(link.userDataRaw()));
+		}
+		else
+		{
+			writeMat(link.userDataCompressed());
+		}
+	}
+
+private:
+	std::ofstream out_;
+};
+
+// The file is memory-mapped (or read at once if it cannot be mapped), values
+// are copied from the mapped memory. Sizes read from the file are checked
+// against the remaining bytes before anything is allocated, so a truncated or
+// corrupted snapshot is rejected instead of triggering huge allocations.
+class SnapshotReader
+{
+public:
+	SnapshotReader(const std::string & path) :
+		data_(0),
+		size_(0),
+		pos_(0),
+		ok_(false),
+		open_(false),
+		mapped_(false)
+#ifdef _WIN32
+		,file_(INVALID_HANDLE_VALUE),
+		mapping_(NULL)
+#endif
+	{
+#ifdef _WIN32
+		file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if(file_ != INVALID_HANDLE_VALUE)
+		{
+			open_ = true;
+			LARGE_INTEGER size;
+			if(GetFileSizeEx(file_, &size) && size.QuadPart > 0)
+			{
+				size_ = (size_t)size.QuadPart;
+				mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+				if(mapping_ != NULL)
+				{
+					data_ = (const char *)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+					mapped_ = data_ != 0;
+				}
+			}
+		}
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if(fd >= 0)
+		{
+			open_ = true;
+			struct stat info;
+			if(fstat(fd, &info) == 0 && info.st_size > 0)
+			{
+				size_ = (size_t)info.st_size;
+				void * data = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+				if(data != MAP_FAILED)
+				{
+					data_ = (const char *)data;
+					mapped_ = true;
+				}
+			}
+			close(fd);
+		}
+#endif
+		if(open_ && size_ && !mapped_)
+		{
+			UWARN("Cannot map \"%s\" in memory, reading it at once.", path.c_str());
+			std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+			buffer_.resize(size_);
+			if(in.read(buffer_.data(), size_))
+			{
+				data_ = buffer_.data();
+			}
+		}
+		ok_ = data_ != 0;
+	}
+	~SnapshotReader()
+	{
+		if(mapped_)
+		{
+#ifdef _WIN32
+			UnmapViewOfFile(data_);
+#else
+			munmap((void *)data_, size_);
+#endif
+		}
+#ifdef _WIN32
+		if(mapping_ != NULL)
+		{
+			CloseHandle(mapping_);
+		}
+		if(file_ != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(file_);
+		}
+#endif
+	}
+	bool isOpen() const {return open_;}
+	bool ok() const {return ok_;}
+	void invalidate() {ok_ = false;}
+	bool atEnd() const {return pos_ == size_;}
+	size_t size() const {return size_;}
+
+	// Check that "count" elements of "elemSize" bytes can still be read.
+	bool fits(size_t count, size_t elemSize)
+	{
+		if(!ok_ || (elemSize && count > (size_ - pos_)/elemSize))
+		{
+			ok_ = false;
+		}
+		return ok_;
+	}
+	bool readBytes(void * data, size_t size)
+	{
+		if(!fits(size, 1))
+		{
+			return false;
+		}
+		if(size)
+		{
+			memcpy(data, data_ + pos_, size);
+		}
+		pos_ += size;
+		return true;
+	}
+	template<typename T>
+	T read()
+	{
+		T value = T();
+		readBytes(&value, sizeof(T));
+		return value;
+	}
+	template<typename T>
+	std::vector<T> readVector()
+	{
+		std::vector<T> values;
+		int size = read<int>();
+		if(size < 0)
+		{
+			ok_ = false;
+		}
+		if(size > 0 && fits(size, sizeof(T)))
+		{
+			values.resize(size);
+			if(!readBytes(values.data(), size*sizeof(T)))
+			{
+				values.clear();
+			}
+		}
+		return values;
+	}
+	std::string readString()
+	{
+		std::vector<char> data = readVector<char>();
+		return std::string(data.begin(), data.end());
+	}
+	cv::Mat readMat()
+	{
+		int rows = read<int>();
+		int cols = read<int>();
+		int type = read<int>();
+		if(!ok_ || rows < 0 || cols < 0 || !isValidType(type))
+		{
+			ok_ = false;
+			return cv::Mat();
+		}
+		if(rows == 0 || cols == 0)
+		{
+			return cv::Mat();
+		}
+		if(!fits(rows, (size_t)cols*CV_ELEM_SIZE(type)))
+		{
+			return cv::Mat();
+		}
+		cv::Mat mat(rows, cols, type);
+		if(readBytes(mat.data, mat.total()*mat.elemSize()))
+		{
+			return mat;
+		}
+		return cv::Mat();
+	}
+	Transform readTransform()
+	{
+		Transform t;
+		if(read<int>() != 0)
+		{
+			Transform data = Transform::getIdentity();
+			if(readBytes(data.data(), 12*sizeof(float)))
+			{
+				t = data;
+			}
+		}
+		return t;
+	}
+	Link readLink()
+	{
+		int from = read<int>();
+		int to = read<int>();
+		int type = read<int>();
+		Transform transform = readTransform();
+		cv::Mat infMatrix(6, 6, CV_64FC1);
+		readBytes(infMatrix.data, 36*sizeof(double));
+		cv::Mat userData = readMat();
+		if(!ok_ || type < 0 || type >= Link::kEnd)
+		{
+			ok_ = false;
+			return Link();
+		}
+		return Link(from, to, (Link::Type)type, transform, infMatrix, userData);
+	}
+
+	static bool isValidType(int type)
+	{
+		return type >= 0 && type == CV_MAT_TYPE(type) && CV_MAT_DEPTH(type) <= CV_64F;
+	}
+
+private:
+	const char * data_;
+	std::vector<char> buffer_;
+	size_t size_;
+	size_t pos_;
+	bool ok_;
+	bool open_;
+	bool mapped_;
+#ifdef _WIN32
+	HANDLE file_;
+	HANDLE mapping_;
+#endif
+};
+
+/**
+ * Cheap fingerprint of the database. Links are refined in place (e.g. after a
+ * graph edition or a reprocessing), which doesn't change the last IDs or the
+ * counts, so the size and the modification time of the file are also kept.
+ */
+struct DatabaseFingerprint
+{
+	DatabaseFingerprint() :
+		lastNodeId(0),
+		lastMapId(0),
+		lastWordId(0),
+		nodesCount(0),
+		wordsCount(0),
+		fileSize(0),
+		fileTime(0)
+	{}
+	int lastNodeId;
+	int lastMapId;
+	int lastWordId;
+	int nodesCount;
+	int wordsCount;
+	long long fileSize;
+	long long fileTime;
+
+	bool operator==(const DatabaseFingerprint & other) const
+	{
+		return lastNodeId == other.lastNodeId &&
+			   lastMapId == other.lastMapId &&
+			   lastWordId == other.lastWordId &&
+			   nodesCount == other.nodesCount &&
+			   wordsCount == other.wordsCount &&
+			   fileSize == other.fileSize &&
+			   fileTime == other.fileTime;
+	}
+	bool operator!=(const DatabaseFingerprint & other) const
+	{
+		return !(*this == other);
+	}
+
+	void write(SnapshotWriter & out) const
+	{
+		out.write<int>(lastNodeId);
+		out.write<int>(lastMapId);
+		out.write<int>(lastWordId);
+		out.write<int>(nodesCount);
+		out.write<int>(wordsCount);
+		out.write<long long>(fileSize);
+		out.write<long long>(fileTime);
+	}
+	void read(SnapshotReader & in)
+	{
+		lastNodeId = in.read<int>();
+		lastMapId = in.read<int>();
+		lastWordId = in.read<int>();
+		nodesCount = in.read<int>();
+		wordsCount = in.read<int>();
+		fileSize = in.read<long long>();
+		fileTime = in.read<long long>();
+	}
+};
+
+DatabaseFingerprint getDatabaseFingerprint(const DBDriver & dbDriver)
+{
+	DatabaseFingerprint fingerprint;
+	dbDriver.getLastNodeId(fingerprint.lastNodeId);
+	dbDriver.getLastMapId(fingerprint.lastMapId);
+	dbDriver.getLastWordId(fingerprint.lastWordId);
+	fingerprint.nodesCount = dbDriver.getTotalNodesSize();
+	fingerprint.wordsCount = dbDriver.getTotalDictionarySize();
+	if(!dbDriver.getUrl().empty())
+	{
+#ifdef _WIN32
+		struct _stat64 info;
+		if(_stat64(dbDriver.getUrl().c_str(), &info) == 0)
+#else
+		struct stat info;
+		if(stat(dbDriver.getUrl().c_str(), &info) == 0)
+#endif
+		{
+			fingerprint.fileSize = (long long)info.st_size;
+			fingerprint.fileTime = (long long)info.st_mtime;
+		}
+	}
+	return fingerprint;
+}
+
+} // namespace
+
+bool LocalizationSnapshot::save(
+		const std::string & path,
+		const DBDriver & dbDriver,
+		const std::map<int, Signature *> & signatures,
+		const VWDictionary & dictionary,
+		bool allNodesInWM)
+{
+	if(dictionary.isDescriptorsPaged())
+	{
+		UERROR("Cannot save a snapshot of a dictionary with paged descriptors (%s=true), "
+				"descriptors are not all in memory.", Parameters::kKpPQPagedDescriptors().c_str());
+		return false;
+	}
+
+	UTimer timer;
+	SnapshotWriter out(path);
+	if(!out.isOpen())
+	{
+		UERROR("Cannot open \"%s\" for writing", path.c_str());
+		return false;
+	}
+
+	DatabaseFingerprint fingerprint = getDatabaseFingerprint(dbDriver);
+
+	// Search index of the vocabulary, its size ties it to this snapshot
+	std::string indexPath = path + ".flann";
+	long long indexSize = 0;
+	if(dictionary.saveIndex(indexPath))
+	{
+		indexSize = UFile::length(indexPath);
+	}
+	else if(UFile::exists(indexPath))
+	{
+		UFile::erase(indexPath);
+	}
+
+	// Vocabulary
+	const std::map<int, VisualWord *> & words = dictionary.getVisualWords();
+	int descriptorType = words.empty()?0:words.begin()->second->getDescriptor().type();
+	int descriptorCols = words.empty()?0:words.begin()->second->getDescriptor().cols;
+
+	int nodes = 0;
+	for(std::map<int, Signature *>::const_iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+	{
+		if(iter->first > 0 && iter->second)
+		{
+			++nodes;
+		}
+	}
+
+	out.writeBytes(kMagic, sizeof(kMagic));
+	out.write<int>(kVersion);
+	out.write<int>(kEndianCheck);
+	out.write<int>((int)sizeof(cv::KeyPoint));
+	fingerprint.write(out);
+	out.write<int>(allNodesInWM?1:0);
+	out.write<int>(dictionary.isIncremental()?1:0);
+	out.write<int>((int)words.size());
+	out.write<int>(descriptorType);
+	out.write<int>(descriptorCols);
+	out.write<int>(nodes);
+	out.write<long long>(indexSize);
+
+	std::vector<int> wordIds = uKeys(words);
+	out.writeBytes(wordIds.data(), wordIds.size()*sizeof(int));
+	for(std::map<int, VisualWord *>::const_iterator iter=words.begin(); iter!=words.end(); ++iter)
+	{
+		const cv::Mat & descriptor = iter->second->getDescriptor();
+		UASSERT_MSG(descriptor.rows == 1 && descriptor.cols == descriptorCols && descriptor.type() == descriptorType,
+				uFormat("Word %d has a different descriptor format than other words", iter->first).c_str());
+		cv::Mat continuous = descriptor.isContinuous()?descriptor:descriptor.clone();
+		out.writeBytes(continuous.data, continuous.total()*continuous.elemSize());
+	}
+
+	// Inverted index of the saved nodes, in the same order than the words: count of
+	// referencing nodes per word, then the node ids and their occurrences.
+	std::map<int, std::map<int, int> > references; // <word id, <node id, occurrences> >
+	for(std::map<int, Signature *>::const_iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+	{
+		if(iter->first <= 0 || iter->second == 0)
+		{
+			continue;
+		}
+		for(std::multimap<int, int>::const_iterator jter=iter->second->getWords().begin(); jter!=iter->second->getWords().end(); ++jter)
+		{
+			if(jter->first > 0 && words.find(jter->first) != words.end())
+			{
+				++references[jter->first][iter->first];
+			}
+		}
+	}
+	std::vector<int> referencesCount(words.size(), 0);
+	std::vector<int> referencesNodeIds;
+	std::vector<int> referencesOccurrences;
+	int w=0;
+	for(std::map<int, VisualWord *>::const_iterator iter=words.begin(); iter!=words.end(); ++iter, ++w)
+	{
+		std::map<int, std::map<int, int> >::const_iterator jter = references.find(iter->first);
+		if(jter != references.end())
+		{
+			referencesCount[w] = (int)jter->second.size();
+			for(std::map<int, int>::const_iterator kter=jter->second.begin(); kter!=jter->second.end(); ++kter)
+			{
+				referencesNodeIds.push_back(kter->first);
+				referencesOccurrences.push_back(kter->second);
+			}
+		}
+	}
+	out.writeBytes(referencesCount.data(), referencesCount.size()*sizeof(int));
+	out.write<int>((int)referencesNodeIds.size());
+	out.writeBytes(referencesNodeIds.data(), referencesNodeIds.size()*sizeof(int));
+	out.writeBytes(referencesOccurrences.data(), referencesOccurrences.size()*sizeof(int));
+
+	// Nodes
+	for(std::map<int, Signature *>::const_iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+	{
+		const Signature * s = iter->second;
+		if(iter->first <= 0 || s == 0)
+		{
+			continue;
+		}
+		out.write<int>(s->id());
+		out.write<int>(s->mapId());
+		out.write<int>(s->getWeight());
+		out.write<double>(s->getStamp());
+		out.writeString(s->getLabel());
+		out.writeTransform(s->getPose());
+		out.writeTransform(s->getGroundTruthPose());
+		out.writeVector(s->getVelocity());
+		const GPS & gps = s->sensorData().gps();
+		out.write<double>(gps.stamp());
+		out.write<double>(gps.longitude());
+		out.write<double>(gps.latitude());
+		out.write<double>(gps.altitude());
+		out.write<double>(gps.error());
+		out.write<double>(gps.bearing());
+
+		// Calibration
+		std::vector<unsigned char> calibration;
+		if(!s->sensorData().cameraModels().empty())
+		{
+			out.write<int>(kCalibrationMono);
+			for(size_t i=0; i<s->sensorData().cameraModels().size(); ++i)
+			{
+				std::vector<unsigned char> data = s->sensorData().cameraModels()[i].serialize();
+				calibration.insert(calibration.end(), data.begin(), data.end());
+			}
+		}
+		else if(s->sensorData().stereoCameraModel().isValidForProjection())
+		{
+			out.write<int>(kCalibrationStereo);
+			calibration = s->sensorData().stereoCameraModel().serialize();
+		}
+		else
+		{
+			out.write<int>(kCalibrationNone);
+		}
+		out.writeVector(calibration);
+
+		// Words
+		std::vector<int> ids(s->getWords().size());
+		std::vector<int> indexes(s->getWords().size());
+		int i=0;
+		for(std::multimap<int, int>::const_iterator jter=s->getWords().begin(); jter!=s->getWords().end(); ++jter)
+		{
+			ids[i] = jter->first;
+			indexes[i] = jter->second;
+			++i;
+		}
+		out.writeVector(ids);
+		out.writeVector(indexes);
+		out.writeVector(s->getWordsKpts());
+		out.writeVector(s->getWords3());
+		out.writeMat(s->getWordsDescriptors().isContinuous()?s->getWordsDescriptors():s->getWordsDescriptors().clone());
+
+		// Links
+		out.write<int>((int)s->getLinks().size());
+		for(std::multimap<int, Link>::const_iterator jter=s->getLinks().begin(); jter!=s->getLinks().end(); ++jter)
+		{
+			out.writeLink(jter->second);
+		}
+		out.write<int>((int)s->getLandmarks().size());
+		for(std::map<int, Link>::const_iterator jter=s->getLandmarks().begin(); jter!=s->getLandmarks().end(); ++jter)
+		{
+			out.writeLink(jter->second);
+		}
+	}
+
+	if(!out.good())
+	{
+		UERROR("Failed writing localization snapshot \"%s\"", path.c_str());
+		return false;
+	}
+	UINFO("Saved localization snapshot \"%s\" (%d nodes, %d words, %d word references%s) in %fs",
+			path.c_str(), nodes, (int)words.size(), (int)referencesNodeIds.size(),
+			indexSize?", with search index":"", timer.ticks());
+	return true;
+}
+
+bool LocalizationSnapshot::load(
+		const std::string & path,
+		const DBDriver & dbDriver,
+		bool allNodesInWM,
+		bool incrementalDictionary,
+		std::list<Signature *> & signatures,
+		std::list<VisualWord *> & words,
+		std::string & indexPath)
+{
+	UTimer timer;
+	SnapshotReader in(path);
+	if(!in.isOpen())
+	{
+		UWARN("Cannot open localization snapshot \"%s\"", path.c_str());
+		return false;
+	}
+	UDEBUG("Opened snapshot of %ld bytes", (long)in.size());
+
+	char magic[sizeof(kMagic)];
+	if(!in.readBytes(magic, sizeof(magic)) || memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+	{
+		UWARN("\"%s\" is not a localization snapshot", path.c_str());
+		return false;
+	}
+	int version = in.read<int>();
+	int endianCheck = in.read<int>();
+	int keypointSize = in.read<int>();
+	if(version != kVersion || endianCheck != kEndianCheck || keypointSize != (int)sizeof(cv::KeyPoint))
+	{
+		UWARN("Localization snapshot \"%s\" was generated with another version or on another platform (version=%d), ignoring it.",
+				path.c_str(), version);
+		return false;
+	}
+
+	DatabaseFingerprint fingerprint = getDatabaseFingerprint(dbDriver);
+	DatabaseFingerprint snapshotFingerprint;
+	snapshotFingerprint.read(in);
+	if(snapshotFingerprint != fingerprint)
+	{
+		UWARN("Localization snapshot \"%s\" doesn't match the database (last node/map/word ids %d/%d/%d vs %d/%d/%d, "
+			  "nodes/words %d/%d vs %d/%d, file size %lld vs %lld, modification time %lld vs %lld), the database "
+			  "has been modified since the snapshot has been generated. Ignoring it.",
+				path.c_str(),
+				snapshotFingerprint.lastNodeId, snapshotFingerprint.lastMapId, snapshotFingerprint.lastWordId,
+				fingerprint.lastNodeId, fingerprint.lastMapId, fingerprint.lastWordId,
+				snapshotFingerprint.nodesCount, snapshotFingerprint.wordsCount,
+				fingerprint.nodesCount, fingerprint.wordsCount,
+				snapshotFingerprint.fileSize, fingerprint.fileSize,
+				snapshotFingerprint.fileTime, fingerprint.fileTime);
+		return false;
+	}
+	bool snapshotAllNodesInWM = in.read<int>() != 0;
+	bool snapshotIncrementalDictionary = in.read<int>() != 0;
+	if(snapshotAllNodesInWM != allNodesInWM || snapshotIncrementalDictionary != incrementalDictionary)
+	{
+		UWARN("Localization snapshot \"%s\" was generated with %s=%s and incremental dictionary=%s, "
+			  "but current parameters are %s and %s. Ignoring it.",
+				path.c_str(),
+				Parameters::kMemInitWMWithAllNodes().c_str(),
+				snapshotAllNodesInWM?"true":"false",
+				snapshotIncrementalDictionary?"true":"false",
+				allNodesInWM?"true":"false",
+				incrementalDictionary?"true":"false");
+		return false;
+	}
+
+	// Vocabulary, descriptors share the same buffer
+	int wordsCount = in.read<int>();
+	int descriptorType = in.read<int>();
+	int descriptorCols = in.read<int>();
+	int nodesCount = in.read<int>();
+	long long indexSize = in.read<long long>();
+	if(!in.ok() || wordsCount < 0 || nodesCount < 0 ||
+	   (wordsCount > 0 && (descriptorCols <= 0 || !SnapshotReader::isValidType(descriptorType) ||
+			   !in.fits(wordsCount, sizeof(int) + (size_t)descriptorCols*CV_ELEM_SIZE(descriptorType)))))
+	{
+		UWARN("Localization snapshot \"%s\" is corrupted", path.c_str());
+		return false;
+	}
+	std::list<VisualWord *> loadedWords;
+	if(wordsCount)
+	{
+		std::vector<int> ids(wordsCount);
+		cv::Mat descriptors(wordsCount, descriptorCols, descriptorType);
+		if(in.readBytes(ids.data(), ids.size()*sizeof(int)) &&
+		   in.readBytes(descriptors.data, descriptors.total()*descriptors.elemSize()))
+		{
+			for(int i=0; i<wordsCount; ++i)
+			{
+				VisualWord * vw = new VisualWord(ids[i], descriptors.row(i));
+				vw->setSaved(true);
+				loadedWords.push_back(vw);
+			}
+		}
+	}
+	UDEBUG("Words loaded (%d) in %fs", (int)loadedWords.size(), timer.ticks());
+
+	// Inverted index, references are added by word instead of by node
+	std::vector<int> referencesCount(in.ok()?wordsCount:0);
+	in.readBytes(referencesCount.data(), referencesCount.size()*sizeof(int));
+	int referencesTotal = in.read<int>();
+	if(in.ok() && referencesTotal >= 0 && in.fits(referencesTotal, 2*sizeof(int)))
+	{
+		std::vector<int> nodeIds(referencesTotal);
+		std::vector<int> occurrences(referencesTotal);
+		in.readBytes(nodeIds.data(), nodeIds.size()*sizeof(int));
+		in.readBytes(occurrences.data(), occurrences.size()*sizeof(int));
+		int w=0;
+		int j=0;
+		for(std::list<VisualWord *>::iterator iter=loadedWords.begin(); iter!=loadedWords.end() && in.ok(); ++iter, ++w)
+		{
+			if(referencesCount[w] < 0 || referencesCount[w] > referencesTotal - j)
+			{
+				in.invalidate();
+				break;
+			}
+			for(int k=0; k<referencesCount[w] && in.ok(); ++k, ++j)
+			{
+				if(nodeIds[j] <= 0 || occurrences[j] <= 0)
+				{
+					in.invalidate();
+				}
+				else
+				{
+					(*iter)->addRef(nodeIds[j], occurrences[j]);
+				}
+			}
+		}
+		if(j != referencesTotal)
+		{
+			in.invalidate();
+		}
+	}
+	else
+	{
+		in.invalidate();
+	}
+	UDEBUG("Word references loaded (%d) in %fs", referencesTotal, timer.ticks());
+
+	// Nodes
+	std::list<Signature *> loadedSignatures;
+	for(int n=0; n<nodesCount && in.ok(); ++n)
+	{
+		int id = in.read<int>();
+		int mapId = in.read<int>();
+		int weight = in.read<int>();
+		double stamp = in.read<double>();
+		std::string label = in.readString();
+		Transform pose = in.readTransform();
+		Transform groundTruthPose = in.readTransform();
+		std::vector<float> velocity = in.readVector<float>();
+		double gps[6];
+		for(int i=0; i<6; ++i)
+		{
+			gps[i] = in.read<double>();
+		}
+		int calibrationType = in.read<int>();
+		std::vector<unsigned char> calibration = in.readVector<unsigned char>();
+
+		std::vector<int> ids = in.readVector<int>();
+		std::vector<int> indexes = in.readVector<int>();
+		std::vector<cv::KeyPoint> keypoints = in.readVector<cv::KeyPoint>();
+		std::vector<cv::Point3f> points = in.readVector<cv::Point3f>();
+		cv::Mat descriptors = in.readMat();
+		if(!in.ok() || ids.size() != indexes.size())
+		{
+			break;
+		}
+
+		Signature * s = new Signature(id, mapId, weight, stamp, label, pose, groundTruthPose);
+		loadedSignatures.push_back(s);
+		if(velocity.size() == 6)
+		{
+			s->setVelocity(velocity[0], velocity[1], velocity[2], velocity[3], velocity[4], velocity[5]);
+		}
+		s->sensorData().setGPS(GPS(gps[0], gps[1], gps[2], gps[3], gps[4], gps[5]));
+
+		if(calibrationType == kCalibrationMono)
+		{
+			std::vector<CameraModel> models;
+			unsigned int bytesReadTotal = 0;
+			unsigned int bytesRead = 0;
+			CameraModel model;
+			while(bytesReadTotal < calibration.size() &&
+				  (bytesRead=model.deserialize(calibration.data()+bytesReadTotal, calibration.size()-bytesReadTotal))!=0)
+			{
+				bytesReadTotal+=bytesRead;
+				models.push_back(model);
+			}
+			s->sensorData().setCameraModels(models);
+		}
+		else if(calibrationType == kCalibrationStereo)
+		{
+			StereoCameraModel model;
+			model.deserialize(calibration);
+			s->sensorData().setStereoCameraModel(model);
+		}
+
+		if(!ids.empty())
+		{
+			std::multimap<int, int> wordsMap;
+			for(size_t i=0; i<ids.size(); ++i)
+			{
+				wordsMap.insert(wordsMap.end(), std::make_pair(ids[i], indexes[i]));
+			}
+			s->setWords(wordsMap, keypoints, points, descriptors);
+		}
+
+		int linksCount = in.read<int>();
+		for(int i=0; i<linksCount && in.ok(); ++i)
+		{
+			Link link = in.readLink();
+			if(in.ok())
+			{
+				s->addLink(link);
+			}
+		}
+		int landmarksCount = in.read<int>();
+		for(int i=0; i<landmarksCount && in.ok(); ++i)
+		{
+			Link link = in.readLink();
+			if(in.ok())
+			{
+				s->addLandmark(link);
+			}
+		}
+		s->setSaved(true);
+		s->setModified(false);
+	}
+
+	if(!in.ok() || !in.atEnd() || (int)loadedSignatures.size() != nodesCount)
+	{
+		UWARN("Localization snapshot \"%s\" is corrupted", path.c_str());
+		for(std::list<Signature *>::iterator iter=loadedSignatures.begin(); iter!=loadedSignatures.end(); ++iter)
+		{
+			delete *iter;
+		}
+		for(std::list<VisualWord *>::iterator iter=loadedWords.begin(); iter!=loadedWords.end(); ++iter)
+		{
+			delete *iter;
+		}
+		return false;
+	}
+
+	indexPath.clear();
+	if(indexSize > 0)
+	{
+		std::string snapshotIndexPath = path + ".flann";
+		if((long long)UFile::length(snapshotIndexPath) == indexSize)
+		{
+			indexPath = snapshotIndexPath;
+		}
+		else
+		{
+			UWARN("Search index \"%s\" of the localization snapshot is missing or doesn't match the snapshot, "
+				  "it will be rebuilt.", snapshotIndexPath.c_str());
+		}
+	}
+
+	signatures.splice(signatures.end(), loadedSignatures);
+	words.splice(words.end(), loadedWords);
+	UINFO("Loaded localization snapshot \"%s\" (%d nodes, %d words) in %fs",
+			path.c_str(), nodesCount, wordsCount, timer.elapsed());
+	return true;
+}
+
+} /* namespace rtabmap */
@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UProcessInfo.h>
+#include <rtabmap/utilite/UProfiler.h>
 #include <rtabmap/utilite/UMath.h>
 
 #include "rtabmap/core/Memory.h"
@@ -56,6 +57,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Statistics.h"
 #include "rtabmap/core/Compression.h"
 #include "rtabmap/core/Graph.h"
+#include "rtabmap/core/LocalizationSnapshot.h"
+#include "rtabmap/core/GlobalDescriptorIndex.h"
 #include "rtabmap/core/Stereo.h"
 #include "rtabmap/core/optimizer/OptimizerG2O.h"
 #include <pcl/io/pcd_io.h>
@@ -63,6 +66,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/OccupancyGrid.h>
 #include <rtabmap/core/MarkerDetector.h>
 #include <opencv2/imgproc/types_c.h>
+#include <algorithm>
 
 namespace rtabmap {
 
@@ -81,6 +85,8 @@ Memory::Memory(const ParametersMap & parameters) :
 	_rgbCompressionFormat(Parameters::defaultMemImageCompressionFormat()),
 	_incrementalMemory(Parameters::defaultMemIncrementalMemory()),
 	_localizationDataSaved(Parameters::defaultMemLocalizationDataSaved()),
+	_localizationFastPath(Parameters::defaultMemLocalizationFastPath()),
+	_localizationSnapshotPath(Parameters::defaultMemLocalizationSnapshot()),
 	_reduceGraph(Parameters::defaultMemReduceGraph()),
 	_maxStMemSize(Parameters::defaultMemSTMSize()),
 	_recentWmRatio(Parameters::defaultMemRecentWmRatio()),
@@ -110,17 +116,25 @@ Memory::Memory(const ParametersMap & parameters) :
 	_imagesAlreadyRectified(Parameters::defaultRtabmapImagesAlreadyRectified()),
 	_rectifyOnlyFeatures(Parameters::defaultRtabmapRectifyOnlyFeatures()),
 	_covOffDiagonalIgnored(Parameters::defaultMemCovOffDiagIgnored()),
+	_topologyCached(Parameters::defaultMemTopologyCached()),
+	_globalDescriptorLikelihood(Parameters::defaultMemGlobalDescriptorLikelihood()),
+	_globalDescriptorTopK(Parameters::defaultMemGlobalDescriptorTopK()),
 	_detectMarkers(Parameters::defaultRGBDMarkerDetection()),
 	_markerLinVariance(Parameters::defaultMarkerVarianceLinear()),
 	_markerAngVariance(Parameters::defaultMarkerVarianceAngular()),
 	_idCount(kIdStart),
 	_idMapCount(kIdStart),
 	_lastSignature(0),
+	_lastFastPathUnmatchedWords(0, 0),
 	_lastGlobalLoopClosureId(0),
 	_memoryChanged(false),
 	_linksChanged(false),
+	_graphRevision(0),
 	_signaturesAdded(0),
 	_allNodesInWM(true),
+	_recentWmBoundaryId(0),
+	_recentWmCount(0),
+	_ltmTopologyLoaded(false),
 
 	_badSignRatio(Parameters::defaultKpBadSignRatio()),
 	_tfIdfLikelihoodUsed(Parameters::defaultKpTfIdfLikelihoodUsed()),
@@ -128,6 +142,7 @@ Memory::Memory(const ParametersMap & parameters) :
 {
 	_feature2D = Feature2D::create(parameters);
 	_vwd = new VWDictionary(parameters);
+	_globalDescriptorIndex = new GlobalDescriptorIndex(GlobalDescriptorIndex::kInnerProduct, true);
 	_registrationPipeline = Registration::create(parameters);
 
 	// for local scan matching, correspondences ratio should be two times higher as we expect more matches
@@ -222,8 +237,20 @@ void Memory::loadDataFromDb(bool postInitClosingEvents)
 
 		// Load the last working memory...
 		std::list<Signature*> dbSignatures;
+		std::list<VisualWord*> snapshotWords;
+		std::string snapshotIndexPath;
+		bool snapshotLoaded = false;
+		if(!_incrementalMemory && !_localizationSnapshotPath.empty())
+		{
+			if(postInitClosingEvents) UEventsManager::post(new RtabmapEventInit(std::string("Loading localization snapshot...")));
+			snapshotLoaded = LocalizationSnapshot::load(_localizationSnapshotPath, *_dbDriver, loadAllNodesInWM, _vwd->isIncremental(), dbSignatures, snapshotWords, snapshotIndexPath);
+		}
 
-		if(loadAllNodesInWM)
+		if(snapshotLoaded)
+		{
+			UDEBUG("Loaded %d nodes from localization snapshot", (int)dbSignatures.size());
+		}
+		else if(loadAllNodesInWM)
 		{
 			if(postInitClosingEvents) UEventsManager::post(new RtabmapEventInit(std::string("Loading all nodes to WM...")));
 			std::set<int> ids;
@@ -247,7 +274,7 @@ void Memory::loadDataFromDb(bool postInitClosingEvents)
 				//       only linked with the ones of the current session by
 				//       global loop closures.
 				_signatures.insert(std::pair<int, Signature *>((*iter)->id(), *iter));
-				_workingMem.insert(std::make_pair((*iter)->id(), UTimer::now()));
+				addToWorkingMem((*iter)->id(), UTimer::now(), (*iter)->getWeight());
 				if(!(*iter)->getGroundTruthPose().isNull()) {
 					_groundTruths.insert(std::make_pair((*iter)->id(), (*iter)->getGroundTruthPose()));
 				}
@@ -333,6 +360,12 @@ void Memory::loadDataFromDb(bool postInitClosingEvents)
 		}
 		UDEBUG("update odomMaxInf vector, done!");
 
+		if(_topologyCached)
+		{
+			if(postInitClosingEvents) UEventsManager::post(new RtabmapEventInit(std::string("Loading graph topology...")));
+			loadLtmTopology();
+		}
+
 		if(postInitClosingEvents) UEventsManager::post(new RtabmapEventInit(std::string("Loading nodes to WM, done! (") + uNumber2Str(int(_workingMem.size() + _stMem.size())) + " loaded)"));
 
 		// Assign the last signature
@@ -354,7 +387,18 @@ void Memory::loadDataFromDb(bool postInitClosingEvents)
 		// Now load the dictionary if we have a connection
 		if(postInitClosingEvents) UEventsManager::post(new RtabmapEventInit("Loading dictionary..."));
 		UDEBUG("Loading dictionary...");
-		if(loadAllNodesInWM)
+		if(snapshotLoaded)
+		{
+			UDEBUG("load %d words (with their references) from localization snapshot", (int)snapshotWords.size());
+			for(std::list<VisualWord*>::iterator iter = snapshotWords.begin(); iter!=snapshotWords.end(); ++iter)
+			{
+				_vwd->addWord(*iter);
+			}
+			int id = 0;
+			_dbDriver->getLastWordId(id);
+			_vwd->setLastWordId(id);
+		}
+		else if(loadAllNodesInWM)
 		{
 			UDEBUG("load all referenced words in working memory");
 			// load all referenced words in working memory
@@ -401,9 +445,12 @@ void Memory::loadDataFromDb(bool postInitClosingEvents)
 			// load the last dictionary
 			_dbDriver->load(_vwd, _vwd->isIncremental());
 		}
-		UDEBUG("%d words loaded!", _vwd->getUnusedWordsSize());
-		_vwd->update();
-		if(postInitClosingEvents) UEventsManager::post(new RtabmapEventInit(uFormat("Loading dictionary, done! (%d words)", (int)_vwd->getUnusedWordsSize())));
+		UDEBUG("%d words loaded!", (int)_vwd->getVisualWords().size());
+		if(snapshotIndexPath.empty() || !_vwd->loadIndex(snapshotIndexPath))
+		{
+			_vwd->update();
+		}
+		if(postInitClosingEvents) UEventsManager::post(new RtabmapEventInit(uFormat("Loading dictionary, done! (%d words)", (int)_vwd->getVisualWords().size())));
 
 		if(postInitClosingEvents) UEventsManager::post(new RtabmapEventInit(std::string("Adding word references...")));
 		// Enable loaded signatures
@@ -416,12 +463,16 @@ void Memory::loadDataFromDb(bool postInitClosingEvents)
 			const std::multimap<int, int> & words = s->getWords();
 			if(words.size())
 			{
-				UDEBUG("node=%d, word references=%d", s->id(), words.size());
-				for(std::multimap<int, int>::const_iterator iter = words.begin(); iter!=words.end(); ++iter)
+				// references of the snapshot words are already set
+				if(!snapshotLoaded)
 				{
-					if(iter->first > 0)
+					UDEBUG("node=%d, word references=%d", s->id(), words.size());
+					for(std::multimap<int, int>::const_iterator iter = words.begin(); iter!=words.end(); ++iter)
 					{
-						_vwd->addWordRef(iter->first, i->first);
+						if(iter->first > 0)
+						{
+							_vwd->addWordRef(iter->first, i->first);
+						}
 					}
 				}
 				s->setEnabled(true);
@@ -451,7 +502,7 @@ void Memory::loadDataFromDb(bool postInitClosingEvents)
 		_idMapCount = kIdStart;
 	}
 
-	_workingMem.insert(std::make_pair(kIdVirtual, 0));
+	addToWorkingMem(kIdVirtual, 0, 0);
 
 	UDEBUG("ids start with %d", _idCount+1);
 	UDEBUG("map ids start with %d", _idMapCount);
@@ -524,6 +575,7 @@ Memory::~Memory()
 	}
 	delete _feature2D;
 	delete _vwd;
+	delete _globalDescriptorIndex;
 	delete _registrationPipeline;
 	delete _registrationIcpMulti;
 	delete _occupancy;
@@ -550,7 +602,12 @@ void Memory::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(params, Parameters::kMemMapLabelsAdded(), _mapLabelsAdded);
 	Parameters::parse(params, Parameters::kMemRehearsalSimilarity(), _similarityThreshold);
 	Parameters::parse(params, Parameters::kMemRecentWmRatio(), _recentWmRatio);
+	bool transferSortingByWeightId = _transferSortingByWeightId;
 	Parameters::parse(params, Parameters::kMemTransferSortingByWeightId(), _transferSortingByWeightId);
+	if(transferSortingByWeightId != _transferSortingByWeightId)
+	{
+		rebuildTransferIndex();
+	}
 	Parameters::parse(params, Parameters::kMemSTMSize(), _maxStMemSize);
 	Parameters::parse(params, Parameters::kMemDepthAsMask(), _depthAsMask);
 	Parameters::parse(params, Parameters::kMemStereoFromMotion(), _stereoFromMotion);
@@ -573,10 +630,16 @@ void Memory::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(params, Parameters::kRtabmapImagesAlreadyRectified(), _imagesAlreadyRectified);
 	Parameters::parse(params, Parameters::kRtabmapRectifyOnlyFeatures(), _rectifyOnlyFeatures);
 	Parameters::parse(params, Parameters::kMemCovOffDiagIgnored(), _covOffDiagonalIgnored);
+	bool topologyCached = _topologyCached;
+	Parameters::parse(params, Parameters::kMemTopologyCached(), _topologyCached);
+	Parameters::parse(params, Parameters::kMemGlobalDescriptorLikelihood(), _globalDescriptorLikelihood);
+	Parameters::parse(params, Parameters::kMemGlobalDescriptorTopK(), _globalDescriptorTopK);
 	Parameters::parse(params, Parameters::kRGBDMarkerDetection(), _detectMarkers);
 	Parameters::parse(params, Parameters::kMarkerVarianceLinear(), _markerLinVariance);
 	Parameters::parse(params, Parameters::kMarkerVarianceAngular(), _markerAngVariance);
 	Parameters::parse(params, Parameters::kMemLocalizationDataSaved(), _localizationDataSaved);
+	Parameters::parse(params, Parameters::kMemLocalizationFastPath(), _localizationFastPath);
+	Parameters::parse(params, Parameters::kMemLocalizationSnapshot(), _localizationSnapshotPath);
 
 	UASSERT_MSG(_maxStMemSize >= 0, uFormat("value=%d", _maxStMemSize).c_str());
 	UASSERT_MSG(_similarityThreshold >= 0.0f && _similarityThreshold <= 1.0f, uFormat("value=%f", _similarityThreshold).c_str());
@@ -591,12 +654,40 @@ void Memory::parseParameters(const ParametersMap & parameters)
 	}
 	UASSERT(_rehearsalMaxDistance >= 0.0f);
 	UASSERT(_rehearsalMaxAngle >= 0.0f);
+	UASSERT_MSG(_globalDescriptorLikelihood >= 0 && _globalDescriptorLikelihood <= 2, uFormat("value=%d", _globalDescriptorLikelihood).c_str());
+	UASSERT_MSG(_globalDescriptorTopK > 0, uFormat("value=%d", _globalDescriptorTopK).c_str());
+
+	if(_globalDescriptorLikelihood == 0)
+	{
+		_globalDescriptorIndex->clear();
+	}
+	else if(_globalDescriptorIndex->size() == 0)
+	{
+		for(std::map<int, double>::const_iterator iter=_workingMem.begin(); iter!=_workingMem.end(); ++iter)
+		{
+			const Signature * s = iter->first>0?_getSignature(iter->first):0;
+			if(s)
+			{
+				indexGlobalDescriptor(s);
+			}
+		}
+	}
 
 	if(_dbDriver)
 	{
 		_dbDriver->parseParameters(params);
 	}
 
+	if(!_topologyCached)
+	{
+		clearLtmTopology();
+	}
+	else if(!topologyCached && _dbDriver && _dbDriver->isConnected())
+	{
+		// enabled at runtime, otherwise it is loaded in loadDataFromDb()
+		loadLtmTopology();
+	}
+
 	// Keypoint stuff
 	if(_vwd)
 	{
@@ -770,6 +861,7 @@ bool Memory::update(
 		const std::vector<float> & velocity,
 		Statistics * stats)
 {
+	UPROFILER_ZONE("Memory::update");
 	UDEBUG("");
 	UTimer timer;
 	UTimer totalTimer;
@@ -1002,6 +1094,7 @@ void Memory::addSignatureToStm(Signature * signature, const cv::Mat & covariance
 
 		_signatures.insert(_signatures.end(), std::pair<int, Signature *>(signature->id(), signature));
 		_stMem.insert(_stMem.end(), signature->id());
+		updateGraphRevision(*signature);
 		if(!signature->getGroundTruthPose().isNull()) {
 			_groundTruths.insert(std::make_pair(signature->id(), signature->getGroundTruthPose()));
 		}
@@ -1011,7 +1104,9 @@ void Memory::addSignatureToStm(Signature * signature, const cv::Mat & covariance
 		{
 			UDEBUG("%d words ref for the signature %d", signature->getWords().size(), signature->id());
 		}
-		if(signature->getWords().size())
+		// Nodes created by the localization fast path are not referenced in
+		// the dictionary, keep them disabled (see createSignature())
+		if(signature->getWords().size() && (_incrementalMemory || !_localizationFastPath))
 		{
 			signature->setEnabled(true);
 		}
@@ -1025,8 +1120,8 @@ void Memory::addSignatureToWmFromLTM(Signature * signature)
 	if(signature)
 	{
 		UDEBUG("Inserting node %d in WM...", signature->id());
-		_workingMem.insert(std::make_pair(signature->id(), UTimer::now()));
 		_signatures.insert(std::pair<int, Signature*>(signature->id(), signature));
+		addToWorkingMem(signature->id(), UTimer::now(), signature->getWeight());
 		if(!signature->getGroundTruthPose().isNull()) {
 			_groundTruths.insert(std::make_pair(signature->id(), signature->getGroundTruthPose()));
 		}
@@ -1080,6 +1175,7 @@ void Memory::moveSignatureToWMFromSTM(int id, int * reducedTo)
 		{
 			if(s->getLabel().empty())
 			{
+				updateGraphRevision(*s);
 				for(std::multimap<int, Link>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
 				{
 					Signature * sTo = this->_getSignature(iter->first);
@@ -1138,7 +1234,7 @@ void Memory::moveSignatureToWMFromSTM(int id, int * reducedTo)
 	}
 	if(s != 0)
 	{
-		_workingMem.insert(_workingMem.end(), std::make_pair(*_stMem.begin(), UTimer::now()));
+		addToWorkingMem(*_stMem.begin(), UTimer::now(), s->getWeight());
 		_stMem.erase(*_stMem.begin());
 	}
 	// else already removed from STM/WM in moveToTrash()
@@ -1387,10 +1483,8 @@ std::map<int, int> Memory::getNeighborsId(
 				//UDEBUG("Added %d with margin %d", *jter, m);
 				// Look up in STM/WM if all ids are here, if not... load them from the database
 				const Signature * s = this->getSignature(*jter);
-				std::multimap<int, Link> tmpLinks;
-				std::map<int, Link> tmpLandmarks;
-				const std::multimap<int, Link> * links = &tmpLinks;
-				const std::map<int, Link> * landmarks = &tmpLandmarks;
+				std::vector<std::pair<int, Link::Type> > neighbors; // <id, link type>
+				std::vector<int> landmarks;
 				if(s)
 				{
 					if(!ignoreIntermediateNodes || s->getWeight() != -1)
@@ -1402,10 +1496,18 @@ std::map<int, int> Memory::getNeighborsId(
 						ignoredIds.insert(*jter);
 					}
 
-					links = &s->getLinks();
+					neighbors.reserve(s->getLinks().size());
+					for(std::multimap<int, Link>::const_iterator iter=s->getLinks().begin(); iter!=s->getLinks().end(); ++iter)
+					{
+						neighbors.push_back(std::make_pair(iter->first, iter->second.type()));
+					}
 					if(!ignoreLoopIds)
 					{
-						landmarks = &s->getLandmarks();
+						landmarks.reserve(s->getLandmarks().size());
+						for(std::map<int, Link>::const_iterator iter=s->getLandmarks().begin(); iter!=s->getLandmarks().end(); ++iter)
+						{
+							landmarks.push_back(iter->first);
+						}
 					}
 				}
 				else if(maxCheckedInDatabase == -1 || (maxCheckedInDatabase > 0 && _dbDriver && nbLoadedFromDb < maxCheckedInDatabase))
@@ -1413,47 +1515,43 @@ std::map<int, int> Memory::getNeighborsId(
 					++nbLoadedFromDb;
 					ids.insert(std::pair<int, int>(*jter, m));
 
-					UTimer timer;
-					_dbDriver->loadLinks(*jter, tmpLinks, ignoreLoopIds?Link::kAllWithoutLandmarks:Link::kAllWithLandmarks);
-					if(tmpLinks.empty())
+					// Use the topology cache if available, otherwise query the database
+					if(!getLtmTopology(*jter, !ignoreLoopIds, neighbors, landmarks))
 					{
-						UWARN("No links loaded for %d?!", *jter);
-					}
-					if(!ignoreLoopIds)
-					{
-						for(std::multimap<int, Link>::iterator kter=tmpLinks.begin(); kter!=tmpLinks.end();)
+						UTimer timer;
+						std::multimap<int, Link::Type> tmpLinks;
+						_dbDriver->loadLinkTypes(*jter, tmpLinks, !ignoreLoopIds);
+						for(std::multimap<int, Link::Type>::iterator kter=tmpLinks.begin(); kter!=tmpLinks.end(); ++kter)
 						{
 							if(kter->first < 0)
 							{
-								tmpLandmarks.insert(*kter);
-								tmpLinks.erase(kter++);
-							}
-							else if(kter->second.from() == kter->second.to())
-							{
-								// ignore self-referring links
-								tmpLinks.erase(kter++);
+								landmarks.push_back(kter->first);
 							}
-							else
+							else if(kter->first != *jter) // ignore self-referring links
 							{
-								++kter;
+								neighbors.push_back(*kter);
 							}
 						}
+						if(dbAccessTime)
+						{
+							*dbAccessTime += timer.getElapsedTime();
+						}
 					}
-					if(dbAccessTime)
+					if(neighbors.empty() && landmarks.empty())
 					{
-						*dbAccessTime += timer.getElapsedTime();
+						UWARN("No links loaded for %d?!", *jter);
 					}
 				}
 
 				// links
-				for(std::multimap<int, Link>::const_iterator iter=links->begin(); iter!=links->end(); ++iter)
+				for(std::vector<std::pair<int, Link::Type> >::const_iterator iter=neighbors.begin(); iter!=neighbors.end(); ++iter)
 				{
 					if(!uContains(ids, iter->first) &&
 					   ignoredIds.find(iter->first) == ignoredIds.end())
 					{
-						UASSERT(iter->second.type() != Link::kUndef);
-						if(iter->second.type() == Link::kNeighbor ||
-					       iter->second.type() == Link::kNeighborMerged)
+						UASSERT(iter->second != Link::kUndef);
+						if(iter->second == Link::kNeighbor ||
+					       iter->second == Link::kNeighborMerged)
 						{
 							if(ignoreIntermediateNodes && s->getWeight()==-1)
 							{
@@ -1468,7 +1566,7 @@ std::map<int, int> Memory::getNeighborsId(
 								nextMargin.insert(iter->first);
 							}
 						}
-						else if(!ignoreLoopIds && (!ignoreLocalSpaceLoopIds || iter->second.type()!=Link::kLocalSpaceClosure))
+						else if(!ignoreLoopIds && (!ignoreLocalSpaceLoopIds || iter->second!=Link::kLocalSpaceClosure))
 						{
 							if(incrementMarginOnLoop)
 							{
@@ -1486,9 +1584,9 @@ std::map<int, int> Memory::getNeighborsId(
 				}
 
 				// landmarks
-				for(std::map<int, Link>::const_iterator iter=landmarks->begin(); iter!=landmarks->end(); ++iter)
+				for(std::vector<int>::const_iterator iter=landmarks.begin(); iter!=landmarks.end(); ++iter)
 				{
-					const std::map<int, std::set<int> >::const_iterator kter = _landmarksInvertedIndex.find(iter->first);
+					const std::map<int, std::set<int> >::const_iterator kter = _landmarksInvertedIndex.find(*iter);
 					if(kter != _landmarksInvertedIndex.end())
 					{
 						for(std::set<int>::const_iterator nter=kter->second.begin(); nter!=kter->second.end(); ++nter)
@@ -1612,6 +1710,16 @@ void Memory::updateAge(int signatureId)
 	if(iter!=_workingMem.end())
 	{
 		iter->second = UTimer::now();
+		if(!_transferSortingByWeightId)
+		{
+			std::map<int, std::set<WeightAgeIdKey>::iterator>::iterator jter = _transferIndexIters.find(signatureId);
+			if(jter != _transferIndexIters.end())
+			{
+				int weight = jter->second->weight;
+				_transferIndex.erase(jter->second);
+				jter->second = _transferIndex.insert(WeightAgeIdKey(weight, iter->second, signatureId)).first;
+			}
+		}
 	}
 }
 
@@ -1651,6 +1759,21 @@ double Memory::getDbSavingTime() const
 	return _dbDriver?_dbDriver->getEmptyTrashesTime():0;
 }
 
+double Memory::getDbMaxCommitTime() const
+{
+	return _dbDriver?_dbDriver->getMaxCommitTime():0;
+}
+
+int Memory::getDbTrashSize() const
+{
+	return _dbDriver?_dbDriver->getTrashesSize():0;
+}
+
+bool Memory::isDbWriteBehind() const
+{
+	return _dbDriver && _dbDriver->isGroupCommitEnabled();
+}
+
 std::set<int> Memory::getAllSignatureIds(bool ignoreChildren) const
 {
 	std::set<int> ids;
@@ -1725,6 +1848,11 @@ void Memory::clear()
 	}
 	UDEBUG("");
 
+	// no need to keep the topology up to date while emptying the memory
+	clearLtmTopology();
+	_nodeRevisions.clear();
+	++_graphRevision;
+
 	//Get the tree root (parents)
 	std::map<int, Signature*> mem = _signatures;
 	for(std::map<int, Signature *>::iterator i=mem.begin(); i!=mem.end(); ++i)
@@ -1741,6 +1869,11 @@ void Memory::clear()
 		ULOGGER_ERROR("_workingMem must be empty here, size=%d", _workingMem.size());
 	}
 	_workingMem.clear();
+	_transferIndex.clear();
+	_transferIndexIters.clear();
+	_globalDescriptorIndex->clear();
+	_recentWmBoundaryId = 0;
+	_recentWmCount = 0;
 	if(_signatures.size()!=0)
 	{
 		ULOGGER_ERROR("_signatures must be empty here, size=%d", _signatures.size());
@@ -1793,6 +1926,76 @@ void Memory::clear()
  * If an error occurs, the result is empty.
  */
 std::map<int, float> Memory::computeLikelihood(const Signature * signature, const std::list<int> & ids)
+{
+	UPROFILER_ZONE("Memory::computeLikelihood");
+	if(_globalDescriptorLikelihood > 0 &&
+	   signature &&
+	   !ids.empty() &&
+	   _globalDescriptorIndex->size() &&
+	   signature->sensorData().globalDescriptors().size())
+	{
+		UTimer timer;
+		cv::Mat query = signature->sensorData().globalDescriptors().front().data();
+		if(query.rows > 1)
+		{
+			query = query.clone().reshape(1, 1); // descriptor as a single row
+		}
+		if(_globalDescriptorLikelihood == 1)
+		{
+			std::map<int, float> scores = _globalDescriptorIndex->scores(query, ids);
+			std::map<int, float> likelihood;
+			for(std::list<int>::const_iterator iter = ids.begin(); iter!=ids.end(); ++iter)
+			{
+				float sim = uValue(scores, *iter, 0.0f);
+				likelihood.insert(likelihood.end(), std::pair<int, float>(*iter, sim>0.0f?sim:0.0f));
+			}
+			UDEBUG("compute likelihood (global descriptors, %d nodes)... %f s", (int)scores.size(), timer.ticks());
+			return likelihood;
+		}
+
+		// Pre-filter: visual words likelihood only for the most similar nodes. Only
+		// nodes of the list are ranked, the caller may have excluded some nodes
+		// of WM (e.g., outside RGBD/LocalRadius), they should not take top K slots.
+		std::map<int, float> scores = _globalDescriptorIndex->scores(query, ids);
+		std::vector<std::pair<float, int> > ranked; // <-score, id>, best first once sorted
+		ranked.reserve(scores.size());
+		for(std::map<int, float>::iterator iter=scores.begin(); iter!=scores.end(); ++iter)
+		{
+			ranked.push_back(std::make_pair(-iter->second, iter->first));
+		}
+		int topK = _globalDescriptorTopK<(int)ranked.size()?_globalDescriptorTopK:(int)ranked.size();
+		if(topK < 0)
+		{
+			topK = 0;
+		}
+		std::partial_sort(ranked.begin(), ranked.begin()+topK, ranked.end());
+		std::set<int> candidates;
+		for(int i=0; i<topK; ++i)
+		{
+			candidates.insert(ranked[i].second);
+		}
+		// Nodes without global descriptor (not indexed) cannot be pre-filtered, they are always candidates
+		std::list<int> candidateIds;
+		for(std::list<int>::const_iterator iter = ids.begin(); iter!=ids.end(); ++iter)
+		{
+			if(*iter <= 0 || candidates.find(*iter) != candidates.end() || !_globalDescriptorIndex->contains(*iter))
+			{
+				candidateIds.push_back(*iter);
+			}
+		}
+		double searchTime = timer.ticks();
+		std::map<int, float> likelihood = computeWordsLikelihood(signature, candidateIds);
+		for(std::list<int>::const_iterator iter = ids.begin(); iter!=ids.end(); ++iter)
+		{
+			likelihood.insert(std::pair<int, float>(*iter, 0.0f)); // not added if already computed
+		}
+		UDEBUG("compute likelihood (%d/%d candidates from global descriptors in %f s)... %f s", (int)candidateIds.size(), (int)ids.size(), searchTime, timer.ticks());
+		return likelihood;
+	}
+	return computeWordsLikelihood(signature, ids);
+}
+
+std::map<int, float> Memory::computeWordsLikelihood(const Signature * signature, const std::list<int> & ids)
 {
 	if(!_tfIdfLikelihoodUsed)
 	{
@@ -1811,6 +2014,36 @@ std::map<int, float> Memory::computeLikelihood(const Signature * signature, cons
 			return likelihood;
 		}
 
+		// In localization fast path, count the matching words of all
+		// nodes at once using the references of the dictionary's words.
+		// Features not matching a word would have been new words (matching
+		// no other node) with the normal path, they are still counted in
+		// the total words of the node to get the same scores.
+		bool invertedIndexUsed = !_incrementalMemory && _localizationFastPath && !signature->isBadSignature();
+		std::map<int, int> pairsCount;
+		int wordsA = (int)signature->getWords().size()-signature->getInvalidWordsCount();
+		if(invertedIndexUsed && _lastFastPathUnmatchedWords.first == signature->id())
+		{
+			wordsA += _lastFastPathUnmatchedWords.second;
+		}
+		if(invertedIndexUsed)
+		{
+			const std::multimap<int, int> & words = signature->getWords();
+			for(std::multimap<int, int>::const_iterator iter=words.begin(); iter!=words.end(); iter=words.upper_bound(iter->first))
+			{
+				const VisualWord * vw = iter->first>0?_vwd->getWord(iter->first):0;
+				if(vw)
+				{
+					int count = (int)words.count(iter->first);
+					const std::map<int, int> & refs = vw->getReferences();
+					for(std::map<int, int>::const_iterator jter=refs.begin(); jter!=refs.end(); ++jter)
+					{
+						pairsCount[jter->first] += count<jter->second?count:jter->second;
+					}
+				}
+			}
+		}
+
 		for(std::list<int>::const_iterator iter = ids.begin(); iter!=ids.end(); ++iter)
 		{
 			float sim = 0.0f;
@@ -1821,7 +2054,32 @@ std::map<int, float> Memory::computeLikelihood(const Signature * signature, cons
 				{
 					UFATAL("Signature %d not found in WM ?!?", *iter);
 				}
-				sim = signature->compareTo(*sB);
+				if(invertedIndexUsed)
+				{
+					if(!sB->isBadSignature())
+					{
+						int pairs;
+						if(sB->isEnabled())
+						{
+							pairs = uValue(pairsCount, *iter, 0);
+						}
+						else
+						{
+							// references of the node are not active in the dictionary
+							std::list<std::pair<int, std::pair<int, int> > > pairsList;
+							EpipolarGeometry::findPairs(sB->getWords(), signature->getWords(), pairsList);
+							pairs = (int)pairsList.size();
+						}
+						int wordsB = (int)sB->getWords().size()-sB->getInvalidWordsCount();
+						int totalWords = wordsA>wordsB?wordsA:wordsB;
+						UASSERT(totalWords > 0);
+						sim = float(pairs) / float(totalWords);
+					}
+				}
+				else
+				{
+					sim = signature->compareTo(*sB);
+				}
 			}
 
 			likelihood.insert(likelihood.end(), std::pair<int, float>(*iter, sim));
@@ -2006,6 +2264,7 @@ std::list<int> Memory::forget(const std::set<int> & ignoredIds)
 
 int Memory::cleanup()
 {
+	UPROFILER_ZONE("Memory::cleanup");
 	UDEBUG("");
 	int signatureRemoved = 0;
 
@@ -2131,42 +2390,106 @@ void Memory::joinTrashThread()
 	}
 }
 
-class WeightAgeIdKey
+void Memory::addToWorkingMem(int id, double age, int weight)
 {
-public:
-	WeightAgeIdKey(int w, double a, int i) :
-		weight(w),
-		age(a),
-		id(i){}
-	bool operator<(const WeightAgeIdKey & k) const
+	std::pair<std::map<int, double>::iterator, bool> inserted = _workingMem.insert(std::make_pair(id, age));
+	if(inserted.second && id > 0)
 	{
-		if(weight < k.weight)
+		_transferIndexIters.insert(std::make_pair(id,
+				_transferIndex.insert(WeightAgeIdKey(weight, _transferSortingByWeightId?0.0:age, id)).first));
+		if(_globalDescriptorLikelihood > 0)
 		{
-			return true;
+			const Signature * s = _getSignature(id);
+			if(s)
+			{
+				indexGlobalDescriptor(s);
+			}
 		}
-		else if(weight == k.weight)
+		if(_recentWmBoundaryId > 0)
 		{
-			if(age < k.age)
+			if(id == _recentWmBoundaryId)
 			{
-				return true;
+				_recentWmBoundaryId = 0; // recompute
 			}
-			else if(age == k.age)
+			else if(id > _recentWmBoundaryId && _recentWmCount > 0)
 			{
-				if(id < k.id)
-				{
-					return true;
-				}
+				++_recentWmCount;
 			}
 		}
-		return false;
 	}
-	int weight, age, id;
-};
+}
+
+void Memory::removeFromWorkingMem(int id)
+{
+	if(_workingMem.erase(id) && id > 0)
+	{
+		_globalDescriptorIndex->remove(id);
+		std::map<int, std::set<WeightAgeIdKey>::iterator>::iterator iter = _transferIndexIters.find(id);
+		if(iter != _transferIndexIters.end())
+		{
+			_transferIndex.erase(iter->second);
+			_transferIndexIters.erase(iter);
+		}
+		if(_recentWmBoundaryId > 0)
+		{
+			if(id == _recentWmBoundaryId)
+			{
+				_recentWmBoundaryId = 0; // recompute
+			}
+			else if(id > _recentWmBoundaryId && _recentWmCount > 0)
+			{
+				--_recentWmCount;
+			}
+		}
+	}
+}
+
+void Memory::indexGlobalDescriptor(const Signature * s)
+{
+	UASSERT(s != 0);
+	const std::vector<GlobalDescriptor> & descriptors = s->sensorData().globalDescriptors();
+	if(!descriptors.empty() && !descriptors.front().data().empty())
+	{
+		_globalDescriptorIndex->add(s->id(), descriptors.front().data());
+	}
+}
+
+void Memory::updateWeight(Signature * s, int weight)
+{
+	UASSERT(s != 0);
+	if(s->getWeight() != weight)
+	{
+		std::map<int, std::set<WeightAgeIdKey>::iterator>::iterator iter = _transferIndexIters.find(s->id());
+		if(iter != _transferIndexIters.end())
+		{
+			WeightAgeIdKey key(weight, 0.0, s->id());
+			key.age = iter->second->age;
+			_transferIndex.erase(iter->second);
+			iter->second = _transferIndex.insert(key).first;
+		}
+	}
+	s->setWeight(weight);
+}
+
+void Memory::rebuildTransferIndex()
+{
+	_transferIndex.clear();
+	_transferIndexIters.clear();
+	for(std::map<int, double>::const_iterator iter=_workingMem.begin(); iter!=_workingMem.end(); ++iter)
+	{
+		Signature * s = iter->first>0?this->_getSignature(iter->first):0;
+		if(s)
+		{
+			_transferIndexIters.insert(_transferIndexIters.end(), std::make_pair(iter->first,
+					_transferIndex.insert(WeightAgeIdKey(s->getWeight(), _transferSortingByWeightId?0.0:iter->second, iter->first)).first));
+		}
+	}
+}
+
 std::list<Signature *> Memory::getRemovableSignatures(int count, const std::set<int> & ignoredIds)
 {
 	//UDEBUG("");
 	std::list<Signature *> removableSignatures;
-	std::map<WeightAgeIdKey, Signature *> weightAgeIdMap;
 
 	// Find the last index to check...
 	UDEBUG("mem.size()=%d, ignoredIds.size()=%d", (int)_workingMem.size(), (int)ignoredIds.size());
@@ -2179,13 +2502,20 @@ std::list<Signature *> Memory::getRemovableSignatures(int count, const std::set<
 		int currentRecentWmSize = 0;
 		if(_lastGlobalLoopClosureId > 0 && _stMem.find(_lastGlobalLoopClosureId) == _stMem.end())
 		{
-			// If set, it must be in WM
-			std::map<int, double>::const_iterator iter = _workingMem.find(_lastGlobalLoopClosureId);
-			while(iter != _workingMem.end())
+			// If set, it must be in WM. The count is then
+			// updated when nodes are added/removed from WM.
+			if(_recentWmBoundaryId != _lastGlobalLoopClosureId)
 			{
-				++currentRecentWmSize;
-				++iter;
+				_recentWmCount = 0;
+				std::map<int, double>::const_iterator iter = _workingMem.find(_lastGlobalLoopClosureId);
+				while(iter != _workingMem.end())
+				{
+					++_recentWmCount;
+					++iter;
+				}
+				_recentWmBoundaryId = _lastGlobalLoopClosureId;
 			}
+			currentRecentWmSize = _recentWmCount;
 			if(currentRecentWmSize>1 && currentRecentWmSize < recentWmMaxSize)
 			{
 				recentWmImmunized = true;
@@ -2204,63 +2534,58 @@ std::list<Signature *> Memory::getRemovableSignatures(int count, const std::set<
 			lastInSTM = _signatures.at(*_stMem.begin());
 		}
 
-		for(std::map<int, double>::const_iterator memIter = _workingMem.begin(); memIter != _workingMem.end(); ++memIter)
+		// recent memory is not removable if it was immunized before the selection
+		bool recentWmIgnored = recentWmImmunized;
+
+		int recentWmCount = 0;
+		// make the list of removable signatures, WM is already sorted by
+		// transfer priority. Criteria : Weight -> Age -> ID
+		UDEBUG("transferIndex.size()=%d _lastGlobalLoopClosureId=%d currentRecentWmSize=%d recentWmMaxSize=%d",
+				(int)_transferIndex.size(), _lastGlobalLoopClosureId, currentRecentWmSize, recentWmMaxSize);
+		for(std::set<WeightAgeIdKey>::const_iterator iter=_transferIndex.begin();
+			iter!=_transferIndex.end();
+			++iter)
 		{
-			if( (recentWmImmunized && memIter->first > _lastGlobalLoopClosureId) ||
-				memIter->first == _lastGlobalLoopClosureId)
+			int id = iter->id;
+			if( (recentWmIgnored && id > _lastGlobalLoopClosureId) ||
+				id == _lastGlobalLoopClosureId ||
+				ignoredIds.find(id) != ignoredIds.end() ||
+				(lastInSTM && lastInSTM->hasLink(id)))
 			{
-				// ignore recent memory
+				continue;
 			}
-			else if(memIter->first > 0 && ignoredIds.find(memIter->first) == ignoredIds.end() && (!lastInSTM || !lastInSTM->hasLink(memIter->first)))
+
+			Signature * s = this->_getSignature(id);
+			if(s == 0)
 			{
-				Signature * s = this->_getSignature(memIter->first);
-				if(s)
-				{
-					// Links must not be in STM to be removable, rehearsal issue
-					bool foundInSTM = false;
-					for(std::map<int, Link>::const_iterator iter = s->getLinks().begin(); iter!=s->getLinks().end(); ++iter)
-					{
-						if(_stMem.find(iter->first) != _stMem.end())
-						{
-							UDEBUG("Ignored %d because it has a link (%d) to STM", s->id(), iter->first);
-							foundInSTM = true;
-							break;
-						}
-					}
-					if(!foundInSTM)
-					{
-						// less weighted signature priority to be transferred
-						weightAgeIdMap.insert(std::make_pair(WeightAgeIdKey(s->getWeight(), _transferSortingByWeightId?0.0:memIter->second, s->id()), s));
-					}
-				}
-				else
+				ULOGGER_ERROR("Not supposed to occur!!!");
+				continue;
+			}
+
+			// Links must not be in STM to be removable, rehearsal issue
+			bool foundInSTM = false;
+			for(std::map<int, Link>::const_iterator jter = s->getLinks().begin(); jter!=s->getLinks().end(); ++jter)
+			{
+				if(_stMem.find(jter->first) != _stMem.end())
 				{
-					ULOGGER_ERROR("Not supposed to occur!!!");
+					UDEBUG("Ignored %d because it has a link (%d) to STM", s->id(), jter->first);
+					foundInSTM = true;
+					break;
 				}
 			}
-			else
+			if(foundInSTM)
 			{
-				//UDEBUG("Ignoring id %d", memIter->first);
+				continue;
 			}
-		}
 
-		int recentWmCount = 0;
-		// make the list of removable signatures
-		// Criteria : Weight -> ID
-		UDEBUG("signatureMap.size()=%d _lastGlobalLoopClosureId=%d currentRecentWmSize=%d recentWmMaxSize=%d",
-				(int)weightAgeIdMap.size(), _lastGlobalLoopClosureId, currentRecentWmSize, recentWmMaxSize);
-		for(std::map<WeightAgeIdKey, Signature*>::iterator iter=weightAgeIdMap.begin();
-			iter!=weightAgeIdMap.end();
-			++iter)
-		{
 			if(!recentWmImmunized)
 			{
 				UDEBUG("weight=%d, id=%d",
-						iter->second->getWeight(),
-						iter->second->id());
-				removableSignatures.push_back(iter->second);
+						s->getWeight(),
+						s->id());
+				removableSignatures.push_back(s);
 
-				if(_lastGlobalLoopClosureId && iter->second->id() > _lastGlobalLoopClosureId)
+				if(_lastGlobalLoopClosureId && s->id() > _lastGlobalLoopClosureId)
 				{
 					++recentWmCount;
 					if(currentRecentWmSize - recentWmCount < recentWmMaxSize)
@@ -2270,12 +2595,12 @@ std::list<Signature *> Memory::getRemovableSignatures(int count, const std::set<
 					}
 				}
 			}
-			else if(_lastGlobalLoopClosureId == 0 || iter->second->id() < _lastGlobalLoopClosureId)
+			else if(_lastGlobalLoopClosureId == 0 || s->id() < _lastGlobalLoopClosureId)
 			{
 				UDEBUG("weight=%d, id=%d",
-						iter->second->getWeight(),
-						iter->second->id());
-				removableSignatures.push_back(iter->second);
+						s->getWeight(),
+						s->id());
+				removableSignatures.push_back(s);
 			}
 			if(removableSignatures.size() >= (unsigned int)count)
 			{
@@ -2337,6 +2662,7 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 			UASSERT_MSG(this->isInSTM(s->id()),
 						uFormat("Deleting location (%d) outside the "
 								"STM is not implemented!", s->id()).c_str());
+			updateGraphRevision(*s);
 			const std::multimap<int, Link> & links = s->getLinks();
 			for(std::multimap<int, Link>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
 			{
@@ -2359,7 +2685,7 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 					// child
 					if(iter->second.type() == Link::kGlobalClosure && s->id() > sTo->id())
 					{
-						sTo->setWeight(sTo->getWeight() + s->getWeight()); // copy weight
+						updateWeight(sTo, sTo->getWeight() + s->getWeight()); // copy weight
 					}
 
 					sTo->removeLink(s->id());
@@ -2368,7 +2694,7 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 			}
 			s->removeLinks(true); // remove all links, but keep self referring link
 			s->removeLandmarks(); // remove all landmarks
-			s->setWeight(-9); // invalid
+			updateWeight(s, -9); // invalid
 			s->setLabel(""); // reset label
 		}
 		else
@@ -2401,7 +2727,7 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 			}
 		}
 
-		_workingMem.erase(s->id());
+		removeFromWorkingMem(s->id());
 		_stMem.erase(s->id());
 		_signatures.erase(s->id());
 		_groundTruths.erase(s->id());
@@ -2437,6 +2763,7 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 			{
 				_allNodesInWM = false;
 			}
+			updateLtmTopology(*s);
 			_dbDriver->asyncSave(s);
 		}
 		else
@@ -2446,6 +2773,258 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 	}
 }
 
+void Memory::loadLtmTopology()
+{
+	if(_ltmTopologyLoaded)
+	{
+		UDEBUG("Topology already loaded");
+		return;
+	}
+	clearLtmTopology();
+	if(_dbDriver && _dbDriver->isConnected())
+	{
+		UTimer timer;
+		std::multimap<int, std::pair<int, Link::Type> > links;
+		_dbDriver->getAllLinkTypes(links, true);
+		_ltmTopologyNeighbors.reserve(links.size());
+		_ltmTopologyTypes.reserve(links.size());
+		// links are sorted by "from" id
+		for(std::multimap<int, std::pair<int, Link::Type> >::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
+		{
+			if(iter->first == iter->second.first)
+			{
+				// ignore self-referring links
+				continue;
+			}
+			if(_ltmTopologyIds.empty() || _ltmTopologyIds.back() != iter->first)
+			{
+				_ltmTopologyIds.push_back(iter->first);
+				_ltmTopologyOffsets.push_back((unsigned int)_ltmTopologyNeighbors.size());
+			}
+			_ltmTopologyNeighbors.push_back(iter->second.first);
+			_ltmTopologyTypes.push_back((unsigned char)iter->second.second);
+		}
+		_ltmTopologyOffsets.push_back((unsigned int)_ltmTopologyNeighbors.size());
+		_ltmTopologyLoaded = true;
+		UINFO("Loaded topology of %d nodes (%d links) in %fs",
+				(int)_ltmTopologyIds.size(), (int)_ltmTopologyNeighbors.size(), timer.ticks());
+	}
+}
+
+void Memory::clearLtmTopology()
+{
+	_ltmTopologyLoaded = false;
+	_ltmTopologyIds = std::vector<int>();
+	_ltmTopologyOffsets = std::vector<unsigned int>();
+	_ltmTopologyNeighbors = std::vector<int>();
+	_ltmTopologyTypes = std::vector<unsigned char>();
+	_ltmTopologyUpdated.clear();
+}
+
+// Merge modified rows back in the compact arrays
+void Memory::compactLtmTopology()
+{
+	if(_ltmTopologyUpdated.size() < 1000 || _ltmTopologyUpdated.size() < _ltmTopologyIds.size()/4)
+	{
+		return;
+	}
+
+	UTimer timer;
+	std::vector<int> ids;
+	std::vector<unsigned int> offsets;
+	std::vector<int> neighbors;
+	std::vector<unsigned char> types;
+	ids.reserve(_ltmTopologyIds.size() + _ltmTopologyUpdated.size());
+	offsets.reserve(ids.capacity()+1);
+	neighbors.reserve(_ltmTopologyNeighbors.size());
+	types.reserve(_ltmTopologyTypes.size());
+
+	size_t i=0;
+	std::map<int, std::vector<std::pair<int, unsigned char> > >::const_iterator iter=_ltmTopologyUpdated.begin();
+	while(i<_ltmTopologyIds.size() || iter!=_ltmTopologyUpdated.end())
+	{
+		if(iter==_ltmTopologyUpdated.end() || (i<_ltmTopologyIds.size() && _ltmTopologyIds[i] < iter->first))
+		{
+			ids.push_back(_ltmTopologyIds[i]);
+			offsets.push_back((unsigned int)neighbors.size());
+			for(unsigned int k=_ltmTopologyOffsets[i]; k<_ltmTopologyOffsets[i+1]; ++k)
+			{
+				neighbors.push_back(_ltmTopologyNeighbors[k]);
+				types.push_back(_ltmTopologyTypes[k]);
+			}
+			++i;
+		}
+		else
+		{
+			if(i<_ltmTopologyIds.size() && _ltmTopologyIds[i] == iter->first)
+			{
+				// replaced by the modified row
+				++i;
+			}
+			if(!iter->second.empty())
+			{
+				ids.push_back(iter->first);
+				offsets.push_back((unsigned int)neighbors.size());
+				for(size_t k=0; k<iter->second.size(); ++k)
+				{
+					neighbors.push_back(iter->second[k].first);
+					types.push_back(iter->second[k].second);
+				}
+			}
+			++iter;
+		}
+	}
+	offsets.push_back((unsigned int)neighbors.size());
+
+	UDEBUG("Compacted topology (%d modified nodes) in %fs", (int)_ltmTopologyUpdated.size(), timer.ticks());
+	_ltmTopologyIds.swap(ids);
+	_ltmTopologyOffsets.swap(offsets);
+	_ltmTopologyNeighbors.swap(neighbors);
+	_ltmTopologyTypes.swap(types);
+	_ltmTopologyUpdated.clear();
+}
+
+// Return false if the topology is not cached
+bool Memory::getLtmTopology(int id, bool withLandmarks, std::vector<std::pair<int, Link::Type> > & neighbors, std::vector<int> & landmarks) const
+{
+	if(!_ltmTopologyLoaded)
+	{
+		return false;
+	}
+
+	std::map<int, std::vector<std::pair<int, unsigned char> > >::const_iterator iter = _ltmTopologyUpdated.find(id);
+	if(iter != _ltmTopologyUpdated.end())
+	{
+		for(size_t k=0; k<iter->second.size(); ++k)
+		{
+			if(iter->second[k].first < 0)
+			{
+				if(withLandmarks)
+				{
+					landmarks.push_back(iter->second[k].first);
+				}
+			}
+			else
+			{
+				neighbors.push_back(std::make_pair(iter->second[k].first, (Link::Type)iter->second[k].second));
+			}
+		}
+	}
+	else
+	{
+		std::vector<int>::const_iterator jter = std::lower_bound(_ltmTopologyIds.begin(), _ltmTopologyIds.end(), id);
+		if(jter != _ltmTopologyIds.end() && *jter == id)
+		{
+			size_t i = jter - _ltmTopologyIds.begin();
+			for(unsigned int k=_ltmTopologyOffsets[i]; k<_ltmTopologyOffsets[i+1]; ++k)
+			{
+				if(_ltmTopologyNeighbors[k] < 0)
+				{
+					if(withLandmarks)
+					{
+						landmarks.push_back(_ltmTopologyNeighbors[k]);
+					}
+				}
+				else
+				{
+					neighbors.push_back(std::make_pair(_ltmTopologyNeighbors[k], (Link::Type)_ltmTopologyTypes[k]));
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// Set the topology of a node saved to database
+void Memory::updateLtmTopology(const Signature & s)
+{
+	if(!_ltmTopologyLoaded)
+	{
+		return;
+	}
+	std::vector<std::pair<int, unsigned char> > & row = _ltmTopologyUpdated[s.id()];
+	row.clear();
+	row.reserve(s.getLinks().size() + s.getLandmarks().size());
+	for(std::multimap<int, Link>::const_iterator iter=s.getLinks().begin(); iter!=s.getLinks().end(); ++iter)
+	{
+		if(iter->second.from() != iter->second.to())
+		{
+			row.push_back(std::make_pair(iter->first, (unsigned char)iter->second.type()));
+		}
+	}
+	for(std::map<int, Link>::const_iterator iter=s.getLandmarks().begin(); iter!=s.getLandmarks().end(); ++iter)
+	{
+		row.push_back(std::make_pair(iter->first, (unsigned char)iter->second.type()));
+	}
+	compactLtmTopology();
+}
+
+// Add or update a link of a node in database
+void Memory::updateLtmTopology(const Link & link)
+{
+	if(!_ltmTopologyLoaded || link.from() == link.to())
+	{
+		return;
+	}
+	std::map<int, std::vector<std::pair<int, unsigned char> > >::iterator iter = _ltmTopologyUpdated.find(link.from());
+	if(iter == _ltmTopologyUpdated.end())
+	{
+		// copy the compact row before modifying it
+		std::vector<std::pair<int, unsigned char> > row;
+		std::vector<int>::const_iterator jter = std::lower_bound(_ltmTopologyIds.begin(), _ltmTopologyIds.end(), link.from());
+		if(jter != _ltmTopologyIds.end() && *jter == link.from())
+		{
+			size_t i = jter - _ltmTopologyIds.begin();
+			for(unsigned int k=_ltmTopologyOffsets[i]; k<_ltmTopologyOffsets[i+1]; ++k)
+			{
+				row.push_back(std::make_pair(_ltmTopologyNeighbors[k], _ltmTopologyTypes[k]));
+			}
+		}
+		iter = _ltmTopologyUpdated.insert(std::make_pair(link.from(), row)).first;
+	}
+	bool found = false;
+	for(size_t k=0; k<iter->second.size() && !found; ++k)
+	{
+		if(iter->second[k].first == link.to())
+		{
+			iter->second[k].second = (unsigned char)link.type();
+			found = true;
+		}
+	}
+	if(!found)
+	{
+		iter->second.push_back(std::make_pair(link.to(), (unsigned char)link.type()));
+	}
+	compactLtmTopology();
+}
+
+unsigned int Memory::getGraphRevision(int id) const
+{
+	std::map<int, unsigned int>::const_iterator iter = _nodeRevisions.find(id);
+	return iter!=_nodeRevisions.end()?iter->second:0;
+}
+
+void Memory::updateGraphRevision(int id)
+{
+	_nodeRevisions[id] = ++_graphRevision;
+}
+
+void Memory::updateGraphRevision(const Signature & s)
+{
+	updateGraphRevision(s.id());
+	for(std::multimap<int, Link>::const_iterator iter=s.getLinks().begin(); iter!=s.getLinks().end(); ++iter)
+	{
+		if(iter->first != s.id())
+		{
+			updateGraphRevision(iter->first);
+		}
+	}
+	for(std::map<int, Link>::const_iterator iter=s.getLandmarks().begin(); iter!=s.getLandmarks().end(); ++iter)
+	{
+		updateGraphRevision(iter->first);
+	}
+}
+
 int Memory::getLastSignatureId() const
 {
 	return _idCount;
@@ -2611,13 +3190,15 @@ void Memory::removeLink(int oldId, int newId)
 			if(type == Link::kGlobalClosure && newS->getWeight() > 0)
 			{
 				// adjust the weight
-				oldS->setWeight(oldS->getWeight()+1);
-				newS->setWeight(newS->getWeight()>0?newS->getWeight()-1:0);
+				updateWeight(oldS, oldS->getWeight()+1);
+				updateWeight(newS, newS->getWeight()>0?newS->getWeight()-1:0);
 			}
 
 
 			oldS->removeLink(newS->id());
 			newS->removeLink(oldS->id());
+			updateGraphRevision(oldS->id());
+			updateGraphRevision(newS->id());
 
 			if(type!=Link::kVirtualClosure)
 			{
@@ -2709,6 +3290,7 @@ Transform Memory::computeTransform(
 		RegistrationInfo * info,
 		bool useKnownCorrespondencesIfPossible) const
 {
+	UPROFILER_ZONE("Memory::computeTransform");
 	UDEBUG("");
 	Transform transform;
 
@@ -3007,6 +3589,7 @@ Transform Memory::computeIcpTransformMulti(
 		const std::map<int, Transform> & poses,
 		RegistrationInfo * info)
 {
+	UPROFILER_ZONE("Memory::computeIcpTransformMulti");
 	UASSERT(uContains(poses, fromId) && uContains(_signatures, fromId));
 	UASSERT(uContains(poses, toId) && uContains(_signatures, toId));
 
@@ -3239,13 +3822,13 @@ bool Memory::addLink(const Link & link, bool addInDatabase)
 					if((_reduceGraph && fromS->id() < toS->id()) ||
 					   (!_reduceGraph && fromS->id() > toS->id()))
 					{
-						fromS->setWeight(fromS->getWeight() + toS->getWeight());
-						toS->setWeight(0);
+						updateWeight(fromS, fromS->getWeight() + toS->getWeight());
+						updateWeight(toS, 0);
 					}
 					else
 					{
-						toS->setWeight(toS->getWeight() + fromS->getWeight());
-						fromS->setWeight(0);
+						updateWeight(toS, toS->getWeight() + fromS->getWeight());
+						updateWeight(fromS, 0);
 					}
 				}
 			}
@@ -3268,11 +3851,13 @@ bool Memory::addLink(const Link & link, bool addInDatabase)
 		UDEBUG("Add link between %d and %d (db)", link.from(), link.to());
 		fromS->addLink(link);
 		_dbDriver->addLink(link.inverse());
+		updateLtmTopology(link.inverse());
 	}
 	else if(toS)
 	{
 		UDEBUG("Add link between %d (db) and %d", link.from(), link.to());
 		_dbDriver->addLink(link);
+		updateLtmTopology(link);
 		toS->addLink(link.inverse());
 	}
 	else
@@ -3280,7 +3865,11 @@ bool Memory::addLink(const Link & link, bool addInDatabase)
 		UDEBUG("Add link between %d (db) and %d (db)", link.from(), link.to());
 		_dbDriver->addLink(link);
 		_dbDriver->addLink(link.inverse());
+		updateLtmTopology(link);
+		updateLtmTopology(link.inverse());
 	}
+	updateGraphRevision(link.from());
+	updateGraphRevision(link.to());
 	return true;
 }
 
@@ -3328,6 +3917,7 @@ void Memory::updateLink(const Link & link, bool updateInDatabase)
 		fromS->removeLink(link.to());
 		fromS->addLink(link);
 		_dbDriver->updateLink(link.inverse());
+		updateLtmTopology(link.inverse());
 	}
 	else if(toS)
 	{
@@ -3335,13 +3925,18 @@ void Memory::updateLink(const Link & link, bool updateInDatabase)
 		toS->removeLink(link.from());
 		toS->addLink(link.inverse());
 		_dbDriver->updateLink(link);
+		updateLtmTopology(link);
 	}
 	else
 	{
 		UDEBUG("Update link between %d (db) and %d (db)", link.from(), link.to());
 		_dbDriver->updateLink(link);
 		_dbDriver->updateLink(link.inverse());
+		updateLtmTopology(link);
+		updateLtmTopology(link.inverse());
 	}
+	updateGraphRevision(link.from());
+	updateGraphRevision(link.to());
 }
 
 void Memory::removeAllVirtualLinks()
@@ -3349,7 +3944,11 @@ void Memory::removeAllVirtualLinks()
 	UDEBUG("");
 	for(std::map<int, Signature*>::iterator iter=_signatures.begin(); iter!=_signatures.end(); ++iter)
 	{
-		iter->second->removeVirtualLinks();
+		if(iter->second->hasLink(0, Link::kVirtualClosure))
+		{
+			updateGraphRevision(iter->first);
+			iter->second->removeVirtualLinks();
+		}
 	}
 }
 
@@ -3368,6 +3967,8 @@ void Memory::removeVirtualLinks(int signatureId)
 				if(sTo)
 				{
 					sTo->removeLink(s->id());
+					updateGraphRevision(sTo->id());
+					updateGraphRevision(s->id());
 				}
 				else
 				{
@@ -3400,6 +4001,18 @@ void Memory::dumpDictionary(const char * fileNameRef, const char * fileNameDesc)
 	}
 }
 
+bool Memory::saveLocalizationSnapshot(const std::string & path) const
+{
+	if(!_dbDriver || !_dbDriver->isConnected())
+	{
+		UERROR("A database should be opened to save a localization snapshot.");
+		return false;
+	}
+	bool loadAllNodesInWM = Parameters::defaultMemInitWMWithAllNodes();
+	Parameters::parse(parameters_, Parameters::kMemInitWMWithAllNodes(), loadAllNodesInWM);
+	return LocalizationSnapshot::save(path, *_dbDriver, _signatures, *_vwd, loadAllNodesInWM);
+}
+
 void Memory::dumpSignatures(const char * fileNameSign, bool words3D) const
 {
 	UDEBUG("");
@@ -3522,8 +4135,11 @@ unsigned long Memory::getMemoryUsed() const
 	{
 		memoryUsage += _vwd->getMemoryUsed();
 	}
+	memoryUsage += _globalDescriptorIndex->memoryUsed();
 	memoryUsage += _stMem.size() * (sizeof(int)+sizeof(std::set<int>::iterator)) + sizeof(std::set<int>);
 	memoryUsage += _workingMem.size() * (sizeof(int)+sizeof(double)+sizeof(std::map<int, double>::iterator)) + sizeof(std::map<int, double>);
+	memoryUsage += _transferIndex.size() * (sizeof(WeightAgeIdKey)+sizeof(std::set<WeightAgeIdKey>::iterator)) + sizeof(std::set<WeightAgeIdKey>);
+	memoryUsage += _transferIndexIters.size() * (sizeof(int)+sizeof(std::set<WeightAgeIdKey>::iterator)+sizeof(std::map<int, std::set<WeightAgeIdKey>::iterator>::iterator)) + sizeof(std::map<int, std::set<WeightAgeIdKey>::iterator>);
 	memoryUsage += _groundTruths.size() * (sizeof(int)+sizeof(Transform)+12*sizeof(float) + sizeof(std::map<int, Transform>::iterator)) + sizeof(std::map<int, Transform>);
 	memoryUsage += _labels.size() * (sizeof(int)+sizeof(std::string) + sizeof(std::map<int, std::string>::iterator)) + sizeof(std::map<int, std::string>);
 	for(std::map<int, std::string>::const_iterator iter=_labels.begin(); iter!=_labels.end(); ++iter)
@@ -3540,6 +4156,13 @@ unsigned long Memory::getMemoryUsed() const
 	{
 		memoryUsage+=iter->second.size()*(sizeof(int)+sizeof(std::set<int>::iterator)) + sizeof(std::set<int>);
 	}
+	memoryUsage += _ltmTopologyIds.size()*sizeof(int) + _ltmTopologyOffsets.size()*sizeof(unsigned int);
+	memoryUsage += _ltmTopologyNeighbors.size()*sizeof(int) + _ltmTopologyTypes.size()*sizeof(unsigned char);
+	memoryUsage += _ltmTopologyUpdated.size() * (sizeof(int)+sizeof(std::vector<std::pair<int, unsigned char> >) + sizeof(std::map<int, std::vector<std::pair<int, unsigned char> > >::iterator)) + sizeof(std::map<int, std::vector<std::pair<int, unsigned char> > >);
+	for(std::map<int, std::vector<std::pair<int, unsigned char> > >::const_iterator iter=_ltmTopologyUpdated.begin(); iter!=_ltmTopologyUpdated.end(); ++iter)
+	{
+		memoryUsage+=iter->second.capacity()*sizeof(std::pair<int, unsigned char>);
+	}
 	memoryUsage += parameters_.size()*(sizeof(std::string)*2+sizeof(ParametersMap::iterator)) + sizeof(ParametersMap);
 	memoryUsage += sizeof(Feature2D) + _feature2D->getParameters().size()*(sizeof(std::string)*2+sizeof(ParametersMap::iterator)) + sizeof(ParametersMap);
 	memoryUsage += sizeof(Registration);
@@ -3553,6 +4176,7 @@ unsigned long Memory::getMemoryUsed() const
 
 void Memory::rehearsal(Signature * signature, Statistics * stats)
 {
+	UPROFILER_ZONE("Memory::rehearsal");
 	UTimer timer;
 	if(signature->isBadSignature())
 	{
@@ -3592,7 +4216,7 @@ void Memory::rehearsal(Signature * signature, Statistics * stats)
 			}
 			else
 			{
-				signature->setWeight(signature->getWeight() + 1 + sB->getWeight());
+				updateWeight(signature, signature->getWeight() + 1 + sB->getWeight());
 			}
 		}
 
@@ -3663,6 +4287,9 @@ bool Memory::rehearsalMerge(int oldId, int newId)
 
 		if(fullMerge)
 		{
+			updateGraphRevision(*oldS);
+			updateGraphRevision(*newS);
+
 			//remove mutual links
 			Link newToOldLink = newS->getLinks().find(oldS->id())->second;
 			oldS->removeLink(newId);
@@ -3704,26 +4331,26 @@ bool Memory::rehearsalMerge(int oldId, int newId)
 				this->copyData(oldS, newS);
 
 				// update weight
-				newS->setWeight(newS->getWeight() + 1 + oldS->getWeight());
+				updateWeight(newS, newS->getWeight() + 1 + oldS->getWeight());
 
 				if(_lastGlobalLoopClosureId == oldS->id())
 				{
 					_lastGlobalLoopClosureId = newS->id();
 				}
-				oldS->setWeight(-9);
+				updateWeight(oldS, -9);
 			}
 			else
 			{
 				newS->addLink(Link(newS->id(), oldS->id(), Link::kGlobalClosure, Transform() , cv::Mat::eye(6,6,CV_64FC1))); // to keep track of the merged location
 
 				// update weight
-				oldS->setWeight(newS->getWeight() + 1 + oldS->getWeight());
+				updateWeight(oldS, newS->getWeight() + 1 + oldS->getWeight());
 
 				if(_lastSignature == newS)
 				{
 					_lastSignature = oldS;
 				}
-				newS->setWeight(-9);
+				updateWeight(newS, -9);
 			}
 
 			// remove location
@@ -3738,8 +4365,8 @@ bool Memory::rehearsalMerge(int oldId, int newId)
 			{
 				// just update weight
 				int w = oldS->getWeight()>=0?oldS->getWeight():0;
-				newS->setWeight(w + newS->getWeight() + 1);
-				oldS->setWeight(intermediateMerge?-1:0); // convert to intermediate node
+				updateWeight(newS, w + newS->getWeight() + 1);
+				updateWeight(oldS, intermediateMerge?-1:0); // convert to intermediate node
 
 				if(_lastGlobalLoopClosureId == oldS->id())
 				{
@@ -3749,8 +4376,8 @@ bool Memory::rehearsalMerge(int oldId, int newId)
 			else // !_idUpdatedToNewOneRehearsal
 			{
 				int w = newS->getWeight()>=0?newS->getWeight():0;
-				oldS->setWeight(w + oldS->getWeight() + 1);
-				newS->setWeight(intermediateMerge?-1:0); // convert to intermediate node
+				updateWeight(oldS, w + oldS->getWeight() + 1);
+				updateWeight(newS, intermediateMerge?-1:0); // convert to intermediate node
 			}
 		}
 	}
@@ -4084,6 +4711,7 @@ private:
 
 Signature * Memory::createSignature(const SensorData & inputData, const Transform & pose, Statistics * stats)
 {
+	UPROFILER_ZONE("Memory::createSignature");
 	UDEBUG("");
 	SensorData data = inputData;
 	UASSERT(data.imageRaw().empty() ||
@@ -4121,6 +4749,9 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 
 	PreUpdateThread preUpdateThread(_vwd);
 
+	// In localization mode, the new node is removed after being processed
+	bool localizationFastPath = !_incrementalMemory && _localizationFastPath;
+
 	UTimer timer;
 	timer.start();
 	float t;
@@ -4680,17 +5311,36 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 		}
 
 		// Quantization to vocabulary
-		wordIds = _vwd->addNewWords(descriptorsForQuantization, id);
+		if(localizationFastPath)
+		{
+			// The dictionary is not modified, features not matching a word get a negative ID.
+			// They are counted to compute the likelihood like the normal path
+			// would with the new words created for them (see computeLikelihood()).
+			wordIds = uVectorToList(_vwd->findNN(descriptorsForQuantization));
+			int unmatched = 0;
+			for(std::list<int>::iterator iter=wordIds.begin(); iter!=wordIds.end(); ++iter)
+			{
+				if(*iter <= 0)
+				{
+					++unmatched;
+				}
+			}
+			_lastFastPathUnmatchedWords = std::make_pair(id, unmatched);
+		}
+		else
+		{
+			wordIds = _vwd->addNewWords(descriptorsForQuantization, id);
+		}
 
 		// Set ID -1 to features not used for quantization
-		if(wordIds.size() < keypoints.size())
+		if(wordIds.size() < keypoints.size() || localizationFastPath)
 		{
 			std::vector<int> allWordIds;
 			allWordIds.resize(keypoints.size(),-1);
 			int i=0;
 			for(std::list<int>::iterator iter=wordIds.begin(); iter!=wordIds.end(); ++iter)
 			{
-				allWordIds[quantizedToRawIndices[i]] = *iter;
+				allWordIds[quantizedToRawIndices.empty()?i:quantizedToRawIndices[i]] = *iter>0?*iter:-1;
 				++i;
 			}
 			int negIndex = -1;
@@ -5012,7 +5662,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 	}
 
 	Signature * s;
-	if(this->isBinDataKept() && (!isIntermediateNode || _saveIntermediateNodeData))
+	if(this->isBinDataKept() && (!isIntermediateNode || _saveIntermediateNodeData) && !(localizationFastPath && !_localizationDataSaved))
 	{
 		UDEBUG("Bin data kept: rgb=%d, depth=%d, scan=%d, userData=%d",
 				image.empty()?0:1,
@@ -5133,7 +5783,11 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 		// just compress user data and laser scan (scans can be used for local scan matching)
 		cv::Mat compressedScan;
 		cv::Mat compressedUserData;
-		if(_compressionParallelized)
+		if(localizationFastPath && !_localizationDataSaved)
+		{
+			UDEBUG("Localization fast path: only raw data is kept");
+		}
+		else if(_compressionParallelized)
 		{
 			rtabmap::CompressionThread ctUserData(data.userDataRaw());
 			rtabmap::CompressionThread ctLaserScan(laserScan.data());
@@ -5231,7 +5885,7 @@ Signature * Memory::createSignature(const SensorData & inputData, const Transfor
 	t = timer.ticks();
 	if(stats) stats->addStatistic(Statistics::kTimingMemCompressing_data(), t*1000.0f);
 	UDEBUG("time compressing data (id=%d) %fs", id, t);
-	if(words.size())
+	if(words.size() && !localizationFastPath)
 	{
 		s->setEnabled(true); // All references are already activated in the dictionary at this point (see _vwd->addNewWords())
 	}
@@ -44,6 +44,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/utilite/UTimer.h"
 #include "rtabmap/utilite/UConversion.h"
 #include "rtabmap/utilite/UProcessInfo.h"
+#include "rtabmap/utilite/UProfiler.h"
+#include "rtabmap/utilite/UThread.h"
 #include "rtabmap/core/ParticleFilter.h"
 #include "rtabmap/core/util2d.h"
 
@@ -123,6 +125,10 @@ Odometry::Odometry(const rtabmap::ParametersMap & parameters) :
 		_alignWithGround(Parameters::defaultOdomAlignWithGround()),
 		_publishRAMUsage(Parameters::defaultRtabmapPublishRAMUsage()),
 		_imagesAlreadyRectified(Parameters::defaultRtabmapImagesAlreadyRectified()),
+		_traceFrames(Parameters::defaultOdomTraceFrames()),
+		_traceFrameCount(0),
+		_traceExported(0),
+		_traceEnabled(false),
 		_pose(Transform::getIdentity()),
 		_resetCurrentCount(0),
 		previousStamp_(0),
@@ -152,6 +158,12 @@ Odometry::Odometry(const rtabmap::ParametersMap & parameters) :
 	Parameters::parse(parameters, Parameters::kOdomAlignWithGround(), _alignWithGround);
 	Parameters::parse(parameters, Parameters::kRtabmapPublishRAMUsage(), _publishRAMUsage);
 	Parameters::parse(parameters, Parameters::kRtabmapImagesAlreadyRectified(), _imagesAlreadyRectified);
+	Parameters::parse(parameters, Parameters::kOdomTraceFrames(), _traceFrames);
+	if(_traceFrames > 0)
+	{
+		UProfiler::setEnabled(true);
+		_traceEnabled = true;
+	}
 
 	if(_imageDecimation == 0)
 	{
@@ -182,12 +194,33 @@ Odometry::Odometry(const rtabmap::ParametersMap & parameters) :
 
 Odometry::~Odometry()
 {
+	exportTrace();
+	if(_traceEnabled)
+	{
+		UProfiler::setEnabled(false);
+		for(std::set<unsigned long>::iterator iter=_traceThreads.begin(); iter!=_traceThreads.end(); ++iter)
+		{
+			UProfiler::setThreadOwned(*iter, false);
+		}
+		_traceThreads.clear();
+	}
 	for(unsigned int i=0; i<particleFilters_.size(); ++i)
 	{
 		delete particleFilters_[i];
 	}
 }
 
+void Odometry::exportTrace()
+{
+	if(_traceFrameCount > 0)
+	{
+		std::string path = uFormat("odom_trace_%d", _traceExported++);
+		// Only zones of our threads, mapping can be traced at the same time in other threads
+		UProfiler::exportTrace(path+".json", path+".folded", true, &_traceThreads);
+		_traceFrameCount = 0;
+	}
+}
+
 void Odometry::reset(const Transform & initialPose)
 {
 	UASSERT(!initialPose.isNull());
@@ -282,6 +315,20 @@ Transform Odometry::process(SensorData & data, OdometryInfo * info)
 
 Transform Odometry::process(SensorData & data, const Transform & guessIn, OdometryInfo * info)
 {
+	if(_traceFrames > 0)
+	{
+		if(_traceFrameCount >= _traceFrames)
+		{
+			exportTrace();
+		}
+		++_traceFrameCount;
+		if(_traceThreads.insert(UThread::currentThreadId()).second)
+		{
+			UProfiler::setThreadOwned(UThread::currentThreadId(), true);
+		}
+	}
+	UPROFILER_ZONE("Odometry::process");
+
 	UASSERT_MSG(data.id() >= 0, uFormat("Input data should have ID greater or equal than 0 (id=%d)!", data.id()).c_str());
 
 	if(!_imagesAlreadyRectified && !this->canProcessRawImages() && !data.imageRaw().empty())
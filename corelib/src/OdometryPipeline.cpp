@@ -0,0 +1,303 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/OdometryPipeline.h"
+#include "rtabmap/core/CameraThread.h"
+#include "rtabmap/core/Camera.h"
+#include "rtabmap/core/Odometry.h"
+#include "rtabmap/core/OdometryEvent.h"
+#include <rtabmap/utilite/UThread.h>
+#include <rtabmap/utilite/ULogger.h>
+
+namespace rtabmap {
+
+class OdometryPipelineStage : public UThread
+{
+public:
+	OdometryPipelineStage(OdometryPipeline * pipeline, bool odometry) : pipeline_(pipeline), odometry_(odometry) {}
+	virtual ~OdometryPipelineStage() {this->join(true);}
+protected:
+	virtual void mainLoopKill()
+	{
+		pipeline_->wakeUp();
+	}
+	virtual void mainLoop()
+	{
+		if(!(odometry_?pipeline_->processOdometry():pipeline_->acquire()))
+		{
+			this->kill();
+		}
+	}
+private:
+	OdometryPipeline * pipeline_;
+	bool odometry_;
+};
+
+OdometryPipeline::OdometryPipeline(CameraThread * camera, Odometry * odometry, int queueSize, bool maxSpeed) :
+	_camera(camera),
+	_odometry(odometry),
+	_queueSize(queueSize),
+	_maxSpeed(maxSpeed),
+	_framesSkipped(0),
+	_laserScanRegenerated(false),
+	_acquisitionThread(0),
+	_odometryThread(0),
+	_stopping(false),
+	_finished(false),
+	_droppedFrames(0),
+	_waitingTime(0.0)
+{
+	UASSERT(_camera != 0 && _camera->camera() != 0);
+	UASSERT(_queueSize > 0);
+	_busyTime[0] = _busyTime[1] = 0.0;
+	for(int i=0; i<2; ++i)
+	{
+		_queuesFree[i].release(_queueSize);
+	}
+	_acquisitionThread = new OdometryPipelineStage(this, false);
+	_odometryThread = new OdometryPipelineStage(this, true);
+}
+
+OdometryPipeline::~OdometryPipeline()
+{
+	stop();
+	delete _acquisitionThread;
+	delete _odometryThread;
+	for(int i=0; i<2; ++i)
+	{
+		for(std::list<Frame*>::iterator iter=_queues[i].begin(); iter!=_queues[i].end(); ++iter)
+		{
+			delete *iter;
+		}
+	}
+}
+
+void OdometryPipeline::start()
+{
+	_timer.restart();
+	_odometryThread->start();
+	_acquisitionThread->start();
+}
+
+void OdometryPipeline::stop()
+{
+	_queuesMutex.lock();
+	_stopping = true;
+	_queuesMutex.unlock();
+	_acquisitionThread->join(true);
+	_odometryThread->join(true);
+}
+
+bool OdometryPipeline::take(Frame & frame)
+{
+	if(_finished)
+	{
+		return false;
+	}
+	UTimer timer;
+	Frame * f = 0;
+	bool popped = pop(1, f);
+	_timeMutex.lock();
+	_waitingTime += timer.ticks();
+	_timeMutex.unlock();
+	if(!popped || f == 0)
+	{
+		_finished = true;
+		return false;
+	}
+	frame = *f;
+	delete f;
+	return true;
+}
+
+std::map<std::string, float> OdometryPipeline::getUtilization() const
+{
+	std::map<std::string, float> utilization;
+	_timeMutex.lock();
+	double elapsed = _timer.elapsed();
+	if(elapsed > 0.0)
+	{
+		utilization.insert(std::make_pair("Acquisition", float(_busyTime[0]/elapsed)));
+		utilization.insert(std::make_pair("Odometry", float(_busyTime[1]/elapsed)));
+		utilization.insert(std::make_pair("Mapping", float((elapsed-_waitingTime)/elapsed)));
+	}
+	_timeMutex.unlock();
+	return utilization;
+}
+
+// Acquisition thread
+bool OdometryPipeline::acquire()
+{
+	UTimer busyTimer;
+	UTimer timer;
+	CameraInfo info;
+	SensorData data = _camera->camera()->takeImage(&info);
+	for(int i=0; i<_framesSkipped && data.isValid(); ++i)
+	{
+		info = CameraInfo();
+		timer.restart();
+		data = _camera->camera()->takeImage(&info);
+	}
+	Frame * frame = 0;
+	if(data.isValid())
+	{
+		if(_laserScanRegenerated)
+		{
+			data.setLaserScan(LaserScan());
+		}
+		_camera->postUpdate(&data, &info);
+		info.timeTotal = timer.ticks();
+		frame = new Frame();
+		frame->data = data;
+		frame->cameraInfo = info;
+	}
+	_timeMutex.lock();
+	_busyTime[0] += busyTimer.elapsed();
+	_timeMutex.unlock();
+
+	push(0, frame);
+	return frame != 0;
+}
+
+// Odometry thread
+bool OdometryPipeline::processOdometry()
+{
+	Frame * frame = 0;
+	if(!pop(0, frame))
+	{
+		return false;
+	}
+	if(frame)
+	{
+		UTimer timer;
+		if(_odometry)
+		{
+			frame->pose = _odometry->process(frame->data, &frame->odomInfo);
+			frame->covariance = frame->odomInfo.reg.covariance;
+			OdometryEvent e(SensorData(), Transform(), frame->odomInfo);
+			frame->velocity = e.velocity();
+		}
+		else
+		{
+			frame->pose = frame->cameraInfo.odomPose;
+			frame->covariance = frame->cameraInfo.odomCovariance;
+			frame->velocity = frame->cameraInfo.odomVelocity;
+		}
+		_timeMutex.lock();
+		_busyTime[1] += timer.ticks();
+		_timeMutex.unlock();
+	}
+	push(1, frame);
+	return frame != 0;
+}
+
+void OdometryPipeline::push(int queue, Frame * frame)
+{
+	if(!_maxSpeed && queue == 1)
+	{
+		// never wait for mapping, drop the oldest frame instead. Frames on which
+		// odometry has been reset (high covariance) are kept, as mapping
+		// should start a new map on them.
+		bool dropped = false;
+		_queuesMutex.lock();
+		if(frame && (int)_queues[queue].size() >= _queueSize)
+		{
+			for(std::list<Frame*>::iterator iter=_queues[queue].begin(); iter!=_queues[queue].end(); ++iter)
+			{
+				if(*iter == 0)
+				{
+					break;
+				}
+				if((*iter)->covariance.empty() || (*iter)->covariance.at<double>(0,0) < 9999)
+				{
+					delete *iter;
+					_queues[queue].erase(iter);
+					++_droppedFrames;
+					dropped = true;
+					break;
+				}
+			}
+		}
+		_queues[queue].push_back(frame);
+		_queuesMutex.unlock();
+		if(!dropped)
+		{
+			_queuesReady[queue].release();
+		}
+		return;
+	}
+
+	// wait for a free slot
+	_queuesFree[queue].acquire();
+	_queuesMutex.lock();
+	_queues[queue].push_back(frame);
+	_queuesMutex.unlock();
+	_queuesReady[queue].release();
+}
+
+bool OdometryPipeline::pop(int queue, Frame *& frame)
+{
+	while(1)
+	{
+		_queuesReady[queue].acquire();
+		_queuesMutex.lock();
+		if(!_queues[queue].empty())
+		{
+			frame = _queues[queue].front();
+			_queues[queue].pop_front();
+			_queuesMutex.unlock();
+			_queuesFree[queue].release();
+			return true;
+		}
+		bool stopping = _stopping;
+		_queuesMutex.unlock();
+		if(stopping)
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+void OdometryPipeline::wakeUp()
+{
+	_queuesMutex.lock();
+	bool stopping = _stopping;
+	_queuesMutex.unlock();
+	if(!stopping)
+	{
+		// stage finished by itself, nobody to wake up
+		return;
+	}
+	for(int i=0; i<2; ++i)
+	{
+		_queuesFree[i].release();
+		_queuesReady[i].release();
+	}
+}
+
+} /* namespace rtabmap */
@@ -29,12 +29,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UConversion.h>
+#include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/core/Optimizer.h>
 #include <rtabmap/core/Graph.h>
 #include <rtabmap/core/util3d_transforms.h>
 #include <rtabmap/core/RegistrationVis.h>
 #include <set>
 #include <queue>
+#include <algorithm>
 
 #include <rtabmap/core/optimizer/OptimizerTORO.h>
 #include <rtabmap/core/optimizer/OptimizerG2O.h>
@@ -316,8 +318,29 @@ Optimizer::Optimizer(int iterations, bool slam2d, bool covarianceIgnored, double
 		robust_(robust),
 		priorsIgnored_(priorsIgnored),
 		landmarksIgnored_(landmarksIgnored),
-		gravitySigma_(gravitySigma)
+		gravitySigma_(gravitySigma),
+		incremental_(Parameters::defaultOptimizerIncremental()),
+		hierarchical_(Parameters::defaultOptimizerHierarchical()),
+		hierarchicalMaxSize_(Parameters::defaultOptimizerHierarchicalMaxSize()),
+		hierarchicalCompareFlat_(Parameters::defaultOptimizerHierarchicalCompareFlat()),
+		hierarchicalPartitions_(0),
+		hierarchicalSubmapsTime_(0.0),
+		hierarchicalSeparatorsTime_(0.0),
+		hierarchicalSubmapsError_(0.0),
+		hierarchicalSeparatorsError_(0.0),
+		hierarchicalFlatError_(0.0),
+		hierarchicalReferenceError_(-1.0),
+		hierarchicalReferenceTime_(0.0)
 {
+	// to create sub-map optimizers with the same parameters
+	parameters_.insert(ParametersPair(Parameters::kOptimizerIterations(), uNumber2Str(iterations_)));
+	parameters_.insert(ParametersPair(Parameters::kRegForce3DoF(), uBool2Str(slam2d_)));
+	parameters_.insert(ParametersPair(Parameters::kOptimizerVarianceIgnored(), uBool2Str(covarianceIgnored_)));
+	parameters_.insert(ParametersPair(Parameters::kOptimizerEpsilon(), uNumber2Str(epsilon_)));
+	parameters_.insert(ParametersPair(Parameters::kOptimizerRobust(), uBool2Str(robust_)));
+	parameters_.insert(ParametersPair(Parameters::kOptimizerPriorsIgnored(), uBool2Str(priorsIgnored_)));
+	parameters_.insert(ParametersPair(Parameters::kOptimizerLandmarksIgnored(), uBool2Str(landmarksIgnored_)));
+	parameters_.insert(ParametersPair(Parameters::kOptimizerGravitySigma(), uNumber2Str(gravitySigma_)));
 }
 
 Optimizer::Optimizer(const ParametersMap & parameters) :
@@ -328,7 +351,19 @@ Optimizer::Optimizer(const ParametersMap & parameters) :
 		robust_(Parameters::defaultOptimizerRobust()),
 		priorsIgnored_(Parameters::defaultOptimizerPriorsIgnored()),
 		landmarksIgnored_(Parameters::defaultOptimizerLandmarksIgnored()),
-		gravitySigma_(Parameters::defaultOptimizerGravitySigma())
+		gravitySigma_(Parameters::defaultOptimizerGravitySigma()),
+		incremental_(Parameters::defaultOptimizerIncremental()),
+		hierarchical_(Parameters::defaultOptimizerHierarchical()),
+		hierarchicalMaxSize_(Parameters::defaultOptimizerHierarchicalMaxSize()),
+		hierarchicalCompareFlat_(Parameters::defaultOptimizerHierarchicalCompareFlat()),
+		hierarchicalPartitions_(0),
+		hierarchicalSubmapsTime_(0.0),
+		hierarchicalSeparatorsTime_(0.0),
+		hierarchicalSubmapsError_(0.0),
+		hierarchicalSeparatorsError_(0.0),
+		hierarchicalFlatError_(0.0),
+		hierarchicalReferenceError_(-1.0),
+		hierarchicalReferenceTime_(0.0)
 {
 	parseParameters(parameters);
 }
@@ -343,6 +378,11 @@ void Optimizer::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kOptimizerPriorsIgnored(), priorsIgnored_);
 	Parameters::parse(parameters, Parameters::kOptimizerLandmarksIgnored(), landmarksIgnored_);
 	Parameters::parse(parameters, Parameters::kOptimizerGravitySigma(), gravitySigma_);
+	Parameters::parse(parameters, Parameters::kOptimizerIncremental(), incremental_);
+	Parameters::parse(parameters, Parameters::kOptimizerHierarchical(), hierarchical_);
+	Parameters::parse(parameters, Parameters::kOptimizerHierarchicalMaxSize(), hierarchicalMaxSize_);
+	Parameters::parse(parameters, Parameters::kOptimizerHierarchicalCompareFlat(), hierarchicalCompareFlat_);
+	uInsert(parameters_, parameters);
 }
 
 std::map<int, Transform> Optimizer::optimizeIncremental(
@@ -410,6 +450,371 @@ std::map<int, Transform> Optimizer::optimizeIncremental(
 	return std::map<int, Transform>();
 }
 
+std::map<int, Transform> Optimizer::optimizePersistent(
+		int rootId,
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & constraints,
+		cv::Mat & outputCovariance,
+		double * finalError,
+		int * iterationsDone)
+{
+	return optimize(rootId, poses, constraints, outputCovariance, 0, finalError, iterationsDone);
+}
+
+// Sum of the squared Mahalanobis errors of the links, the cost minimized by flat optimization
+static double computeLinksError(const std::map<int, Transform> & poses, const std::multimap<int, Link> & links, bool slam2d)
+{
+	double error = 0.0;
+	for(std::multimap<int, Link>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
+	{
+		const Link & link = iter->second;
+		std::map<int, Transform>::const_iterator from = poses.find(link.from());
+		std::map<int, Transform>::const_iterator to = poses.find(link.to());
+		if(link.from() == link.to() || from == poses.end() || to == poses.end())
+		{
+			continue;
+		}
+		Transform t = link.transform().inverse() * from->second.inverse() * to->second;
+		float x,y,z,roll,pitch,yaw;
+		t.getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+		cv::Mat v = (cv::Mat_<double>(6,1) << x, y, slam2d?0.0:z, slam2d?0.0:roll, slam2d?0.0:pitch, yaw);
+		error += cv::Mat(v.t() * link.infMatrix() * v).at<double>(0,0);
+	}
+	return error;
+}
+
+std::map<int, Transform> Optimizer::optimizeHierarchical(
+		int rootId,
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & constraints,
+		cv::Mat & outputCovariance,
+		double * finalError,
+		int * iterationsDone)
+{
+	hierarchicalPartitions_ = 0;
+	hierarchicalSubmapsTime_ = 0.0;
+	hierarchicalSeparatorsTime_ = 0.0;
+	hierarchicalSubmapsError_ = 0.0;
+	hierarchicalSeparatorsError_ = 0.0;
+	hierarchicalFlatError_ = 0.0;
+	hierarchicalReferenceError_ = -1.0;
+	hierarchicalReferenceTime_ = 0.0;
+
+	// Only pose graphs can be partitioned, do flat optimization otherwise
+	bool supported = rootId > 0 &&
+			poses.size()>=2 &&
+			iterations() > 0 &&
+			uContains(poses, rootId) &&
+			(landmarksIgnored() || poses.begin()->first > 0);
+	for(std::multimap<int, Link>::const_iterator iter=constraints.begin(); supported && iter!=constraints.end(); ++iter)
+	{
+		if(iter->second.from() == iter->second.to())
+		{
+			if((iter->second.type() == Link::kPosePrior && !priorsIgnored()) ||
+			   (iter->second.type() == Link::kGravity && !isSlam2d() && gravitySigma() > 0))
+			{
+				supported = false;
+			}
+		}
+		else if((iter->second.from() < 0 || iter->second.to() < 0) && !landmarksIgnored())
+		{
+			supported = false;
+		}
+	}
+	if(!supported)
+	{
+		UDEBUG("Graph cannot be partitioned (priors, gravity or landmarks), doing flat optimization.");
+		return optimize(rootId, poses, constraints, outputCovariance, 0, finalError, iterationsDone);
+	}
+
+	UTimer timer;
+
+	// Sub-maps: poses connected by neighbor links (a map/session is a chain of neighbor links)
+	std::map<int, int> parents;
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		if(iter->first > 0)
+		{
+			parents.insert(std::make_pair(iter->first, iter->first));
+		}
+	}
+	std::multimap<int, int> neighbors;
+	for(std::multimap<int, Link>::const_iterator iter=constraints.begin(); iter!=constraints.end(); ++iter)
+	{
+		const Link & link = iter->second;
+		if((link.type() == Link::kNeighbor || link.type() == Link::kNeighborMerged) &&
+		   link.from() != link.to() &&
+		   parents.find(link.from()) != parents.end() &&
+		   parents.find(link.to()) != parents.end())
+		{
+			neighbors.insert(std::make_pair(link.from(), link.to()));
+			neighbors.insert(std::make_pair(link.to(), link.from()));
+			int a = link.from();
+			while(parents.at(a) != a) a = parents.at(a);
+			int b = link.to();
+			while(parents.at(b) != b) b = parents.at(b);
+			if(a != b)
+			{
+				parents.at(a<b?b:a) = a<b?a:b;
+			}
+			// path compression
+			parents.at(link.from()) = a<b?a:b;
+			parents.at(link.to()) = a<b?a:b;
+		}
+	}
+	std::map<int, std::vector<int> > maps; // <smallest id, ids>
+	for(std::map<int, int>::iterator iter=parents.begin(); iter!=parents.end(); ++iter)
+	{
+		int a = iter->first;
+		while(parents.at(a) != a) a = parents.at(a);
+		iter->second = a;
+		maps[a].push_back(iter->first);
+	}
+
+	// Split large maps in chunks following their neighbor links
+	std::vector<std::vector<int> > partitions;
+	for(std::map<int, std::vector<int> >::iterator iter=maps.begin(); iter!=maps.end(); ++iter)
+	{
+		if(hierarchicalMaxSize_ <= 0 || (int)iter->second.size() <= hierarchicalMaxSize_)
+		{
+			partitions.push_back(iter->second);
+			continue;
+		}
+		std::set<int> visited;
+		std::queue<int> q;
+		q.push(iter->first);
+		visited.insert(iter->first);
+		std::vector<int> chunk;
+		while(!q.empty())
+		{
+			int id = q.front();
+			q.pop();
+			chunk.push_back(id);
+			if((int)chunk.size() >= hierarchicalMaxSize_)
+			{
+				partitions.push_back(chunk);
+				chunk.clear();
+			}
+			for(std::multimap<int, int>::const_iterator jter=neighbors.find(id); jter!=neighbors.end() && jter->first == id; ++jter)
+			{
+				if(visited.insert(jter->second).second)
+				{
+					q.push(jter->second);
+				}
+			}
+		}
+		if(!chunk.empty())
+		{
+			partitions.push_back(chunk);
+		}
+	}
+
+	if(partitions.size() <= 1)
+	{
+		UDEBUG("Graph has only one sub-map, doing flat optimization.");
+		hierarchicalPartitions_ = (int)partitions.size();
+		return optimize(rootId, poses, constraints, outputCovariance, 0, finalError, iterationsDone);
+	}
+
+	std::map<int, int> partitionOf;
+	for(size_t i=0; i<partitions.size(); ++i)
+	{
+		for(size_t j=0; j<partitions[i].size(); ++j)
+		{
+			partitionOf.insert(std::make_pair(partitions[i][j], (int)i));
+		}
+	}
+
+	// Links inside sub-maps, links between sub-maps are separators
+	std::vector<std::multimap<int, Link> > subLinks(partitions.size());
+	std::list<const Link *> separators;
+	for(std::multimap<int, Link>::const_iterator iter=constraints.begin(); iter!=constraints.end(); ++iter)
+	{
+		const Link & link = iter->second;
+		if(link.from() == link.to() || link.from() < 0 || link.to() < 0)
+		{
+			// ignored priors, gravity and landmarks (see above)
+			continue;
+		}
+		std::map<int, int>::iterator pa = partitionOf.find(link.from());
+		std::map<int, int>::iterator pb = partitionOf.find(link.to());
+		if(pa == partitionOf.end() || pb == partitionOf.end())
+		{
+			continue;
+		}
+		if(pa->second == pb->second)
+		{
+			subLinks[pa->second].insert(*iter);
+		}
+		else
+		{
+			separators.push_back(&link);
+		}
+	}
+
+	// Anchor of the sub-map containing the root is the root, for the others it is their smallest id
+	std::vector<int> anchors(partitions.size());
+	for(size_t i=0; i<partitions.size(); ++i)
+	{
+		anchors[i] = partitionOf.at(rootId) == (int)i?rootId:*std::min_element(partitions[i].begin(), partitions[i].end());
+	}
+
+	// Optimize sub-maps in parallel, each with its own optimizer
+	hierarchicalPartitions_ = (int)partitions.size();
+	std::vector<std::map<int, Transform> > subPoses(partitions.size());
+	std::vector<double> subErrors(partitions.size(), 0.0);
+	std::vector<cv::Mat> subCovariances(partitions.size());
+	std::vector<int> failed(partitions.size(), 0);
+	std::vector<std::string> exceptions(partitions.size()); // checked outside the parallel region
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(int i=0; i<(int)partitions.size(); ++i)
+	{
+		std::map<int, Transform> inputPoses;
+		for(size_t j=0; j<partitions[i].size(); ++j)
+		{
+			inputPoses.insert(*poses.find(partitions[i][j]));
+		}
+		if(inputPoses.size() == 1 || subLinks[i].empty())
+		{
+			subPoses[i] = inputPoses;
+			continue;
+		}
+		Optimizer * optimizer = Optimizer::create(this->type(), parameters_);
+		optimizer->setIterations(iterations());
+		optimizer->setSlam2d(isSlam2d());
+		optimizer->setCovarianceIgnored(isCovarianceIgnored());
+		optimizer->setEpsilon(epsilon());
+		optimizer->setRobust(isRobust());
+		optimizer->setPriorsIgnored(priorsIgnored());
+		optimizer->setLandmarksIgnored(landmarksIgnored());
+		optimizer->setGravitySigma(gravitySigma());
+		try
+		{
+			subPoses[i] = optimizer->optimize(anchors[i], inputPoses, subLinks[i], subCovariances[i], 0, &subErrors[i]);
+		}
+		catch(const std::exception & e)
+		{
+			// an exception cannot leave the parallel region
+			exceptions[i] = e.what();
+		}
+		delete optimizer;
+		if(subPoses[i].size() != inputPoses.size())
+		{
+			failed[i] = 1;
+		}
+	}
+	hierarchicalSubmapsTime_ = timer.ticks();
+	for(size_t i=0; i<partitions.size(); ++i)
+	{
+		UASSERT_MSG(exceptions[i].empty(), uFormat("Optimization of sub-map %d (anchor=%d, %d poses, %d links) failed: %s",
+				(int)i, anchors[i], (int)partitions[i].size(), (int)subLinks[i].size(), exceptions[i].c_str()).c_str());
+		if(failed[i])
+		{
+			UWARN("Optimization of sub-map %d (anchor=%d, %d poses, %d links) failed (%d poses optimized).",
+					(int)i, anchors[i], (int)partitions[i].size(), (int)subLinks[i].size(), (int)subPoses[i].size());
+			return std::map<int, Transform>();
+		}
+		hierarchicalSubmapsError_ += subErrors[i];
+	}
+
+	// Separator graph: anchors linked by the inter sub-map links expressed between anchors
+	std::map<int, Transform> anchorPoses;
+	for(size_t i=0; i<partitions.size(); ++i)
+	{
+		anchorPoses.insert(std::make_pair(anchors[i], poses.at(anchors[i])));
+	}
+	std::multimap<int, Link> anchorLinks;
+	for(std::list<const Link *>::const_iterator iter=separators.begin(); iter!=separators.end(); ++iter)
+	{
+		const Link & link = **iter;
+		int i = partitionOf.at(link.from());
+		int j = partitionOf.at(link.to());
+		Transform offsetFrom = subPoses[i].at(anchors[i]).inverse() * subPoses[i].at(link.from());
+		Transform offsetTo = subPoses[j].at(anchors[j]).inverse() * subPoses[j].at(link.to());
+		Transform t = offsetFrom * link.transform() * offsetTo.inverse();
+		if(isSlam2d())
+		{
+			t = t.to3DoF();
+		}
+		anchorLinks.insert(std::make_pair(anchors[i], Link(anchors[i], anchors[j], link.type(), t, link.infMatrix())));
+	}
+	cv::Mat anchorCovariance;
+	double separatorsError = 0.0;
+	std::map<int, Transform> optimizedAnchors = optimize(rootId, anchorPoses, anchorLinks, anchorCovariance, 0, &separatorsError, iterationsDone);
+	hierarchicalSeparatorsTime_ = timer.ticks();
+	hierarchicalSeparatorsError_ = separatorsError;
+	if(optimizedAnchors.size() != anchorPoses.size())
+	{
+		UWARN("Optimization of the separator graph failed (%d/%d anchors optimized, %d links).",
+				(int)optimizedAnchors.size(), (int)anchorPoses.size(), (int)anchorLinks.size());
+		return std::map<int, Transform>();
+	}
+
+	// Propagate anchor corrections to their sub-map
+	std::map<int, Transform> optimizedPoses;
+	for(size_t i=0; i<partitions.size(); ++i)
+	{
+		Transform correction = optimizedAnchors.at(anchors[i]) * subPoses[i].at(anchors[i]).inverse();
+		for(std::map<int, Transform>::const_iterator iter=subPoses[i].begin(); iter!=subPoses[i].end(); ++iter)
+		{
+			optimizedPoses.insert(std::make_pair(iter->first, correction * iter->second));
+		}
+	}
+
+	// Covariance of the last pose in its sub-map
+	int lastPartition = partitionOf.at(poses.rbegin()->first);
+	outputCovariance = subCovariances[lastPartition].empty()?cv::Mat::eye(6,6,CV_64FC1):subCovariances[lastPartition];
+
+	// Error of the original (flat) problem at the hierarchical solution
+	hierarchicalFlatError_ = computeLinksError(optimizedPoses, constraints, isSlam2d());
+	if(finalError)
+	{
+		*finalError = hierarchicalFlatError_;
+	}
+
+	UINFO("Hierarchical optimization: %d poses, %d sub-maps (%fs, error=%f), %d separator links (%fs, error=%f), flat error=%f",
+			(int)optimizedPoses.size(), hierarchicalPartitions_,
+			hierarchicalSubmapsTime_, hierarchicalSubmapsError_,
+			(int)anchorLinks.size(),
+			hierarchicalSeparatorsTime_, hierarchicalSeparatorsError_,
+			hierarchicalFlatError_);
+
+	if(hierarchicalCompareFlat_)
+	{
+		// Compare with flat optimization of the same graph (evaluation only, doubles the optimization time)
+		UTimer flatTimer;
+		cv::Mat flatCovariance;
+		std::map<int, Transform> flatPoses = optimize(rootId, poses, constraints, flatCovariance);
+		double flatTime = flatTimer.ticks();
+		hierarchicalReferenceTime_ = flatTime;
+		if(flatPoses.size() == optimizedPoses.size())
+		{
+			double flatError = computeLinksError(flatPoses, constraints, isSlam2d());
+			hierarchicalReferenceError_ = flatError;
+			float maxTranslation = 0.0f;
+			float maxRotation = 0.0f;
+			for(std::map<int, Transform>::iterator iter=flatPoses.begin(); iter!=flatPoses.end(); ++iter)
+			{
+				Transform t = iter->second.inverse() * optimizedPoses.at(iter->first);
+				maxTranslation = std::max(maxTranslation, t.getNorm());
+				maxRotation = std::max(maxRotation, Eigen::AngleAxisf(t.getQuaternionf()).angle());
+			}
+			UINFO("Flat optimization: %fs (hierarchical=%fs), error=%f (hierarchical=%f, ratio=%f), max pose difference=%f m, %f rad",
+					flatTime, hierarchicalSubmapsTime_+hierarchicalSeparatorsTime_,
+					flatError, hierarchicalFlatError_, flatError>0.0?hierarchicalFlatError_/flatError:0.0,
+					maxTranslation, maxRotation);
+		}
+		else
+		{
+			UWARN("Flat optimization failed (%d/%d poses optimized).", (int)flatPoses.size(), (int)optimizedPoses.size());
+		}
+	}
+
+	return optimizedPoses;
+}
+
 std::map<int, Transform> Optimizer::optimize(
 		int rootId,
 		const std::map<int, Transform> & poses,
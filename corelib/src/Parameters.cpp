@@ -569,6 +569,7 @@ const char * Parameters::showUsage()
 			"   --logtime \"bool\"     Print time when logging\n"
 			"   --logwhere \"bool\"    Print where when logging\n"
 			"   --logthread \"bool\"   Print thread id when logging\n"
+			"   --ulogasync \"bool\"   Write log messages in a background thread\n"
 			;
 }
 
@@ -919,6 +920,18 @@ ParametersMap Parameters::parseArguments(int argc, char * argv[], bool onlyParam
 					UERROR("\"--ulogthread\" argument requires a following boolean value");
 				}
 			}
+			else if(strcmp(argv[i], "--ulogasync") == 0)
+			{
+				++i;
+				if(i < argc)
+				{
+					ULogger::setAsync(uStr2Bool(argv[i]));
+				}
+				else
+				{
+					UERROR("\"--ulogasync\" argument requires a following boolean value");
+				}
+			}
 			else
 			{
 				checkParameters = true;
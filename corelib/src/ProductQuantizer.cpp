@@ -0,0 +1,444 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/ProductQuantizer.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <algorithm>
+
+namespace rtabmap {
+
+ProductQuantizer::ProductQuantizer() :
+		subQuantizers_(0),
+		centroids_(0),
+		featuresDim_(0),
+		subDim_(0)
+{
+}
+
+ProductQuantizer::~ProductQuantizer()
+{
+	this->release();
+}
+
+void ProductQuantizer::release()
+{
+	UDEBUG("");
+	coarseCentroids_ = cv::Mat();
+	codebooks_ = cv::Mat();
+	codes_ = cv::Mat();
+	lists_.clear();
+	indexList_.clear();
+	indexPosition_.clear();
+	freeIndices_.clear();
+	subQuantizers_ = 0;
+	centroids_ = 0;
+	featuresDim_ = 0;
+	subDim_ = 0;
+}
+
+bool ProductQuantizer::train(
+		const cv::Mat & features,
+		int subQuantizers,
+		int centroids,
+		int iterations,
+		int maxSamples,
+		int coarseCentroids)
+{
+	this->release();
+
+	UASSERT(features.type() == CV_32FC1);
+	UASSERT(iterations > 0);
+	if(subQuantizers <= 0 || features.cols % subQuantizers != 0)
+	{
+		UERROR("Features dimension (%d) should be a multiple of the number of sub-quantizers (%d).", features.cols, subQuantizers);
+		return false;
+	}
+	if(centroids < 2 || centroids > 256)
+	{
+		UERROR("Number of centroids (%d) should be between 2 and 256.", centroids);
+		return false;
+	}
+	if(features.rows < centroids || features.rows < coarseCentroids)
+	{
+		UERROR("Not enough features (%d) to train %d centroids and %d coarse centroids.", features.rows, centroids, coarseCentroids);
+		return false;
+	}
+
+	UTimer timer;
+	cv::Mat samples = features;
+	if(maxSamples > 0 && features.rows > maxSamples)
+	{
+		// uniform sub-sampling
+		samples = cv::Mat(maxSamples, features.cols, CV_32FC1);
+		double step = double(features.rows)/double(maxSamples);
+		for(int i=0; i<maxSamples; ++i)
+		{
+			features.row(int(double(i)*step)).copyTo(samples.row(i));
+		}
+	}
+
+	if(coarseCentroids > 0)
+	{
+		// Coarse quantizer, the codebooks are learned on the residuals
+		cv::Mat labels;
+		cv::kmeans(samples,
+				coarseCentroids,
+				labels,
+				cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, iterations, 1e-4),
+				1,
+				cv::KMEANS_PP_CENTERS,
+				coarseCentroids_);
+		UASSERT(coarseCentroids_.rows == coarseCentroids && coarseCentroids_.cols == features.cols && coarseCentroids_.type() == CV_32FC1);
+		UASSERT(labels.rows == samples.rows && labels.type() == CV_32SC1);
+		cv::Mat residuals(samples.rows, samples.cols, CV_32FC1);
+		for(int i=0; i<samples.rows; ++i)
+		{
+			cv::subtract(samples.row(i), coarseCentroids_.row(labels.at<int>(i)), residuals.row(i));
+		}
+		samples = residuals;
+		UDEBUG("Trained %d coarse centroids: %fs", coarseCentroids, timer.ticks());
+	}
+
+	int subDim = features.cols / subQuantizers;
+	cv::Mat codebooks(subQuantizers*centroids, subDim, CV_32FC1);
+	for(int m=0; m<subQuantizers; ++m)
+	{
+		cv::Mat subSamples = samples.colRange(m*subDim, (m+1)*subDim).clone();
+		cv::Mat labels;
+		cv::Mat centers;
+		cv::kmeans(subSamples,
+				centroids,
+				labels,
+				cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, iterations, 1e-4),
+				1,
+				cv::KMEANS_PP_CENTERS,
+				centers);
+		UASSERT(centers.rows == centroids && centers.cols == subDim && centers.type() == CV_32FC1);
+		centers.copyTo(codebooks.rowRange(m*centroids, (m+1)*centroids));
+	}
+
+	codebooks_ = codebooks;
+	subQuantizers_ = subQuantizers;
+	centroids_ = centroids;
+	featuresDim_ = features.cols;
+	subDim_ = subDim;
+	lists_.resize(coarseCentroids_.empty()?1:coarseCentroids_.rows);
+	UDEBUG("Trained %d sub-quantizers of %d centroids with %d samples (dim=%d, lists=%d): %fs",
+			subQuantizers_, centroids_, samples.rows, featuresDim_, (int)lists_.size(), timer.ticks());
+	return true;
+}
+
+unsigned int ProductQuantizer::indexedFeatures() const
+{
+	return codes_.rows - freeIndices_.size();
+}
+
+unsigned long ProductQuantizer::memoryUsed() const
+{
+	unsigned long memoryUsage = sizeof(ProductQuantizer);
+	memoryUsage += coarseCentroids_.total()*coarseCentroids_.elemSize();
+	memoryUsage += codebooks_.total()*codebooks_.elemSize();
+	memoryUsage += codes_.total()*codes_.elemSize();
+	for(unsigned int i=0; i<lists_.size(); ++i)
+	{
+		memoryUsage += sizeof(std::vector<unsigned int>) + lists_[i].capacity()*sizeof(unsigned int);
+	}
+	memoryUsage += indexList_.capacity()*sizeof(int);
+	memoryUsage += indexPosition_.capacity()*sizeof(unsigned int);
+	memoryUsage += freeIndices_.capacity()*sizeof(unsigned int);
+	return memoryUsage;
+}
+
+int ProductQuantizer::nearestCoarseCentroid(const float * feature) const
+{
+	int nearest = 0;
+	float minDist = -1.0f;
+	for(int l=0; l<coarseCentroids_.rows; ++l)
+	{
+		const float * centroid = coarseCentroids_.ptr<float>(l);
+		float d = 0.0f;
+		for(int j=0; j<featuresDim_; ++j)
+		{
+			float diff = feature[j] - centroid[j];
+			d += diff*diff;
+		}
+		if(minDist < 0.0f || d < minDist)
+		{
+			minDist = d;
+			nearest = l;
+		}
+	}
+	return nearest;
+}
+
+// Squared distances between each sub-vector of the feature and their centroids
+void ProductQuantizer::computeDistanceTable(const float * feature, float * table) const
+{
+	for(int m=0; m<subQuantizers_; ++m)
+	{
+		const float * sub = feature + m*subDim_;
+		for(int c=0; c<centroids_; ++c)
+		{
+			const float * centroid = codebooks_.ptr<float>(m*centroids_+c);
+			float d = 0.0f;
+			for(int j=0; j<subDim_; ++j)
+			{
+				float diff = sub[j] - centroid[j];
+				d += diff*diff;
+			}
+			table[m*centroids_+c] = d;
+		}
+	}
+}
+
+void ProductQuantizer::encode(const cv::Mat & features, cv::Mat & codes, std::vector<int> & lists) const
+{
+	UASSERT(isTrained());
+	UASSERT_MSG(features.type() == CV_32FC1 && features.cols == featuresDim_,
+			uFormat("type=%d dim=%d (expected dim=%d)", features.type(), features.cols, featuresDim_).c_str());
+
+	codes = cv::Mat(features.rows, subQuantizers_, CV_8UC1);
+	lists = std::vector<int>(features.rows, 0);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for(int i=0; i<features.rows; ++i)
+	{
+		const float * f = features.ptr<float>(i);
+		std::vector<float> residual;
+		if(!coarseCentroids_.empty())
+		{
+			lists[i] = nearestCoarseCentroid(f);
+			const float * coarse = coarseCentroids_.ptr<float>(lists[i]);
+			residual.resize(featuresDim_);
+			for(int j=0; j<featuresDim_; ++j)
+			{
+				residual[j] = f[j] - coarse[j];
+			}
+			f = &residual[0];
+		}
+		unsigned char * code = codes.ptr(i);
+		for(int m=0; m<subQuantizers_; ++m)
+		{
+			const float * sub = f + m*subDim_;
+			float minDist = -1.0f;
+			for(int c=0; c<centroids_; ++c)
+			{
+				const float * centroid = codebooks_.ptr<float>(m*centroids_+c);
+				float d = 0.0f;
+				for(int j=0; j<subDim_; ++j)
+				{
+					float diff = sub[j] - centroid[j];
+					d += diff*diff;
+				}
+				if(minDist < 0.0f || d < minDist)
+				{
+					minDist = d;
+					code[m] = (unsigned char)c;
+				}
+			}
+		}
+	}
+}
+
+cv::Mat ProductQuantizer::decode(const cv::Mat & codes, const std::vector<int> & lists) const
+{
+	UASSERT(isTrained());
+	UASSERT(codes.type() == CV_8UC1 && codes.cols == subQuantizers_);
+	UASSERT((int)lists.size() == codes.rows);
+
+	cv::Mat features(codes.rows, featuresDim_, CV_32FC1);
+	for(int i=0; i<codes.rows; ++i)
+	{
+		const unsigned char * code = codes.ptr(i);
+		for(int m=0; m<subQuantizers_; ++m)
+		{
+			codebooks_.row(m*centroids_+code[m]).copyTo(features.row(i).colRange(m*subDim_, (m+1)*subDim_));
+		}
+		if(!coarseCentroids_.empty())
+		{
+			UASSERT(lists[i] >= 0 && lists[i] < coarseCentroids_.rows);
+			features.row(i) += coarseCentroids_.row(lists[i]);
+		}
+	}
+	return features;
+}
+
+std::vector<unsigned int> ProductQuantizer::addPoints(const cv::Mat & features)
+{
+	cv::Mat codes;
+	std::vector<int> lists;
+	this->encode(features, codes, lists);
+
+	std::vector<unsigned int> indices(codes.rows);
+	for(int i=0; i<codes.rows; ++i)
+	{
+		unsigned int index;
+		if(freeIndices_.size())
+		{
+			index = freeIndices_.back();
+			freeIndices_.pop_back();
+			codes.row(i).copyTo(codes_.row(index));
+		}
+		else
+		{
+			index = codes_.rows;
+			codes_.push_back(codes.row(i));
+			indexList_.push_back(-1);
+			indexPosition_.push_back(0);
+		}
+		UASSERT(indexList_[index] == -1);
+		indexList_[index] = lists[i];
+		indexPosition_[index] = lists_[lists[i]].size();
+		lists_[lists[i]].push_back(index);
+		indices[i] = index;
+	}
+	return indices;
+}
+
+void ProductQuantizer::removePoint(unsigned int index)
+{
+	UASSERT(index < indexList_.size());
+	int list = indexList_[index];
+	if(list >= 0)
+	{
+		// Remove from its inverted list by moving the last index of the list at its position
+		std::vector<unsigned int> & indices = lists_[list];
+		unsigned int position = indexPosition_[index];
+		UASSERT(position < indices.size() && indices[position] == index);
+		indices[position] = indices.back();
+		indexPosition_[indices[position]] = position;
+		indices.pop_back();
+
+		// The index (and its code row) will be reused by the next added feature
+		indexList_[index] = -1;
+		freeIndices_.push_back(index);
+	}
+}
+
+void ProductQuantizer::knnSearch(
+		const cv::Mat & query,
+		cv::Mat & indices,
+		cv::Mat & dists,
+		int knn,
+		int nprobe) const
+{
+	UASSERT(isTrained());
+	UASSERT_MSG(query.type() == CV_32FC1 && query.cols == featuresDim_,
+			uFormat("type=%d dim=%d (expected dim=%d)", query.type(), query.cols, featuresDim_).c_str());
+	UASSERT(knn > 0);
+
+	indices = cv::Mat(query.rows, knn, CV_32SC1, cv::Scalar::all(-1));
+	dists = cv::Mat(query.rows, knn, CV_32FC1, cv::Scalar::all(-1.0f));
+
+	if(nprobe < 1)
+	{
+		nprobe = 1;
+	}
+	else if(nprobe > (int)lists_.size())
+	{
+		nprobe = (int)lists_.size();
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(int i=0; i<query.rows; ++i)
+	{
+		const float * q = query.ptr<float>(i);
+
+		// Inverted lists to search, sorted by distance of their coarse centroid to the query
+		std::vector<std::pair<float, int> > probes;
+		if(coarseCentroids_.empty())
+		{
+			probes.push_back(std::make_pair(0.0f, 0));
+		}
+		else
+		{
+			probes.resize(coarseCentroids_.rows);
+			for(int l=0; l<coarseCentroids_.rows; ++l)
+			{
+				probes[l] = std::make_pair((float)cv::norm(query.row(i), coarseCentroids_.row(l), cv::NORM_L2SQR), l);
+			}
+			std::partial_sort(probes.begin(), probes.begin()+nprobe, probes.end());
+			probes.resize(nprobe);
+		}
+
+		std::vector<float> table(subQuantizers_*centroids_);
+		std::vector<float> residual(featuresDim_);
+		int * idx = indices.ptr<int>(i);
+		float * dst = dists.ptr<float>(i);
+		int found = 0;
+		for(unsigned int p=0; p<probes.size(); ++p)
+		{
+			const std::vector<unsigned int> & list = lists_[probes[p].second];
+			if(list.empty())
+			{
+				continue;
+			}
+			if(coarseCentroids_.empty())
+			{
+				computeDistanceTable(q, &table[0]);
+			}
+			else
+			{
+				const float * coarse = coarseCentroids_.ptr<float>(probes[p].second);
+				for(int j=0; j<featuresDim_; ++j)
+				{
+					residual[j] = q[j] - coarse[j];
+				}
+				computeDistanceTable(&residual[0], &table[0]);
+			}
+
+			for(unsigned int r=0; r<list.size(); ++r)
+			{
+				const unsigned char * code = codes_.ptr(list[r]);
+				float d = 0.0f;
+				for(int m=0; m<subQuantizers_; ++m)
+				{
+					d += table[m*centroids_+code[m]];
+				}
+				if(found < knn || d < dst[knn-1])
+				{
+					// keep results sorted
+					int j = found<knn?found++:knn-1;
+					for(; j>0 && dst[j-1] > d; --j)
+					{
+						dst[j] = dst[j-1];
+						idx[j] = idx[j-1];
+					}
+					dst[j] = d;
+					idx[j] = list[r];
+				}
+			}
+		}
+	}
+}
+
+} /* namespace rtabmap */
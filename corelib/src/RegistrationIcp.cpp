@@ -36,6 +36,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UProfiler.h>
 #include <pcl/conversions.h>
 #include <pcl/common/pca.h>
 
@@ -541,6 +542,7 @@ Transform RegistrationIcp::computeTransformationImpl(
 			Transform guess,
 			RegistrationInfo & info) const
 {
+	UPROFILER_ZONE("RegistrationIcp::computeTransformationImpl");
 	UDEBUG("Guess transform = %s", guess.prettyPrint().c_str());
 	UDEBUG("Voxel size=%f", _voxelSize);
 	UDEBUG("PointToPlane=%d", _pointToPlane?1:0);
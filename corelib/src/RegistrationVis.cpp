@@ -42,6 +42,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/UTimer.h>
 #include <rtabmap/utilite/UMath.h>
+#include <rtabmap/utilite/UProfiler.h>
 #include <opencv2/core/core_c.h>
 
 #if defined(HAVE_OPENCV_XFEATURES2D) && (CV_MAJOR_VERSION > 3 || (CV_MAJOR_VERSION==3 && CV_MINOR_VERSION >=4 && CV_SUBMINOR_VERSION >= 1))
@@ -204,10 +205,8 @@ void RegistrationVis::parseParameters(const ParametersMap & parameters)
 
 	if(uContains(parameters, Parameters::kVisCorNNType()))
 	{
-		if(_nnType<VWDictionary::kNNUndef)
-		{
-			uInsert(_featureParameters, ParametersPair(Parameters::kKpNNStrategy(), uNumber2Str(_nnType)));
-		}
+		// Values above kNNBruteForceGPU are registration-only matchers, the dictionary does brute force
+		uInsert(_featureParameters, ParametersPair(Parameters::kKpNNStrategy(), uNumber2Str(_nnType<=VWDictionary::kNNBruteForceGPU?_nnType:(int)VWDictionary::kNNBruteForce)));
 	}
 	if(uContains(parameters, Parameters::kVisCorNNDR()))
 	{
@@ -279,6 +278,7 @@ Transform RegistrationVis::computeTransformationImpl(
 			Transform guess, // (flowMaxLevel is set to 0 when guess is used)
 			RegistrationInfo & info) const
 {
+	UPROFILER_ZONE("RegistrationVis::computeTransformationImpl");
 	UDEBUG("%s=%d", Parameters::kVisMinInliers().c_str(), _minInliers);
 	UDEBUG("%s=%f", Parameters::kVisInlierDistance().c_str(), _inlierDistance);
 	UDEBUG("%s=%d", Parameters::kVisIterations().c_str(), _iterations);
@@ -47,6 +47,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UProcessInfo.h>
+#include <rtabmap/utilite/UProfiler.h>
+#include <rtabmap/utilite/UThread.h>
 
 #include <pcl/search/kdtree.h>
 #include <pcl/filters/crop_box.h>
@@ -84,6 +86,7 @@ Rtabmap::Rtabmap() :
 	_publishRAMUsage(Parameters::defaultRtabmapPublishRAMUsage()),
 	_computeRMSE(Parameters::defaultRtabmapComputeRMSE()),
 	_saveWMState(Parameters::defaultRtabmapSaveWMState()),
+	_traceFrames(Parameters::defaultRtabmapTraceFrames()),
 	_maxTimeAllowed(Parameters::defaultRtabmapTimeThr()), // 700 ms
 	_maxMemoryAllowed(Parameters::defaultRtabmapMemoryThr()), // 0=inf
 	_loopThr(Parameters::defaultRtabmapLoopThr()),
@@ -143,6 +146,9 @@ Rtabmap::Rtabmap() :
 	_foutFloat(0),
 	_foutInt(0),
 	_wDir(""),
+	_traceFrameCount(0),
+	_traceExported(0),
+	_traceEnabled(false),
 	_mapCorrection(Transform::getIdentity()),
 	_lastLocalizationNodeId(0),
 	_currentSessionHasGPS(false),
@@ -159,6 +165,15 @@ Rtabmap::Rtabmap() :
 Rtabmap::~Rtabmap() {
 	UDEBUG("");
 	this->close();
+	if(_traceEnabled)
+	{
+		UProfiler::setEnabled(false);
+		for(std::set<unsigned long>::iterator iter=_traceThreads.begin(); iter!=_traceThreads.end(); ++iter)
+		{
+			UProfiler::setThreadOwned(*iter, false);
+		}
+		_traceThreads.clear();
+	}
 }
 
 void Rtabmap::setupLogFiles(bool overwrite)
@@ -267,6 +282,17 @@ void Rtabmap::setupLogFiles(bool overwrite)
 	}
 }
 
+void Rtabmap::exportTrace()
+{
+	if(_traceFrameCount > 0)
+	{
+		std::string path = uFormat("%s/rtabmap_trace_%d", _wDir.empty()?".":_wDir.c_str(), _traceExported++);
+		// Only zones of our threads, odometry can be traced at the same time in other threads
+		UProfiler::exportTrace(path+".json", path+".folded", true, &_traceThreads);
+		_traceFrameCount = 0;
+	}
+}
+
 void Rtabmap::flushStatisticLogs()
 {
 	if(_foutFloat && _bufferedLogsF.size())
@@ -392,6 +418,7 @@ void Rtabmap::init(const std::string & configFile, const std::string & databaseP
 void Rtabmap::close(bool databaseSaved, const std::string & ouputDatabasePath)
 {
 	UINFO("databaseSaved=%d", databaseSaved?1:0);
+	exportTrace();
 	_highestHypothesis = std::make_pair(0,0.0f);
 	_loopClosureHypothesis = std::make_pair(0,0.0f);
 	_lastProcessTime = 0.0;
@@ -489,6 +516,23 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kRtabmapPublishRAMUsage(), _publishRAMUsage);
 	Parameters::parse(parameters, Parameters::kRtabmapComputeRMSE(), _computeRMSE);
 	Parameters::parse(parameters, Parameters::kRtabmapSaveWMState(), _saveWMState);
+	Parameters::parse(parameters, Parameters::kRtabmapTraceFrames(), _traceFrames);
+	if(_traceFrames > 0 && !_traceEnabled)
+	{
+		UProfiler::setEnabled(true);
+		_traceEnabled = true;
+	}
+	else if(_traceFrames <= 0 && _traceEnabled)
+	{
+		exportTrace();
+		UProfiler::setEnabled(false);
+		for(std::set<unsigned long>::iterator iter=_traceThreads.begin(); iter!=_traceThreads.end(); ++iter)
+		{
+			UProfiler::setThreadOwned(*iter, false);
+		}
+		_traceThreads.clear();
+		_traceEnabled = false;
+	}
 	Parameters::parse(parameters, Parameters::kRtabmapTimeThr(), _maxTimeAllowed);
 	Parameters::parse(parameters, Parameters::kRtabmapMemoryThr(), _maxMemoryAllowed);
 	Parameters::parse(parameters, Parameters::kRtabmapLoopThr(), _loopThr);
@@ -760,6 +804,10 @@ int Rtabmap::triggerNewMap()
 		UINFO("New map triggered, new map = %d", mapId);
 		_optimizedPoses.clear();
 		_constraints.clear();
+		if(_graphOptimizer)
+		{
+			_graphOptimizer->resetPersistent();
+		}
 
 		if(_bayesFilter)
 		{
@@ -903,6 +951,10 @@ void Rtabmap::resetMemory()
 	_someNodesHaveBeenTransferred = false;
 	_optimizedPoses.clear();
 	_constraints.clear();
+	if(_graphOptimizer)
+	{
+		_graphOptimizer->resetPersistent();
+	}
 	_mapCorrection.setIdentity();
 	_mapCorrectionBackup.setNull();
 	_lastLocalizationPose.setNull();
@@ -998,6 +1050,20 @@ bool Rtabmap::process(
 {
 	UDEBUG("");
 
+	if(_traceFrames > 0)
+	{
+		if(_traceFrameCount >= _traceFrames)
+		{
+			exportTrace();
+		}
+		++_traceFrameCount;
+		if(_traceThreads.insert(UThread::currentThreadId()).second)
+		{
+			UProfiler::setThreadOwned(UThread::currentThreadId(), true);
+		}
+	}
+	UPROFILER_ZONE("Rtabmap::process");
+
 	//============================================================
 	// Initialization
 	//============================================================
@@ -1012,6 +1078,7 @@ bool Rtabmap::process(
 	double timeReactivations = 0;
 	double timeAddLoopClosureLink = 0;
 	double timeMapOptimization = 0;
+	double timeMapOptimizationUpdate = 0;
 	double timeRetrievalDbAccess = 0;
 	double timeLikelihoodCalculation = 0;
 	double timePosteriorCalculation = 0;
@@ -1794,8 +1861,13 @@ bool Rtabmap::process(
 
 	//============================================================
 	// Before retrieval, make sure the trash has finished
+	// (not required with write-behind, the database can be read
+	//  between the group commits)
 	//============================================================
-	_memory->joinTrashThread();
+	if(!_memory->isDbWriteBehind())
+	{
+		_memory->joinTrashThread();
+	}
 	timeEmptyingTrash = _memory->getDbSavingTime();
 	timeJoiningTrash = timer.ticks();
 	ULOGGER_INFO("Time emptying memory trash = %fs,  joining (actual overhead) = %fs", timeEmptyingTrash, timeJoiningTrash);
@@ -2934,6 +3006,10 @@ bool Rtabmap::process(
 			std::multimap<int, Link> constraints;
 			cv::Mat covariance;
 			optimizeCurrentMap(signature->id(), false, poses, covariance, &constraints, &optimizationError, &optimizationIterations);
+			if(_graphOptimizer->isIncremental())
+			{
+				timeMapOptimizationUpdate = _graphOptimizer->persistentUpdateTime();
+			}
 
 			// Check added loop closures have broken the graph
 			// (in case of wrong loop closures).
@@ -3032,6 +3108,8 @@ bool Rtabmap::process(
 						_memory->removeLink(iter->first, iter->second);
 						UWARN("Loop closure %d->%d rejected!", iter->first, iter->second);
 					}
+					// the incremental graph has been optimized with the wrong loop closures
+					_graphOptimizer->resetPersistent();
 					updateConstraints = false;
 					_loopClosureHypothesis.first = 0;
 					lastProximitySpaceClosureId = 0;
@@ -3268,6 +3346,24 @@ bool Rtabmap::process(
 			statistics_.addStatistic(Statistics::kTimingReactivation(), timeReactivations*1000);
 			statistics_.addStatistic(Statistics::kTimingAdd_loop_closure_link(), timeAddLoopClosureLink*1000);
 			statistics_.addStatistic(Statistics::kTimingMap_optimization(), timeMapOptimization*1000);
+			if(_graphOptimizer->isIncremental())
+			{
+				statistics_.addStatistic(Statistics::kTimingMap_optimization_update(), timeMapOptimizationUpdate*1000);
+			}
+			if(_graphOptimizer->isHierarchical())
+			{
+				statistics_.addStatistic(Statistics::kTimingMap_optimization_submaps(), _graphOptimizer->hierarchicalSubmapsTime()*1000);
+				statistics_.addStatistic(Statistics::kTimingMap_optimization_separators(), _graphOptimizer->hierarchicalSeparatorsTime()*1000);
+				statistics_.addStatistic(Statistics::kLoopOptimization_partitions(), _graphOptimizer->hierarchicalPartitions());
+				statistics_.addStatistic(Statistics::kLoopOptimization_submaps_error(), _graphOptimizer->hierarchicalSubmapsError());
+				statistics_.addStatistic(Statistics::kLoopOptimization_separators_error(), _graphOptimizer->hierarchicalSeparatorsError());
+				statistics_.addStatistic(Statistics::kLoopOptimization_flat_error(), _graphOptimizer->hierarchicalFlatError());
+				if(_graphOptimizer->isHierarchicalCompareFlat())
+				{
+					statistics_.addStatistic(Statistics::kTimingMap_optimization_reference(), _graphOptimizer->hierarchicalReferenceTime()*1000);
+					statistics_.addStatistic(Statistics::kLoopOptimization_reference_error(), _graphOptimizer->hierarchicalReferenceError());
+				}
+			}
 			statistics_.addStatistic(Statistics::kTimingLikelihood_computation(), timeLikelihoodCalculation*1000);
 			statistics_.addStatistic(Statistics::kTimingPosterior_computation(), timePosteriorCalculation*1000);
 			statistics_.addStatistic(Statistics::kTimingHypotheses_creation(), timeHypothesesCreation*1000);
@@ -3565,6 +3661,8 @@ bool Rtabmap::process(
 		statistics_.addStatistic(Statistics::kTimingForgetting(), timeRealTimeLimitReachedProcess*1000);
 		statistics_.addStatistic(Statistics::kTimingJoining_trash(), timeJoiningTrash*1000);
 		statistics_.addStatistic(Statistics::kTimingEmptying_trash(), timeEmptyingTrash*1000);
+		statistics_.addStatistic(Statistics::kTimingDatabase_commit_max(), _memory->getDbMaxCommitTime()*1000);
+		statistics_.addStatistic(Statistics::kMemoryDatabase_write_queue(), _memory->getDbTrashSize());
 		statistics_.addStatistic(Statistics::kTimingMemory_cleanup(), timeMemoryCleanup*1000);
 
 		// Transfer
@@ -4165,6 +4263,7 @@ void Rtabmap::optimizeCurrentMap(
 		double * error,
 		int * iterationsDone) const
 {
+	UPROFILER_ZONE("Rtabmap::optimizeCurrentMap");
 	//Optimize the map
 	UINFO("Optimize map: around location %d (lookInDatabase=%s)", id, lookInDatabase?"true":"false");
 	if(_memory && id > 0)
@@ -4177,7 +4276,7 @@ void Rtabmap::optimizeCurrentMap(
 		}
 		UINFO("get %d ids time %f s", (int)ids.size(), timer.ticks());
 
-		std::map<int, Transform> poses = Rtabmap::optimizeGraph(id, uKeysSet(ids), optimizedPoses, lookInDatabase, covariance, constraints, error, iterationsDone);
+		std::map<int, Transform> poses = Rtabmap::optimizeGraph(id, uKeysSet(ids), optimizedPoses, lookInDatabase, covariance, constraints, error, iterationsDone, !lookInDatabase);
 		UINFO("optimize time %f s", timer.ticks());
 
 		if(poses.size())
@@ -4210,8 +4309,10 @@ std::map<int, Transform> Rtabmap::optimizeGraph(
 		cv::Mat & covariance,
 		std::multimap<int, Link> * constraints,
 		double * error,
-		int * iterationsDone) const
+		int * iterationsDone,
+		bool persistent) const
 {
+	UPROFILER_ZONE("Rtabmap::optimizeGraph");
 	UTimer timer;
 	std::map<int, Transform> optimizedPoses;
 	std::map<int, Transform> poses;
@@ -4253,7 +4354,18 @@ std::map<int, Transform> Rtabmap::optimizeGraph(
 			std::map<int, Transform> posesOut;
 			std::multimap<int, Link> edgeConstraintsOut;
 			_graphOptimizer->getConnectedGraph(fromId, poses, edgeConstraints, posesOut, edgeConstraintsOut);
-			optimizedPoses = _graphOptimizer->optimize(fromId, posesOut, edgeConstraintsOut, covariance, 0, error, iterationsDone);
+			if(_graphOptimizer->isHierarchical())
+			{
+				optimizedPoses = _graphOptimizer->optimizeHierarchical(fromId, posesOut, edgeConstraintsOut, covariance, error, iterationsDone);
+			}
+			else if(persistent && _graphOptimizer->isIncremental())
+			{
+				optimizedPoses = _graphOptimizer->optimizePersistent(fromId, posesOut, edgeConstraintsOut, covariance, error, iterationsDone);
+			}
+			else
+			{
+				optimizedPoses = _graphOptimizer->optimize(fromId, posesOut, edgeConstraintsOut, covariance, 0, error, iterationsDone);
+			}
 			if(constraints)
 			{
 				*constraints = edgeConstraintsOut;
@@ -4262,7 +4374,18 @@ std::map<int, Transform> Rtabmap::optimizeGraph(
 		else
 		{
 			UDEBUG("use input guess poses");
-			optimizedPoses = _graphOptimizer->optimize(fromId, poses, edgeConstraints, covariance, 0, error, iterationsDone);
+			if(_graphOptimizer->isHierarchical())
+			{
+				optimizedPoses = _graphOptimizer->optimizeHierarchical(fromId, poses, edgeConstraints, covariance, error, iterationsDone);
+			}
+			else if(persistent && _graphOptimizer->isIncremental())
+			{
+				optimizedPoses = _graphOptimizer->optimizePersistent(fromId, poses, edgeConstraints, covariance, error, iterationsDone);
+			}
+			else
+			{
+				optimizedPoses = _graphOptimizer->optimize(fromId, poses, edgeConstraints, covariance, 0, error, iterationsDone);
+			}
 			if(constraints)
 			{
 				*constraints = edgeConstraints;
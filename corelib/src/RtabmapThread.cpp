@@ -51,7 +51,11 @@ RtabmapThread::RtabmapThread(Rtabmap * rtabmap) :
 		_previousStamp(0.0),
 		_rtabmap(rtabmap),
 		_paused(false),
-		lastPose_(Transform::getIdentity())
+		lastPose_(Transform::getIdentity()),
+		_mapRevision(0),
+		_mapRevisionReset(0),
+		_globalOptimizedRevision(0),
+		_globalOptimizedValid(false)
 
 {
 	UASSERT(rtabmap != 0);
@@ -126,10 +130,150 @@ void RtabmapThread::close(bool databaseSaved, const std::string & ouputDatabaseP
 	}
 }
 
-void RtabmapThread::publishMap(bool optimized, bool full, bool graphOnly) const
+void RtabmapThread::resetMapRevisions()
 {
-	UDEBUG("optimized=%s, full=%s, graphOnly=%s", optimized?"true":"false", full?"true":"false", graphOnly?"true":"false");
-	if(_rtabmap)
+	_mapRevisionReset = ++_mapRevision;
+	for(int i=0; i<2; ++i)
+	{
+		_nodeRevisions[i].clear();
+		_removedNodeRevisions[i].clear();
+	}
+	_globalOptimizedPoses.clear();
+	_globalOptimizedConstraints.clear();
+	_globalOptimizedValid = false;
+}
+
+void RtabmapThread::publishMap(bool optimized, bool full, bool graphOnly, int sinceRevision)
+{
+	UDEBUG("optimized=%s, full=%s, graphOnly=%s, sinceRevision=%d", optimized?"true":"false", full?"true":"false", graphOnly?"true":"false", sinceRevision);
+	if(_rtabmap && sinceRevision >= 0)
+	{
+		UTimer timer;
+		const Memory * memory = _rtabmap->getMemory();
+		std::map<int, Transform> poses;
+		std::multimap<int, Link> constraints;
+		if(optimized && !full && _rtabmap->isRGBDMode() && !_rtabmap->getLocalOptimizedPoses().empty())
+		{
+			// The local graph is optimized on each update, no need to optimize it again
+			poses = _rtabmap->getLocalOptimizedPoses();
+			constraints = _rtabmap->getLocalConstraints();
+		}
+		else if(optimized && full && memory && _globalOptimizedValid && _globalOptimizedRevision == memory->getGraphRevision())
+		{
+			// No node or link changed since the global graph was last optimized
+			poses = _globalOptimizedPoses;
+			constraints = _globalOptimizedConstraints;
+			UDEBUG("Reusing global graph optimized at memory revision %d", (int)_globalOptimizedRevision);
+		}
+		else
+		{
+			_rtabmap->getGraph(poses, constraints, optimized, full);
+			if(optimized && full && memory)
+			{
+				_globalOptimizedPoses = poses;
+				_globalOptimizedConstraints = constraints;
+				_globalOptimizedRevision = memory->getGraphRevision();
+				_globalOptimizedValid = true;
+			}
+		}
+
+		// Nodes with data, same as a full map (see Rtabmap::getGraph()): WM+STM
+		// for the local map, all nodes for the global map. They are not
+		// necessarily all in the optimized graph.
+		std::set<int> dataIds;
+		if(memory && memory->getLastWorkingSignature())
+		{
+			if(full)
+			{
+				dataIds = memory->getAllSignatureIds();
+			}
+			else
+			{
+				dataIds = uKeysSet(memory->getWorkingMem());
+				dataIds.erase(Memory::kIdVirtual);
+				dataIds.insert(memory->getStMem().begin(), memory->getStMem().end());
+			}
+		}
+		std::set<int> ids = dataIds;
+		for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+		{
+			ids.insert(ids.end(), iter->first);
+		}
+
+		// Update revisions, local and global graphs are tracked independently. A node
+		// is republished when it appears in the graph (or the nodes with data) or
+		// when the memory modified it or its links.
+		std::map<int, std::pair<int, unsigned int> > & nodeRevisions = _nodeRevisions[full?1:0];
+		std::map<int, int> & removedNodeRevisions = _removedNodeRevisions[full?1:0];
+		++_mapRevision;
+		bool changed = false;
+		for(std::set<int>::iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+		{
+			unsigned int memoryRevision = memory?memory->getGraphRevision(*iter):0;
+			std::map<int, std::pair<int, unsigned int> >::iterator jter = nodeRevisions.find(*iter);
+			if(jter == nodeRevisions.end())
+			{
+				nodeRevisions.insert(std::make_pair(*iter, std::make_pair(_mapRevision, memoryRevision)));
+				removedNodeRevisions.erase(*iter);
+				changed = true;
+			}
+			else if(jter->second.second != memoryRevision)
+			{
+				jter->second = std::make_pair(_mapRevision, memoryRevision);
+				changed = true;
+			}
+		}
+		for(std::map<int, std::pair<int, unsigned int> >::iterator iter=nodeRevisions.begin(); iter!=nodeRevisions.end();)
+		{
+			if(ids.find(iter->first) == ids.end())
+			{
+				removedNodeRevisions[iter->first] = _mapRevision;
+				nodeRevisions.erase(iter++);
+				changed = true;
+			}
+			else
+			{
+				++iter;
+			}
+		}
+		if(!changed)
+		{
+			--_mapRevision;
+		}
+
+		// Only copy data of new or modified nodes
+		bool delta = sinceRevision >= _mapRevisionReset;
+		std::map<int, Signature> signatures;
+		std::set<int> removedIds;
+		for(std::map<int, std::pair<int, unsigned int> >::iterator iter=nodeRevisions.begin(); iter!=nodeRevisions.end(); ++iter)
+		{
+			if(dataIds.find(iter->first) != dataIds.end() && (!delta || iter->second.first > sinceRevision))
+			{
+				signatures.insert(std::make_pair(iter->first, _rtabmap->getSignatureCopy(iter->first, !graphOnly, !graphOnly, !graphOnly, !graphOnly, true, true)));
+			}
+		}
+		if(delta)
+		{
+			for(std::map<int, int>::iterator iter=removedNodeRevisions.begin(); iter!=removedNodeRevisions.end(); ++iter)
+			{
+				if(iter->second > sinceRevision)
+				{
+					removedIds.insert(iter->first);
+				}
+			}
+		}
+		UDEBUG("Publishing map revision %d (since %d, delta=%s): %d/%d nodes with data, %d removed (%fs)",
+				_mapRevision, sinceRevision, delta?"true":"false", (int)signatures.size(), (int)poses.size(), (int)removedIds.size(), timer.ticks());
+
+		this->post(new RtabmapEvent3DMap(
+				signatures,
+				poses,
+				constraints,
+				_mapRevision,
+				delta,
+				removedIds));
+	}
+	else if(_rtabmap)
 	{
 		std::map<int, Signature> signatures;
 		std::map<int, Transform> poses;
@@ -212,6 +356,7 @@ void RtabmapThread::mainLoop()
 		Parameters::parse(parameters, Parameters::kRtabmapCreateIntermediateNodes(), _createIntermediateNodes);
 		UASSERT(_rate >= 0.0f);
 		_rtabmap->init(parameters, str);
+		resetMapRevisions();
 		break;
 	case kStateChangingParameters:
 		Parameters::parse(parameters, Parameters::kRtabmapImageBufferSize(), _dataBufferMaxSize);
@@ -219,10 +364,12 @@ void RtabmapThread::mainLoop()
 		Parameters::parse(parameters, Parameters::kRtabmapCreateIntermediateNodes(), _createIntermediateNodes);
 		UASSERT(_rate >= 0.0f);
 		_rtabmap->parseParameters(parameters);
+		_globalOptimizedValid = false;
 		break;
 	case kStateReseting:
 		_rtabmap->resetMemory();
 		this->clearBufferedData();
+		resetMapRevisions();
 		break;
 	case kStateClose:
 		if(_dataBuffer.size())
@@ -231,6 +378,7 @@ void RtabmapThread::mainLoop()
 			this->clearBufferedData();
 		}
 		_rtabmap->close(uStr2Bool(parameters.at("saved")), parameters.at("outputPath"));
+		resetMapRevisions();
 		break;
 	case kStateDumpingMemory:
 		_rtabmap->dumpData();
@@ -258,7 +406,8 @@ void RtabmapThread::mainLoop()
 		this->publishMap(
 				uStr2Bool(parameters.at("optimized")),
 				uStr2Bool(parameters.at("global")),
-				uStr2Bool(parameters.at("graph_only")));
+				uStr2Bool(parameters.at("graph_only")),
+				uContains(parameters, "since_revision")?atoi(parameters.at("since_revision").c_str()):-1);
 		break;
 	case kStateTriggeringMap:
 		_rtabmap->triggerNewMap();
@@ -466,6 +615,10 @@ bool RtabmapThread::handleEvent(UEvent* event)
 				param.insert(ParametersPair("global", rtabmapEvent->value1().toStr()));
 				param.insert(ParametersPair("optimized", rtabmapEvent->value2().toStr()));
 				param.insert(ParametersPair("graph_only", rtabmapEvent->value3().toStr()));
+				if(rtabmapEvent->value4().isInt() || rtabmapEvent->value4().isUInt())
+				{
+					param.insert(ParametersPair("since_revision", rtabmapEvent->value4().toStr()));
+				}
 				pushNewState(kStatePublishingMap, param);
 			}
 			else if(cmd == RtabmapEventCmd::kCmdTriggerNewMap)
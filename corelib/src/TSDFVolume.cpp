@@ -0,0 +1,521 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/TSDFVolume.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <pcl/point_types.h>
+#include <pcl/conversions.h>
+#include <pcl/surface/marching_cubes.h> // for edgeTable and triTable
+#include <algorithm>
+#include <cmath>
+
+namespace rtabmap {
+
+// 21 bits per axis for blocks
+static const long long kBlockKeyOffset = 1<<20;
+static const long long kBlockKeyMask = (1<<21)-1;
+// 20 bits per axis + 2 bits for the axis for edges
+static const long long kEdgeKeyOffset = 1<<19;
+static const long long kEdgeKeyMask = (1<<20)-1;
+
+// Corners of a cube and its edges (lower corner first), same
+// convention than the tables in pcl/surface/marching_cubes.h
+static const int kCorners[8][3] = {{0,0,0},{1,0,0},{1,1,0},{0,1,0},{0,0,1},{1,0,1},{1,1,1},{0,1,1}};
+static const int kEdges[12][2] = {{0,1},{1,2},{3,2},{0,3},{4,5},{5,6},{7,6},{4,7},{0,4},{1,5},{2,6},{3,7}};
+
+static inline float depthValue(const cv::Mat & depth, int u, int v)
+{
+	float d = depth.type() == CV_32FC1?depth.at<float>(v,u):float(depth.at<unsigned short>(v,u))*0.001f;
+	return std::isfinite(d)?d:0.0f;
+}
+
+TSDFVolume::TSDFVolume(
+		float voxelSize,
+		float truncationDistance,
+		float maxDepth,
+		int blockSize,
+		float maxWeight) :
+	voxelSize_(voxelSize),
+	truncationDistance_(truncationDistance>0.0f?truncationDistance:voxelSize*4.0f),
+	maxDepth_(maxDepth),
+	blockSize_(blockSize),
+	maxWeight_(maxWeight),
+	integrations_(0)
+{
+	UASSERT(voxelSize_ > 0.0f);
+	UASSERT(blockSize_ > 0);
+	UASSERT(maxWeight_ >= 1.0f);
+}
+
+void TSDFVolume::clear()
+{
+	blocks_.clear();
+	integrations_ = 0;
+}
+
+unsigned long TSDFVolume::memoryUsed() const
+{
+	return blocks_.size() * (blockSize_*blockSize_*blockSize_*sizeof(Voxel) + sizeof(std::pair<long long, Block>) + 2*sizeof(void*));
+}
+
+long long TSDFVolume::blockKey(int x, int y, int z) const
+{
+	return ((((long long)x+kBlockKeyOffset)&kBlockKeyMask)<<42) |
+		   ((((long long)y+kBlockKeyOffset)&kBlockKeyMask)<<21) |
+		    (((long long)z+kBlockKeyOffset)&kBlockKeyMask);
+}
+
+void TSDFVolume::blockCoordinates(long long key, int & x, int & y, int & z) const
+{
+	x = int(((key>>42)&kBlockKeyMask) - kBlockKeyOffset);
+	y = int(((key>>21)&kBlockKeyMask) - kBlockKeyOffset);
+	z = int((key&kBlockKeyMask) - kBlockKeyOffset);
+}
+
+bool TSDFVolume::integrate(const SensorData & data, const Transform & pose)
+{
+	UASSERT(!pose.isNull());
+	cv::Mat depth = data.depthRaw();
+	if(depth.empty())
+	{
+		UWARN("Node %d: depth image is empty (is data uncompressed?), cannot integrate it in the TSDF volume.", data.id());
+		return false;
+	}
+	const std::vector<CameraModel> & models = data.cameraModels();
+	if(models.empty())
+	{
+		UWARN("Node %d: no camera calibration, cannot integrate it in the TSDF volume.", data.id());
+		return false;
+	}
+	UASSERT(depth.cols % models.size() == 0);
+	const cv::Mat & rgb = data.imageRaw();
+	int subDepthWidth = depth.cols/models.size();
+	int subRgbWidth = rgb.cols/models.size();
+	bool integrated = false;
+	for(unsigned int i=0; i<models.size(); ++i)
+	{
+		if(!models[i].isValidForProjection())
+		{
+			UWARN("Node %d: camera %d is not valid for projection, it is ignored.", data.id(), i);
+			continue;
+		}
+		integrated = integrate(
+				depth.colRange(i*subDepthWidth, (i+1)*subDepthWidth),
+				rgb.empty()?cv::Mat():rgb.colRange(i*subRgbWidth, (i+1)*subRgbWidth),
+				models[i],
+				pose * models[i].localTransform()) || integrated;
+	}
+	return integrated;
+}
+
+bool TSDFVolume::integrate(
+		const cv::Mat & depth,
+		const cv::Mat & rgb,
+		const CameraModel & model,
+		const Transform & cameraPose)
+{
+	UASSERT(!depth.empty() && (depth.type() == CV_32FC1 || depth.type() == CV_16UC1));
+	UASSERT(rgb.empty() || rgb.type() == CV_8UC3 || rgb.type() == CV_8UC1);
+	UASSERT(model.isValidForProjection());
+	UASSERT(!cameraPose.isNull());
+
+	// calibration at depth resolution
+	CameraModel m = model;
+	if(m.imageWidth() > 0 && m.imageWidth() != depth.cols)
+	{
+		m = m.scaled(double(depth.cols)/double(m.imageWidth()));
+	}
+	const float fx = m.fx();
+	const float fy = m.fy();
+	const float cx = m.cx();
+	const float cy = m.cy();
+	const float rgbScaleX = rgb.empty()?0.0f:float(rgb.cols)/float(depth.cols);
+	const float rgbScaleY = rgb.empty()?0.0f:float(rgb.rows)/float(depth.rows);
+
+	const Eigen::Affine3f camToWorld = cameraPose.toEigen3f();
+	const Eigen::Affine3f worldToCam = camToWorld.inverse();
+	const float blockLength = voxelSize_*float(blockSize_);
+	const float trunc = truncationDistance_;
+
+	// Blocks touched by the truncation band around the depth pixels. Every
+	// two pixels is enough as a block covers many pixels at usual ranges.
+	std::vector<long long> keys;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+		std::vector<long long> threadKeys;
+#ifdef _OPENMP
+#pragma omp for nowait
+#endif
+		for(int v=0; v<depth.rows; v+=2)
+		{
+			for(int u=0; u<depth.cols; u+=2)
+			{
+				float d = depthValue(depth, u, v);
+				if(d <= 0.0f || (maxDepth_ > 0.0f && d > maxDepth_))
+				{
+					continue;
+				}
+				Eigen::Vector3f ray((float(u)-cx)/fx, (float(v)-cy)/fy, 1.0f);
+				float end = d+trunc;
+				for(float s=std::max(0.0f, d-trunc); ; s+=blockLength/2.0f)
+				{
+					s = std::min(s, end);
+					Eigen::Vector3f p = camToWorld * (ray*s);
+					threadKeys.push_back(blockKey(
+							(int)std::floor(p[0]/blockLength),
+							(int)std::floor(p[1]/blockLength),
+							(int)std::floor(p[2]/blockLength)));
+					if(s >= end)
+					{
+						break;
+					}
+				}
+			}
+		}
+		std::sort(threadKeys.begin(), threadKeys.end());
+		threadKeys.erase(std::unique(threadKeys.begin(), threadKeys.end()), threadKeys.end());
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+		keys.insert(keys.end(), threadKeys.begin(), threadKeys.end());
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	if(keys.empty())
+	{
+		return false;
+	}
+
+	// Allocate missing blocks (not thread-safe)
+	const int voxelsPerBlock = blockSize_*blockSize_*blockSize_;
+	std::vector<Block*> touchedBlocks(keys.size());
+	for(size_t i=0; i<keys.size(); ++i)
+	{
+		Block & block = blocks_[keys[i]];
+		if(block.empty())
+		{
+			block.resize(voxelsPerBlock);
+		}
+		touchedBlocks[i] = &block;
+	}
+
+	// Update voxels, each block is updated by a single thread
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(int i=0; i<(int)keys.size(); ++i)
+	{
+		int bx,by,bz;
+		blockCoordinates(keys[i], bx, by, bz);
+		Block & block = *touchedBlocks[i];
+		for(int z=0; z<blockSize_; ++z)
+		{
+			for(int y=0; y<blockSize_; ++y)
+			{
+				for(int x=0; x<blockSize_; ++x)
+				{
+					Eigen::Vector3f pc = worldToCam * Eigen::Vector3f(
+							(float(bx*blockSize_+x)+0.5f)*voxelSize_,
+							(float(by*blockSize_+y)+0.5f)*voxelSize_,
+							(float(bz*blockSize_+z)+0.5f)*voxelSize_);
+					if(pc[2] <= 0.0f)
+					{
+						continue;
+					}
+					int u = int(fx*pc[0]/pc[2] + cx + 0.5f);
+					int v = int(fy*pc[1]/pc[2] + cy + 0.5f);
+					if(u < 0 || u >= depth.cols || v < 0 || v >= depth.rows)
+					{
+						continue;
+					}
+					float d = depthValue(depth, u, v);
+					if(d <= 0.0f || (maxDepth_ > 0.0f && d > maxDepth_))
+					{
+						continue;
+					}
+					float sdf = d - pc[2];
+					if(sdf < -trunc)
+					{
+						// occluded
+						continue;
+					}
+					float tsdf = std::min(1.0f, sdf/trunc);
+
+					Voxel & vox = block[(z*blockSize_ + y)*blockSize_ + x];
+					float w = vox.weight;
+					vox.tsdf = (vox.tsdf*w + tsdf)/(w+1.0f);
+					if(!rgb.empty() && sdf < trunc)
+					{
+						int ur = std::min(int(float(u)*rgbScaleX), rgb.cols-1);
+						int vr = std::min(int(float(v)*rgbScaleY), rgb.rows-1);
+						unsigned char b,g,r;
+						if(rgb.type() == CV_8UC3)
+						{
+							const unsigned char * bgr = rgb.ptr<unsigned char>(vr, ur);
+							b = bgr[0]; g = bgr[1]; r = bgr[2];
+						}
+						else
+						{
+							b = g = r = rgb.at<unsigned char>(vr, ur);
+						}
+						float cw = vox.colorWeight;
+						vox.r = (unsigned char)((float(vox.r)*cw + float(r))/(cw+1.0f) + 0.5f);
+						vox.g = (unsigned char)((float(vox.g)*cw + float(g))/(cw+1.0f) + 0.5f);
+						vox.b = (unsigned char)((float(vox.b)*cw + float(b))/(cw+1.0f) + 0.5f);
+						vox.colorWeight = std::min(cw+1.0f, maxWeight_);
+					}
+					vox.weight = std::min(w+1.0f, maxWeight_);
+				}
+			}
+		}
+	}
+	++integrations_;
+	UDEBUG("Integrated depth (%dx%d) in %d blocks (total blocks=%d)", depth.cols, depth.rows, (int)keys.size(), (int)blocks_.size());
+	return true;
+}
+
+pcl::PolygonMesh::Ptr TSDFVolume::extractMesh(const ProgressState * state) const
+{
+	pcl::PolygonMesh::Ptr mesh(new pcl::PolygonMesh);
+	if(blocks_.empty())
+	{
+		return mesh;
+	}
+
+	std::vector<long long> keys;
+	keys.reserve(blocks_.size());
+	for(std::unordered_map<long long, Block>::const_iterator iter=blocks_.begin(); iter!=blocks_.end(); ++iter)
+	{
+		keys.push_back(iter->first);
+	}
+	// deterministic output
+	std::sort(keys.begin(), keys.end());
+
+	// Marching cubes per block: each cube is extracted by the block
+	// containing its lower corner, neighbor blocks are only read. Vertices
+	// are identified by the edge they lie on, so that vertices on block
+	// borders are computed the same way and merged afterwards.
+	std::vector<std::vector<std::pair<long long, pcl::PointXYZRGBNormal> > > blockVertices(keys.size());
+	std::vector<std::vector<long long> > blockTriangles(keys.size());
+	const int B = blockSize_;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for(int i=0; i<(int)keys.size(); ++i)
+	{
+		int bx,by,bz;
+		blockCoordinates(keys[i], bx, by, bz);
+
+		// this block and its neighbors in +x, +y, +z
+		const Block * neighbors[2][2][2];
+		for(int dx=0; dx<2; ++dx)
+		{
+			for(int dy=0; dy<2; ++dy)
+			{
+				for(int dz=0; dz<2; ++dz)
+				{
+					std::unordered_map<long long, Block>::const_iterator iter = blocks_.find(blockKey(bx+dx, by+dy, bz+dz));
+					neighbors[dx][dy][dz] = iter!=blocks_.end()?&iter->second:0;
+				}
+			}
+		}
+
+		std::unordered_map<long long, int> edgeToVertex;
+		for(int z=0; z<B; ++z)
+		{
+			for(int y=0; y<B; ++y)
+			{
+				for(int x=0; x<B; ++x)
+				{
+					const Voxel * corners[8];
+					int cubeIndex = 0;
+					bool valid = true;
+					for(int c=0; c<8 && valid; ++c)
+					{
+						int cx = x+kCorners[c][0];
+						int cy = y+kCorners[c][1];
+						int cz = z+kCorners[c][2];
+						const Block * block = neighbors[cx/B][cy/B][cz/B];
+						if(block == 0)
+						{
+							valid = false;
+							break;
+						}
+						corners[c] = &(*block)[((cz%B)*B + (cy%B))*B + (cx%B)];
+						if(corners[c]->weight <= 0.0f)
+						{
+							valid = false;
+							break;
+						}
+						if(corners[c]->tsdf < 0.0f)
+						{
+							cubeIndex |= 1<<c;
+						}
+					}
+					if(!valid || pcl::edgeTable[cubeIndex] == 0)
+					{
+						continue;
+					}
+
+					int gx = bx*B+x;
+					int gy = by*B+y;
+					int gz = bz*B+z;
+					long long edgeKeys[12];
+					for(int e=0; e<12; ++e)
+					{
+						if((pcl::edgeTable[cubeIndex] & (1<<e)) == 0)
+						{
+							continue;
+						}
+						const int * a = kCorners[kEdges[e][0]];
+						const int * b = kCorners[kEdges[e][1]];
+						int axis = a[0]!=b[0]?0:a[1]!=b[1]?1:2;
+						edgeKeys[e] =
+								((((long long)(gx+a[0])+kEdgeKeyOffset)&kEdgeKeyMask)<<42) |
+								((((long long)(gy+a[1])+kEdgeKeyOffset)&kEdgeKeyMask)<<22) |
+								((((long long)(gz+a[2])+kEdgeKeyOffset)&kEdgeKeyMask)<<2) |
+								axis;
+						if(edgeToVertex.find(edgeKeys[e]) == edgeToVertex.end())
+						{
+							const Voxel & va = *corners[kEdges[e][0]];
+							const Voxel & vb = *corners[kEdges[e][1]];
+							float t = va.tsdf/(va.tsdf-vb.tsdf);
+							pcl::PointXYZRGBNormal pt;
+							pt.x = (float(gx+a[0]) + t*float(b[0]-a[0]) + 0.5f)*voxelSize_;
+							pt.y = (float(gy+a[1]) + t*float(b[1]-a[1]) + 0.5f)*voxelSize_;
+							pt.z = (float(gz+a[2]) + t*float(b[2]-a[2]) + 0.5f)*voxelSize_;
+							pt.r = (unsigned char)(float(va.r) + t*(float(vb.r)-float(va.r)) + 0.5f);
+							pt.g = (unsigned char)(float(va.g) + t*(float(vb.g)-float(va.g)) + 0.5f);
+							pt.b = (unsigned char)(float(va.b) + t*(float(vb.b)-float(va.b)) + 0.5f);
+							pt.normal_x = pt.normal_y = pt.normal_z = 0.0f;
+							edgeToVertex.insert(std::make_pair(edgeKeys[e], (int)blockVertices[i].size()));
+							blockVertices[i].push_back(std::make_pair(edgeKeys[e], pt));
+						}
+					}
+
+					// gradient of the cube, pointing outside of the surface
+					Eigen::Vector3f gradient(
+							corners[1]->tsdf + corners[2]->tsdf + corners[5]->tsdf + corners[6]->tsdf - corners[0]->tsdf - corners[3]->tsdf - corners[4]->tsdf - corners[7]->tsdf,
+							corners[2]->tsdf + corners[3]->tsdf + corners[6]->tsdf + corners[7]->tsdf - corners[0]->tsdf - corners[1]->tsdf - corners[4]->tsdf - corners[5]->tsdf,
+							corners[4]->tsdf + corners[5]->tsdf + corners[6]->tsdf + corners[7]->tsdf - corners[0]->tsdf - corners[1]->tsdf - corners[2]->tsdf - corners[3]->tsdf);
+					for(int t=0; pcl::triTable[cubeIndex][t] != -1; t+=3)
+					{
+						long long k0 = edgeKeys[pcl::triTable[cubeIndex][t]];
+						long long k1 = edgeKeys[pcl::triTable[cubeIndex][t+1]];
+						long long k2 = edgeKeys[pcl::triTable[cubeIndex][t+2]];
+						const pcl::PointXYZRGBNormal & p0 = blockVertices[i][edgeToVertex.at(k0)].second;
+						const pcl::PointXYZRGBNormal & p1 = blockVertices[i][edgeToVertex.at(k1)].second;
+						const pcl::PointXYZRGBNormal & p2 = blockVertices[i][edgeToVertex.at(k2)].second;
+						Eigen::Vector3f normal = (p1.getVector3fMap()-p0.getVector3fMap()).cross(p2.getVector3fMap()-p0.getVector3fMap());
+						blockTriangles[i].push_back(k0);
+						if(normal.dot(gradient) < 0.0f)
+						{
+							blockTriangles[i].push_back(k2);
+							blockTriangles[i].push_back(k1);
+						}
+						else
+						{
+							blockTriangles[i].push_back(k1);
+							blockTriangles[i].push_back(k2);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if(state)
+	{
+		if(state->isCanceled())
+		{
+			return mesh;
+		}
+		state->callback(uFormat("Extracted surface of %d blocks", (int)keys.size()));
+	}
+
+	// Merge blocks, shared vertices on block borders are added once
+	pcl::PointCloud<pcl::PointXYZRGBNormal> cloud;
+	std::unordered_map<long long, int> vertexIndices;
+	for(size_t i=0; i<keys.size(); ++i)
+	{
+		for(size_t j=0; j<blockVertices[i].size(); ++j)
+		{
+			if(vertexIndices.insert(std::make_pair(blockVertices[i][j].first, (int)cloud.size())).second)
+			{
+				cloud.push_back(blockVertices[i][j].second);
+			}
+		}
+		std::vector<std::pair<long long, pcl::PointXYZRGBNormal> >().swap(blockVertices[i]);
+	}
+	for(size_t i=0; i<keys.size(); ++i)
+	{
+		for(size_t j=0; j<blockTriangles[i].size(); j+=3)
+		{
+			pcl::Vertices polygon;
+			polygon.vertices.resize(3);
+			for(int k=0; k<3; ++k)
+			{
+				polygon.vertices[k] = vertexIndices.at(blockTriangles[i][j+k]);
+			}
+			if(polygon.vertices[0] == polygon.vertices[1] ||
+			   polygon.vertices[1] == polygon.vertices[2] ||
+			   polygon.vertices[0] == polygon.vertices[2])
+			{
+				continue;
+			}
+
+			// area-weighted vertex normals
+			Eigen::Vector3f normal =
+					(cloud.at(polygon.vertices[1]).getVector3fMap()-cloud.at(polygon.vertices[0]).getVector3fMap()).cross(
+					 cloud.at(polygon.vertices[2]).getVector3fMap()-cloud.at(polygon.vertices[0]).getVector3fMap());
+			for(int k=0; k<3; ++k)
+			{
+				cloud.at(polygon.vertices[k]).getNormalVector3fMap() += normal;
+			}
+			mesh->polygons.push_back(polygon);
+		}
+	}
+	for(size_t i=0; i<cloud.size(); ++i)
+	{
+		float norm = cloud.at(i).getNormalVector3fMap().norm();
+		if(norm > 0.0f)
+		{
+			cloud.at(i).getNormalVector3fMap() /= norm;
+		}
+	}
+	pcl::toPCLPointCloud2(cloud, mesh->cloud);
+
+	UDEBUG("Extracted mesh from %d blocks: %d vertices, %d polygons", (int)keys.size(), (int)cloud.size(), (int)mesh->polygons.size());
+	return mesh;
+}
+
+} /* namespace rtabmap */
@@ -32,6 +32,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/DBDriver.h"
 #include "rtabmap/core/Parameters.h"
 #include "rtabmap/core/FlannIndex.h"
+#include "rtabmap/core/ProductQuantizer.h"
+#include "rtabmap/core/VocabularyTree.h"
 
 #include "rtabmap/utilite/UtiLite.h"
 
@@ -50,9 +52,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <fstream>
 #include <string>
+#include <algorithm>
 
 #define KDTREE_SIZE 4
 #define KNN_CHECKS 32
+#define PQ_TRAINING_WORDS_PER_CENTROID 40
+#define PQ_MAX_TRAINING_WORDS 65536
+#define PQ_ENCODING_BATCH 4096
+#define VOCTREE_BRANCHING 10
+#define VOCTREE_LEAF_SIZE 10
 
 namespace rtabmap
 {
@@ -71,7 +79,17 @@ VWDictionary::VWDictionary(const ParametersMap & parameters) :
 	_newWordsComparedTogether(Parameters::defaultKpNewWordsComparedTogether()),
 	_lastWordId(0),
 	useDistanceL1_(false),
+	_pqSubQuantizers(Parameters::defaultKpPQSubQuantizers()),
+	_pqCentroids(Parameters::defaultKpPQCentroids()),
+	_pqCoarseCentroids(Parameters::defaultKpPQCoarseCentroids()),
+	_pqNProbe(Parameters::defaultKpPQNProbe()),
+	_pqRerank(Parameters::defaultKpPQRerank()),
+	_pqPagedDescriptors(Parameters::defaultKpPQPagedDescriptors()),
+	_pqPagedCacheSize(Parameters::defaultKpPQPagedCacheSize()),
 	_flannIndex(new FlannIndex()),
+	_productQuantizer(new ProductQuantizer()),
+	_vocabularyTree(new VocabularyTree()),
+	_pagedDriver(0),
 	_strategy(kNNBruteForce)
 {
 	this->setNNStrategy((NNStrategy)Parameters::defaultKpNNStrategy());
@@ -82,6 +100,8 @@ VWDictionary::~VWDictionary()
 {
 	this->clear();
 	delete _flannIndex;
+	delete _productQuantizer;
+	delete _vocabularyTree;
 }
 
 void VWDictionary::parseParameters(const ParametersMap & parameters)
@@ -93,6 +113,16 @@ void VWDictionary::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kKpFlannRebalancingFactor(), _rebalancingFactor);
 	bool byteToFloat = _byteToFloat;
 	Parameters::parse(parameters, Parameters::kKpByteToFloat(), _byteToFloat);
+	int pqSubQuantizers = _pqSubQuantizers;
+	int pqCentroids = _pqCentroids;
+	int pqCoarseCentroids = _pqCoarseCentroids;
+	Parameters::parse(parameters, Parameters::kKpPQSubQuantizers(), _pqSubQuantizers);
+	Parameters::parse(parameters, Parameters::kKpPQCentroids(), _pqCentroids);
+	Parameters::parse(parameters, Parameters::kKpPQCoarseCentroids(), _pqCoarseCentroids);
+	Parameters::parse(parameters, Parameters::kKpPQNProbe(), _pqNProbe);
+	Parameters::parse(parameters, Parameters::kKpPQRerank(), _pqRerank);
+	Parameters::parse(parameters, Parameters::kKpPQPagedDescriptors(), _pqPagedDescriptors);
+	Parameters::parse(parameters, Parameters::kKpPQPagedCacheSize(), _pqPagedCacheSize);
 
 	UASSERT_MSG(_nndrRatio > 0.0f, uFormat("String=%s value=%f", uContains(parameters, Parameters::kKpNndrRatio())?parameters.at(Parameters::kKpNndrRatio()).c_str():"", _nndrRatio).c_str());
 
@@ -113,7 +143,7 @@ void VWDictionary::parseParameters(const ParametersMap & parameters)
 		NNStrategy nnStrategy = (NNStrategy)std::atoi((*iter).second.c_str());
 		treeUpdated = this->setNNStrategy(nnStrategy);
 	}
-	if(!treeUpdated && byteToFloat!=_byteToFloat && _strategy == kNNFlannKdTree)
+	if(!treeUpdated && byteToFloat!=_byteToFloat && _strategy == kNNFlannKdTree && !this->isQuantized())
 	{
 		UINFO("KDTree: Binary to Float conversion approach has changed, re-initialize kd-tree.");
 		_dataTree = cv::Mat();
@@ -121,6 +151,30 @@ void VWDictionary::parseParameters(const ParametersMap & parameters)
 		_removedIndexedWords.clear();
 		this->update();
 	}
+	if(this->isQuantized() && (pqSubQuantizers != _pqSubQuantizers || pqCentroids != _pqCentroids || pqCoarseCentroids != _pqCoarseCentroids))
+	{
+		if(_pagedDriver)
+		{
+			UWARN("Product quantization: \"%s\", \"%s\" and \"%s\" cannot be changed while descriptors are paged, "
+				  "the fixed dictionary should be reloaded.",
+				  Parameters::kKpPQSubQuantizers().c_str(), Parameters::kKpPQCentroids().c_str(), Parameters::kKpPQCoarseCentroids().c_str());
+			_pqSubQuantizers = pqSubQuantizers;
+			_pqCentroids = pqCentroids;
+			_pqCoarseCentroids = pqCoarseCentroids;
+		}
+		else
+		{
+			UINFO("Product quantization parameters have changed, re-initialize search index.");
+			_productQuantizer->release();
+			_flannIndex->release();
+			_dataTree = cv::Mat();
+			_mapIndexId.clear();
+			_mapIdIndex.clear();
+			_notIndexedWords = uKeysSet(_visualWords);
+			_removedIndexedWords.clear();
+			this->update();
+		}
+	}
 
 	if(incrementalDictionary)
 	{
@@ -166,7 +220,16 @@ void VWDictionary::setFixedDictionary(const std::string & dictionaryPath)
 						iter->second->setSaved(true);
 					}
 					_incrementalDictionary = _visualWords.size()==0;
-					driver->closeConnection(false);
+					if(_pqSubQuantizers > 0 && _pqPagedDescriptors && _pagedDriver == 0 && _visualWords.size())
+					{
+						// Keep the database opened to load back descriptors released after quantization
+						_pagedDriver = driver;
+						driver = 0;
+					}
+					else
+					{
+						driver->closeConnection(false);
+					}
 				}
 				else
 				{
@@ -329,6 +392,11 @@ bool VWDictionary::setNNStrategy(NNStrategy strategy)
 
 	bool update = _strategy != strategy;
 	_strategy = strategy;
+	if(update && this->isQuantized())
+	{
+		// the search index of the strategy is not used with product quantization
+		return false;
+	}
 	if(update)
 	{
 		if(_notIndexedWords.size() != _visualWords.size() || !_dataTree.empty())
@@ -336,6 +404,7 @@ bool VWDictionary::setNNStrategy(NNStrategy strategy)
 			UINFO("Nearest neighbor strategy has changed, re-initialize search tree.");
 		}
 		_dataTree = cv::Mat();
+		_vocabularyTree->release();
 		_notIndexedWords = uKeysSet(_visualWords);
 		_removedIndexedWords.clear();
 		this->update();
@@ -358,12 +427,21 @@ int VWDictionary::getLastIndexedWordId() const
 
 unsigned int VWDictionary::getIndexedWordsCount() const
 {
+	if(this->isQuantized())
+	{
+		return _productQuantizer->indexedFeatures();
+	}
 	return _flannIndex->indexedFeatures();
 }
 
 unsigned int VWDictionary::getIndexMemoryUsed() const
 {
-	return _flannIndex->memoryUsed();
+	return _flannIndex->memoryUsed() + _productQuantizer->memoryUsed() + _vocabularyTree->memoryUsed();
+}
+
+bool VWDictionary::isQuantized() const
+{
+	return _productQuantizer->isTrained();
 }
 
 unsigned long VWDictionary::getMemoryUsed() const
@@ -391,6 +469,10 @@ unsigned long VWDictionary::getMemoryUsed() const
 	memoryUsage += _mapIdIndex.size() * (sizeof(int)*2+sizeof(std::map<int ,int>::iterator)) + sizeof(std::map<int ,int>);
 	memoryUsage += _notIndexedWords.size() * (sizeof(int)+sizeof(std::set<int>::iterator)) + sizeof(std::set<int>);
 	memoryUsage += _removedIndexedWords.size() * (sizeof(int)+sizeof(std::set<int>::iterator)) + sizeof(std::set<int>);
+	if(!_pagedCache.empty())
+	{
+		memoryUsage += _pagedCache.size() * (sizeof(int)*2 + sizeof(cv::Mat) + sizeof(std::list<int>::iterator)*2 + _pagedCache.begin()->second.first.total()*_pagedCache.begin()->second.first.elemSize());
+	}
 	return memoryUsage;
 }
 
@@ -467,6 +549,7 @@ cv::Mat VWDictionary::convert32FToBin(const cv::Mat & descriptorsIn, bool byteTo
 
 void VWDictionary::update()
 {
+	UPROFILER_ZONE("VWDictionary::update");
 	ULOGGER_DEBUG("incremental=%d", _incrementalDictionary?1:0);
 	if(!_incrementalDictionary)
 	{
@@ -482,6 +565,13 @@ void VWDictionary::update()
 		}
 	}
 
+	if(this->updateProductQuantization())
+	{
+		_notIndexedWords.clear();
+		_removedIndexedWords.clear();
+		return;
+	}
+
 	if(_notIndexedWords.size() || _visualWords.size() == 0 || _removedIndexedWords.size())
 	{
 		if(_incrementalFlann &&
@@ -565,6 +655,7 @@ void VWDictionary::update()
 			}
 		}
 		else if(_strategy >= kNNBruteForce &&
+				!_vocabularyTree->isBuilt() &&
 				_notIndexedWords.size() &&
 				_removedIndexedWords.size() == 0 &&
 				_visualWords.size() &&
@@ -592,69 +683,23 @@ void VWDictionary::update()
 			_mapIdIndex.clear();
 			_dataTree = cv::Mat();
 			_flannIndex->release();
+			_vocabularyTree->release();
 
 			if(_visualWords.size())
 			{
 				UTimer timer;
 				timer.start();
 
-				int dim = _visualWords.begin()->second->getDescriptor().cols;
-				int type;
-				if(_visualWords.begin()->second->getDescriptor().type() == CV_8U)
-				{
-					useDistanceL1_ = true;
-					if(_strategy == kNNFlannKdTree)
-					{
-						type = CV_32F;
-						if(!_byteToFloat)
-						{
-							dim *= 8;
-						}
-					}
-					else
-					{
-						type = _visualWords.begin()->second->getDescriptor().type();
-					}
-				}
-				else
-				{
-					type = _visualWords.begin()->second->getDescriptor().type();
-				}
-
-				UASSERT(type == CV_32F || type == CV_8U);
-				UASSERT(dim > 0);
-
-				// Create the data matrix
-				_dataTree = cv::Mat(_visualWords.size(), dim, type); // SURF descriptors are CV_32F
+				_dataTree = createDataTree(useDistanceL1_);
+				int type = _dataTree.type();
 				std::map<int, VisualWord*>::const_iterator iter = _visualWords.begin();
-				for(unsigned int i=0; i < _visualWords.size(); ++i, ++iter)
+				for(int i=0; i < _dataTree.rows; ++i, ++iter)
 				{
-					cv::Mat descriptor;
-					if(iter->second->getDescriptor().type() == CV_8U)
-					{
-						if(_strategy == kNNFlannKdTree)
-						{
-							descriptor = convertBinTo32F(iter->second->getDescriptor(), _byteToFloat);
-						}
-						else
-						{
-							descriptor = iter->second->getDescriptor();
-						}
-					}
-					else
-					{
-						descriptor = iter->second->getDescriptor();
-					}
-
-					UASSERT_MSG(descriptor.type() == type, uFormat("%d vs %d", descriptor.type(), type).c_str());
-					UASSERT_MSG(descriptor.cols == dim, uFormat("%d vs %d", descriptor.cols, dim).c_str());
-
-					descriptor.copyTo(_dataTree.row(i));
 					_mapIndexId.insert(_mapIndexId.end(), std::pair<int, int>(i, iter->second->id()));
 					_mapIdIndex.insert(_mapIdIndex.end(), std::pair<int, int>(iter->second->id(), i));
 				}
 
-				ULOGGER_DEBUG("_mapIndexId.size() = %d, words.size()=%d, _dim=%d",_mapIndexId.size(), _visualWords.size(), dim);
+				ULOGGER_DEBUG("_mapIndexId.size() = %d, words.size()=%d, _dim=%d",_mapIndexId.size(), _visualWords.size(), _dataTree.cols);
 				ULOGGER_DEBUG("copying data = %f s", timer.ticks());
 
 				switch(_strategy)
@@ -670,6 +715,18 @@ void VWDictionary::update()
 					UASSERT_MSG(type == CV_8U, "To use LSH dictionary, binary descriptors are required!");
 					_flannIndex->buildLSHIndex(_dataTree, 12, 20, 2, _incrementalDictionary&&_incrementalFlann?_rebalancingFactor:1);
 					break;
+				case kNNVocabularyTree:
+					if(_incrementalDictionary)
+					{
+						UWARN("Vocabulary tree strategy can only be used with a fixed dictionary, doing brute force instead.");
+					}
+					else if(!UFile::exists(_dictionaryPath + ".tree") || !_vocabularyTree->load(_dictionaryPath + ".tree", _dataTree))
+					{
+						UINFO("Building vocabulary tree of %d words...", _dataTree.rows);
+						_vocabularyTree->build(_dataTree, VOCTREE_BRANCHING, VOCTREE_LEAF_SIZE);
+						UINFO("Building vocabulary tree of %d words... done! (depth=%d leaves=%d)", _dataTree.rows, _vocabularyTree->depth(), _vocabularyTree->leaves());
+					}
+					break;
 				default:
 					break;
 				}
@@ -689,6 +746,353 @@ void VWDictionary::update()
 	UDEBUG("");
 }
 
+cv::Mat VWDictionary::createDataTree(bool & useDistanceL1) const
+{
+	UASSERT(_visualWords.size());
+	int dim = _visualWords.begin()->second->getDescriptor().cols;
+	int type;
+	if(_visualWords.begin()->second->getDescriptor().type() == CV_8U)
+	{
+		useDistanceL1 = true;
+		if(_strategy == kNNFlannKdTree)
+		{
+			type = CV_32F;
+			if(!_byteToFloat)
+			{
+				dim *= 8;
+			}
+		}
+		else
+		{
+			type = _visualWords.begin()->second->getDescriptor().type();
+		}
+	}
+	else
+	{
+		type = _visualWords.begin()->second->getDescriptor().type();
+	}
+
+	UASSERT(type == CV_32F || type == CV_8U);
+	UASSERT(dim > 0);
+
+	// Create the data matrix
+	cv::Mat dataTree(_visualWords.size(), dim, type); // SURF descriptors are CV_32F
+	std::map<int, VisualWord*>::const_iterator iter = _visualWords.begin();
+	for(unsigned int i=0; i < _visualWords.size(); ++i, ++iter)
+	{
+		cv::Mat descriptor;
+		if(iter->second->getDescriptor().type() == CV_8U)
+		{
+			if(_strategy == kNNFlannKdTree)
+			{
+				descriptor = convertBinTo32F(iter->second->getDescriptor(), _byteToFloat);
+			}
+			else
+			{
+				descriptor = iter->second->getDescriptor();
+			}
+		}
+		else
+		{
+			descriptor = iter->second->getDescriptor();
+		}
+
+		UASSERT_MSG(descriptor.type() == type, uFormat("%d vs %d", descriptor.type(), type).c_str());
+		UASSERT_MSG(descriptor.cols == dim, uFormat("%d vs %d", descriptor.cols, dim).c_str());
+
+		descriptor.copyTo(dataTree.row(i));
+	}
+	return dataTree;
+}
+
+bool VWDictionary::isIndexSerializable() const
+{
+	return _incrementalDictionary &&
+		   _strategy < kNNBruteForce &&
+		   _pqSubQuantizers <= 0 &&
+		   _visualWords.size();
+}
+
+bool VWDictionary::saveIndex(const std::string & path) const
+{
+	if(!this->isIndexSerializable())
+	{
+		UDEBUG("Search index of the dictionary cannot be saved (incremental=%d strategy=%s words=%d)",
+				_incrementalDictionary?1:0, nnStrategyName(_strategy).c_str(), (int)_visualWords.size());
+		return false;
+	}
+
+	// The current index may have been modified incrementally, save a
+	// new one with the same layout than a full update().
+	UTimer timer;
+	bool useDistanceL1 = useDistanceL1_;
+	cv::Mat dataTree = createDataTree(useDistanceL1);
+	FlannIndex index;
+	switch(_strategy)
+	{
+	case kNNFlannNaive:
+		index.buildLinearIndex(dataTree, useDistanceL1);
+		break;
+	case kNNFlannKdTree:
+		UASSERT_MSG(dataTree.type() == CV_32F, "To use KdTree dictionary, float descriptors are required!");
+		index.buildKDTreeIndex(dataTree, KDTREE_SIZE, useDistanceL1);
+		break;
+	case kNNFlannLSH:
+		UASSERT_MSG(dataTree.type() == CV_8U, "To use LSH dictionary, binary descriptors are required!");
+		index.buildLSHIndex(dataTree, 12, 20, 2);
+		break;
+	default:
+		UFATAL("Not supposed to be here!");
+		break;
+	}
+	if(!index.save(path))
+	{
+		return false;
+	}
+	UINFO("Saved search index of %d words to \"%s\" (%fs)", dataTree.rows, path.c_str(), timer.ticks());
+	return true;
+}
+
+bool VWDictionary::loadIndex(const std::string & path)
+{
+	if(!this->isIndexSerializable() || !UFile::exists(path))
+	{
+		return false;
+	}
+
+	UTimer timer;
+	_mapIndexId.clear();
+	_mapIdIndex.clear();
+	_flannIndex->release();
+	_dataTree = createDataTree(useDistanceL1_);
+	if(!_flannIndex->load(path, _dataTree, useDistanceL1_, _incrementalFlann?_rebalancingFactor:1))
+	{
+		_dataTree = cv::Mat();
+		return false;
+	}
+	std::map<int, VisualWord*>::const_iterator iter = _visualWords.begin();
+	for(int i=0; i < _dataTree.rows; ++i, ++iter)
+	{
+		_mapIndexId.insert(_mapIndexId.end(), std::pair<int, int>(i, iter->second->id()));
+		_mapIdIndex.insert(_mapIdIndex.end(), std::pair<int, int>(iter->second->id(), i));
+	}
+	_notIndexedWords.clear();
+	_removedIndexedWords.clear();
+	UINFO("Loaded search index of %d words from \"%s\" (%fs)", _dataTree.rows, path.c_str(), timer.ticks());
+	return true;
+}
+
+bool VWDictionary::updateProductQuantization()
+{
+	if(_productQuantizer->isTrained() && _visualWords.empty())
+	{
+		// codebooks will be trained again with the new words
+		_productQuantizer->release();
+	}
+	if(_pqSubQuantizers <= 0 ||
+	   _visualWords.empty() ||
+	   _visualWords.begin()->second->getDescriptor().type() != CV_32F)
+	{
+		return false;
+	}
+
+	int dim = _visualWords.begin()->second->getDescriptor().cols;
+	if(!_productQuantizer->isTrained())
+	{
+		if(dim % _pqSubQuantizers != 0 || _pqCentroids < 2 || _pqCentroids > 256)
+		{
+			UERROR("Product quantization cannot be used: descriptor size (%d) should be a multiple of %s (%d) "
+					"and %s (%d) should be between 2 and 256. Product quantization is disabled.",
+					dim, Parameters::kKpPQSubQuantizers().c_str(), _pqSubQuantizers,
+					Parameters::kKpPQCentroids().c_str(), _pqCentroids);
+			_pqSubQuantizers = 0;
+			return false;
+		}
+		if((int)_visualWords.size() < (_pqCoarseCentroids>_pqCentroids?_pqCoarseCentroids:_pqCentroids) * PQ_TRAINING_WORDS_PER_CENTROID)
+		{
+			// Not enough words to train the codebooks, the search index of the strategy is used until then
+			return false;
+		}
+
+		UTimer timer;
+		UINFO("Training product quantization (%d sub-quantizers, %d centroids, %d coarse centroids) with %d words...",
+				_pqSubQuantizers, _pqCentroids, _pqCoarseCentroids>0?_pqCoarseCentroids:0, (int)_visualWords.size());
+		// uniform sub-sampling of the words to train on
+		int step = (int)_visualWords.size() > PQ_MAX_TRAINING_WORDS?(int)_visualWords.size()/PQ_MAX_TRAINING_WORDS:1;
+		cv::Mat samples((int)_visualWords.size()/step, dim, CV_32F);
+		std::map<int, VisualWord*>::const_iterator iter = _visualWords.begin();
+		for(int i=0; i<samples.rows; ++i)
+		{
+			UASSERT(iter->second->getDescriptor().cols == dim && iter->second->getDescriptor().type() == CV_32F);
+			iter->second->getDescriptor().copyTo(samples.row(i));
+			std::advance(iter, step);
+		}
+		if(!_productQuantizer->train(samples, _pqSubQuantizers, _pqCentroids, 10, PQ_MAX_TRAINING_WORDS, _pqCoarseCentroids>0?_pqCoarseCentroids:0))
+		{
+			UERROR("Failed to train product quantization, it is disabled.");
+			_pqSubQuantizers = 0;
+			return false;
+		}
+		UINFO("Training product quantization... done! (%fs)", timer.ticks());
+
+		// Replace the search index of the strategy
+		_flannIndex->release();
+		_vocabularyTree->release();
+		_dataTree = cv::Mat();
+		_mapIndexId.clear();
+		_mapIdIndex.clear();
+		_notIndexedWords = uKeysSet(_visualWords);
+		_removedIndexedWords.clear();
+	}
+
+	for(std::set<int>::iterator iter=_removedIndexedWords.begin(); iter!=_removedIndexedWords.end(); ++iter)
+	{
+		UASSERT(uContains(_mapIdIndex, *iter));
+		_productQuantizer->removePoint(_mapIdIndex.at(*iter));
+		_mapIndexId.erase(_mapIdIndex.at(*iter));
+		_mapIdIndex.erase(*iter);
+	}
+
+	int released = 0;
+	std::vector<int> ids(_notIndexedWords.begin(), _notIndexedWords.end());
+	for(unsigned int i=0; i<ids.size(); i+=PQ_ENCODING_BATCH)
+	{
+		unsigned int end = i+PQ_ENCODING_BATCH<ids.size()?i+PQ_ENCODING_BATCH:ids.size();
+		std::vector<VisualWord*> words(end-i);
+		cv::Mat descriptors(end-i, dim, CV_32F);
+		for(unsigned int j=i; j<end; ++j)
+		{
+			VisualWord* w = uValue(_visualWords, ids[j], (VisualWord*)0);
+			UASSERT(w);
+			UASSERT(w->getDescriptor().cols == dim && w->getDescriptor().type() == CV_32F);
+			w->getDescriptor().copyTo(descriptors.row(j-i));
+			words[j-i] = w;
+		}
+		std::vector<unsigned int> indices = _productQuantizer->addPoints(descriptors);
+		UASSERT(indices.size() == words.size());
+		for(unsigned int j=0; j<words.size(); ++j)
+		{
+			std::pair<std::map<int, int>::iterator, bool> inserted;
+			inserted = _mapIndexId.insert(std::pair<int, int>(indices[j], words[j]->id()));
+			UASSERT(inserted.second);
+			inserted = _mapIdIndex.insert(std::pair<int, int>(words[j]->id(), indices[j]));
+			UASSERT(inserted.second);
+
+			// The first word keeps its descriptor as reference of the dictionary's descriptor format
+			if(_pagedDriver && words[j]->isSaved() && words[j]->id() != _visualWords.begin()->first)
+			{
+				words[j]->releaseDescriptor();
+				++released;
+			}
+		}
+	}
+
+	UDEBUG("Dictionary updated with product quantization! (indexed=%d added=%d removed=%d released=%d)",
+			(int)_productQuantizer->indexedFeatures(), (int)_notIndexedWords.size(), (int)_removedIndexedWords.size(), released);
+	return true;
+}
+
+void VWDictionary::searchQuantized(
+		const cv::Mat & query,
+		std::vector<std::vector<cv::DMatch> > & matches,
+		int k) const
+{
+	UPROFILER_ZONE("VWDictionary::searchQuantized");
+	UASSERT(this->isQuantized());
+	cv::Mat indices;
+	cv::Mat dists;
+	_productQuantizer->knnSearch(query, indices, dists, _pqRerank>k?_pqRerank:k, _pqNProbe);
+
+	// Paged descriptors of the candidates, from the cache or loaded back from the database
+	std::map<int, cv::Mat> pagedDescriptors;
+	if(_pqRerank > 0 && _pagedDriver)
+	{
+		std::set<int> ids;
+		int cached = 0;
+		for(int i=0; i<indices.rows; ++i)
+		{
+			const int * idx = indices.ptr<int>(i);
+			for(int j=0; j<indices.cols && idx[j]>=0; ++j)
+			{
+				int id = uValue(_mapIndexId, idx[j], 0);
+				const VisualWord * vw = uValue(_visualWords, id, (VisualWord*)0);
+				if(vw && vw->getDescriptor().empty() && pagedDescriptors.find(id) == pagedDescriptors.end())
+				{
+					std::map<int, std::pair<cv::Mat, std::list<int>::iterator> >::iterator jter = _pagedCache.find(id);
+					if(jter != _pagedCache.end())
+					{
+						// most recently used
+						_pagedCacheUsage.splice(_pagedCacheUsage.begin(), _pagedCacheUsage, jter->second.second);
+						pagedDescriptors.insert(std::make_pair(id, jter->second.first));
+						++cached;
+					}
+					else
+					{
+						ids.insert(id);
+					}
+				}
+			}
+		}
+		if(ids.size())
+		{
+			std::list<VisualWord*> vws;
+			_pagedDriver->loadWords(ids, vws);
+			for(std::list<VisualWord*>::iterator iter=vws.begin(); iter!=vws.end(); ++iter)
+			{
+				cv::Mat descriptor = (*iter)->getDescriptor().clone();
+				pagedDescriptors.insert(std::make_pair((*iter)->id(), descriptor));
+				if(_pqPagedCacheSize > 0)
+				{
+					_pagedCacheUsage.push_front((*iter)->id());
+					_pagedCache.insert(std::make_pair((*iter)->id(), std::make_pair(descriptor, _pagedCacheUsage.begin())));
+				}
+				delete *iter;
+			}
+		}
+		// Release the least recently used descriptors
+		while((int)_pagedCache.size() > (_pqPagedCacheSize>0?_pqPagedCacheSize:0))
+		{
+			_pagedCache.erase(_pagedCacheUsage.back());
+			_pagedCacheUsage.pop_back();
+		}
+		UDEBUG("Paged descriptors: %d cached, %d loaded (cache=%d)", cached, (int)ids.size(), (int)_pagedCache.size());
+	}
+
+	// Re-rank candidates with exact distances
+	matches.resize(query.rows);
+	for(int i=0; i<query.rows; ++i)
+	{
+		const int * idx = indices.ptr<int>(i);
+		const float * dst = dists.ptr<float>(i);
+		std::vector<cv::DMatch> & queryMatches = matches[i];
+		queryMatches.clear();
+		for(int j=0; j<indices.cols && idx[j]>=0; ++j)
+		{
+			float d = dst[j];
+			if(_pqRerank > 0)
+			{
+				int id = uValue(_mapIndexId, idx[j], 0);
+				const VisualWord * vw = uValue(_visualWords, id, (VisualWord*)0);
+				cv::Mat descriptor;
+				if(vw)
+				{
+					descriptor = vw->getDescriptor().empty()?uValue(pagedDescriptors, id, cv::Mat()):vw->getDescriptor();
+				}
+				if(!descriptor.empty())
+				{
+					d = (float)cv::norm(query.row(i), descriptor, cv::NORM_L2SQR);
+				}
+			}
+			queryMatches.push_back(cv::DMatch(i, idx[j], d));
+		}
+		std::sort(queryMatches.begin(), queryMatches.end());
+		if((int)queryMatches.size() > k)
+		{
+			queryMatches.resize(k);
+		}
+	}
+}
+
 void VWDictionary::clear(bool printWarningsIfNotEmpty)
 {
 	ULOGGER_DEBUG("");
@@ -717,6 +1121,16 @@ void VWDictionary::clear(bool printWarningsIfNotEmpty)
 	_mapIdIndex.clear();
 	_unusedWords.clear();
 	_flannIndex->release();
+	_productQuantizer->release();
+	_vocabularyTree->release();
+	if(_pagedDriver)
+	{
+		_pagedDriver->closeConnection(false);
+		delete _pagedDriver;
+		_pagedDriver = 0;
+	}
+	_pagedCache.clear();
+	_pagedCacheUsage.clear();
 	useDistanceL1_ = false;
 }
 
@@ -760,6 +1174,7 @@ std::list<int> VWDictionary::addNewWords(
 		const cv::Mat & descriptorsIn,
 		int signatureId)
 {
+	UPROFILER_ZONE("VWDictionary::addNewWords");
 	UDEBUG("id=%d descriptors=%d", signatureId, descriptorsIn.rows);
 	UTimer timer;
 	std::list<int> wordIds;
@@ -851,7 +1266,19 @@ std::list<int> VWDictionary::addNewWords(
 	UTimer timerLocal;
 	timerLocal.start();
 
-	if(_flannIndex->isBuilt() || (!_dataTree.empty() && _dataTree.rows >= (int)k))
+	if(this->isQuantized())
+	{
+		bruteForce = true; // results are returned as matches
+		this->searchQuantized(descriptors, matches, k);
+		UDEBUG("Time to find nn (quantized) = %f s", timerLocal.ticks());
+	}
+	else if(_vocabularyTree->isBuilt())
+	{
+		bruteForce = true; // results are returned as matches
+		_vocabularyTree->knnSearch(descriptors, matches, k);
+		UDEBUG("Time to find nn (vocabulary tree) = %f s", timerLocal.ticks());
+	}
+	else if(_flannIndex->isBuilt() || (!_dataTree.empty() && _dataTree.rows >= (int)k))
 	{
 		//Find nearest neighbors
 		UDEBUG("newPts.total()=%d ", descriptors.rows);
@@ -860,7 +1287,7 @@ std::list<int> VWDictionary::addNewWords(
 		{
 			_flannIndex->knnSearch(descriptors, results, dists, k, KNN_CHECKS);
 		}
-		else if(_strategy == kNNBruteForce)
+		else if(_strategy == kNNBruteForce || _strategy == kNNVocabularyTree)
 		{
 			bruteForce = true;
 			cv::BFMatcher matcher(descriptors.type()==CV_8U?cv::NORM_HAMMING:cv::NORM_L2SQR);
@@ -1178,7 +1605,17 @@ std::vector<int> VWDictionary::findNN(const cv::Mat & queryIn) const
 		cv::Mat results;
 		cv::Mat dists;
 
-		if(_flannIndex->isBuilt() || (!_dataTree.empty() && _dataTree.rows >= (int)k))
+		if(this->isQuantized())
+		{
+			bruteForce = true; // results are returned as matches
+			this->searchQuantized(query, matches, k);
+		}
+		else if(_vocabularyTree->isBuilt())
+		{
+			bruteForce = true; // results are returned as matches
+			_vocabularyTree->knnSearch(query, matches, k);
+		}
+		else if(_flannIndex->isBuilt() || (!_dataTree.empty() && _dataTree.rows >= (int)k))
 		{
 			//Find nearest neighbors
 			UDEBUG("query.rows=%d ", query.rows);
@@ -1187,7 +1624,7 @@ std::vector<int> VWDictionary::findNN(const cv::Mat & queryIn) const
 			{
 				_flannIndex->knnSearch(query, results, dists, k, KNN_CHECKS);
 			}
-			else if(_strategy == kNNBruteForce)
+			else if(_strategy == kNNBruteForce || _strategy == kNNVocabularyTree)
 			{
 				bruteForce = true;
 				cv::BFMatcher matcher(query.type()==CV_8U?cv::NORM_HAMMING:cv::NORM_L2SQR);
@@ -48,18 +48,20 @@ VisualWord::~VisualWord()
 {
 }
 
-void VisualWord::addRef(int signatureId)
+void VisualWord::addRef(int signatureId, int occurrences)
 {
-	std::map<int, int>::iterator iter = _references.find(signatureId);
-	if(iter != _references.end())
+	UASSERT(occurrences > 0);
+	std::map<int, int>::iterator iter = _references.lower_bound(signatureId);
+	if(iter != _references.end() && iter->first == signatureId)
 	{
-		(*iter).second += 1;
+		(*iter).second += occurrences;
 	}
 	else
 	{
-		_references.insert(std::pair<int, int>(signatureId, 1));
+		// hint: references are usually added by increasing signature ids
+		_references.insert(iter, std::pair<int, int>(signatureId, occurrences));
 	}
-	++_totalReferences;
+	_totalReferences += occurrences;
 }
 
 int VisualWord::removeAllRef(int signatureId)
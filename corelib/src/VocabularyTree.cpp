@@ -0,0 +1,570 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/VocabularyTree.h>
+#include <rtabmap/core/DescriptorDistance.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <fstream>
+#include <string.h>
+
+namespace rtabmap {
+
+namespace {
+const char kMagic[4] = {'R','T','V','T'};
+const int kVersion = 1;
+
+struct BuildTask
+{
+	int node;
+	int depth;
+	std::vector<int> rows;
+};
+}
+
+VocabularyTree::VocabularyTree() :
+		branching_(0)
+{
+}
+
+VocabularyTree::~VocabularyTree()
+{
+	this->release();
+}
+
+void VocabularyTree::release()
+{
+	features_ = cv::Mat();
+	centroids_ = cv::Mat();
+	nodes_.clear();
+	branching_ = 0;
+}
+
+float VocabularyTree::distance(const unsigned char * a, const unsigned char * b) const
+{
+	if(features_.type() == CV_32FC1)
+	{
+		return descriptorDistanceL2Sqr((const float *)a, (const float *)b, features_.cols);
+	}
+	return (float)descriptorDistanceHamming(a, b, features_.cols);
+}
+
+void VocabularyTree::computeCentroids(
+		const std::vector<int> & rows,
+		const std::vector<int> & labels,
+		cv::Mat & centers) const
+{
+	UASSERT(rows.size() == labels.size());
+	int k = centers.rows;
+	int dim = features_.cols;
+	std::vector<int> counts(k, 0);
+	if(features_.type() == CV_32FC1)
+	{
+		// mean
+		std::vector<double> sums(k*dim, 0.0);
+		for(unsigned int i=0; i<rows.size(); ++i)
+		{
+			const float * f = features_.ptr<float>(rows[i]);
+			double * sum = &sums[labels[i]*dim];
+			for(int j=0; j<dim; ++j)
+			{
+				sum[j] += f[j];
+			}
+			++counts[labels[i]];
+		}
+		for(int c=0; c<k; ++c)
+		{
+			if(counts[c])
+			{
+				float * center = centers.ptr<float>(c);
+				for(int j=0; j<dim; ++j)
+				{
+					center[j] = float(sums[c*dim+j]/double(counts[c]));
+				}
+			}
+		}
+	}
+	else
+	{
+		// k-majority: a bit is set if it is set in more than half of the features
+		std::vector<int> bits(k*dim*8, 0);
+		for(unsigned int i=0; i<rows.size(); ++i)
+		{
+			const unsigned char * f = features_.ptr(rows[i]);
+			int * bit = &bits[labels[i]*dim*8];
+			for(int j=0; j<dim; ++j)
+			{
+				for(int b=0; b<8; ++b)
+				{
+					bit[j*8+b] += (f[j] >> b) & 1;
+				}
+			}
+			++counts[labels[i]];
+		}
+		for(int c=0; c<k; ++c)
+		{
+			if(counts[c])
+			{
+				unsigned char * center = centers.ptr(c);
+				const int * bit = &bits[c*dim*8];
+				for(int j=0; j<dim; ++j)
+				{
+					unsigned char byte = 0;
+					for(int b=0; b<8; ++b)
+					{
+						if(bit[j*8+b]*2 > counts[c])
+						{
+							byte |= (unsigned char)(1 << b);
+						}
+					}
+					center[j] = byte;
+				}
+			}
+		}
+	}
+}
+
+void VocabularyTree::cluster(
+		const std::vector<int> & rows,
+		int k,
+		int iterations,
+		cv::RNG & rng,
+		cv::Mat & centers,
+		std::vector<int> & labels) const
+{
+	int n = (int)rows.size();
+	k = k<n?k:n;
+	UASSERT(k > 0);
+	centers = cv::Mat(k, features_.cols, features_.type());
+
+	// k-means++ seeding
+	std::vector<float> minDists(n, -1.0f);
+	features_.row(rows[rng.uniform(0, n)]).copyTo(centers.row(0));
+	for(int c=1; c<k; ++c)
+	{
+		double total = 0.0;
+		for(int i=0; i<n; ++i)
+		{
+			float d = distance(features_.ptr(rows[i]), centers.ptr(c-1));
+			if(minDists[i] < 0.0f || d < minDists[i])
+			{
+				minDists[i] = d;
+			}
+			total += minDists[i];
+		}
+		int chosen = rng.uniform(0, n);
+		if(total > 0.0)
+		{
+			double r = rng.uniform(0.0, total);
+			for(int i=0; i<n; ++i)
+			{
+				r -= minDists[i];
+				if(r <= 0.0)
+				{
+					chosen = i;
+					break;
+				}
+			}
+		}
+		features_.row(rows[chosen]).copyTo(centers.row(c));
+	}
+
+	labels.assign(n, -1);
+	for(int it=0; it<iterations; ++it)
+	{
+		int changed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:changed)
+#endif
+		for(int i=0; i<n; ++i)
+		{
+			const unsigned char * f = features_.ptr(rows[i]);
+			int best = 0;
+			float bestDist = distance(f, centers.ptr(0));
+			for(int c=1; c<k; ++c)
+			{
+				float d = distance(f, centers.ptr(c));
+				if(d < bestDist)
+				{
+					bestDist = d;
+					best = c;
+				}
+			}
+			if(labels[i] != best)
+			{
+				labels[i] = best;
+				++changed;
+			}
+		}
+		if(changed == 0 || it+1 == iterations)
+		{
+			break;
+		}
+		computeCentroids(rows, labels, centers);
+	}
+}
+
+void VocabularyTree::build(
+		const cv::Mat & features,
+		int branching,
+		int leafMaxSize,
+		int maxDepth,
+		int iterations)
+{
+	UASSERT(features.type() == CV_32FC1 || features.type() == CV_8UC1);
+	UASSERT(features.rows > 0 && features.cols > 0);
+	UASSERT(branching >= 2 && leafMaxSize >= 1 && maxDepth >= 0 && iterations > 0);
+	this->release();
+
+	UTimer timer;
+	features_ = features;
+	branching_ = branching;
+	cv::RNG rng(0x5EED);
+
+	std::vector<BuildTask> tasks(1);
+	tasks[0].node = 0;
+	tasks[0].depth = 0;
+	tasks[0].rows.resize(features.rows);
+	for(int i=0; i<features.rows; ++i)
+	{
+		tasks[0].rows[i] = i;
+	}
+	nodes_.push_back(Node());
+	cv::Mat rootCentroid(1, features.cols, features.type());
+	computeCentroids(tasks[0].rows, std::vector<int>(features.rows, 0), rootCentroid);
+	centroids_.push_back(rootCentroid);
+
+	while(!tasks.empty())
+	{
+		BuildTask task;
+		task.node = tasks.back().node;
+		task.depth = tasks.back().depth;
+		task.rows.swap(tasks.back().rows);
+		tasks.pop_back();
+
+		if((int)task.rows.size() <= leafMaxSize || (maxDepth > 0 && task.depth >= maxDepth))
+		{
+			nodes_[task.node].features.swap(task.rows);
+			continue;
+		}
+
+		cv::Mat centers;
+		std::vector<int> labels;
+		cluster(task.rows, branching, iterations, rng, centers, labels);
+		std::vector<std::vector<int> > clusters(centers.rows);
+		for(unsigned int i=0; i<labels.size(); ++i)
+		{
+			clusters[labels[i]].push_back(task.rows[i]);
+		}
+		int nonEmpty = 0;
+		for(unsigned int c=0; c<clusters.size(); ++c)
+		{
+			nonEmpty += clusters[c].empty()?0:1;
+		}
+		if(nonEmpty < 2)
+		{
+			// cannot be split (all features are the same)
+			nodes_[task.node].features.swap(task.rows);
+			continue;
+		}
+
+		for(unsigned int c=0; c<clusters.size(); ++c)
+		{
+			if(!clusters[c].empty())
+			{
+				int child = (int)nodes_.size();
+				nodes_.push_back(Node());
+				centroids_.push_back(centers.row(c));
+				nodes_[task.node].children.push_back(child);
+				tasks.push_back(BuildTask());
+				tasks.back().node = child;
+				tasks.back().depth = task.depth+1;
+				tasks.back().rows.swap(clusters[c]);
+			}
+		}
+	}
+	UDEBUG("Built vocabulary tree of %d features (dim=%d type=%d): nodes=%d leaves=%d depth=%d branching=%d (%fs)",
+			features_.rows, features_.cols, features_.type(), (int)nodes_.size(), leaves(), depth(), branching_, timer.ticks());
+}
+
+int VocabularyTree::depth() const
+{
+	int maxDepth = 0;
+	std::vector<std::pair<int, int> > stack; // <node, depth>
+	if(!nodes_.empty())
+	{
+		stack.push_back(std::make_pair(0, 0));
+	}
+	while(!stack.empty())
+	{
+		std::pair<int, int> n = stack.back();
+		stack.pop_back();
+		maxDepth = n.second>maxDepth?n.second:maxDepth;
+		for(unsigned int i=0; i<nodes_[n.first].children.size(); ++i)
+		{
+			stack.push_back(std::make_pair(nodes_[n.first].children[i], n.second+1));
+		}
+	}
+	return maxDepth;
+}
+
+int VocabularyTree::leaves() const
+{
+	int count = 0;
+	for(unsigned int i=0; i<nodes_.size(); ++i)
+	{
+		count += nodes_[i].children.empty()?1:0;
+	}
+	return count;
+}
+
+unsigned long VocabularyTree::memoryUsed() const
+{
+	unsigned long memoryUsage = sizeof(VocabularyTree);
+	memoryUsage += centroids_.total()*centroids_.elemSize();
+	memoryUsage += nodes_.size()*sizeof(Node);
+	for(unsigned int i=0; i<nodes_.size(); ++i)
+	{
+		memoryUsage += (nodes_[i].children.size() + nodes_[i].features.size())*sizeof(int);
+	}
+	return memoryUsage;
+}
+
+cv::Mat VocabularyTree::convertLeavesToWords()
+{
+	UASSERT(isBuilt());
+	cv::Mat words;
+	for(unsigned int i=0; i<nodes_.size(); ++i)
+	{
+		if(nodes_[i].children.empty())
+		{
+			words.push_back(centroids_.row(i));
+			nodes_[i].features = std::vector<int>(1, words.rows-1);
+		}
+	}
+	features_ = words;
+	return words;
+}
+
+void VocabularyTree::knnSearch(
+		const cv::Mat & query,
+		std::vector<std::vector<cv::DMatch> > & matches,
+		int knn) const
+{
+	UASSERT(isBuilt());
+	UASSERT_MSG(query.type() == features_.type() && query.cols == features_.cols,
+			uFormat("type=%d dim=%d (expected type=%d dim=%d)", query.type(), query.cols, features_.type(), features_.cols).c_str());
+	UASSERT(knn > 0);
+
+	matches.resize(query.rows);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for(int i=0; i<query.rows; ++i)
+	{
+		const unsigned char * q = query.ptr(i);
+
+		// descend to the nearest leaf
+		int node = 0;
+		while(!nodes_[node].children.empty())
+		{
+			const std::vector<int> & children = nodes_[node].children;
+			int best = children[0];
+			float bestDist = distance(q, centroids_.ptr(best));
+			for(unsigned int c=1; c<children.size(); ++c)
+			{
+				float d = distance(q, centroids_.ptr(children[c]));
+				if(d < bestDist)
+				{
+					bestDist = d;
+					best = children[c];
+				}
+			}
+			node = best;
+		}
+
+		// nearest features of the leaf, sorted
+		std::vector<cv::DMatch> & queryMatches = matches[i];
+		queryMatches.clear();
+		const std::vector<int> & leafFeatures = nodes_[node].features;
+		for(unsigned int j=0; j<leafFeatures.size(); ++j)
+		{
+			float d = distance(q, features_.ptr(leafFeatures[j]));
+			if((int)queryMatches.size() < knn || d < queryMatches.back().distance)
+			{
+				if((int)queryMatches.size() == knn)
+				{
+					queryMatches.pop_back();
+				}
+				std::vector<cv::DMatch>::iterator iter = queryMatches.begin();
+				while(iter != queryMatches.end() && iter->distance <= d)
+				{
+					++iter;
+				}
+				queryMatches.insert(iter, cv::DMatch(i, leafFeatures[j], d));
+			}
+		}
+	}
+}
+
+bool VocabularyTree::save(const std::string & path) const
+{
+	UASSERT(isBuilt());
+	std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+	if(!file.is_open())
+	{
+		UERROR("Cannot open \"%s\" for writing", path.c_str());
+		return false;
+	}
+	int header[6] = {kVersion, features_.type(), features_.cols, features_.rows, branching_, (int)nodes_.size()};
+	file.write(kMagic, sizeof(kMagic));
+	file.write((const char *)header, sizeof(header));
+	for(int i=0; i<centroids_.rows; ++i)
+	{
+		file.write((const char *)centroids_.ptr(i), centroids_.cols*centroids_.elemSize());
+	}
+	for(unsigned int i=0; i<nodes_.size(); ++i)
+	{
+		int children = (int)nodes_[i].children.size();
+		int features = (int)nodes_[i].features.size();
+		file.write((const char *)&children, sizeof(int));
+		if(children)
+		{
+			file.write((const char *)&nodes_[i].children[0], children*sizeof(int));
+		}
+		file.write((const char *)&features, sizeof(int));
+		if(features)
+		{
+			file.write((const char *)&nodes_[i].features[0], features*sizeof(int));
+		}
+	}
+	return file.good();
+}
+
+bool VocabularyTree::load(const std::string & path, const cv::Mat & features)
+{
+	this->release();
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if(!file.is_open())
+	{
+		UERROR("Cannot open \"%s\"", path.c_str());
+		return false;
+	}
+	char magic[sizeof(kMagic)];
+	int header[6];
+	file.read(magic, sizeof(magic));
+	file.read((char *)header, sizeof(header));
+	if(!file.good() || memcmp(magic, kMagic, sizeof(kMagic)) != 0 || header[0] != kVersion)
+	{
+		UERROR("\"%s\" is not a vocabulary tree file (or version is not supported)", path.c_str());
+		return false;
+	}
+	if(header[1] != features.type() || header[2] != features.cols || header[3] != features.rows)
+	{
+		UERROR("Vocabulary tree \"%s\" was built for other features (type=%d dim=%d count=%d) "
+				"than the ones provided (type=%d dim=%d count=%d)",
+				path.c_str(), header[1], header[2], header[3], features.type(), features.cols, features.rows);
+		return false;
+	}
+	// Each node has a centroid and two counts, reject node counts the file cannot hold
+	int nodes = header[5];
+	std::streampos headerEnd = file.tellg();
+	file.seekg(0, std::ios::end);
+	long long remaining = (long long)(file.tellg() - headerEnd);
+	file.seekg(headerEnd);
+	if(nodes <= 0 || header[4] < 2 ||
+	   (long long)nodes * (long long)(features.cols*features.elemSize() + 2*sizeof(int)) > remaining)
+	{
+		UERROR("Vocabulary tree \"%s\" is corrupted (branching=%d nodes=%d)", path.c_str(), header[4], nodes);
+		return false;
+	}
+	cv::Mat centroids(nodes, features.cols, features.type());
+	for(int i=0; i<nodes && file.good(); ++i)
+	{
+		file.read((char *)centroids.ptr(i), centroids.cols*centroids.elemSize());
+	}
+	std::vector<Node> tree(nodes);
+	for(int i=0; i<nodes && file.good(); ++i)
+	{
+		int count = 0;
+		file.read((char *)&count, sizeof(int));
+		if(!file.good() || count < 0 || count > nodes)
+		{
+			UERROR("Vocabulary tree \"%s\" is corrupted (node %d has %d children)", path.c_str(), i, count);
+			return false;
+		}
+		if(count > 0)
+		{
+			tree[i].children.resize(count);
+			file.read((char *)&tree[i].children[0], count*sizeof(int));
+		}
+		file.read((char *)&count, sizeof(int));
+		if(!file.good() || count < 0 || count > features.rows)
+		{
+			UERROR("Vocabulary tree \"%s\" is corrupted (node %d has %d features)", path.c_str(), i, count);
+			return false;
+		}
+		if(count > 0)
+		{
+			tree[i].features.resize(count);
+			file.read((char *)&tree[i].features[0], count*sizeof(int));
+		}
+	}
+	if(!file.good())
+	{
+		UERROR("Vocabulary tree \"%s\" is corrupted", path.c_str());
+		return false;
+	}
+	for(int i=0; i<nodes; ++i)
+	{
+		for(unsigned int j=0; j<tree[i].children.size(); ++j)
+		{
+			if(tree[i].children[j] <= i || tree[i].children[j] >= nodes)
+			{
+				UERROR("Vocabulary tree \"%s\" is corrupted", path.c_str());
+				return false;
+			}
+		}
+		for(unsigned int j=0; j<tree[i].features.size(); ++j)
+		{
+			if(tree[i].features[j] < 0 || tree[i].features[j] >= features.rows)
+			{
+				UERROR("Vocabulary tree \"%s\" is corrupted", path.c_str());
+				return false;
+			}
+		}
+	}
+
+	features_ = features;
+	centroids_ = centroids;
+	nodes_.swap(tree);
+	branching_ = header[4];
+	return true;
+}
+
+} /* namespace rtabmap */
@@ -29,7 +29,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UDirectory.h>
 #include <rtabmap/utilite/UStl.h>
-#include <rtabmap/utilite/UThreadC.h>
+#include <rtabmap/utilite/UThread.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/USemaphore.h>
 #include <rtabmap/core/util3d.h>
 #include <rtabmap/core/util3d_filtering.h>
 #include <rtabmap/core/Graph.h>
@@ -39,6 +41,183 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace rtabmap
 {
 
+class CameraImagesReadAhead;
+
+/**
+ * Decode files for CameraImagesReadAhead.
+ */
+class CameraImagesLoader : public UThread
+{
+public:
+	CameraImagesLoader(CameraImagesReadAhead * readAhead) : readAhead_(readAhead) {}
+	virtual ~CameraImagesLoader() {this->join(true);}
+protected:
+	virtual void mainLoopKill();
+	virtual void mainLoop();
+private:
+	CameraImagesReadAhead * readAhead_;
+};
+
+/**
+ * Decode the next files of CameraImages in background threads, up
+ * to "size" frames ahead of capture. Frames decoded out of order
+ * by the loaders are reordered to be taken in file order.
+ */
+class CameraImagesReadAhead
+{
+public:
+	CameraImagesReadAhead(
+			const CameraImages * camera,
+			const std::vector<std::pair<std::string, std::string> > & files, // <image, scan>
+			int size,
+			int threads) :
+		camera_(camera),
+		model_(camera->cameraModel()),
+		files_(files),
+		index_(0),
+		nextIndex_(0),
+		freeSlots_(size)
+	{
+		UASSERT(camera_ != 0);
+		UASSERT(size > 0);
+		UASSERT(threads > 0);
+		for(int i=0; i<threads; ++i)
+		{
+			loaders_.push_back(new CameraImagesLoader(this));
+		}
+		for(unsigned int i=0; i<loaders_.size(); ++i)
+		{
+			loaders_[i]->start();
+		}
+	}
+	virtual ~CameraImagesReadAhead()
+	{
+		// kill all loaders before joining them, so that they all wake up
+		for(unsigned int i=0; i<loaders_.size(); ++i)
+		{
+			loaders_[i]->kill();
+		}
+		for(unsigned int i=0; i<loaders_.size(); ++i)
+		{
+			delete loaders_[i];
+		}
+	}
+
+	// Blocking until the frame of these files is decoded. Returns
+	// false if they are not the next files expected.
+	bool take(
+			const std::string & imageFilePath,
+			const std::string & scanFilePath,
+			cv::Mat & img,
+			LaserScan & scan,
+			cv::Mat & depthFromScan,
+			double & decodeTime,
+			int & buffered)
+	{
+		if(nextIndex_ >= files_.size() ||
+		   files_[nextIndex_].first.compare(imageFilePath) != 0 ||
+		   files_[nextIndex_].second.compare(scanFilePath) != 0)
+		{
+			return false;
+		}
+		while(1)
+		{
+			bufferMutex_.lock();
+			std::map<unsigned int, Item>::iterator iter = buffer_.find(nextIndex_);
+			if(iter != buffer_.end())
+			{
+				img = iter->second.img;
+				if(!scanFilePath.empty())
+				{
+					scan = iter->second.scan;
+				}
+				depthFromScan = iter->second.depthFromScan;
+				decodeTime = iter->second.decodeTime;
+				buffer_.erase(iter);
+				buffered = (int)buffer_.size();
+				++nextIndex_;
+				bufferMutex_.unlock();
+				freeSlots_.release();
+				return true;
+			}
+			bufferMutex_.unlock();
+			dataReady_.acquire();
+		}
+		return false;
+	}
+
+	// Called by loaders, blocking until a slot is free. Returns
+	// false when all files are loaded or the loader is killed.
+	bool loadNext(const CameraImagesLoader * loader)
+	{
+		freeSlots_.acquire();
+		bufferMutex_.lock();
+		unsigned int index = index_;
+		bool done = loader->isKilled() || index_ >= files_.size();
+		if(!done)
+		{
+			++index_;
+		}
+		bufferMutex_.unlock();
+		if(done)
+		{
+			// wake up next loader
+			freeSlots_.release();
+			return false;
+		}
+
+		Item item;
+		UTimer timer;
+		camera_->loadData(files_[index].first, files_[index].second, model_, item.img, item.scan, item.depthFromScan);
+		item.decodeTime = timer.ticks();
+
+		bufferMutex_.lock();
+		buffer_.insert(std::make_pair(index, item));
+		bufferMutex_.unlock();
+		dataReady_.release();
+		return true;
+	}
+
+	void releaseLoader()
+	{
+		freeSlots_.release();
+	}
+
+private:
+	struct Item
+	{
+		Item() : decodeTime(0.0) {}
+		cv::Mat img;
+		LaserScan scan;
+		cv::Mat depthFromScan;
+		double decodeTime;
+	};
+
+	const CameraImages * camera_;
+	CameraModel model_;
+	std::vector<std::pair<std::string, std::string> > files_;
+	unsigned int index_;
+	unsigned int nextIndex_;
+	std::map<unsigned int, Item> buffer_; // reorder buffer <index, item>
+	std::vector<CameraImagesLoader*> loaders_;
+	UMutex bufferMutex_;
+	USemaphore freeSlots_;
+	USemaphore dataReady_;
+};
+
+void CameraImagesLoader::mainLoopKill()
+{
+	readAhead_->releaseLoader();
+}
+
+void CameraImagesLoader::mainLoop()
+{
+	if(!readAhead_->loadNext(this))
+	{
+		this->kill();
+	}
+}
+
 CameraImages::CameraImages() :
 		_startAt(0),
 		_maxFrames(0),
@@ -62,7 +241,10 @@ CameraImages::CameraImages() :
 		_odometryFormat(0),
 		_groundTruthFormat(0),
 		_maxPoseTimeDiff(0.02),
-		_captureDelay(0.0)
+		_captureDelay(0.0),
+		_readAheadThreads(0),
+		_readAheadSize(10),
+		_readAhead(0)
 	{}
 CameraImages::CameraImages(const std::string & path,
 					 float imageRate,
@@ -91,7 +273,10 @@ CameraImages::CameraImages(const std::string & path,
 	_odometryFormat(0),
 	_groundTruthFormat(0),
 	_maxPoseTimeDiff(0.02),
-	_captureDelay(0.0)
+	_captureDelay(0.0),
+	_readAheadThreads(0),
+	_readAheadSize(10),
+	_readAhead(0)
 {
 
 }
@@ -99,6 +284,7 @@ CameraImages::CameraImages(const std::string & path,
 CameraImages::~CameraImages()
 {
 	UDEBUG("");
+	delete _readAhead;
 	delete _dir;
 	delete _scanDir;
 }
@@ -111,6 +297,8 @@ bool CameraImages::init(const std::string & calibrationFolder, const std::string
 	_countScan = 0;
 	_captureDelay = 0.0;
 	_framesPublished=0;
+	delete _readAhead;
+	_readAhead = 0;
 
 	UDEBUG("");
 	if(_dir)
@@ -327,6 +515,36 @@ bool CameraImages::init(const std::string & calibrationFolder, const std::string
 		}
 	}
 
+	if(success && _readAheadThreads > 0)
+	{
+		if(_startAt < 0 || _refreshDir)
+		{
+			UWARN("Read-ahead is not used when the last image of the directory is read "
+				  "or when the directory is refreshed (path=%s).", _path.c_str());
+		}
+		else
+		{
+			std::vector<std::string> imageFileNames = uListToVector(_dir->getFileNames());
+			std::vector<std::string> scanFileNames;
+			if(_scanDir)
+			{
+				scanFileNames = uListToVector(_scanDir->getFileNames());
+			}
+			std::vector<std::pair<std::string, std::string> > files;
+			for(unsigned int i=_startAt; i<imageFileNames.size() && (_maxFrames<=0 || (int)files.size()<_maxFrames); ++i)
+			{
+				files.push_back(std::make_pair(
+						_path + imageFileNames[i],
+						i<scanFileNames.size()?_scanPath + scanFileNames[i]:std::string()));
+			}
+			if(files.size())
+			{
+				UINFO("Read-ahead of %d frames with %d threads (path=%s)", _readAheadSize>0?_readAheadSize:1, _readAheadThreads, _path.c_str());
+				_readAhead = new CameraImagesReadAhead(this, files, _readAheadSize>0?_readAheadSize:1, _readAheadThreads);
+			}
+		}
+	}
+
 	_captureTimer.restart();
 
 	return success;
@@ -446,6 +664,113 @@ bool CameraImages::readPoses(std::list<Transform> & outputPoses, std::list<doubl
 	return true;
 }
 
+void CameraImages::loadData(
+		const std::string & imageFilePath,
+		const std::string & scanFilePath,
+		const CameraModel & model,
+		cv::Mat & img,
+		LaserScan & scan,
+		cv::Mat & depthFromScan) const
+{
+	if(!imageFilePath.empty())
+	{
+		ULOGGER_DEBUG("Loading image : %s", imageFilePath.c_str());
+
+#if CV_MAJOR_VERSION >2 || (CV_MAJOR_VERSION >=2 && CV_MINOR_VERSION >=4)
+		img = cv::imread(imageFilePath.c_str(), cv::IMREAD_UNCHANGED);
+#else
+		img = cv::imread(imageFilePath.c_str(), -1);
+#endif
+		UDEBUG("width=%d, height=%d, channels=%d, elementSize=%d, total=%d",
+				img.cols, img.rows, img.channels(), img.elemSize(), img.total());
+
+		if(_isDepth)
+		{
+			if(img.type() != CV_16UC1 && img.type() != CV_32FC1)
+			{
+				UERROR("Depth is on and the loaded image has not a format supported (file = \"%s\", type=%d). "
+						"Formats supported are 16 bits 1 channel (mm) and 32 bits 1 channel (m).",
+						imageFilePath.c_str(), img.type());
+				img = cv::Mat();
+			}
+
+			if(_depthScaleFactor > 1.0f)
+			{
+				img /= _depthScaleFactor;
+			}
+		}
+		else
+		{
+#if CV_MAJOR_VERSION < 3
+			// FIXME : it seems that some png are incorrectly loaded with opencv c++ interface, where c interface works...
+			if(img.depth() != CV_8U)
+			{
+				// The depth should be 8U
+				UWARN("Cannot read the image correctly, falling back to old OpenCV C interface...");
+				IplImage * i = cvLoadImage(imageFilePath.c_str());
+				img = cv::Mat(i, true);
+				cvReleaseImage(&i);
+			}
+#endif
+			if(img.channels()>3)
+			{
+				UWARN("Conversion from 4 channels to 3 channels (file=%s)", imageFilePath.c_str());
+				cv::Mat out;
+				cv::cvtColor(img, out, CV_BGRA2BGR);
+				img = out;
+			}
+			else if(_bayerMode >= 0 && _bayerMode <=3)
+			{
+				cv::Mat debayeredImg;
+				try
+				{
+					cv::cvtColor(img, debayeredImg, CV_BayerBG2BGR + _bayerMode);
+					img = debayeredImg;
+				}
+				catch(const cv::Exception & e)
+				{
+					UWARN("Error debayering images: \"%s\". Please set bayer mode to -1 if images are not bayered!", e.what());
+				}
+			}
+
+		}
+
+		if(!img.empty() && model.isValidForRectification() && _rectifyImages)
+		{
+			img = model.rectifyImage(img);
+		}
+	}
+
+	if(!scanFilePath.empty())
+	{
+		// load without filtering
+		scan = util3d::loadScan(scanFilePath);
+		scan = LaserScan(scan.data(), _scanMaxPts, 0.0f, scan.format(), _scanLocalTransform);
+		UDEBUG("Loaded scan=%d points", (int)scan.size());
+		if(_depthFromScan && !img.empty())
+		{
+			UDEBUG("Computing depth from scan...");
+			if(!model.isValidForProjection())
+			{
+				UWARN("Depth from laser scan: Camera model should be valid.");
+			}
+			else if(_isDepth)
+			{
+				UWARN("Depth from laser scan: Loading already a depth image.");
+			}
+			else
+			{
+				pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = util3d::laserScanToPointCloud(scan, scan.localTransform());
+				depthFromScan = util3d::projectCloudToCamera(img.size(), model.K(), cloud, model.localTransform());
+				if(_depthFromScanFillHoles!=0)
+				{
+					util3d::fillProjectedCloudHoles(depthFromScan, _depthFromScanFillHoles>0, _depthFromScanFillHolesFromBorder);
+				}
+			}
+		}
+	}
+}
+
 bool CameraImages::isCalibrated() const
 {
 	return _model.isValidForProjection();
@@ -638,102 +963,31 @@ SensorData CameraImages::captureImage(CameraInfo * info)
 		if(_maxFrames <=0 || ++_framesPublished <= _maxFrames)
 		{
 
-			if(!imageFilePath.empty())
+			bool loaded = false;
+			if(_readAhead && (!imageFilePath.empty() || !scanFilePath.empty()))
 			{
-				ULOGGER_DEBUG("Loading image : %s", imageFilePath.c_str());
-
-#if CV_MAJOR_VERSION >2 || (CV_MAJOR_VERSION >=2 && CV_MINOR_VERSION >=4)
-				img = cv::imread(imageFilePath.c_str(), cv::IMREAD_UNCHANGED);
-#else
-				img = cv::imread(imageFilePath.c_str(), -1);
-#endif
-				UDEBUG("width=%d, height=%d, channels=%d, elementSize=%d, total=%d",
-						img.cols, img.rows, img.channels(), img.elemSize(), img.total());
-
-				if(_isDepth)
+				double decodeTime = 0.0;
+				int buffered = 0;
+				loaded = _readAhead->take(imageFilePath, scanFilePath, img, scan, depthFromScan, decodeTime, buffered);
+				if(loaded)
 				{
-					if(img.type() != CV_16UC1 && img.type() != CV_32FC1)
-					{
-						UERROR("Depth is on and the loaded image has not a format supported (file = \"%s\", type=%d). "
-								"Formats supported are 16 bits 1 channel (mm) and 32 bits 1 channel (m).",
-								imageFilePath.c_str(), img.type());
-						img = cv::Mat();
-					}
-
-					if(_depthScaleFactor > 1.0f)
+					if(info)
 					{
-						img /= _depthScaleFactor;
+						info->timeDecoding = decodeTime;
+						info->bufferedFrames = buffered;
 					}
 				}
 				else
 				{
-#if CV_MAJOR_VERSION < 3
-					// FIXME : it seems that some png are incorrectly loaded with opencv c++ interface, where c interface works...
-					if(img.depth() != CV_8U)
-					{
-						// The depth should be 8U
-						UWARN("Cannot read the image correctly, falling back to old OpenCV C interface...");
-						IplImage * i = cvLoadImage(imageFilePath.c_str());
-						img = cv::Mat(i, true);
-						cvReleaseImage(&i);
-					}
-#endif
-					if(img.channels()>3)
-					{
-						UWARN("Conversion from 4 channels to 3 channels (file=%s)", imageFilePath.c_str());
-						cv::Mat out;
-						cv::cvtColor(img, out, CV_BGRA2BGR);
-						img = out;
-					}
-					else if(_bayerMode >= 0 && _bayerMode <=3)
-					{
-						cv::Mat debayeredImg;
-						try
-						{
-							cv::cvtColor(img, debayeredImg, CV_BayerBG2BGR + _bayerMode);
-							img = debayeredImg;
-						}
-						catch(const cv::Exception & e)
-						{
-							UWARN("Error debayering images: \"%s\". Please set bayer mode to -1 if images are not bayered!", e.what());
-						}
-					}
-
-				}
-
-				if(!img.empty() && _model.isValidForRectification() && _rectifyImages)
-				{
-					img = _model.rectifyImage(img);
+					UWARN("Read-ahead is out of sync with the files captured (next file is \"%s\"), "
+						  "disabling it.", imageFilePath.c_str());
+					delete _readAhead;
+					_readAhead = 0;
 				}
 			}
-
-			if(!scanFilePath.empty())
+			if(!loaded)
 			{
-				// load without filtering
-				scan = util3d::loadScan(scanFilePath);
-				scan = LaserScan(scan.data(), _scanMaxPts, 0.0f, scan.format(), _scanLocalTransform);
-				UDEBUG("Loaded scan=%d points", (int)scan.size());
-				if(_depthFromScan && !img.empty())
-				{
-					UDEBUG("Computing depth from scan...");
-					if(!_model.isValidForProjection())
-					{
-						UWARN("Depth from laser scan: Camera model should be valid.");
-					}
-					else if(_isDepth)
-					{
-						UWARN("Depth from laser scan: Loading already a depth image.");
-					}
-					else
-					{
-						pcl::PointCloud<pcl::PointXYZ>::Ptr cloud = util3d::laserScanToPointCloud(scan, scan.localTransform());
-						depthFromScan = util3d::projectCloudToCamera(img.size(), _model.K(), cloud, _model.localTransform());
-						if(_depthFromScanFillHoles!=0)
-						{
-							util3d::fillProjectedCloudHoles(depthFromScan, _depthFromScanFillHoles>0, _depthFromScanFillHolesFromBorder);
-						}
-					}
-				}
+				loadData(imageFilePath, scanFilePath, _model, img, scan, depthFromScan);
 			}
 		}
 	}
@@ -88,7 +88,14 @@ SensorData CameraRGBDImages::captureImage(CameraInfo * info)
 	rgb = CameraImages::captureImage(info);
 	if(!rgb.imageRaw().empty())
 	{
-		depth = cameraDepth_.takeImage();
+		CameraInfo depthInfo;
+		depth = cameraDepth_.takeImage(&depthInfo);
+		if(info)
+		{
+			// both are read ahead in parallel
+			info->timeDecoding += depthInfo.timeDecoding;
+			info->bufferedFrames = depthInfo.bufferedFrames<info->bufferedFrames?depthInfo.bufferedFrames:info->bufferedFrames;
+		}
 		if(!depth.depthRaw().empty())
 		{
 			data = SensorData(rgb.imageRaw(), depth.depthRaw(), rgb.cameraModels(), rgb.id(), rgb.stamp());
@@ -163,6 +163,12 @@ SensorData CameraStereoImages::captureImage(CameraInfo * info)
 	left = CameraImages::captureImage(info);
 	if(!left.imageRaw().empty())
 	{
+		float timeDecoding = info?info->timeDecoding:0.0f;
+		int bufferedFrames = info?info->bufferedFrames:0;
+		if(info)
+		{
+			info->timeDecoding = 0.0f;
+		}
 		if(camera2_)
 		{
 			right = camera2_->takeImage(info);
@@ -171,6 +177,11 @@ SensorData CameraStereoImages::captureImage(CameraInfo * info)
 		{
 			right = this->takeImage(info);
 		}
+		if(info)
+		{
+			info->timeDecoding += timeDecoding;
+			info->bufferedFrames = bufferedFrames<info->bufferedFrames?bufferedFrames:info->bufferedFrames;
+		}
 
 		if(!right.imageRaw().empty())
 		{
@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/utilite/ULogger.h"
 #include "rtabmap/utilite/UTimer.h"
 #include "rtabmap/utilite/UStl.h"
+#include "rtabmap/utilite/UProfiler.h"
 
 namespace rtabmap {
 
@@ -71,6 +72,7 @@ Transform OdometryF2F::computeTransform(
 		const Transform & guess,
 		OdometryInfo * info)
 {
+	UPROFILER_ZONE("OdometryF2F::computeTransform");
 	UTimer timer;
 	Transform output;
 	if(!data.rightRaw().empty() && !data.stereoCameraModel().isValidForProjection())
@@ -42,6 +42,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/utilite/UTimer.h"
 #include "rtabmap/utilite/UMath.h"
 #include "rtabmap/utilite/UConversion.h"
+#include "rtabmap/utilite/UProfiler.h"
 #include <opencv2/calib3d/calib3d.hpp>
 #include <rtabmap/core/odometry/OdometryF2M.h>
 #include <pcl/common/io.h>
@@ -210,6 +211,7 @@ Transform OdometryF2M::computeTransform(
 		const Transform & guessIn,
 		OdometryInfo * info)
 {
+	UPROFILER_ZONE("OdometryF2M::computeTransform");
 	Transform guess = guessIn;
 	UTimer timer;
 	Transform output;
@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/odometry/OdometryMono.h"
 #include "rtabmap/core/OdometryInfo.h"
 #include "rtabmap/core/Memory.h"
+#include "rtabmap/core/VWDictionary.h"
 #include "rtabmap/core/Signature.h"
 #include "rtabmap/core/util3d_transforms.h"
 #include "rtabmap/core/util3d_motion_estimation.h"
@@ -101,6 +102,7 @@ OdometryMono::OdometryMono(const rtabmap::ParametersMap & parameters) :
 	customParameters.insert(ParametersPair(Parameters::kMemSTMSize(), "0"));
 	customParameters.insert(ParametersPair(Parameters::kMemNotLinkedNodesKept(), "false"));
 	customParameters.insert(ParametersPair(Parameters::kKpTfIdfLikelihoodUsed(), "false"));
+	customParameters.insert(ParametersPair(Parameters::kMemGlobalDescriptorLikelihood(), "0")); // likelihood is computed on STM nodes, not indexed
 	int nn = Parameters::defaultVisCorNNType();
 	float nndr = Parameters::defaultVisCorNNDR();
 	int featureType = Parameters::defaultVisFeatureType();
@@ -109,7 +111,8 @@ OdometryMono::OdometryMono(const rtabmap::ParametersMap & parameters) :
 	Parameters::parse(parameters, Parameters::kVisCorNNDR(), nndr);
 	Parameters::parse(parameters, Parameters::kVisFeatureType(), featureType);
 	Parameters::parse(parameters, Parameters::kVisMaxFeatures(), maxFeatures);
-	customParameters.insert(ParametersPair(Parameters::kKpNNStrategy(), uNumber2Str(nn)));
+	// Vis/CorNNType values above kNNBruteForceGPU are registration-only matchers, not dictionary strategies
+	customParameters.insert(ParametersPair(Parameters::kKpNNStrategy(), uNumber2Str(nn<=VWDictionary::kNNBruteForceGPU?nn:(int)VWDictionary::kNNBruteForce)));
 	customParameters.insert(ParametersPair(Parameters::kKpNndrRatio(), uNumber2Str(nndr)));
 	customParameters.insert(ParametersPair(Parameters::kKpDetectorStrategy(), uNumber2Str(featureType)));
 	customParameters.insert(ParametersPair(Parameters::kKpMaxFeatures(), uNumber2Str(maxFeatures)));
@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UProfiler.h>
 #include <set>
 
 #include <rtabmap/core/optimizer/OptimizerCVSBA.h>
@@ -62,6 +63,7 @@ std::map<int, Transform> OptimizerCVSBA::optimizeBA(
 		const std::map<int, std::map<int, FeatureBA> > & wordReferences, // <ID words, IDs frames + keypoint/Disparity>)
 		std::set<int> * outliers)
 {
+	UPROFILER_ZONE("OptimizerCVSBA::optimizeBA");
 #ifdef RTABMAP_CVSBA
 	// run sba optimization
 	cvsba::Sba sba;
@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UProfiler.h>
 #include <set>
 
 #include <rtabmap/core/optimizer/OptimizerCeres.h>
@@ -72,6 +73,7 @@ std::map<int, Transform> OptimizerCeres::optimize(
 		double * finalError,
 		int * iterationsDone)
 {
+	UPROFILER_ZONE("OptimizerCeres::optimize");
 	outputCovariance = cv::Mat::eye(6,6,CV_64FC1);
 	std::map<int, Transform> optimizedPoses;
 #ifdef RTABMAP_CERES
@@ -322,6 +324,7 @@ std::map<int, Transform> OptimizerCeres::optimizeBA(
 		const std::map<int, std::map<int, FeatureBA> > & wordReferences, // <ID words, IDs frames + keypoint/Disparity>)
 		std::set<int> * outliers)
 {
+	UPROFILER_ZONE("OptimizerCeres::optimizeBA");
 #ifdef RTABMAP_CERES
 	// run sba optimization
 
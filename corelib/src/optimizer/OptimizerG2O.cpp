@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UProfiler.h>
 #include <locale.h>
 #include <set>
 
@@ -167,8 +168,220 @@ void OptimizerG2O::parseParameters(const ParametersMap & parameters)
 #endif
 #endif
 
+	// parameters may have changed, rebuild the graph on next incremental update
+	resetPersistent();
 }
 
+OptimizerG2O::~OptimizerG2O()
+{
+	resetPersistent();
+}
+
+#ifdef RTABMAP_G2O
+static g2o::OptimizationAlgorithm * createSlamAlgorithm(int solver, int optimizer)
+{
+#ifdef RTABMAP_G2O_CPP11
+
+	std::unique_ptr<SlamBlockSolver> blockSolver;
+
+	if(solver == 3)
+	{
+		//eigen
+		auto linearSolver = g2o::make_unique<SlamLinearEigenSolver>();
+		linearSolver->setBlockOrdering(false);
+		blockSolver = g2o::make_unique<SlamBlockSolver>(std::move(linearSolver));
+	}
+#ifdef G2O_HAVE_CHOLMOD
+	else if(solver == 2)
+	{
+		//chmold
+		auto linearSolver = g2o::make_unique<SlamLinearCholmodSolver>();
+		linearSolver->setBlockOrdering(false);
+		blockSolver = g2o::make_unique<SlamBlockSolver>(std::move(linearSolver));
+	}
+#endif
+#ifdef G2O_HAVE_CSPARSE
+	else if(solver == 0)
+	{
+
+		//csparse
+		auto linearSolver = g2o::make_unique<SlamLinearCSparseSolver>();
+		linearSolver->setBlockOrdering(false);
+		blockSolver = g2o::make_unique<SlamBlockSolver>(std::move(linearSolver));
+	}
+#endif
+	else
+	{
+		//pcg
+		auto linearSolver = g2o::make_unique<SlamLinearPCGSolver>();
+		blockSolver = g2o::make_unique<SlamBlockSolver>(std::move(linearSolver));
+	}
+
+	if(optimizer == 1)
+	{
+
+		return new g2o::OptimizationAlgorithmGaussNewton(std::move(blockSolver));
+	}
+	else
+	{
+		return new g2o::OptimizationAlgorithmLevenberg(std::move(blockSolver));
+	}
+
+#else
+
+	SlamBlockSolver * blockSolver = 0;
+
+	if(solver == 3)
+	{
+		//eigen
+		SlamLinearEigenSolver * linearSolver = new SlamLinearEigenSolver();
+		linearSolver->setBlockOrdering(false);
+		blockSolver = new SlamBlockSolver(linearSolver);
+	}
+#ifdef G2O_HAVE_CHOLMOD
+	else if(solver == 2)
+	{
+		//chmold
+		SlamLinearCholmodSolver * linearSolver = new SlamLinearCholmodSolver();
+		linearSolver->setBlockOrdering(false);
+		blockSolver = new SlamBlockSolver(linearSolver);
+	}
+#endif
+#ifdef G2O_HAVE_CSPARSE
+	else if(solver == 0)
+	{
+		//csparse
+		SlamLinearCSparseSolver* linearSolver = new SlamLinearCSparseSolver();
+		linearSolver->setBlockOrdering(false);
+		blockSolver = new SlamBlockSolver(linearSolver);
+	}
+#endif
+	else
+	{
+		//pcg
+		SlamLinearPCGSolver * linearSolver = new SlamLinearPCGSolver();
+		blockSolver = new SlamBlockSolver(linearSolver);
+	}
+
+	if(optimizer == 1)
+	{
+		return new g2o::OptimizationAlgorithmGaussNewton(blockSolver);
+	}
+	else
+	{
+		return new g2o::OptimizationAlgorithmLevenberg(blockSolver);
+	}
+#endif
+}
+
+// Covariance of the pose "id" computed from the marginals of the optimized graph
+static void computePoseCovariance(g2o::SparseOptimizer & optimizer, int id, bool slam2d, cv::Mat & outputCovariance)
+{
+	if(slam2d)
+	{
+		g2o::VertexSE2* v = (g2o::VertexSE2*)optimizer.vertex(id);
+		if(v)
+		{
+			UTimer t;
+			g2o::SparseBlockMatrix<g2o::MatrixXD> spinv;
+			optimizer.computeMarginals(spinv, v);
+			UINFO("Computed marginals = %fs (cols=%d rows=%d, v=%d id=%d)", t.ticks(), spinv.cols(), spinv.rows(), v->hessianIndex(), id);
+			if(v->hessianIndex() >= 0 && v->hessianIndex() < (int)spinv.blockCols().size())
+			{
+				g2o::SparseBlockMatrix<g2o::MatrixXD>::SparseMatrixBlock * block = spinv.blockCols()[v->hessianIndex()].begin()->second;
+				UASSERT(block && block->cols() == 3 && block->cols() == 3);
+				outputCovariance.at<double>(0,0) = (*block)(0,0); // x-x
+				outputCovariance.at<double>(0,1) = (*block)(0,1); // x-y
+				outputCovariance.at<double>(0,5) = (*block)(0,2); // x-theta
+				outputCovariance.at<double>(1,0) = (*block)(1,0); // y-x
+				outputCovariance.at<double>(1,1) = (*block)(1,1); // y-y
+				outputCovariance.at<double>(1,5) = (*block)(1,2); // y-theta
+				outputCovariance.at<double>(5,0) = (*block)(2,0); // theta-x
+				outputCovariance.at<double>(5,1) = (*block)(2,1); // theta-y
+				outputCovariance.at<double>(5,5) = (*block)(2,2); // theta-theta
+			}
+			else if(v->hessianIndex() < 0)
+			{
+				UWARN("Computing marginals: vertex %d has negative hessian index (%d). Cannot compute last pose covariance.", id, v->hessianIndex());
+			}
+			else
+			{
+				UWARN("Computing marginals: vertex %d has hessian not valid (%d > block size=%d). Cannot compute last pose covariance.", id, v->hessianIndex(), (int)spinv.blockCols().size());
+			}
+		}
+		else
+		{
+			UERROR("Vertex %d not found!? Cannot compute marginals...", id);
+		}
+	}
+	else
+	{
+		g2o::VertexSE3* v = (g2o::VertexSE3*)optimizer.vertex(id);
+		if(v)
+		{
+			UTimer t;
+			g2o::SparseBlockMatrix<g2o::MatrixXD> spinv;
+			optimizer.computeMarginals(spinv, v);
+			UINFO("Computed marginals = %fs (cols=%d rows=%d, v=%d id=%d)", t.ticks(), spinv.cols(), spinv.rows(), v->hessianIndex(), id);
+			if(v->hessianIndex() >= 0 && v->hessianIndex() < (int)spinv.blockCols().size())
+			{
+				g2o::SparseBlockMatrix<g2o::MatrixXD>::SparseMatrixBlock * block = spinv.blockCols()[v->hessianIndex()].begin()->second;
+				UASSERT(block && block->cols() == 6 && block->cols() == 6);
+				memcpy(outputCovariance.data, block->data(), outputCovariance.total()*sizeof(double));
+			}
+			else if(v->hessianIndex() < 0)
+			{
+				UWARN("Computing marginals: vertex %d has negative hessian index (%d). Cannot compute last pose covariance.", id, v->hessianIndex());
+			}
+#ifdef RTABMAP_G2O_CPP11
+			else
+			{
+				UWARN("Computing marginals: vertex %d has hessian not valid (%d > block size=%d). Cannot compute last pose covariance.", id, v->hessianIndex(), (int)spinv.blockCols().size());
+			}
+#endif
+		}
+		else
+		{
+			UERROR("Vertex %d not found!? Cannot compute marginals...", id);
+		}
+	}
+}
+
+static void setEdgeMeasurement(g2o::EdgeSE2 * e, const Link & link, bool covarianceIgnored)
+{
+	Eigen::Matrix<double, 3, 3> information = Eigen::Matrix<double, 3, 3>::Identity();
+	if(!covarianceIgnored)
+	{
+		information(0,0) = link.infMatrix().at<double>(0,0); // x-x
+		information(0,1) = link.infMatrix().at<double>(0,1); // x-y
+		information(0,2) = link.infMatrix().at<double>(0,5); // x-theta
+		information(1,0) = link.infMatrix().at<double>(1,0); // y-x
+		information(1,1) = link.infMatrix().at<double>(1,1); // y-y
+		information(1,2) = link.infMatrix().at<double>(1,5); // y-theta
+		information(2,0) = link.infMatrix().at<double>(5,0); // theta-x
+		information(2,1) = link.infMatrix().at<double>(5,1); // theta-y
+		information(2,2) = link.infMatrix().at<double>(5,5); // theta-theta
+	}
+	e->setMeasurement(g2o::SE2(link.transform().x(), link.transform().y(), link.transform().theta()));
+	e->setInformation(information);
+}
+
+static void setEdgeMeasurement(g2o::EdgeSE3 * e, const Link & link, bool covarianceIgnored)
+{
+	Eigen::Matrix<double, 6, 6> information = Eigen::Matrix<double, 6, 6>::Identity();
+	if(!covarianceIgnored)
+	{
+		memcpy(information.data(), link.infMatrix().data, link.infMatrix().total()*sizeof(double));
+	}
+	Eigen::Affine3d a = link.transform().toEigen3d();
+	Eigen::Isometry3d constraint;
+	constraint = a.linear();
+	constraint.translation() = a.translation();
+	e->setMeasurement(constraint);
+	e->setInformation(information);
+}
+#endif
+
 std::map<int, Transform> OptimizerG2O::optimize(
 		int rootId,
 		const std::map<int, Transform> & poses,
@@ -178,6 +391,7 @@ std::map<int, Transform> OptimizerG2O::optimize(
 		double * finalError,
 		int * iterationsDone)
 {
+	UPROFILER_ZONE("OptimizerG2O::optimize");
 	outputCovariance = cv::Mat::eye(6,6,CV_64FC1);
 	std::map<int, Transform> optimizedPoses;
 #ifdef RTABMAP_G2O
@@ -211,98 +425,8 @@ std::map<int, Transform> OptimizerG2O::optimize(
 			optimizer.addParameter(odomOffset);
 		}
 
-#ifdef RTABMAP_G2O_CPP11
-
-		std::unique_ptr<SlamBlockSolver> blockSolver;
-
-		if(solver_ == 3)
-		{
-			//eigen
-			auto linearSolver = g2o::make_unique<SlamLinearEigenSolver>();
-			linearSolver->setBlockOrdering(false);
-			blockSolver = g2o::make_unique<SlamBlockSolver>(std::move(linearSolver));
-		}
-#ifdef G2O_HAVE_CHOLMOD
-		else if(solver_ == 2)
-		{
-			//chmold
-			auto linearSolver = g2o::make_unique<SlamLinearCholmodSolver>();
-			linearSolver->setBlockOrdering(false);
-			blockSolver = g2o::make_unique<SlamBlockSolver>(std::move(linearSolver));
-		}
-#endif
-#ifdef G2O_HAVE_CSPARSE
-		else if(solver_ == 0)
-		{
-
-			//csparse
-			auto linearSolver = g2o::make_unique<SlamLinearCSparseSolver>();
-			linearSolver->setBlockOrdering(false);
-			blockSolver = g2o::make_unique<SlamBlockSolver>(std::move(linearSolver));
-		}
-#endif
-		else
-		{
-			//pcg
-			auto linearSolver = g2o::make_unique<SlamLinearPCGSolver>();
-			blockSolver = g2o::make_unique<SlamBlockSolver>(std::move(linearSolver));
-		}
-
-		if(optimizer_ == 1)
-		{
-
-			optimizer.setAlgorithm(new g2o::OptimizationAlgorithmGaussNewton(std::move(blockSolver)));
-		}
-		else
-		{
-			optimizer.setAlgorithm(new g2o::OptimizationAlgorithmLevenberg(std::move(blockSolver)));
-		}
+		optimizer.setAlgorithm(createSlamAlgorithm(solver_, optimizer_));
 
-#else
-
-		SlamBlockSolver * blockSolver = 0;
-
-		if(solver_ == 3)
-		{
-			//eigen
-			SlamLinearEigenSolver * linearSolver = new SlamLinearEigenSolver();
-			linearSolver->setBlockOrdering(false);
-			blockSolver = new SlamBlockSolver(linearSolver);
-		}
-#ifdef G2O_HAVE_CHOLMOD
-		else if(solver_ == 2)
-		{
-			//chmold
-			SlamLinearCholmodSolver * linearSolver = new SlamLinearCholmodSolver();
-			linearSolver->setBlockOrdering(false);
-			blockSolver = new SlamBlockSolver(linearSolver);
-		}
-#endif
-#ifdef G2O_HAVE_CSPARSE
-		else if(solver_ == 0)
-		{
-			//csparse
-			SlamLinearCSparseSolver* linearSolver = new SlamLinearCSparseSolver();
-			linearSolver->setBlockOrdering(false);
-			blockSolver = new SlamBlockSolver(linearSolver);
-		}
-#endif
-		else
-		{
-			//pcg
-			SlamLinearPCGSolver * linearSolver = new SlamLinearPCGSolver();
-			blockSolver = new SlamBlockSolver(linearSolver);
-		}
-
-		if(optimizer_ == 1)
-		{
-			optimizer.setAlgorithm(new g2o::OptimizationAlgorithmGaussNewton(blockSolver));
-		}
-		else
-		{
-			optimizer.setAlgorithm(new g2o::OptimizationAlgorithmLevenberg(blockSolver));
-		}
-#endif
 		// detect if there is a global pose prior set, if so remove rootId
 		if(!priorsIgnored())
 		{
@@ -1035,40 +1159,7 @@ std::map<int, Transform> OptimizerG2O::optimize(
 				}
 			}
 
-			g2o::VertexSE2* v = (g2o::VertexSE2*)optimizer.vertex(poses.rbegin()->first);
-			if(v)
-			{
-				UTimer t;
-				g2o::SparseBlockMatrix<g2o::MatrixXD> spinv;
-				optimizer.computeMarginals(spinv, v);
-				UINFO("Computed marginals = %fs (cols=%d rows=%d, v=%d id=%d)", t.ticks(), spinv.cols(), spinv.rows(), v->hessianIndex(), poses.rbegin()->first);
-				if(v->hessianIndex() >= 0 && v->hessianIndex() < (int)spinv.blockCols().size())
-				{
-					g2o::SparseBlockMatrix<g2o::MatrixXD>::SparseMatrixBlock * block = spinv.blockCols()[v->hessianIndex()].begin()->second;
-					UASSERT(block && block->cols() == 3 && block->cols() == 3);
-					outputCovariance.at<double>(0,0) = (*block)(0,0); // x-x
-					outputCovariance.at<double>(0,1) = (*block)(0,1); // x-y
-					outputCovariance.at<double>(0,5) = (*block)(0,2); // x-theta
-					outputCovariance.at<double>(1,0) = (*block)(1,0); // y-x
-					outputCovariance.at<double>(1,1) = (*block)(1,1); // y-y
-					outputCovariance.at<double>(1,5) = (*block)(1,2); // y-theta
-					outputCovariance.at<double>(5,0) = (*block)(2,0); // theta-x
-					outputCovariance.at<double>(5,1) = (*block)(2,1); // theta-y
-					outputCovariance.at<double>(5,5) = (*block)(2,2); // theta-theta
-				}
-				else if(v->hessianIndex() < 0)
-				{
-					UWARN("Computing marginals: vertex %d has negative hessian index (%d). Cannot compute last pose covariance.", poses.rbegin()->first, v->hessianIndex());
-				}
-				else
-				{
-					UWARN("Computing marginals: vertex %d has hessian not valid (%d > block size=%d). Cannot compute last pose covariance.", poses.rbegin()->first, v->hessianIndex(), (int)spinv.blockCols().size());
-				}
-			}
-			else
-			{
-				UERROR("Vertex %d not found!? Cannot compute marginals...", poses.rbegin()->first);
-			}
+			computePoseCovariance(optimizer, poses.rbegin()->first, true, outputCovariance);
 		}
 		else
 		{
@@ -1119,34 +1210,7 @@ std::map<int, Transform> OptimizerG2O::optimize(
 				}
 			}
 
-			g2o::VertexSE3* v = (g2o::VertexSE3*)optimizer.vertex(poses.rbegin()->first);
-			if(v)
-			{
-				UTimer t;
-				g2o::SparseBlockMatrix<g2o::MatrixXD> spinv;
-				optimizer.computeMarginals(spinv, v);
-				UINFO("Computed marginals = %fs (cols=%d rows=%d, v=%d id=%d)", t.ticks(), spinv.cols(), spinv.rows(), v->hessianIndex(), poses.rbegin()->first);
-				if(v->hessianIndex() >= 0 && v->hessianIndex() < (int)spinv.blockCols().size())
-				{
-					g2o::SparseBlockMatrix<g2o::MatrixXD>::SparseMatrixBlock * block = spinv.blockCols()[v->hessianIndex()].begin()->second;
-					UASSERT(block && block->cols() == 6 && block->cols() == 6);
-					memcpy(outputCovariance.data, block->data(), outputCovariance.total()*sizeof(double));
-				}
-				else if(v->hessianIndex() < 0)
-				{
-					UWARN("Computing marginals: vertex %d has negative hessian index (%d). Cannot compute last pose covariance.", poses.rbegin()->first, v->hessianIndex());
-				}
-#ifdef RTABMAP_G2O_CPP11
-				else
-				{
-					UWARN("Computing marginals: vertex %d has hessian not valid (%d > block size=%d). Cannot compute last pose covariance.", poses.rbegin()->first, v->hessianIndex(), (int)spinv.blockCols().size());
-				}
-#endif
-			}
-			else
-			{
-				UERROR("Vertex %d not found!? Cannot compute marginals...", poses.rbegin()->first);
-			}
+			computePoseCovariance(optimizer, poses.rbegin()->first, false, outputCovariance);
 		}
 	}
 	else if(poses.size() == 1 || iterations() <= 0)
@@ -1168,6 +1232,372 @@ std::map<int, Transform> OptimizerG2O::optimize(
 	return optimizedPoses;
 }
 
+std::map<int, Transform> OptimizerG2O::optimizePersistent(
+		int rootId,
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & edgeConstraints,
+		cv::Mat & outputCovariance,
+		double * finalError,
+		int * iterationsDone)
+{
+#ifdef RTABMAP_G2O
+	// Only pose graphs are kept between updates, fallback to batch optimization otherwise
+	bool supported = !isRobust() &&
+			edgeConstraints.size()>=1 &&
+			poses.size()>=2 &&
+			iterations() > 0 &&
+			poses.rbegin()->first > 0 &&
+			(landmarksIgnored() || poses.begin()->first > 0);
+	for(std::multimap<int, Link>::const_iterator iter=edgeConstraints.begin(); supported && iter!=edgeConstraints.end(); ++iter)
+	{
+		if(iter->second.from() == iter->second.to())
+		{
+			if((iter->second.type() == Link::kPosePrior && !priorsIgnored()) ||
+			   (iter->second.type() == Link::kGravity && !isSlam2d() && gravitySigma() > 0))
+			{
+				supported = false;
+			}
+		}
+		else if((iter->second.from() < 0 || iter->second.to() < 0) && !landmarksIgnored())
+		{
+			supported = false;
+		}
+	}
+	if(!supported)
+	{
+		UDEBUG("Graph cannot be optimized incrementally (priors, gravity, landmarks or robust optimization), doing batch optimization.");
+		resetPersistent();
+		incUpdateTime_ = 0.0;
+		return optimize(rootId, poses, edgeConstraints, outputCovariance, 0, finalError, iterationsDone);
+	}
+
+	UTimer timer;
+	outputCovariance = cv::Mat::eye(6,6,CV_64FC1);
+	std::map<int, Transform> optimizedPoses;
+
+	bool structureChanged = false;
+	if(incOptimizer_ && incSlam2d_ != isSlam2d())
+	{
+		resetPersistent();
+	}
+	if(incOptimizer_ == 0)
+	{
+		incOptimizer_ = new g2o::SparseOptimizer();
+		if (isSlam2d())
+		{
+			g2o::ParameterSE2Offset* odomOffset = new g2o::ParameterSE2Offset();
+			odomOffset->setId(PARAM_OFFSET);
+			incOptimizer_->addParameter(odomOffset);
+		}
+		else
+		{
+			g2o::ParameterSE3Offset* odomOffset = new g2o::ParameterSE3Offset();
+			odomOffset->setId(PARAM_OFFSET);
+			incOptimizer_->addParameter(odomOffset);
+		}
+		incOptimizer_->setAlgorithm(createSlamAlgorithm(solver_, optimizer_));
+		incSlam2d_ = isSlam2d();
+		incRootId_ = 0;
+		structureChanged = true;
+	}
+	g2o::SparseOptimizer & optimizer = *incOptimizer_;
+
+	// Update measurements of links already in the graph
+	std::multimap<std::pair<int, int>, g2o::OptimizableGraph::Edge*> currentEdges;
+	for(g2o::HyperGraph::EdgeSet::const_iterator iter=optimizer.edges().begin(); iter!=optimizer.edges().end(); ++iter)
+	{
+		g2o::OptimizableGraph::Edge * e = (g2o::OptimizableGraph::Edge*)(*iter);
+		currentEdges.insert(std::make_pair(std::make_pair(e->vertex(0)->id(), e->vertex(1)->id()), e));
+	}
+	std::list<const Link *> newLinks;
+	for(std::multimap<int, Link>::const_iterator iter=edgeConstraints.begin(); iter!=edgeConstraints.end(); ++iter)
+	{
+		const Link & link = iter->second;
+		if(link.from() == link.to() || link.from() < 0 || link.to() < 0)
+		{
+			// ignored priors, gravity and landmarks (see above)
+			continue;
+		}
+		UASSERT(!link.transform().isNull());
+		std::multimap<std::pair<int, int>, g2o::OptimizableGraph::Edge*>::iterator jter = currentEdges.find(std::make_pair(link.from(), link.to()));
+		if(jter != currentEdges.end())
+		{
+			if(isSlam2d())
+			{
+				setEdgeMeasurement((g2o::EdgeSE2*)jter->second, link, isCovarianceIgnored());
+			}
+			else
+			{
+				setEdgeMeasurement((g2o::EdgeSE3*)jter->second, link, isCovarianceIgnored());
+			}
+			currentEdges.erase(jter);
+		}
+		else
+		{
+			newLinks.push_back(&link);
+		}
+	}
+
+	// Remove links and poses not in the graph anymore (e.g., rejected loop closures, nodes transferred to LTM)
+	int linksRemoved = (int)currentEdges.size();
+	for(std::multimap<std::pair<int, int>, g2o::OptimizableGraph::Edge*>::iterator iter=currentEdges.begin(); iter!=currentEdges.end(); ++iter)
+	{
+		optimizer.removeEdge(iter->second);
+	}
+	std::vector<g2o::HyperGraph::Vertex*> removedVertices;
+	for(g2o::HyperGraph::VertexIDMap::const_iterator iter=optimizer.vertices().begin(); iter!=optimizer.vertices().end(); ++iter)
+	{
+		if(poses.find(iter->first) == poses.end())
+		{
+			removedVertices.push_back(iter->second);
+		}
+	}
+	for(size_t i=0; i<removedVertices.size(); ++i)
+	{
+		optimizer.removeVertex(removedVertices[i]);
+	}
+	structureChanged = structureChanged || linksRemoved > 0 || !removedVertices.empty();
+
+	if(rootId != incRootId_)
+	{
+		g2o::OptimizableGraph::Vertex * v = (g2o::OptimizableGraph::Vertex*)optimizer.vertex(incRootId_);
+		if(v)
+		{
+			v->setFixed(false);
+		}
+		structureChanged = true;
+	}
+
+	// Add new poses, initialized from the already optimized poses they are linked to
+	std::multimap<int, const Link *> newLinksByPose;
+	for(std::list<const Link *>::const_iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter)
+	{
+		newLinksByPose.insert(std::make_pair((*iter)->from(), *iter));
+		newLinksByPose.insert(std::make_pair((*iter)->to(), *iter));
+	}
+	int posesAdded = 0;
+	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
+	{
+		int id = iter->first;
+		if(id <= 0 || optimizer.vertex(id) != 0)
+		{
+			continue;
+		}
+		UASSERT(!iter->second.isNull());
+
+		const Link * seed = 0;
+		g2o::HyperGraph::Vertex * seedVertex = 0;
+		for(std::multimap<int, const Link *>::const_iterator jter=newLinksByPose.lower_bound(id); jter!=newLinksByPose.end() && jter->first == id && seed==0; ++jter)
+		{
+			seedVertex = optimizer.vertex(jter->second->from() == id?jter->second->to():jter->second->from());
+			if(seedVertex)
+			{
+				seed = jter->second;
+			}
+		}
+
+		g2o::HyperGraph::Vertex * vertex = 0;
+		if(isSlam2d())
+		{
+			g2o::VertexSE2 * v2 = new g2o::VertexSE2();
+			g2o::SE2 estimate(iter->second.x(), iter->second.y(), iter->second.theta());
+			if(seed)
+			{
+				g2o::SE2 t(seed->transform().x(), seed->transform().y(), seed->transform().theta());
+				const g2o::SE2 & seedEstimate = ((g2o::VertexSE2*)seedVertex)->estimate();
+				estimate = seed->from() == id?seedEstimate * t.inverse():seedEstimate * t;
+			}
+			v2->setEstimate(estimate);
+			vertex = v2;
+		}
+		else
+		{
+			g2o::VertexSE3 * v3 = new g2o::VertexSE3();
+			Eigen::Affine3d a = iter->second.toEigen3d();
+			Eigen::Isometry3d estimate;
+			estimate = a.linear();
+			estimate.translation() = a.translation();
+			if(seed)
+			{
+				a = seed->transform().toEigen3d();
+				Eigen::Isometry3d t;
+				t = a.linear();
+				t.translation() = a.translation();
+				const Eigen::Isometry3d & seedEstimate = ((g2o::VertexSE3*)seedVertex)->estimate();
+				estimate = seed->from() == id?seedEstimate * t.inverse():seedEstimate * t;
+			}
+			v3->setEstimate(estimate);
+			vertex = v3;
+		}
+		vertex->setId(id);
+		UASSERT_MSG(optimizer.addVertex(vertex), uFormat("cannot insert vertex %d!?", id).c_str());
+		++posesAdded;
+	}
+	g2o::OptimizableGraph::Vertex * root = (g2o::OptimizableGraph::Vertex*)optimizer.vertex(rootId);
+	if(root)
+	{
+		root->setFixed(true);
+	}
+	incRootId_ = rootId;
+
+	// Add new links
+	for(std::list<const Link *>::const_iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter)
+	{
+		const Link & link = **iter;
+		g2o::HyperGraph::Vertex * v1 = optimizer.vertex(link.from());
+		g2o::HyperGraph::Vertex * v2 = optimizer.vertex(link.to());
+		UASSERT_MSG(v1 != 0 && v2 != 0, uFormat("Link %d->%d refers to a pose not in the graph!", link.from(), link.to()).c_str());
+		g2o::OptimizableGraph::Edge * edge = 0;
+		if(isSlam2d())
+		{
+			g2o::EdgeSE2 * e = new g2o::EdgeSE2();
+			e->setVertex(0, v1);
+			e->setVertex(1, v2);
+			setEdgeMeasurement(e, link, isCovarianceIgnored());
+			edge = e;
+		}
+		else
+		{
+			g2o::EdgeSE3 * e = new g2o::EdgeSE3();
+			e->setVertex(0, v1);
+			e->setVertex(1, v2);
+			setEdgeMeasurement(e, link, isCovarianceIgnored());
+			edge = e;
+		}
+		if (!optimizer.addEdge(edge))
+		{
+			delete edge;
+			UERROR("Map: Failed adding constraint between %d and %d, skipping", link.from(), link.to());
+		}
+	}
+	structureChanged = structureChanged || posesAdded > 0 || !newLinks.empty();
+
+	if(structureChanged)
+	{
+		optimizer.initializeOptimization();
+		UASSERT_MSG(optimizer.verifyInformationMatrices(true),
+				"This error can be caused by (1) bad covariance matrix "
+				"set in odometry messages "
+				"(see requirements in g2o::OptimizableGraph::verifyInformationMatrices() function) "
+				"or that (2) PCL and g2o hadn't "
+				"been built both with or without \"-march=native\" compilation "
+				"flag (if one library is built with this flag and not the other, "
+				"this is causing Eigen to not work properly, resulting in segmentation faults).");
+	}
+	incUpdateTime_ = timer.ticks();
+	UINFO("g2o incremental update: %d poses (+%d, -%d), %d links (+%d, -%d) (%fs)",
+			(int)optimizer.vertices().size(), posesAdded, (int)removedVertices.size(),
+			(int)optimizer.edges().size(), (int)newLinks.size(), linksRemoved,
+			incUpdateTime_);
+
+	// If the structure didn't change, the hessian structure of the last optimization is reused
+	bool online = !structureChanged;
+	int it = 0;
+	double lastError = 0.0;
+	if(this->epsilon() > 0.0)
+	{
+		for(int i=0; i<iterations(); ++i)
+		{
+			it += optimizer.optimize(1, online);
+			online = true;
+
+			// early stop condition
+			optimizer.computeActiveErrors();
+			double chi2 = optimizer.activeRobustChi2();
+			UDEBUG("iteration %d: %d nodes, %d edges, chi2: %f", i, (int)optimizer.vertices().size(), (int)optimizer.edges().size(), chi2);
+
+			if(i>0 && chi2 > 1000000000000.0)
+			{
+				break;
+			}
+
+			double errorDelta = lastError - chi2;
+			if(i>0 && errorDelta < this->epsilon())
+			{
+				if(errorDelta < 0)
+				{
+					UDEBUG("Negative improvement?! Ignore and continue optimizing... (%f < %f)", errorDelta, this->epsilon());
+				}
+				else
+				{
+					UINFO("Stop optimizing, not enough improvement (%f < %f)", errorDelta, this->epsilon());
+					break;
+				}
+			}
+			else if(i==0 && chi2 < this->epsilon())
+			{
+				UINFO("Stop optimizing, error is already under epsilon (%f < %f)", chi2, this->epsilon());
+				break;
+			}
+			lastError = chi2;
+		}
+	}
+	else
+	{
+		it = optimizer.optimize(iterations(), online);
+		optimizer.computeActiveErrors();
+		UDEBUG("%d nodes, %d edges, chi2: %f", (int)optimizer.vertices().size(), (int)optimizer.edges().size(), optimizer.activeRobustChi2());
+	}
+	if(finalError)
+	{
+		*finalError = lastError;
+	}
+	if(iterationsDone)
+	{
+		*iterationsDone = it;
+	}
+	UINFO("g2o incremental optimizing end (%d iterations done, error=%f, time = %f s)", it, optimizer.activeRobustChi2(), timer.ticks());
+
+	if(optimizer.activeRobustChi2() > 1000000000000.0)
+	{
+		UWARN("g2o: Large optimimzation error detected (%f), aborting optimization!", optimizer.activeRobustChi2());
+		// don't start the next optimization from this solution
+		resetPersistent();
+		return optimizedPoses;
+	}
+
+	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
+	{
+		int id = iter->first;
+		if(id > 0)
+		{
+			Transform t;
+			if(isSlam2d())
+			{
+				const g2o::VertexSE2* v = (const g2o::VertexSE2*)optimizer.vertex(id);
+				UASSERT(v != 0);
+				float roll, pitch, yaw;
+				iter->second.getEulerAngles(roll, pitch, yaw);
+				t = Transform(v->estimate().translation()[0], v->estimate().translation()[1], iter->second.z(), roll, pitch, v->estimate().rotation().angle());
+			}
+			else
+			{
+				const g2o::VertexSE3* v = (const g2o::VertexSE3*)optimizer.vertex(id);
+				UASSERT(v != 0);
+				t = Transform::fromEigen3d(v->estimate());
+			}
+			UASSERT_MSG(!t.isNull(), uFormat("Optimized pose %d is null!?!?", id).c_str());
+			optimizedPoses.insert(std::pair<int, Transform>(id, t));
+		}
+	}
+
+	computePoseCovariance(optimizer, poses.rbegin()->first, isSlam2d(), outputCovariance);
+
+	return optimizedPoses;
+#else
+	return optimize(rootId, poses, edgeConstraints, outputCovariance, 0, finalError, iterationsDone);
+#endif
+}
+
+void OptimizerG2O::resetPersistent()
+{
+#ifdef RTABMAP_G2O
+	delete incOptimizer_;
+#endif
+	incOptimizer_ = 0;
+	incRootId_ = 0;
+}
+
 #ifdef RTABMAP_ORB_SLAM2
 /**
  * \brief 3D edge between two SBAcam
@@ -1252,6 +1682,7 @@ std::map<int, Transform> OptimizerG2O::optimizeBA(
 		const std::map<int, std::map<int, FeatureBA> > & wordReferences,
 		std::set<int> * outliers)
 {
+	UPROFILER_ZONE("OptimizerG2O::optimizeBA");
 	std::map<int, Transform> optimizedPoses;
 #if defined(RTABMAP_G2O) || defined(RTABMAP_ORB_SLAM2)
 	UDEBUG("Optimizing graph...");
@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UProfiler.h>
 #include <set>
 
 #include <rtabmap/core/optimizer/OptimizerGTSAM.h>
@@ -49,6 +50,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <gtsam/nonlinear/LevenbergMarquardtOptimizer.h>
 #include <gtsam/nonlinear/NonlinearOptimizer.h>
 #include <gtsam/nonlinear/Marginals.h>
+#include <gtsam/nonlinear/ISAM2.h>
 #include <gtsam/nonlinear/Values.h>
 #include "gtsam/GravityFactor.h"
 #include "gtsam/GPSPose2XYFactor.h"
@@ -77,8 +79,82 @@ void OptimizerGTSAM::parseParameters(const ParametersMap & parameters)
 {
 	Optimizer::parseParameters(parameters);
 	Parameters::parse(parameters, Parameters::kGTSAMOptimizer(), optimizer_);
+	Parameters::parse(parameters, Parameters::kGTSAMIncrementalRelinearizeThreshold(), relinearizeThreshold_);
+	Parameters::parse(parameters, Parameters::kGTSAMIncrementalRelinearizeSkip(), relinearizeSkip_);
+
+	// parameters may have changed, rebuild the graph on next incremental update
+	resetPersistent();
+}
+
+OptimizerGTSAM::~OptimizerGTSAM()
+{
+	resetPersistent();
+}
+
+#ifdef RTABMAP_GTSAM
+static gtsam::SharedNoiseModel createLinkNoiseModel(const Link & link, bool slam2d, bool covarianceIgnored)
+{
+	if(slam2d)
+	{
+		Eigen::Matrix<double, 3, 3> information = Eigen::Matrix<double, 3, 3>::Identity();
+		if(!covarianceIgnored)
+		{
+			information(0,0) = link.infMatrix().at<double>(0,0); // x-x
+			information(0,1) = link.infMatrix().at<double>(0,1); // x-y
+			information(0,2) = link.infMatrix().at<double>(0,5); // x-theta
+			information(1,0) = link.infMatrix().at<double>(1,0); // y-x
+			information(1,1) = link.infMatrix().at<double>(1,1); // y-y
+			information(1,2) = link.infMatrix().at<double>(1,5); // y-theta
+			information(2,0) = link.infMatrix().at<double>(5,0); // theta-x
+			information(2,1) = link.infMatrix().at<double>(5,1); // theta-y
+			information(2,2) = link.infMatrix().at<double>(5,5); // theta-theta
+		}
+		return gtsam::noiseModel::Gaussian::Information(information);
+	}
+
+	Eigen::Matrix<double, 6, 6> information = Eigen::Matrix<double, 6, 6>::Identity();
+	if(!covarianceIgnored)
+	{
+		memcpy(information.data(), link.infMatrix().data, link.infMatrix().total()*sizeof(double));
+	}
+
+	Eigen::Matrix<double, 6, 6> mgtsam = Eigen::Matrix<double, 6, 6>::Identity();
+	mgtsam.block(0,0,3,3) = information.block(3,3,3,3); // cov rotation
+	mgtsam.block(3,3,3,3) = information.block(0,0,3,3); // cov translation
+	mgtsam.block(0,3,3,3) = information.block(0,3,3,3); // off diagonal
+	mgtsam.block(3,0,3,3) = information.block(3,0,3,3); // off diagonal
+	return gtsam::noiseModel::Gaussian::Information(mgtsam);
 }
 
+static bool convertMarginalCovariance(const gtsam::Matrix & info, bool slam2d, cv::Mat & outputCovariance)
+{
+	if(slam2d && info.cols() == 3 && info.cols() == 3)
+	{
+		outputCovariance.at<double>(0,0) = info(0,0); // x-x
+		outputCovariance.at<double>(0,1) = info(0,1); // x-y
+		outputCovariance.at<double>(0,5) = info(0,2); // x-theta
+		outputCovariance.at<double>(1,0) = info(1,0); // y-x
+		outputCovariance.at<double>(1,1) = info(1,1); // y-y
+		outputCovariance.at<double>(1,5) = info(1,2); // y-theta
+		outputCovariance.at<double>(5,0) = info(2,0); // theta-x
+		outputCovariance.at<double>(5,1) = info(2,1); // theta-y
+		outputCovariance.at<double>(5,5) = info(2,2); // theta-theta
+		return true;
+	}
+	else if(!slam2d && info.cols() == 6 && info.cols() == 6)
+	{
+		Eigen::Matrix<double, 6, 6> mgtsam = Eigen::Matrix<double, 6, 6>::Identity();
+		mgtsam.block(3,3,3,3) = info.block(0,0,3,3); // cov rotation
+		mgtsam.block(0,0,3,3) = info.block(3,3,3,3); // cov translation
+		mgtsam.block(0,3,3,3) = info.block(0,3,3,3); // off diagonal
+		mgtsam.block(3,0,3,3) = info.block(3,0,3,3); // off diagonal
+		memcpy(outputCovariance.data, mgtsam.data(), outputCovariance.total()*sizeof(double));
+		return true;
+	}
+	return false;
+}
+#endif
+
 std::map<int, Transform> OptimizerGTSAM::optimize(
 		int rootId,
 		const std::map<int, Transform> & poses,
@@ -88,6 +164,7 @@ std::map<int, Transform> OptimizerGTSAM::optimize(
 		double * finalError,
 		int * iterationsDone)
 {
+	UPROFILER_ZONE("OptimizerGTSAM::optimize");
 	outputCovariance = cv::Mat::eye(6,6,CV_64FC1);
 	std::map<int, Transform> optimizedPoses;
 #ifdef RTABMAP_GTSAM
@@ -402,23 +479,9 @@ std::map<int, Transform> OptimizerGTSAM::optimize(
 				}
 #endif
 
+				gtsam::SharedNoiseModel model = createLinkNoiseModel(iter->second, isSlam2d(), isCovarianceIgnored());
 				if(isSlam2d())
 				{
-					Eigen::Matrix<double, 3, 3> information = Eigen::Matrix<double, 3, 3>::Identity();
-					if(!isCovarianceIgnored())
-					{
-						information(0,0) = iter->second.infMatrix().at<double>(0,0); // x-x
-						information(0,1) = iter->second.infMatrix().at<double>(0,1); // x-y
-						information(0,2) = iter->second.infMatrix().at<double>(0,5); // x-theta
-						information(1,0) = iter->second.infMatrix().at<double>(1,0); // y-x
-						information(1,1) = iter->second.infMatrix().at<double>(1,1); // y-y
-						information(1,2) = iter->second.infMatrix().at<double>(1,5); // y-theta
-						information(2,0) = iter->second.infMatrix().at<double>(5,0); // theta-x
-						information(2,1) = iter->second.infMatrix().at<double>(5,1); // theta-y
-						information(2,2) = iter->second.infMatrix().at<double>(5,5); // theta-theta
-					}
-					gtsam::noiseModel::Gaussian::shared_ptr model = gtsam::noiseModel::Gaussian::Information(information);
-
 #ifdef RTABMAP_VERTIGO
 					if(this->isRobust() &&
 					   iter->second.type()!=Link::kNeighbor &&
@@ -435,19 +498,6 @@ std::map<int, Transform> OptimizerGTSAM::optimize(
 				}
 				else
 				{
-					Eigen::Matrix<double, 6, 6> information = Eigen::Matrix<double, 6, 6>::Identity();
-					if(!isCovarianceIgnored())
-					{
-						memcpy(information.data(), iter->second.infMatrix().data, iter->second.infMatrix().total()*sizeof(double));
-					}
-
-					Eigen::Matrix<double, 6, 6> mgtsam = Eigen::Matrix<double, 6, 6>::Identity();
-					mgtsam.block(0,0,3,3) = information.block(3,3,3,3); // cov rotation
-					mgtsam.block(3,3,3,3) = information.block(0,0,3,3); // cov translation
-					mgtsam.block(0,3,3,3) = information.block(0,3,3,3); // off diagonal
-					mgtsam.block(3,0,3,3) = information.block(3,0,3,3); // off diagonal
-					gtsam::SharedNoiseModel model = gtsam::noiseModel::Gaussian::Information(mgtsam);
-
 #ifdef RTABMAP_VERTIGO
 					if(this->isRobust() &&
 					   iter->second.type() != Link::kNeighbor &&
@@ -663,28 +713,7 @@ std::map<int, Transform> OptimizerGTSAM::optimize(
 			gtsam::Marginals marginals(graph, optimizer->values());
 			gtsam::Matrix info = marginals.marginalCovariance(poses.rbegin()->first);
 			UDEBUG("Computed marginals = %fs (key=%d)", t.ticks(), poses.rbegin()->first);
-			if(isSlam2d() && info.cols() == 3 && info.cols() == 3)
-			{
-				outputCovariance.at<double>(0,0) = info(0,0); // x-x
-				outputCovariance.at<double>(0,1) = info(0,1); // x-y
-				outputCovariance.at<double>(0,5) = info(0,2); // x-theta
-				outputCovariance.at<double>(1,0) = info(1,0); // y-x
-				outputCovariance.at<double>(1,1) = info(1,1); // y-y
-				outputCovariance.at<double>(1,5) = info(1,2); // y-theta
-				outputCovariance.at<double>(5,0) = info(2,0); // theta-x
-				outputCovariance.at<double>(5,1) = info(2,1); // theta-y
-				outputCovariance.at<double>(5,5) = info(2,2); // theta-theta
-			}
-			else if(!isSlam2d() && info.cols() == 6 && info.cols() == 6)
-			{
-				Eigen::Matrix<double, 6, 6> mgtsam = Eigen::Matrix<double, 6, 6>::Identity();
-				mgtsam.block(3,3,3,3) = info.block(0,0,3,3); // cov rotation
-				mgtsam.block(0,0,3,3) = info.block(3,3,3,3); // cov translation
-				mgtsam.block(0,3,3,3) = info.block(0,3,3,3); // off diagonal
-				mgtsam.block(3,0,3,3) = info.block(3,0,3,3); // off diagonal
-				memcpy(outputCovariance.data, mgtsam.data(), outputCovariance.total()*sizeof(double));
-			}
-			else
+			if(!convertMarginalCovariance(info, isSlam2d(), outputCovariance))
 			{
 				UWARN("GTSAM: Could not compute marginal covariance!");
 			}
@@ -715,4 +744,387 @@ std::map<int, Transform> OptimizerGTSAM::optimize(
 	return optimizedPoses;
 }
 
+std::map<int, Transform> OptimizerGTSAM::optimizePersistent(
+		int rootId,
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & edgeConstraints,
+		cv::Mat & outputCovariance,
+		double * finalError,
+		int * iterationsDone)
+{
+#ifdef RTABMAP_GTSAM
+	// Only pose graphs are kept between updates, fallback to batch optimization otherwise
+	bool supported = !isRobust() &&
+			edgeConstraints.size()>=1 &&
+			poses.size()>=2 &&
+			iterations() > 0 &&
+			poses.rbegin()->first > 0 &&
+			(landmarksIgnored() || poses.begin()->first > 0);
+	for(std::multimap<int, Link>::const_iterator iter=edgeConstraints.begin(); supported && iter!=edgeConstraints.end(); ++iter)
+	{
+		if(iter->second.from() == iter->second.to())
+		{
+			if((iter->second.type() == Link::kPosePrior && !priorsIgnored()) ||
+			   (iter->second.type() == Link::kGravity && !isSlam2d() && gravitySigma() > 0))
+			{
+				supported = false;
+			}
+		}
+		else if((iter->second.from() < 0 || iter->second.to() < 0) && !landmarksIgnored())
+		{
+			supported = false;
+		}
+	}
+	if(!supported)
+	{
+		UDEBUG("Graph cannot be optimized incrementally (priors, gravity, landmarks or robust optimization), doing batch optimization.");
+		resetPersistent();
+		isamUpdateTime_ = 0.0;
+		return optimize(rootId, poses, edgeConstraints, outputCovariance, 0, finalError, iterationsDone);
+	}
+
+	UTimer timer;
+	outputCovariance = cv::Mat::eye(6,6,CV_64FC1);
+	std::map<int, Transform> optimizedPoses;
+
+	if(isam_ && isamSlam2d_ != isSlam2d())
+	{
+		resetPersistent();
+	}
+	if(isam_)
+	{
+		// iSAM2 cannot remove variables: poses leaving the graph are kept
+		// disconnected with a prior, rebuild when there are too many of them.
+		int parked = 0;
+		const gtsam::Values & theta = isam_->getLinearizationPoint();
+		for(gtsam::Values::const_iterator iter=theta.begin(); iter!=theta.end(); ++iter)
+		{
+			if(poses.find((int)iter->key) == poses.end())
+			{
+				++parked;
+			}
+		}
+		if(parked > 100 && parked > (int)poses.size())
+		{
+			UDEBUG("%d poses are not in the graph anymore (graph has %d poses), rebuilding iSAM2 graph.", parked, (int)poses.size());
+			resetPersistent();
+		}
+	}
+	if(isam_ == 0)
+	{
+		gtsam::ISAM2Params params;
+		if(optimizer_ == 2)
+		{
+			params.optimizationParams = gtsam::ISAM2DoglegParams();
+		}
+		else
+		{
+			// Levenberg-Marquardt is not available with iSAM2
+			params.optimizationParams = gtsam::ISAM2GaussNewtonParams();
+		}
+		params.relinearizeThreshold = relinearizeThreshold_;
+		params.relinearizeSkip = relinearizeSkip_>1?relinearizeSkip_:1;
+		isam_ = new gtsam::ISAM2(params);
+		isamSlam2d_ = isSlam2d();
+		isamRootId_ = 0;
+		isamRootFactor_ = 0;
+	}
+	const gtsam::Values & theta = isam_->getLinearizationPoint();
+
+	// Find new links and links with a changed measurement
+	gtsam::FastVector<size_t> removedFactors;
+	std::list<const Link *> newLinks;
+	std::set<std::pair<int, int> > links;
+	bool loopClosureAdded = false;
+	for(std::multimap<int, Link>::const_iterator iter=edgeConstraints.begin(); iter!=edgeConstraints.end(); ++iter)
+	{
+		const Link & link = iter->second;
+		if(link.from() == link.to() || link.from() < 0 || link.to() < 0)
+		{
+			// ignored priors, gravity and landmarks (see above)
+			continue;
+		}
+		UASSERT(!link.transform().isNull());
+		std::pair<int, int> key(link.from(), link.to());
+		links.insert(key);
+		std::map<std::pair<int, int>, std::pair<size_t, Link> >::iterator jter = isamLinks_.find(key);
+		if(jter != isamLinks_.end())
+		{
+			if(jter->second.second.transform() == link.transform() &&
+			   cv::countNonZero(jter->second.second.infMatrix() != link.infMatrix()) == 0)
+			{
+				continue;
+			}
+			removedFactors.push_back(jter->second.first);
+			isamLinks_.erase(jter);
+		}
+		newLinks.push_back(&link);
+		loopClosureAdded = loopClosureAdded || (link.type() != Link::kNeighbor && link.type() != Link::kNeighborMerged);
+	}
+
+	// Remove links not in the graph anymore (e.g., rejected loop closures, nodes transferred to LTM)
+	int linksRemoved = 0;
+	for(std::map<std::pair<int, int>, std::pair<size_t, Link> >::iterator iter=isamLinks_.begin(); iter!=isamLinks_.end();)
+	{
+		if(links.find(iter->first) == links.end())
+		{
+			removedFactors.push_back(iter->second.first);
+			isamLinks_.erase(iter++);
+			++linksRemoved;
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	// Poses coming back in the graph (e.g., retrieved from LTM) lose their parking prior
+	for(std::map<int, size_t>::iterator iter=isamParkedPoses_.begin(); iter!=isamParkedPoses_.end();)
+	{
+		if(poses.find(iter->first) != poses.end())
+		{
+			removedFactors.push_back(iter->second);
+			isamParkedPoses_.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	gtsam::NonlinearFactorGraph newFactors;
+	gtsam::Values newValues;
+
+	// Poses leaving the graph are parked: all their links are removed, so
+	// a prior at their current value keeps the system determined.
+	std::vector<int> parkedPoses;
+	for(gtsam::Values::const_iterator iter=theta.begin(); iter!=theta.end(); ++iter)
+	{
+		int id = (int)iter->key;
+		if(poses.find(id) == poses.end() && isamParkedPoses_.find(id) == isamParkedPoses_.end())
+		{
+			if(isSlam2d())
+			{
+				newFactors.add(gtsam::PriorFactor<gtsam::Pose2>(id, iter->value.cast<gtsam::Pose2>(), gtsam::noiseModel::Unit::Create(3)));
+			}
+			else
+			{
+				newFactors.add(gtsam::PriorFactor<gtsam::Pose3>(id, iter->value.cast<gtsam::Pose3>(), gtsam::noiseModel::Unit::Create(6)));
+			}
+			parkedPoses.push_back(id);
+		}
+	}
+
+	// Add new poses, initialized from the already optimized poses they are linked to
+	std::multimap<int, const Link *> newLinksByPose;
+	for(std::list<const Link *>::const_iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter)
+	{
+		newLinksByPose.insert(std::make_pair((*iter)->from(), *iter));
+		newLinksByPose.insert(std::make_pair((*iter)->to(), *iter));
+	}
+	int posesAdded = 0;
+	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
+	{
+		int id = iter->first;
+		if(id <= 0 || theta.exists(id))
+		{
+			continue;
+		}
+		UASSERT(!iter->second.isNull());
+
+		const Link * seed = 0;
+		int seedId = 0;
+		for(std::multimap<int, const Link *>::const_iterator jter=newLinksByPose.lower_bound(id); jter!=newLinksByPose.end() && jter->first == id && seed==0; ++jter)
+		{
+			seedId = jter->second->from() == id?jter->second->to():jter->second->from();
+			if(newValues.exists(seedId) || theta.exists(seedId))
+			{
+				seed = jter->second;
+			}
+		}
+
+		if(isSlam2d())
+		{
+			gtsam::Pose2 estimate(iter->second.x(), iter->second.y(), iter->second.theta());
+			if(seed)
+			{
+				gtsam::Pose2 t(seed->transform().x(), seed->transform().y(), seed->transform().theta());
+				gtsam::Pose2 seedEstimate = newValues.exists(seedId)?newValues.at<gtsam::Pose2>(seedId):isam_->calculateEstimate<gtsam::Pose2>(seedId);
+				estimate = seed->from() == id?seedEstimate * t.inverse():seedEstimate * t;
+			}
+			newValues.insert(id, estimate);
+		}
+		else
+		{
+			gtsam::Pose3 estimate(iter->second.toEigen4d());
+			if(seed)
+			{
+				gtsam::Pose3 t(seed->transform().toEigen4d());
+				gtsam::Pose3 seedEstimate = newValues.exists(seedId)?newValues.at<gtsam::Pose3>(seedId):isam_->calculateEstimate<gtsam::Pose3>(seedId);
+				estimate = seed->from() == id?seedEstimate * t.inverse():seedEstimate * t;
+			}
+			newValues.insert(id, estimate);
+		}
+		++posesAdded;
+	}
+
+	// Add new links
+	for(std::list<const Link *>::const_iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter)
+	{
+		const Link & link = **iter;
+		UASSERT_MSG((theta.exists(link.from()) || newValues.exists(link.from())) &&
+				(theta.exists(link.to()) || newValues.exists(link.to())),
+				uFormat("Link %d->%d refers to a pose not in the graph!", link.from(), link.to()).c_str());
+		gtsam::SharedNoiseModel model = createLinkNoiseModel(link, isSlam2d(), isCovarianceIgnored());
+		if(isSlam2d())
+		{
+			newFactors.add(gtsam::BetweenFactor<gtsam::Pose2>(link.from(), link.to(), gtsam::Pose2(link.transform().x(), link.transform().y(), link.transform().theta()), model));
+		}
+		else
+		{
+			newFactors.add(gtsam::BetweenFactor<gtsam::Pose3>(link.from(), link.to(), gtsam::Pose3(link.transform().toEigen4d()), model));
+		}
+	}
+
+	// Move the root prior
+	bool rootChanged = rootId != isamRootId_;
+	if(rootChanged)
+	{
+		UASSERT(uContains(poses, rootId));
+		if(isamRootId_ != 0)
+		{
+			removedFactors.push_back(isamRootFactor_);
+		}
+		// Keep the current estimate of the root to avoid moving the whole graph
+		if(isSlam2d())
+		{
+			gtsam::Pose2 rootPose = newValues.exists(rootId)?newValues.at<gtsam::Pose2>(rootId):isam_->calculateEstimate<gtsam::Pose2>(rootId);
+			newFactors.add(gtsam::PriorFactor<gtsam::Pose2>(rootId, rootPose, gtsam::noiseModel::Diagonal::Variances(gtsam::Vector3(0.01, 0.01, 0.01))));
+		}
+		else
+		{
+			gtsam::Pose3 rootPose = newValues.exists(rootId)?newValues.at<gtsam::Pose3>(rootId):isam_->calculateEstimate<gtsam::Pose3>(rootId);
+			newFactors.add(gtsam::PriorFactor<gtsam::Pose3>(rootId, rootPose, gtsam::noiseModel::Diagonal::Variances(
+					(gtsam::Vector(6) << 1e-2, 1e-2, 1e-2, 1e-2, 1e-2, 1e-2).finished())));
+		}
+	}
+
+	// Neighbor-only updates don't need extra relinearization steps
+	bool fastPath = !loopClosureAdded && !rootChanged && removedFactors.empty() && parkedPoses.empty();
+	int it = 0;
+	try
+	{
+		gtsam::ISAM2Result result = isam_->update(newFactors, newValues, removedFactors);
+		++it;
+
+		// Factors are indexed in the order they were added
+		UASSERT(result.newFactorsIndices.size() == newFactors.size());
+		size_t i=0;
+		for(; i<parkedPoses.size(); ++i)
+		{
+			isamParkedPoses_.insert(std::make_pair(parkedPoses[i], result.newFactorsIndices[i]));
+		}
+		for(std::list<const Link *>::const_iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter, ++i)
+		{
+			isamLinks_.insert(std::make_pair(std::make_pair((*iter)->from(), (*iter)->to()), std::make_pair(result.newFactorsIndices[i], **iter)));
+		}
+		if(rootChanged)
+		{
+			isamRootFactor_ = result.newFactorsIndices[i];
+			isamRootId_ = rootId;
+		}
+		isamUpdateTime_ = timer.ticks();
+		UINFO("GTSAM iSAM2 update: %d poses (+%d, parked %d), %d links (+%d, -%d), relinearized=%d (%fs)",
+				(int)theta.size(), posesAdded, (int)isamParkedPoses_.size(),
+				(int)isamLinks_.size(), (int)newLinks.size(), linksRemoved,
+				(int)result.variablesRelinearized,
+				isamUpdateTime_);
+
+		if(!fastPath)
+		{
+			// Relinearize until no pose moves over the threshold
+			for(; it<iterations(); ++it)
+			{
+				result = isam_->update(gtsam::NonlinearFactorGraph(), gtsam::Values(), gtsam::FastVector<size_t>(), boost::none, boost::none, boost::none, true);
+				UDEBUG("iteration %d: relinearized=%d", it, (int)result.variablesRelinearized);
+				if(result.variablesRelinearized == 0)
+				{
+					++it;
+					break;
+				}
+			}
+		}
+	}
+	catch(gtsam::IndeterminantLinearSystemException & e)
+	{
+		UWARN("GTSAM exception caught: %s\n Graph has %d edges and %d vertices", e.what(),
+				(int)edgeConstraints.size(),
+				(int)poses.size());
+		// don't start the next optimization from this solution
+		resetPersistent();
+		return optimizedPoses;
+	}
+	if(iterationsDone)
+	{
+		*iterationsDone = it;
+	}
+
+	gtsam::Values estimate = isam_->calculateEstimate();
+	if(finalError)
+	{
+		*finalError = isam_->getFactorsUnsafe().error(estimate);
+	}
+	UINFO("GTSAM iSAM2 optimizing end (%d updates done, fast path=%d, time = %f s)", it, fastPath?1:0, timer.ticks());
+
+	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
+	{
+		int id = iter->first;
+		if(id > 0)
+		{
+			if(isSlam2d())
+			{
+				gtsam::Pose2 p = estimate.at<gtsam::Pose2>(id);
+				optimizedPoses.insert(std::make_pair(id, Transform(p.x(), p.y(), p.theta())));
+			}
+			else
+			{
+				gtsam::Pose3 p = estimate.at<gtsam::Pose3>(id);
+				optimizedPoses.insert(std::make_pair(id, Transform::fromEigen4d(p.matrix())));
+			}
+		}
+	}
+
+	// The last pose is generally close to the root of the Bayes tree, so its marginal is cheap
+	try {
+		UTimer t;
+		gtsam::Matrix info = isam_->marginalCovariance(poses.rbegin()->first);
+		UDEBUG("Computed marginals = %fs (key=%d)", t.ticks(), poses.rbegin()->first);
+		if(!convertMarginalCovariance(info, isSlam2d(), outputCovariance))
+		{
+			UWARN("GTSAM: Could not compute marginal covariance!");
+		}
+	}
+	catch(std::exception& e)
+	{
+		UWARN("GTSAM exception caught: %s", e.what());
+	}
+
+	return optimizedPoses;
+#else
+	return optimize(rootId, poses, edgeConstraints, outputCovariance, 0, finalError, iterationsDone);
+#endif
+}
+
+void OptimizerGTSAM::resetPersistent()
+{
+#ifdef RTABMAP_GTSAM
+	delete isam_;
+#endif
+	isam_ = 0;
+	isamLinks_.clear();
+	isamParkedPoses_.clear();
+	isamRootId_ = 0;
+	isamRootFactor_ = 0;
+}
+
 } /* namespace rtabmap */
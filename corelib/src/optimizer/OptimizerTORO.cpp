@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UProfiler.h>
 #include <set>
 
 #include <rtabmap/core/optimizer/OptimizerTORO.h>
@@ -60,6 +61,7 @@ std::map<int, Transform> OptimizerTORO::optimize(
 		double * finalError,
 		int * iterationsDone)
 {
+	UPROFILER_ZONE("OptimizerTORO::optimize");
 	outputCovariance = cv::Mat::eye(6,6,CV_64FC1);
 	std::map<int, Transform> optimizedPoses;
 #ifdef RTABMAP_TORO
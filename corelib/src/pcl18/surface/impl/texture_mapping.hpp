@@ -42,6 +42,10 @@
 #include <pcl18/surface/texture_mapping.h>
 #include <pcl/search/octree.h>
 #include <pcl/common/common.h> // for getAngle3D
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
 template<typename PointInT> std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> >
@@ -1078,208 +1082,371 @@ pcl::TextureMapping<PointInT>::textureMeshwithMultipleCameras2 (
 	std::vector<Eigen::Affine3f> invCamTransform(cameras.size());
 	std::vector<std::list<int> > faceCameras(faces.size());
 	UINFO("Precompute visible faces per cam (%d faces, %d cams)", (int)faces.size(), (int)cameras.size());
-	for (unsigned int current_cam = 0; current_cam < cameras.size(); ++current_cam)
-	{
-		UDEBUG("Texture camera %d...", current_cam);
-
-		typename pcl::PointCloud<PointInT>::Ptr camera_cloud (new pcl::PointCloud<PointInT>);
-		pcl::transformPointCloud(*mesh_cloud, *camera_cloud, cameras[current_cam].pose.inverse());
 
-		std::vector<int> visibilityIndices;
-		visibilityIndices.resize (faces.size ());
-		pcl::PointCloud<pcl::PointXY>::Ptr projections (new pcl::PointCloud<pcl::PointXY>);
-		projections->resize(faces.size()*3);
-		std::map<float, int> sortedVisibleFaces;
-		int oi=0;
+	// When max distance is set, index face centroids in a uniform grid so that
+	// each camera only tests the faces that can be inside its frustum.
+	bool useFaceGrid = max_distance_ > 0.0f && !faces.empty();
+	Eigen::Vector3f gridMin(0,0,0);
+	Eigen::Vector3i gridSize(0,0,0);
+	std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > faceCentroids;
+	std::map<long long, std::vector<int> > faceGrid;
+	if(useFaceGrid)
+	{
+		faceCentroids.resize(faces.size());
+		gridMin = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+		Eigen::Vector3f gridMax = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
 		for(unsigned int idx_face=0; idx_face<faces.size(); ++idx_face)
 		{
-			pcl::Vertices & face = faces[idx_face];
-
-			int j=oi*3;
-			pcl::PointXY & uv_coords1 = projections->at(j);
-			pcl::PointXY & uv_coords2 = projections->at(j+1);
-			pcl::PointXY & uv_coords3 = projections->at(j+2);
-			PointInT & pt0 = camera_cloud->points[face.vertices[0]];
-			PointInT & pt1 = camera_cloud->points[face.vertices[1]];
-			PointInT & pt2 = camera_cloud->points[face.vertices[2]];
-			if (isFaceProjected (cameras[current_cam],
-					pt0,
-					pt1,
-					pt2,
-					uv_coords1,
-					uv_coords2,
-					uv_coords3))
+			const pcl::Vertices & face = faces[idx_face];
+			const PointInT & pt0 = mesh_cloud->points[face.vertices[0]];
+			const PointInT & pt1 = mesh_cloud->points[face.vertices[1]];
+			const PointInT & pt2 = mesh_cloud->points[face.vertices[2]];
+			faceCentroids[idx_face] = Eigen::Vector3f(
+					(pt0.x+pt1.x+pt2.x)/3.0f,
+					(pt0.y+pt1.y+pt2.y)/3.0f,
+					(pt0.z+pt1.z+pt2.z)/3.0f);
+			gridMin = gridMin.cwiseMin(faceCentroids[idx_face]);
+			gridMax = gridMax.cwiseMax(faceCentroids[idx_face]);
+		}
+		for(int i=0; i<3 && useFaceGrid; ++i)
+		{
+			double cells = std::floor((gridMax[i]-gridMin[i])/max_distance_)+1.0;
+			if(!std::isfinite(cells) || cells >= double(1<<20))
+			{
+				// mesh too large compared to max distance, test all faces
+				useFaceGrid = false;
+			}
+			else
+			{
+				gridSize[i] = (int)cells;
+			}
+		}
+		if(useFaceGrid)
+		{
+			for(unsigned int idx_face=0; idx_face<faces.size(); ++idx_face)
 			{
-				// check if the polygon is facing the camera, assuming counterclockwise normal
-				Eigen::Vector3f v0(
-						uv_coords2.x - uv_coords1.x,
-						uv_coords2.y - uv_coords1.y,
-						0);
-				Eigen::Vector3f v1(
-						uv_coords3.x - uv_coords1.x,
-						uv_coords3.y - uv_coords1.y,
-						0);
-				Eigen::Vector3f normal = v0.cross(v1);
-				float angle = normal.dot(Eigen::Vector3f(0.0f,0.0f,1.0f));
-				bool facingTheCam = angle>0.0f;
-				float distanceToCam = std::min(std::min(pt0.z, pt1.z), pt2.z);
-				float angleToCam = 0.0f;
-				Eigen::Vector3f e0 = Eigen::Vector3f(
-						pt1.x - pt0.x,
-						pt1.y - pt0.y,
-						pt1.z - pt0.z);
-				Eigen::Vector3f e1 = Eigen::Vector3f(
-						pt2.x - pt0.x,
-						pt2.y - pt0.y,
-						pt2.z - pt0.z);
-				Eigen::Vector3f e2 = Eigen::Vector3f(
-						pt2.x - pt1.x,
-						pt2.y - pt1.y,
-						pt2.z - pt1.z);
-				if(facingTheCam && this->max_angle_)
+				long long cell[3];
+				for(int i=0; i<3; ++i)
 				{
-					Eigen::Vector3f normal3D;
-					normal3D = e0.cross(e1);
-					angleToCam = pcl::getAngle3D(Eigen::Vector4f(normal3D[0], normal3D[1], normal3D[2], 0.0f), Eigen::Vector4f(0.0f,0.0f,-1.0f,0.0f));
+					cell[i] = std::min((int)((faceCentroids[idx_face][i]-gridMin[i])/max_distance_), gridSize[i]-1);
 				}
-
-				// longest edge
-				float e0norm2 = e0[0]*e0[0] + e0[1]*e0[1] + e0[2]*e0[2];
-				float e1norm2 = e1[0]*e1[0] + e1[1]*e1[1] + e1[2]*e1[2];
-				float e2norm2 = e2[0]*e2[0] + e2[1]*e2[1] + e2[2]*e2[2];
-				float longestEdgeSqrd = std::max(std::max(e0norm2, e1norm2), e2norm2);
-
-				pcl::PointXY center;
-				center.x = (uv_coords1.x+uv_coords2.x+uv_coords3.x)/3.0f;
-				center.y = (uv_coords1.y+uv_coords2.y+uv_coords3.y)/3.0f;
-				visibleFaces[current_cam].insert(visibleFaces[current_cam].end(), std::make_pair(idx_face, FaceInfo(distanceToCam, angleToCam, longestEdgeSqrd, facingTheCam, uv_coords1, uv_coords2, uv_coords3, center)));
-				sortedVisibleFaces.insert(std::make_pair(distanceToCam, idx_face));
-				visibilityIndices[oi] = idx_face;
-				++oi;
+				faceGrid[(cell[0]<<42) | (cell[1]<<21) | cell[2]].push_back(idx_face);
 			}
+			UDEBUG("Indexed %d faces in %d cells (%dx%dx%d)", (int)faces.size(), (int)faceGrid.size(), gridSize[0], gridSize[1], gridSize[2]);
 		}
-		visibilityIndices.resize(oi);
-		projections->resize(oi*3);
-		UASSERT(projections->size() == visibilityIndices.size()*3);
-
-		//filter occluded polygons
-		//create kdtree
-		pcl::KdTreeFLANN<pcl::PointXY> kdtree;
-		kdtree.setInputCloud (projections);
-
-		std::vector<int> idxNeighbors;
-		std::vector<float> neighborsSquaredDistance;
-		// af first (idx_pcan < current_cam), check if some of the faces attached to previous cameras occlude the current faces
-		// then (idx_pcam == current_cam), check for self occlusions. At this stage, we skip faces that were already marked as occluded
-		// project all faces
-		std::set<int> occludedFaces;
-		for (std::map<float, int>::iterator jter=sortedVisibleFaces.begin(); jter!=sortedVisibleFaces.end(); ++jter)
-		//for (unsigned int idx = 0; idx<visibilityIndices.size(); ++idx)
+		else
 		{
-			int idx_face = jter->second;
-			//int idx_face = visibilityIndices[idx];
-			std::map<int, FaceInfo>::iterator iter= visibleFaces[current_cam].find(idx_face);
-			UASSERT(iter != visibleFaces[current_cam].end());
+			faceCentroids.clear();
+		}
+	}
 
-			FaceInfo & info = iter->second;
+	// Cameras are processed in parallel by batches, progress is reported
+	// between batches from this thread. Faces kept by each camera are added
+	// to faceCameras in camera order afterwards, so that the result is the
+	// same than processing the cameras sequentially.
+	int batchSize = 1;
+#ifdef _OPENMP
+	batchSize = std::max(1, omp_get_max_threads()*2);
+#endif
+	std::vector<std::vector<int> > keptFaces(cameras.size());
+	std::vector<int> occludedCount(cameras.size(), 0);
+	std::vector<int> clusterCount(cameras.size(), 0);
+	std::vector<int> visibleCount(cameras.size(), 0);
+	std::vector<int> missingFaces(cameras.size(), 0); // checked outside the parallel region
+	for (int batchStart = 0; batchStart < (int)cameras.size(); batchStart+=batchSize)
+	{
+		int batchEnd = std::min(batchStart+batchSize, (int)cameras.size());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int current_cam = batchStart; current_cam < batchEnd; ++current_cam)
+		{
+			UDEBUG("Texture camera %d...", current_cam);
 
-			// face is in the camera's FOV
-			//get its circumsribed circle
-			double radius;
-			pcl::PointXY center;
-			// getTriangleCircumcenterAndSize (info.uv_coord1, info.uv_coord2, info.uv_coord3, center, radius);
-			getTriangleCircumcscribedCircleCentroid(info.uv_coord1, info.uv_coord2, info.uv_coord3, center, radius); // this function yields faster results than getTriangleCircumcenterAndSize
+			typename pcl::PointCloud<PointInT>::Ptr camera_cloud (new pcl::PointCloud<PointInT>);
+			pcl::transformPointCloud(*mesh_cloud, *camera_cloud, cameras[current_cam].pose.inverse());
 
-			// get points inside circ.circle
-			if (kdtree.radiusSearch (center, radius, idxNeighbors, neighborsSquaredDistance) > 0 )
+			// candidate faces, in increasing index order
+			std::vector<int> candidateFaces;
+			if(useFaceGrid)
 			{
-				// for each neighbor
-				for (size_t i = 0; i < idxNeighbors.size (); ++i)
+				const pcl::texture_mapping::Camera & cam = cameras[current_cam];
+				double cx = cam.center_w > 0?cam.center_w:cam.width/2.0;
+				double cy = cam.center_h > 0?cam.center_h:cam.height/2.0;
+				double fx = cam.focal_length_w > 0?cam.focal_length_w:cam.focal_length;
+				double fy = cam.focal_length_h > 0?cam.focal_length_h:cam.focal_length;
+				double tx = std::max(cx, cam.width-cx)/fx;
+				double ty = std::max(cy, cam.height-cy)/fy;
+				// radius of the sphere containing the frustum up to max distance (with some margin)
+				double radius = max_distance_*std::sqrt(1.0+tx*tx+ty*ty)*1.01 + max_distance_*0.01;
+				Eigen::Vector3f camCenter = cam.pose.translation();
+				if(fx > 0.0 && fy > 0.0 && std::isfinite(radius) && camCenter.allFinite())
 				{
-					int neighborFaceIndex = idxNeighbors[i]/3;
-					//std::map<int, FaceInfo>::iterator jter= visibleFaces[current_cam].find(visibilityIndices[neighborFaceIndex]);
-					//if(jter != visibleFaces[current_cam].end())
+					float radiusSqrd = float(radius*radius);
+					int cellMin[3];
+					int cellMax[3];
+					for(int i=0; i<3; ++i)
 					{
-						if (std::max(camera_cloud->points[faces[idx_face].vertices[0]].z,
-									std::max (camera_cloud->points[faces[idx_face].vertices[1]].z,
-											camera_cloud->points[faces[idx_face].vertices[2]].z))
-							< camera_cloud->points[faces[visibilityIndices[neighborFaceIndex]].vertices[idxNeighbors[i]%3]].z)
-						//if (info.distance < jter->second.distance)
+						// clamp before casting, the camera can be far outside the grid
+						double minCell = std::floor((camCenter[i]-gridMin[i]-radius)/max_distance_);
+						double maxCell = std::floor((camCenter[i]-gridMin[i]+radius)/max_distance_);
+						cellMin[i] = (int)std::min(std::max(minCell, 0.0), double(gridSize[i]));
+						cellMax[i] = (int)std::min(std::max(maxCell, -1.0), double(gridSize[i]-1));
+					}
+					for(int x=cellMin[0]; x<=cellMax[0]; ++x)
+					{
+						for(int y=cellMin[1]; y<=cellMax[1]; ++y)
 						{
-							// neighbor is farther than all the face's points. Check if it falls into the triangle
-							if (checkPointInsideTriangle(info.uv_coord1, info.uv_coord2, info.uv_coord3, projections->at(idxNeighbors[i])))
+							for(int z=cellMin[2]; z<=cellMax[2]; ++z)
 							{
-								// current neighbor is inside triangle and is closer => the corresponding face
-								occludedFaces.insert(visibilityIndices[neighborFaceIndex]);
-								//TODO we could remove the projections of this face from the kd-tree cloud, but I fond it slower, and I need the point to keep ordered to querry UV coordinates later
+								std::map<long long, std::vector<int> >::const_iterator cellIter = faceGrid.find(((long long)x<<42) | ((long long)y<<21) | (long long)z);
+								if(cellIter != faceGrid.end())
+								{
+									for(size_t i=0; i<cellIter->second.size(); ++i)
+									{
+										if((faceCentroids[cellIter->second[i]]-camCenter).squaredNorm() <= radiusSqrd)
+										{
+											candidateFaces.push_back(cellIter->second[i]);
+										}
+									}
+								}
 							}
 						}
 					}
+					std::sort(candidateFaces.begin(), candidateFaces.end());
+				}
+				else
+				{
+					candidateFaces.resize(faces.size());
+					for(unsigned int idx_face=0; idx_face<faces.size(); ++idx_face)
+					{
+						candidateFaces[idx_face] = idx_face;
+					}
+				}
+			}
+			else
+			{
+				candidateFaces.resize(faces.size());
+				for(unsigned int idx_face=0; idx_face<faces.size(); ++idx_face)
+				{
+					candidateFaces[idx_face] = idx_face;
 				}
 			}
-		}
 
-		// remove occluded faces
-		for(std::set<int>::iterator iter= occludedFaces.begin(); iter!=occludedFaces.end(); ++iter)
-		{
-			visibleFaces[current_cam].erase(*iter);
-		}
+			std::vector<int> visibilityIndices;
+			visibilityIndices.resize (candidateFaces.size ());
+			pcl::PointCloud<pcl::PointXY>::Ptr projections (new pcl::PointCloud<pcl::PointXY>);
+			projections->resize(candidateFaces.size()*3);
+			std::map<float, int> sortedVisibleFaces;
+			int oi=0;
+			for(unsigned int c=0; c<candidateFaces.size(); ++c)
+			{
+				int idx_face = candidateFaces[c];
+				pcl::Vertices & face = faces[idx_face];
+
+				int j=oi*3;
+				pcl::PointXY & uv_coords1 = projections->at(j);
+				pcl::PointXY & uv_coords2 = projections->at(j+1);
+				pcl::PointXY & uv_coords3 = projections->at(j+2);
+				PointInT & pt0 = camera_cloud->points[face.vertices[0]];
+				PointInT & pt1 = camera_cloud->points[face.vertices[1]];
+				PointInT & pt2 = camera_cloud->points[face.vertices[2]];
+				if (isFaceProjected (cameras[current_cam],
+						pt0,
+						pt1,
+						pt2,
+						uv_coords1,
+						uv_coords2,
+						uv_coords3))
+				{
+					// check if the polygon is facing the camera, assuming counterclockwise normal
+					Eigen::Vector3f v0(
+							uv_coords2.x - uv_coords1.x,
+							uv_coords2.y - uv_coords1.y,
+							0);
+					Eigen::Vector3f v1(
+							uv_coords3.x - uv_coords1.x,
+							uv_coords3.y - uv_coords1.y,
+							0);
+					Eigen::Vector3f normal = v0.cross(v1);
+					float angle = normal.dot(Eigen::Vector3f(0.0f,0.0f,1.0f));
+					bool facingTheCam = angle>0.0f;
+					float distanceToCam = std::min(std::min(pt0.z, pt1.z), pt2.z);
+					float angleToCam = 0.0f;
+					Eigen::Vector3f e0 = Eigen::Vector3f(
+							pt1.x - pt0.x,
+							pt1.y - pt0.y,
+							pt1.z - pt0.z);
+					Eigen::Vector3f e1 = Eigen::Vector3f(
+							pt2.x - pt0.x,
+							pt2.y - pt0.y,
+							pt2.z - pt0.z);
+					Eigen::Vector3f e2 = Eigen::Vector3f(
+							pt2.x - pt1.x,
+							pt2.y - pt1.y,
+							pt2.z - pt1.z);
+					if(facingTheCam && this->max_angle_)
+					{
+						Eigen::Vector3f normal3D;
+						normal3D = e0.cross(e1);
+						angleToCam = pcl::getAngle3D(Eigen::Vector4f(normal3D[0], normal3D[1], normal3D[2], 0.0f), Eigen::Vector4f(0.0f,0.0f,-1.0f,0.0f));
+					}
 
-		// filter clusters
-		int clusterFaces = 0;
+					// longest edge
+					float e0norm2 = e0[0]*e0[0] + e0[1]*e0[1] + e0[2]*e0[2];
+					float e1norm2 = e1[0]*e1[0] + e1[1]*e1[1] + e1[2]*e1[2];
+					float e2norm2 = e2[0]*e2[0] + e2[1]*e2[1] + e2[2]*e2[2];
+					float longestEdgeSqrd = std::max(std::max(e0norm2, e1norm2), e2norm2);
+
+					pcl::PointXY center;
+					center.x = (uv_coords1.x+uv_coords2.x+uv_coords3.x)/3.0f;
+					center.y = (uv_coords1.y+uv_coords2.y+uv_coords3.y)/3.0f;
+					visibleFaces[current_cam].insert(visibleFaces[current_cam].end(), std::make_pair(idx_face, FaceInfo(distanceToCam, angleToCam, longestEdgeSqrd, facingTheCam, uv_coords1, uv_coords2, uv_coords3, center)));
+					sortedVisibleFaces.insert(std::make_pair(distanceToCam, idx_face));
+					visibilityIndices[oi] = idx_face;
+					++oi;
+				}
+			}
+			visibilityIndices.resize(oi);
+			projections->resize(oi*3);
+
+			//filter occluded polygons
+			//create kdtree
+			pcl::KdTreeFLANN<pcl::PointXY> kdtree;
+			kdtree.setInputCloud (projections);
+
+			std::vector<int> idxNeighbors;
+			std::vector<float> neighborsSquaredDistance;
+			// af first (idx_pcan < current_cam), check if some of the faces attached to previous cameras occlude the current faces
+			// then (idx_pcam == current_cam), check for self occlusions. At this stage, we skip faces that were already marked as occluded
+			// project all faces
+			std::set<int> occludedFaces;
+			for (std::map<float, int>::iterator jter=sortedVisibleFaces.begin(); jter!=sortedVisibleFaces.end(); ++jter)
+			//for (unsigned int idx = 0; idx<visibilityIndices.size(); ++idx)
+			{
+				int idx_face = jter->second;
+				//int idx_face = visibilityIndices[idx];
+				std::map<int, FaceInfo>::iterator iter= visibleFaces[current_cam].find(idx_face);
+				if(iter == visibleFaces[current_cam].end())
+				{
+					++missingFaces[current_cam];
+					continue;
+				}
 
-		std::vector<pcl::Vertices> polygons(visibleFaces[current_cam].size());
-		std::vector<int> polygon_to_face_index(visibleFaces[current_cam].size());
-		oi =0;
-		for(std::map<int, FaceInfo>::iterator iter=visibleFaces[current_cam].begin(); iter!=visibleFaces[current_cam].end(); ++iter)
-		{
-			polygons[oi].vertices.resize(3);
-			polygons[oi].vertices[0] = faces[iter->first].vertices[0];
-			polygons[oi].vertices[1] = faces[iter->first].vertices[1];
-			polygons[oi].vertices[2] = faces[iter->first].vertices[2];
-			polygon_to_face_index[oi] = iter->first;
-			++oi;
-		}
+				FaceInfo & info = iter->second;
 
-		std::vector<std::set<int> > neighbors;
-		std::vector<std::set<int> > vertexToPolygons;
-		rtabmap::util3d::createPolygonIndexes(polygons,
-				(int)camera_cloud->size(),
-				neighbors,
-				vertexToPolygons);
-		std::list<std::list<int> > clusters = rtabmap::util3d::clusterPolygons(
-				neighbors,
-				min_cluster_size_);
-		std::set<int> polygonsKept;
-		for(std::list<std::list<int> >::iterator iter=clusters.begin(); iter!=clusters.end(); ++iter)
-		{
-			for(std::list<int>::iterator jter=iter->begin(); jter!=iter->end(); ++jter)
+				// face is in the camera's FOV
+				//get its circumsribed circle
+				double radius;
+				pcl::PointXY center;
+				// getTriangleCircumcenterAndSize (info.uv_coord1, info.uv_coord2, info.uv_coord3, center, radius);
+				getTriangleCircumcscribedCircleCentroid(info.uv_coord1, info.uv_coord2, info.uv_coord3, center, radius); // this function yields faster results than getTriangleCircumcenterAndSize
+
+				// get points inside circ.circle
+				if (kdtree.radiusSearch (center, radius, idxNeighbors, neighborsSquaredDistance) > 0 )
+				{
+					// for each neighbor
+					for (size_t i = 0; i < idxNeighbors.size (); ++i)
+					{
+						int neighborFaceIndex = idxNeighbors[i]/3;
+						//std::map<int, FaceInfo>::iterator jter= visibleFaces[current_cam].find(visibilityIndices[neighborFaceIndex]);
+						//if(jter != visibleFaces[current_cam].end())
+						{
+							if (std::max(camera_cloud->points[faces[idx_face].vertices[0]].z,
+										std::max (camera_cloud->points[faces[idx_face].vertices[1]].z,
+												camera_cloud->points[faces[idx_face].vertices[2]].z))
+								< camera_cloud->points[faces[visibilityIndices[neighborFaceIndex]].vertices[idxNeighbors[i]%3]].z)
+							//if (info.distance < jter->second.distance)
+							{
+								// neighbor is farther than all the face's points. Check if it falls into the triangle
+								if (checkPointInsideTriangle(info.uv_coord1, info.uv_coord2, info.uv_coord3, projections->at(idxNeighbors[i])))
+								{
+									// current neighbor is inside triangle and is closer => the corresponding face
+									occludedFaces.insert(visibilityIndices[neighborFaceIndex]);
+									//TODO we could remove the projections of this face from the kd-tree cloud, but I fond it slower, and I need the point to keep ordered to querry UV coordinates later
+								}
+							}
+						}
+					}
+				}
+			}
+
+			// remove occluded faces
+			for(std::set<int>::iterator iter= occludedFaces.begin(); iter!=occludedFaces.end(); ++iter)
 			{
-				polygonsKept.insert(polygon_to_face_index[*jter]);
-				faceCameras[polygon_to_face_index[*jter]].push_back(current_cam);
+				visibleFaces[current_cam].erase(*iter);
 			}
-		}
 
-		for(std::map<int, FaceInfo>::iterator iter=visibleFaces[current_cam].begin(); iter!=visibleFaces[current_cam].end();)
-		{
-			if(polygonsKept.find(iter->first) == polygonsKept.end())
+			// filter clusters
+			int clusterFaces = 0;
+
+			std::vector<pcl::Vertices> polygons(visibleFaces[current_cam].size());
+			std::vector<int> polygon_to_face_index(visibleFaces[current_cam].size());
+			oi =0;
+			for(std::map<int, FaceInfo>::iterator iter=visibleFaces[current_cam].begin(); iter!=visibleFaces[current_cam].end(); ++iter)
 			{
-				visibleFaces[current_cam].erase(iter++);
-				++clusterFaces;
+				polygons[oi].vertices.resize(3);
+				polygons[oi].vertices[0] = faces[iter->first].vertices[0];
+				polygons[oi].vertices[1] = faces[iter->first].vertices[1];
+				polygons[oi].vertices[2] = faces[iter->first].vertices[2];
+				polygon_to_face_index[oi] = iter->first;
+				++oi;
 			}
-			else
+
+			std::vector<std::set<int> > neighbors;
+			std::vector<std::set<int> > vertexToPolygons;
+			rtabmap::util3d::createPolygonIndexes(polygons,
+					(int)camera_cloud->size(),
+					neighbors,
+					vertexToPolygons);
+			std::list<std::list<int> > clusters = rtabmap::util3d::clusterPolygons(
+					neighbors,
+					min_cluster_size_);
+			std::set<int> polygonsKept;
+			for(std::list<std::list<int> >::iterator iter=clusters.begin(); iter!=clusters.end(); ++iter)
 			{
-				++iter;
+				for(std::list<int>::iterator jter=iter->begin(); jter!=iter->end(); ++jter)
+				{
+					polygonsKept.insert(polygon_to_face_index[*jter]);
+					keptFaces[current_cam].push_back(polygon_to_face_index[*jter]);
+				}
 			}
+
+			for(std::map<int, FaceInfo>::iterator iter=visibleFaces[current_cam].begin(); iter!=visibleFaces[current_cam].end();)
+			{
+				if(polygonsKept.find(iter->first) == polygonsKept.end())
+				{
+					visibleFaces[current_cam].erase(iter++);
+					++clusterFaces;
+				}
+				else
+				{
+					++iter;
+				}
+			}
+
+			occludedCount[current_cam] = (int)occludedFaces.size();
+			clusterCount[current_cam] = clusterFaces;
+			visibleCount[current_cam] = (int)visibilityIndices.size();
 		}
 
-		std::string msg = uFormat("Processed camera %d/%d: %d occluded and %d spurious polygons out of %d", (int)current_cam+1, (int)cameras.size(), (int)occludedFaces.size(), clusterFaces, (int)visibilityIndices.size());
-		UINFO(msg.c_str());
-		if(state && !state->callback(msg))
+		for (int current_cam = batchStart; current_cam < batchEnd; ++current_cam)
 		{
-			//cancelled!
-			UWARN("Texturing cancelled!");
-			return false;
+			UASSERT_MSG(missingFaces[current_cam] == 0, uFormat("Camera %d: %d visible faces not found", current_cam, missingFaces[current_cam]).c_str());
+			for(size_t i=0; i<keptFaces[current_cam].size(); ++i)
+			{
+				faceCameras[keptFaces[current_cam][i]].push_back(current_cam);
+			}
+			std::vector<int>().swap(keptFaces[current_cam]);
+
+			std::string msg = uFormat("Processed camera %d/%d: %d occluded and %d spurious polygons out of %d", (int)current_cam+1, (int)cameras.size(), occludedCount[current_cam], clusterCount[current_cam], visibleCount[current_cam]);
+			UINFO(msg.c_str());
+			if(state && !state->callback(msg))
+			{
+				//cancelled!
+				UWARN("Texturing cancelled!");
+				return false;
+			}
 		}
 	}
 
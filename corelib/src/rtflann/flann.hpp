@@ -184,6 +184,29 @@ public:
         fclose(fout);
     }
 
+    /**
+     * Load an index saved with save() in this index. The index should
+     * have been created with the same type and with the dataset used
+     * to build the saved index.
+     * @param filename
+     */
+    void load(std::string filename)
+    {
+        FILE* fin = fopen(filename.c_str(), "rb");
+        if (fin == NULL) {
+            throw FLANNException("Cannot open file");
+        }
+        try {
+            nnIndex_->loadIndex(fin);
+        }
+        catch (...) {
+            fclose(fin);
+            throw;
+        }
+        fclose(fin);
+        loaded_ = true;
+    }
+
     /**
      * \returns number of features in this index.
      */
@@ -48,6 +48,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pcl18/surface/texture_mapping.h>
 #include <pcl/features/integral_image_normal.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef RTABMAP_ALICE_VISION
 #include <aliceVision/sfmData/SfMData.hpp>
 #include <aliceVision/sfmDataIO/sfmDataIO.hpp>
@@ -1647,82 +1651,136 @@ cv::Mat mergeTextures(
 				int oi=0;
 				std::vector<cv::Point2i> imageOrigin(textures.size());
 				std::vector<int> newCamIndex(textures.size(), -1);
-				for(int t=0; t<(int)textures.size(); ++t)
+
+				// Textures are assembled by batches: images are fetched sequentially
+				// (memory and database accesses are not thread-safe), then decoded,
+				// resized and copied in their own cell of the atlas in parallel. The
+				// batch size bounds the number of decoded images kept in RAM.
+				int batchSize = 1;
+#ifdef _OPENMP
+				batchSize = std::max(1, omp_get_max_threads()*2);
+#endif
+				for(int batchStart=0; batchStart<(int)textures.size(); batchStart+=batchSize)
 				{
-					if(materialsKept.at(t))
+					int batchEnd = std::min(batchStart+batchSize, (int)textures.size());
+
+					// index in batchImages of the image used by each texture, -1 for previousImage
+					std::vector<int> imageIndex(batchEnd-batchStart, -1);
+					std::vector<cv::Mat> batchImages;
+					std::vector<SensorData> batchData;
+					std::vector<std::vector<CameraModel> > batchModels;
+					for(int t=batchStart; t<batchEnd; ++t)
 					{
-						int indexMaterial = oi / (cols*rows);
-						UASSERT(indexMaterial < materials);
-
-						newCamIndex[t] = oi;
-						int u = oi%cols * emptyImage.cols;
-						int v = ((oi/cols) % rows ) * emptyImage.rows;
-						UASSERT_MSG(u < textureSize-emptyImage.cols, uFormat("u=%d textureSize=%d emptyImage.cols=%d", u, textureSize, emptyImage.cols).c_str());
-						UASSERT_MSG(v < textureSize-emptyImage.rows, uFormat("v=%d textureSize=%d emptyImage.rows=%d", v, textureSize, emptyImage.rows).c_str());
-						imageOrigin[t].x = u;
-						imageOrigin[t].y = v;
-						if(textures[t].first>=0)
+						if(materialsKept.at(t))
 						{
-							cv::Mat image;
-							std::vector<CameraModel> models;
-
-							if(textures[t].first == previousTextureId)
-							{
-								image = previousImage;
-								models = previousCameraModels;
-							}
-							else
+							int indexMaterial = oi / (cols*rows);
+							UASSERT(indexMaterial < materials);
+
+							newCamIndex[t] = oi;
+							int u = oi%cols * emptyImage.cols;
+							int v = ((oi/cols) % rows ) * emptyImage.rows;
+							UASSERT_MSG(u < textureSize-emptyImage.cols, uFormat("u=%d textureSize=%d emptyImage.cols=%d", u, textureSize, emptyImage.cols).c_str());
+							UASSERT_MSG(v < textureSize-emptyImage.rows, uFormat("v=%d textureSize=%d emptyImage.rows=%d", v, textureSize, emptyImage.rows).c_str());
+							imageOrigin[t].x = u;
+							imageOrigin[t].y = v;
+							if(textures[t].first>=0 && textures[t].first != previousTextureId)
 							{
+								cv::Mat image;
+								SensorData data;
+								std::vector<CameraModel> models;
 								if(images.find(textures[t].first) != images.end() &&
 									!images.find(textures[t].first)->second.empty() &&
 									calibrations.find(textures[t].first) != calibrations.end())
 								{
 									image = images.find(textures[t].first)->second;
-									if(image.rows == 1 && image.type() == CV_8UC1)
-									{
-										image = uncompressImage(image);
-									}
 									models = calibrations.find(textures[t].first)->second;
 								}
 								else if(memory)
 								{
-									SensorData data = memory->getNodeData(textures[t].first, true, false, false, false);
+									data = memory->getNodeData(textures[t].first, true, false, false, false);
 									models = data.cameraModels();
-									data.uncompressDataConst(&image, 0);
 								}
 								else if(dbDriver)
 								{
-									SensorData data;
 									dbDriver->getNodeData(textures[t].first, data, true, false, false, false);
-									data.uncompressDataConst(&image, 0);
 									StereoCameraModel stereoModel;
 									dbDriver->getCalibration(textures[t].first, models, stereoModel);
 								}
-
-								previousImage = image;
-								previousCameraModels = models;
+								batchImages.push_back(image);
+								batchData.push_back(data);
+								batchModels.push_back(models);
 								previousTextureId = textures[t].first;
 							}
+							if(textures[t].first>=0)
+							{
+								imageIndex[t-batchStart] = (int)batchImages.size()-1;
+							}
+							++oi;
+						}
+					}
+
+					// decode
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+					for(int i=0; i<(int)batchImages.size(); ++i)
+					{
+						if(!batchImages[i].empty())
+						{
+							if(batchImages[i].rows == 1 && batchImages[i].type() == CV_8UC1)
+							{
+								batchImages[i] = uncompressImage(batchImages[i]);
+							}
+						}
+						else
+						{
+							batchData[i].uncompressDataConst(&batchImages[i], 0);
+						}
+					}
+					batchData.clear();
 
-							UASSERT(!image.empty());
+					// resize and copy in the atlas, each texture has its own cell
+					std::vector<int> invalidImages(batchEnd-batchStart, 0); // checked outside the parallel region
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+					for(int t=batchStart; t<batchEnd; ++t)
+					{
+						if(!materialsKept.at(t))
+						{
+							continue;
+						}
+						int indexMaterial = newCamIndex[t] / (cols*rows);
+						int u = imageOrigin[t].x;
+						int v = imageOrigin[t].y;
+						if(textures[t].first>=0)
+						{
+							int index = imageIndex[t-batchStart];
+							cv::Mat image = index>=0?batchImages[index]:previousImage;
+							const std::vector<CameraModel> & models = index>=0?batchModels[index]:previousCameraModels;
+
+							if(image.empty() ||
+							   (textures[t].second>=0 && textures[t].second >= (int)models.size()) ||
+							   (image.type() != CV_8UC1 && image.type() != CV_8UC3))
+							{
+								invalidImages[t-batchStart] = 1;
+								continue;
+							}
 
 							if(textures[t].second>=0)
 							{
-								UASSERT(textures[t].second < (int)models.size());
 								int width = image.cols/models.size();
 								image = image.colRange(width*textures[t].second, width*(textures[t].second+1));
 							}
 
 							cv::Mat resizedImage;
 							cv::resize(image, resizedImage, emptyImage.size(), 0.0f, 0.0f, cv::INTER_AREA);
-							UASSERT(resizedImage.type() == CV_8UC1 || resizedImage.type() == CV_8UC3);
 							if(resizedImage.type() == CV_8UC1)
 							{
 								cv::Mat resizedImageColor;
 								cv::cvtColor(resizedImage, resizedImageColor, CV_GRAY2BGR);
 								resizedImage = resizedImageColor;
 							}
-							UASSERT(resizedImage.type() == globalTextures.type());
 							resizedImage.copyTo(globalTextures(cv::Rect(u+indexMaterial*globalTextures.rows, v, resizedImage.cols, resizedImage.rows)));
 							emptyImageMask.copyTo(globalTextureMasks(cv::Rect(u+indexMaterial*globalTextureMasks.rows, v, resizedImage.cols, resizedImage.rows)));
 						}
@@ -1730,16 +1788,30 @@ cv::Mat mergeTextures(
 						{
 							emptyImage.copyTo(globalTextures(cv::Rect(u+indexMaterial*globalTextures.rows, v, emptyImage.cols, emptyImage.rows)));
 						}
-						++oi;
+					}
+
+					for(int t=batchStart; t<batchEnd; ++t)
+					{
+						UASSERT_MSG(invalidImages[t-batchStart] == 0, uFormat("Texture %d (camera %d, sub camera %d): image is empty, not 8 bits or sub camera index is invalid.",
+								t, textures[t].first, textures[t].second).c_str());
+					}
+
+					if(!batchImages.empty())
+					{
+						previousImage = batchImages.back();
+						previousCameraModels = batchModels.back();
 					}
 
 					if(state)
 					{
-						if(state->isCanceled())
+						for(int t=batchStart; t<batchEnd; ++t)
 						{
-							return cv::Mat();
+							if(state->isCanceled())
+							{
+								return cv::Mat();
+							}
+							state->callback(uFormat("Assembled texture %d/%d.", t+1, (int)textures.size()));
 						}
-						state->callback(uFormat("Assembled texture %d/%d.", t+1, (int)textures.size()));
 					}
 				}
 
@@ -1880,16 +1952,17 @@ cv::Mat mergeTextures(
 						gainsG.copyTo(gains.col(2));
 						gainsB.copyTo(gains.col(3));
 
+						// each texture has its own cell in the atlas
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
 						for(int t=0; t<(int)textures.size(); ++t)
 						{
-							//break;
 							if(materialsKept.at(t))
 							{
 								int u = imageOrigin[t].x;
 								int v = imageOrigin[t].y;
 
-								UDEBUG("Gain cam%d = %f", newCamIndex[t], gainsGray(newCamIndex[t], 0));
-
 								int indexMaterial = newCamIndex[t] / (cols*rows);
 								cv::Mat roi = globalTextures(cv::Rect(u+indexMaterial*globalTextures.rows, v, emptyImage.cols, emptyImage.rows));
 
@@ -1902,6 +1975,15 @@ cv::Mat mergeTextures(
 								cv::multiply(channels[2], gains(newCamIndex[t], gainRGB?1:0), channels[2]);
 
 								cv::merge(channels, roi);
+							}
+						}
+
+						for(int t=0; t<(int)textures.size(); ++t)
+						{
+							//break;
+							if(materialsKept.at(t))
+							{
+								UDEBUG("Gain cam%d = %f", newCamIndex[t], gainsGray(newCamIndex[t], 0));
 
 								if(gainsOut)
 								{
@@ -2081,6 +2163,10 @@ cv::Mat mergeTextures(
 							}
 						}
 
+						// materials are independent
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
 						for(int i=0; i<materials; ++i)
 						{
 							/*std::vector<cv::Mat> channels;
@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/utilite/UEventsHandler.h"
 #include <QMainWindow>
 #include <QtCore/QSet>
+#include <QtCore/QMutex>
 #include "rtabmap/core/RtabmapEvent.h"
 #include "rtabmap/core/SensorData.h"
 #include "rtabmap/core/OdometryEvent.h"
@@ -57,6 +58,7 @@ class OccupancyGrid;
 class QGraphicsScene;
 class Ui_mainWindow;
 class QActionGroup;
+class QThreadPool;
 
 namespace rtabmap {
 
@@ -73,6 +75,7 @@ class PostProcessingDialog;
 class DepthCalibrationDialog;
 class DataRecorder;
 class OctoMap;
+class CloudGenerationTask;
 
 class RTABMAPGUI_EXP MainWindow : public QMainWindow, public UEventsHandler
 {
@@ -225,6 +228,7 @@ protected Q_SLOTS:
 	void dataRecorderDestroyed();
 	void updateNodeVisibility(int, bool);
 	void updateGraphView();
+	void processGeneratedClouds();
 
 Q_SIGNALS:
 	void statsReceived(const rtabmap::Statistics &);
@@ -260,8 +264,15 @@ private:
 			bool verboseProgress = false,
 			std::map<std::string, float> * stats = 0);
 	std::pair<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, pcl::IndicesPtr> createAndAddCloudToMap(int nodeId,	const Transform & pose, int mapId);
+	bool createCloudInBackground(int nodeId, const Transform & pose, int mapId, const ParametersMap & parameters);
+	bool addLodCloudToMap(int nodeId, const Transform & pose, int mapId, const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud, const pcl::IndicesPtr & indices, const pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr & cloudWithNormals, int lod);
+	int getCloudLod(const Transform & pose) const;
 	void createAndAddScanToMap(int nodeId, const Transform & pose, int mapId);
+	bool createScanInBackground(int nodeId, const Transform & pose, int mapId);
+	bool addScanToMap(int nodeId, const Transform & pose, int mapId, const LaserScan & scan);
 	void createAndAddFeaturesToMap(int nodeId, const Transform & pose, int mapId);
+	bool createFeaturesInBackground(int nodeId, const Transform & pose, int mapId);
+	bool addFeaturesToMap(int nodeId, const Transform & pose, int mapId, const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud);
 	Transform alignPosesToGroundTruth(const std::map<int, Transform> & poses, const std::map<int, Transform> & groundTruth);
 	void drawKeypoints(const std::multimap<int, cv::KeyPoint> & refWords, const std::multimap<int, cv::KeyPoint> & loopWords);
 	void drawLandmarks(cv::Mat & image, const Signature & signature);
@@ -347,10 +358,35 @@ private:
 	std::map<int, int> _currentMapIds;   // <nodeId, mapId>
 	std::map<int, std::string> _currentLabels; // <nodeId, label>
 	std::map<int, std::pair<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, pcl::IndicesPtr> > _cachedClouds;
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr> _cachedCloudsWithNormals; // dense, one point per index of _cachedClouds
 	long _createdCloudsMemoryUsage;
 	std::set<int> _cachedEmptyClouds;
 	std::pair<int, std::pair<std::pair<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr>, pcl::IndicesPtr> > _previousCloud; // used for subtraction
 	std::map<int, float> _cachedWordsCount;
+
+	// Clouds created in background
+	friend class CloudGenerationTask;
+	struct GeneratedCloud
+	{
+		enum Type {kCloud, kScan, kFeatures};
+		Type type;
+		int generation;
+		int nodeId;
+		int mapId;
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud; // organized, filtered points are NaN
+		pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudWithNormals;
+		pcl::IndicesPtr indices;
+		LaserScan scan; // filtered, in scan frame
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr featuresCloud;
+	};
+	QThreadPool * _cloudGenerationPool;
+	QMutex _generatedCloudsMutex;
+	std::list<GeneratedCloud> _generatedClouds;
+	std::set<int> _pendingClouds;
+	std::set<int> _pendingScans;
+	std::set<int> _pendingFeatures;
+	int _cloudGeneration;
+	std::map<int, int> _cloudLods; // <nodeId, level of detail>
 	std::map<int, float> _cachedLocalizationsCount;
 
 	std::map<int, LaserScan> _createdScans;
@@ -279,6 +279,8 @@ public:
 	//
 	bool isImagesKept() const;
 	bool isCloudsKept() const;
+	bool isCloudsBackgroundGenerated() const;
+	double getCloudLodDistance() const;
 	float getTimeLimit() const;
 	float getDetectionRate() const;
 	bool isSLAMMode() const;
@@ -43,6 +43,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/util2d.h"
 #include "rtabmap/core/Graph.h"
 #include "rtabmap/core/GainCompensator.h"
+#include "rtabmap/core/CloudTileAssembler.h"
 #include "rtabmap/core/clams/discrete_depth_distortion_model.h"
 #include "rtabmap/core/DBDriver.h"
 #include "rtabmap/core/Version.h"
@@ -133,6 +134,7 @@ ExportCloudsDialog::ExportCloudsDialog(QWidget *parent) :
 	connect(_ui->checkBox_assemble, SIGNAL(clicked(bool)), this, SIGNAL(configChanged()));
 	connect(_ui->checkBox_assemble, SIGNAL(clicked(bool)), this, SLOT(updateReconstructionFlavor()));
 	connect(_ui->doubleSpinBox_voxelSize_assembled, SIGNAL(valueChanged(double)), this, SIGNAL(configChanged()));
+	connect(_ui->spinBox_streamingBudget, SIGNAL(valueChanged(int)), this, SIGNAL(configChanged()));
 	connect(_ui->comboBox_frame, SIGNAL(currentIndexChanged(int)), this, SIGNAL(configChanged()));
 	connect(_ui->comboBox_frame, SIGNAL(currentIndexChanged(int)), this, SLOT(updateReconstructionFlavor()));
 
@@ -326,6 +328,7 @@ void ExportCloudsDialog::saveSettings(QSettings & settings, const QString & grou
 
 	settings.setValue("assemble", _ui->checkBox_assemble->isChecked());
 	settings.setValue("assemble_voxel",_ui->doubleSpinBox_voxelSize_assembled->value());
+	settings.setValue("assemble_streaming_budget",_ui->spinBox_streamingBudget->value());
 	settings.setValue("frame",_ui->comboBox_frame->currentIndex());
 
 	settings.setValue("subtract",_ui->checkBox_subtraction->isChecked());
@@ -465,6 +468,7 @@ void ExportCloudsDialog::loadSettings(QSettings & settings, const QString & grou
 		_ui->checkBox_assemble->setChecked(settings.value("assemble", _ui->checkBox_assemble->isChecked()).toBool());
 	}
 	_ui->doubleSpinBox_voxelSize_assembled->setValue(settings.value("assemble_voxel", _ui->doubleSpinBox_voxelSize_assembled->value()).toDouble());
+	_ui->spinBox_streamingBudget->setValue(settings.value("assemble_streaming_budget", _ui->spinBox_streamingBudget->value()).toInt());
 	_ui->comboBox_frame->setCurrentIndex(settings.value("frame", _ui->comboBox_frame->currentIndex()).toInt());
 
 	_ui->checkBox_subtraction->setChecked(settings.value("subtract",_ui->checkBox_subtraction->isChecked()).toBool());
@@ -601,6 +605,7 @@ void ExportCloudsDialog::restoreDefaults()
 
 	_ui->checkBox_assemble->setChecked(true);
 	_ui->doubleSpinBox_voxelSize_assembled->setValue(0.01);
+	_ui->spinBox_streamingBudget->setValue(0);
 	_ui->comboBox_frame->setCurrentIndex(0);
 
 	_ui->checkBox_subtraction->setChecked(false);
@@ -759,6 +764,10 @@ void ExportCloudsDialog::updateReconstructionFlavor()
 	_ui->label_smoothing->setVisible(_ui->comboBox_pipeline->currentIndex() == 1);
 
 	_ui->comboBox_frame->setEnabled(!_ui->checkBox_assemble->isChecked() && _ui->checkBox_binary->isEnabled());
+	// out-of-core assembly only when exporting a cloud
+	_ui->spinBox_streamingBudget->setEnabled(_ui->checkBox_assemble->isChecked() && !_ui->checkBox_meshing->isChecked() && _ui->checkBox_binary->isEnabled());
+	_ui->spinBox_streamingBudget->setVisible(_ui->checkBox_binary->isEnabled());
+	_ui->label_streamingBudget->setVisible(_ui->checkBox_binary->isEnabled());
 	_ui->comboBox_frame->setVisible(_ui->comboBox_frame->isEnabled());
 	_ui->label_frame->setVisible(_ui->comboBox_frame->isEnabled());
 	_ui->checkBox_gainCompensation->setEnabled(!(_ui->comboBox_frame->isEnabled() && _ui->comboBox_frame->currentIndex() == 2));
@@ -937,7 +946,7 @@ void ExportCloudsDialog::exportClouds(
 				saveMeshes(workingDirectory, poses, meshes, _ui->checkBox_binary->isChecked());
 			}
 		}
-		else
+		else if(clouds.size()) // empty when the cloud has been streamed to file
 		{
 			saveClouds(workingDirectory, poses, clouds, _ui->checkBox_binary->isChecked());
 		}
@@ -1424,6 +1433,16 @@ bool ExportCloudsDialog::getExportedClouds(
 		}
 		_progressDialog->setMaximumSteps(int(poses.size())*mul+1);
 
+		if(_ui->spinBox_streamingBudget->isEnabled() && _ui->spinBox_streamingBudget->value() > 0)
+		{
+			return exportCloudsStreaming(
+					poses,
+					cachedSignatures,
+					cachedClouds,
+					cachedScans,
+					parameters);
+		}
+
 		bool loadClouds = true;
 #ifdef RTABMAP_OPENCHISEL
 		if(_ui->comboBox_meshingApproach->currentIndex()==4 && _ui->checkBox_assemble->isChecked())
@@ -3363,6 +3382,104 @@ std::map<int, std::pair<pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr, pcl::Indic
 }
 
 
+bool ExportCloudsDialog::exportCloudsStreaming(
+		const std::map<int, Transform> & poses,
+		const QMap<int, Signature> & cachedSignatures,
+		const std::map<int, std::pair<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, pcl::IndicesPtr> > & cachedClouds,
+		const std::map<int, LaserScan> & cachedScans,
+		const ParametersMap & parameters)
+{
+	QString path = QFileDialog::getSaveFileName(this, tr("Save cloud to ..."), _workingDirectory+QDir::separator()+"cloud.ply", tr("Point cloud data (*.ply)"));
+	if(path.isEmpty())
+	{
+		return false;
+	}
+	if(QFileInfo(path).suffix() == "")
+	{
+		path += ".ply";
+	}
+	else if(QFileInfo(path).suffix() != "ply")
+	{
+		QMessageBox::warning(this, tr("Exporting cloud..."), tr("Only PLY format is supported with out-of-core assembly."));
+		return false;
+	}
+
+	_progressDialog->appendText(tr("Out-of-core assembly of %1 clouds (memory budget = %2 MB)...").arg(poses.size()).arg(_ui->spinBox_streamingBudget->value()));
+	QApplication::processEvents();
+
+	// spilled tiles are written beside the output file
+	CloudTileAssembler assembler(
+			_ui->doubleSpinBox_voxelSize_assembled->value(),
+			10.0f,
+			_ui->spinBox_streamingBudget->value(),
+			QFileInfo(path).absolutePath().toStdString());
+
+	// Clouds are created by small batches, so that only the voxels of the assembler are kept in RAM
+	const int batchSize = 20;
+	int processed = 0;
+	bool has2dScans = false;
+	std::map<int, Transform> batch;
+	for(std::map<int, Transform>::const_iterator iter=poses.lower_bound(1); iter!=poses.end(); ++iter)
+	{
+		batch.insert(*iter);
+		std::map<int, Transform>::const_iterator next = iter;
+		++next;
+		if((int)batch.size() < batchSize && next!=poses.end())
+		{
+			continue;
+		}
+
+		std::map<int, std::pair<pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr, pcl::IndicesPtr> > clouds = this->getClouds(
+				batch,
+				cachedSignatures,
+				cachedClouds,
+				cachedScans,
+				parameters,
+				has2dScans);
+		if(_canceled)
+		{
+			return false;
+		}
+		for(std::map<int, std::pair<pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr, pcl::IndicesPtr> >::iterator jter=clouds.begin(); jter!=clouds.end(); ++jter)
+		{
+			pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr transformed(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+			pcl::copyPointCloud(*jter->second.first, *jter->second.second, *transformed);
+			transformed = util3d::transformPointCloud(transformed, poses.at(jter->first));
+			assembler.addCloud(*transformed);
+		}
+		if(assembler.spillFailed())
+		{
+			_progressDialog->appendText(tr("Failed spilling tiles to %1!").arg(QFileInfo(path).absolutePath()), Qt::darkRed);
+			_progressDialog->setAutoClose(false);
+			return false;
+		}
+		processed += (int)batch.size();
+		batch.clear();
+
+		_progressDialog->appendText(tr("Assembled %1/%2 clouds (%3 tiles, %4 spilled, %5 MB in RAM).")
+				.arg(processed).arg(poses.size()).arg(assembler.tiles()).arg(assembler.spilledTiles()).arg(assembler.memoryUsed()/(1024*1024)));
+		QApplication::processEvents();
+		if(_canceled)
+		{
+			return false;
+		}
+	}
+
+	_progressDialog->appendText(tr("Saving the cloud to %1 (%2 tiles)...").arg(path).arg(assembler.tiles()));
+	QApplication::processEvents();
+	long points = assembler.writePLY(
+			path.toStdString(),
+			_ui->spinBox_normalKSearch->value()>0 || _ui->doubleSpinBox_normalRadiusSearch->value()>0.0);
+	if(points < 0)
+	{
+		_progressDialog->appendText(tr("Failed saving the cloud to %1!").arg(path), Qt::darkRed);
+		_progressDialog->setAutoClose(false);
+		return false;
+	}
+	_progressDialog->appendText(tr("Saving the cloud to %1 (%2 points)... done.").arg(path).arg(points));
+	return true;
+}
+
 void ExportCloudsDialog::saveClouds(
 		const QString & workingDirectory,
 		const std::map<int, Transform> & poses,
@@ -82,6 +82,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QDockWidget>
 #include <QtCore/QBuffer>
 #include <QtCore/QTimer>
+#include <QtCore/QThreadPool>
+#include <QtCore/QRunnable>
 #include <QtCore/QTime>
 #include <QActionGroup>
 #include <QtGui/QDesktopServices>
@@ -134,6 +136,526 @@ inline static void initGuiResource() { Q_INIT_RESOURCE(GuiLib); }
 
 namespace rtabmap {
 
+// Voxel, floor/ceiling and radius filtering of the clouds shown in the 3D Map
+static pcl::PointCloud<pcl::PointXYZRGB>::Ptr filterMapCloud(
+		const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloudIn,
+		pcl::IndicesPtr & indices,
+		const Transform & pose,
+		double voxel,
+		double floorHeight,
+		double ceilingHeight,
+		double noiseRadius,
+		int noiseMinNeighbors)
+{
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = cloudIn;
+	if(indices->size() && voxel > 0.0)
+	{
+		cloud = util3d::voxelize(cloud, indices, voxel);
+		//generate indices for all points (they are all valid)
+		indices->resize(cloud->size());
+		for(unsigned int i=0; i<cloud->size(); ++i)
+		{
+			indices->at(i) = i;
+		}
+	}
+
+	// Do ceiling/floor filtering
+	if(indices->size() &&
+	   (floorHeight != 0.0 ||
+	    ceilingHeight != 0.0))
+	{
+		// perform in /map frame
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudTransformed = util3d::transformPointCloud(cloud, pose);
+		indices = rtabmap::util3d::passThrough(
+				cloudTransformed,
+				indices,
+				"z",
+				floorHeight==0.0?(float)std::numeric_limits<int>::min():floorHeight,
+				ceilingHeight==0.0?(float)std::numeric_limits<int>::max():ceilingHeight);
+	}
+
+	// Do radius filtering after voxel filtering ( a lot faster)
+	if(indices->size() &&
+	   noiseRadius > 0.0 &&
+	   noiseMinNeighbors > 0)
+	{
+		indices = rtabmap::util3d::radiusFiltering(
+				cloud,
+				indices,
+				noiseRadius,
+				noiseMinNeighbors);
+	}
+	return cloud;
+}
+
+// Range, voxel, floor/ceiling filtering and normals of the scans shown in the 3D Map.
+// The returned scan is in scan frame (see MainWindow::addScanToMap()).
+static LaserScan filterMapScan(
+		const SensorData & data,
+		const Transform & pose,
+		int downsamplingStep,
+		double minRange,
+		double maxRange,
+		double voxel,
+		double floorHeight,
+		double ceilingHeight,
+		int normalK,
+		double normalRadius)
+{
+	LaserScan scan;
+	data.uncompressDataConst(0, 0, &scan);
+	if(scan.isEmpty())
+	{
+		return scan;
+	}
+
+	if(downsamplingStep > 1 ||
+		maxRange > 0.0f ||
+		minRange > 0.0f)
+	{
+		scan = util3d::commonFiltering(scan,
+				downsamplingStep,
+				minRange,
+				maxRange);
+	}
+
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudRGB;
+	pcl::PointCloud<pcl::PointXYZI>::Ptr cloudI;
+	pcl::PointCloud<pcl::PointNormal>::Ptr cloudWithNormals;
+	pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudRGBWithNormals;
+	pcl::PointCloud<pcl::PointXYZINormal>::Ptr cloudIWithNormals;
+	if(scan.hasNormals() && scan.hasRGB() && voxel <= 0.0)
+	{
+		cloudRGBWithNormals = util3d::laserScanToPointCloudRGBNormal(scan, scan.localTransform());
+	}
+	else if(scan.hasNormals() && scan.hasIntensity() && voxel <= 0.0)
+	{
+		cloudIWithNormals = util3d::laserScanToPointCloudINormal(scan, scan.localTransform());
+	}
+	else if((scan.hasNormals()) && voxel <= 0.0)
+	{
+		cloudWithNormals = util3d::laserScanToPointCloudNormal(scan, scan.localTransform());
+	}
+	else if(scan.hasRGB())
+	{
+		cloudRGB = util3d::laserScanToPointCloudRGB(scan, scan.localTransform());
+	}
+	else if(scan.hasIntensity())
+	{
+		cloudI = util3d::laserScanToPointCloudI(scan, scan.localTransform());
+	}
+	else
+	{
+		cloud = util3d::laserScanToPointCloud(scan, scan.localTransform());
+	}
+
+	if(voxel > 0.0)
+	{
+		if(cloud.get())
+		{
+			cloud = util3d::voxelize(cloud, voxel);
+		}
+		if(cloudRGB.get())
+		{
+			cloudRGB = util3d::voxelize(cloudRGB, voxel);
+		}
+		if(cloudI.get())
+		{
+			cloudI = util3d::voxelize(cloudI, voxel);
+		}
+	}
+
+	// Do ceiling/floor filtering
+	if((!scan.is2d()) && // don't filter 2D scans
+	   (floorHeight != 0.0 ||
+	   ceilingHeight != 0.0))
+	{
+		if(cloudRGBWithNormals.get())
+		{
+			// perform in /map frame
+			pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudTransformed = util3d::transformPointCloud(cloudRGBWithNormals, pose);
+			cloudTransformed = rtabmap::util3d::passThrough(
+					cloudTransformed,
+					"z",
+					floorHeight==0.0?(float)std::numeric_limits<int>::min():floorHeight,
+					ceilingHeight==0.0?(float)std::numeric_limits<int>::max():ceilingHeight);
+
+			//transform back in sensor frame
+			cloudRGBWithNormals = util3d::transformPointCloud(cloudTransformed, pose.inverse());
+		}
+		if(cloudIWithNormals.get())
+		{
+			// perform in /map frame
+			pcl::PointCloud<pcl::PointXYZINormal>::Ptr cloudTransformed = util3d::transformPointCloud(cloudIWithNormals, pose);
+			cloudTransformed = rtabmap::util3d::passThrough(
+					cloudTransformed,
+					"z",
+					floorHeight==0.0?(float)std::numeric_limits<int>::min():floorHeight,
+					ceilingHeight==0.0?(float)std::numeric_limits<int>::max():ceilingHeight);
+
+			//transform back in sensor frame
+			cloudIWithNormals = util3d::transformPointCloud(cloudTransformed, pose.inverse());
+		}
+		if(cloudWithNormals.get())
+		{
+			// perform in /map frame
+			pcl::PointCloud<pcl::PointNormal>::Ptr cloudTransformed = util3d::transformPointCloud(cloudWithNormals, pose);
+			cloudTransformed = rtabmap::util3d::passThrough(
+					cloudTransformed,
+					"z",
+					floorHeight==0.0?(float)std::numeric_limits<int>::min():floorHeight,
+					ceilingHeight==0.0?(float)std::numeric_limits<int>::max():ceilingHeight);
+
+			//transform back in sensor frame
+			cloudWithNormals = util3d::transformPointCloud(cloudTransformed, pose.inverse());
+		}
+		if(cloudRGB.get())
+		{
+			// perform in /map frame
+			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudTransformed = util3d::transformPointCloud(cloudRGB, pose);
+			cloudTransformed = rtabmap::util3d::passThrough(
+					cloudTransformed,
+					"z",
+					floorHeight==0.0?(float)std::numeric_limits<int>::min():floorHeight,
+					ceilingHeight==0.0?(float)std::numeric_limits<int>::max():ceilingHeight);
+
+			//transform back in sensor frame
+			cloudRGB = util3d::transformPointCloud(cloudTransformed, pose.inverse());
+		}
+		if(cloudI.get())
+		{
+			// perform in /map frame
+			pcl::PointCloud<pcl::PointXYZI>::Ptr cloudTransformed = util3d::transformPointCloud(cloudI, pose);
+			cloudTransformed = rtabmap::util3d::passThrough(
+					cloudTransformed,
+					"z",
+					floorHeight==0.0?(float)std::numeric_limits<int>::min():floorHeight,
+					ceilingHeight==0.0?(float)std::numeric_limits<int>::max():ceilingHeight);
+
+			//transform back in sensor frame
+			cloudI = util3d::transformPointCloud(cloudTransformed, pose.inverse());
+		}
+		if(cloud.get())
+		{
+			// perform in /map frame
+			pcl::PointCloud<pcl::PointXYZ>::Ptr cloudTransformed = util3d::transformPointCloud(cloud, pose);
+			cloudTransformed = rtabmap::util3d::passThrough(
+					cloudTransformed,
+					"z",
+					floorHeight==0.0?(float)std::numeric_limits<int>::min():floorHeight,
+					ceilingHeight==0.0?(float)std::numeric_limits<int>::max():ceilingHeight);
+
+			//transform back in sensor frame
+			cloud = util3d::transformPointCloud(cloudTransformed, pose.inverse());
+		}
+	}
+
+	if(	(cloud.get() || cloudRGB.get() || cloudI.get()) &&
+	   (normalK > 0 || normalRadius > 0.0))
+	{
+		Eigen::Vector3f scanViewpoint(
+				scan.localTransform().x(),
+				scan.localTransform().y(),
+				scan.localTransform().z());
+
+		pcl::PointCloud<pcl::Normal>::Ptr normals;
+		if(cloud.get() && cloud->size())
+		{
+			if(scan.is2d())
+			{
+				normals = util3d::computeFastOrganizedNormals2D(cloud, normalK, normalRadius, scanViewpoint);
+			}
+			else
+			{
+				normals = util3d::computeNormals(cloud, normalK, normalRadius, scanViewpoint);
+			}
+			cloudWithNormals.reset(new pcl::PointCloud<pcl::PointNormal>);
+			pcl::concatenateFields(*cloud, *normals, *cloudWithNormals);
+			cloud.reset();
+		}
+		else if(cloudRGB.get() && cloudRGB->size())
+		{
+			// Assuming 3D
+			normals = util3d::computeNormals(cloudRGB, normalK, normalRadius, scanViewpoint);
+			cloudRGBWithNormals.reset(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+			pcl::concatenateFields(*cloudRGB, *normals, *cloudRGBWithNormals);
+			cloudRGB.reset();
+		}
+		else if(cloudI.get())
+		{
+			if(scan.is2d())
+			{
+				normals = util3d::computeFastOrganizedNormals2D(cloudI, normalK, normalRadius, scanViewpoint);
+			}
+			else
+			{
+				normals = util3d::computeNormals(cloudI, normalK, normalRadius, scanViewpoint);
+			}
+			cloudIWithNormals.reset(new pcl::PointCloud<pcl::PointXYZINormal>);
+			pcl::concatenateFields(*cloudI, *normals, *cloudIWithNormals);
+			cloudI.reset();
+		}
+	}
+
+	// Convert back the filtered cloud in scan frame
+	if(cloudRGBWithNormals.get())
+	{
+		return LaserScan(util3d::laserScanFromPointCloud(*cloudRGBWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZRGBNormal, scan.localTransform());
+	}
+	else if(cloudIWithNormals.get())
+	{
+		if(scan.is2d())
+		{
+			return LaserScan(util3d::laserScan2dFromPointCloud(*cloudIWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYINormal, scan.localTransform());
+		}
+		return LaserScan(util3d::laserScanFromPointCloud(*cloudIWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZINormal, scan.localTransform());
+	}
+	else if(cloudWithNormals.get())
+	{
+		if(scan.is2d())
+		{
+			return LaserScan(util3d::laserScan2dFromPointCloud(*cloudWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYNormal, scan.localTransform());
+		}
+		return LaserScan(util3d::laserScanFromPointCloud(*cloudWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZNormal, scan.localTransform());
+	}
+	else if(cloudRGB.get())
+	{
+		return LaserScan(util3d::laserScanFromPointCloud(*cloudRGB, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZRGB, scan.localTransform());
+	}
+	else if(cloudI.get())
+	{
+		if(scan.is2d())
+		{
+			return LaserScan(util3d::laserScan2dFromPointCloud(*cloudI, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYI, scan.localTransform());
+		}
+		return LaserScan(util3d::laserScanFromPointCloud(*cloudI, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZI, scan.localTransform());
+	}
+	UASSERT(cloud.get());
+	if(scan.is2d())
+	{
+		return LaserScan(util3d::laserScan2dFromPointCloud(*cloud, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXY, scan.localTransform());
+	}
+	return LaserScan(util3d::laserScanFromPointCloud(*cloud, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZ, scan.localTransform());
+}
+
+// Cloud of the 3D words of a node shown in the 3D Map, colored with the node's image
+static pcl::PointCloud<pcl::PointXYZRGB>::Ptr createFeaturesCloud(const Signature & node, float maxDepth)
+{
+	cv::Mat rgb;
+	if(!node.sensorData().imageCompressed().empty() || !node.sensorData().imageRaw().empty())
+	{
+		node.sensorData().uncompressDataConst(&rgb, 0);
+	}
+
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+	cloud->resize(node.getWords3().size());
+	int oi=0;
+	UASSERT(node.getWords().size() == node.getWords3().size());
+	if(!node.getWords3().empty() && !node.getWordsKpts().empty())
+	{
+		Transform invLocalTransform = Transform::getIdentity();
+		if(node.sensorData().cameraModels().size() == 1 && node.sensorData().cameraModels().at(0).isValidForProjection())
+		{
+			invLocalTransform = node.sensorData().cameraModels()[0].localTransform().inverse();
+		}
+		else if(node.sensorData().stereoCameraModel().isValidForProjection())
+		{
+			invLocalTransform = node.sensorData().stereoCameraModel().left().localTransform().inverse();
+		}
+
+		for(std::multimap<int, int>::const_iterator jter=node.getWords().begin(); jter!=node.getWords().end(); ++jter)
+		{
+			const cv::Point3f & pt = node.getWords3()[jter->second];
+			if(util3d::isFinite(pt) &&
+				(maxDepth == 0.0f ||
+						//move back point in camera frame (to get depth along z), ignore for multi-camera
+						(node.sensorData().cameraModels().size()<=1 &&
+						 util3d::transformPoint(pt, invLocalTransform).z < maxDepth)))
+			{
+				(*cloud)[oi].x = pt.x;
+				(*cloud)[oi].y = pt.y;
+				(*cloud)[oi].z = pt.z;
+				const cv::KeyPoint & kpt = node.getWordsKpts()[jter->second];
+				int u = kpt.pt.x+0.5;
+				int v = kpt.pt.y+0.5;
+				if(!rgb.empty() &&
+					uIsInBounds(u, 0, rgb.cols-1) &&
+					uIsInBounds(v, 0, rgb.rows-1))
+				{
+					if(rgb.channels() == 1)
+					{
+						(*cloud)[oi].r = (*cloud)[oi].g = (*cloud)[oi].b = rgb.at<unsigned char>(v, u);
+					}
+					else
+					{
+						cv::Vec3b bgr = rgb.at<cv::Vec3b>(v, u);
+						(*cloud)[oi].b = bgr.val[0];
+						(*cloud)[oi].g = bgr.val[1];
+						(*cloud)[oi].r = bgr.val[2];
+					}
+				}
+				else
+				{
+					(*cloud)[oi].r = (*cloud)[oi].g = (*cloud)[oi].b = 255;
+				}
+				++oi;
+			}
+		}
+	}
+	cloud->resize(oi);
+	return cloud;
+}
+
+/**
+ * Creates the cloud, the scan or the features cloud of a node for the 3D Map outside
+ * the GUI thread. The result is queued in MainWindow and added to the viewer by
+ * MainWindow::processGeneratedClouds().
+ */
+class CloudGenerationTask : public QRunnable
+{
+public:
+	CloudGenerationTask(MainWindow * window, MainWindow::GeneratedCloud::Type type, int generation, int nodeId, int mapId, const Signature & node, const Transform & pose, const ParametersMap & parameters) :
+		window_(window),
+		type_(type),
+		generation_(generation),
+		nodeId_(nodeId),
+		mapId_(mapId),
+		data_(node.sensorData()),
+		pose_(pose),
+		decimation_(window->_preferencesDialog->getCloudDecimation(0)),
+		maxDepth_(window->_preferencesDialog->getCloudMaxDepth(0)),
+		minDepth_(window->_preferencesDialog->getCloudMinDepth(0)),
+		roiRatios_(window->_preferencesDialog->getCloudRoiRatios(0)),
+		parameters_(parameters),
+		voxel_(window->_preferencesDialog->getVoxel()),
+		floorHeight_(window->_preferencesDialog->getFloorFilteringHeight()),
+		ceilingHeight_(window->_preferencesDialog->getCeilingFilteringHeight()),
+		noiseRadius_(window->_preferencesDialog->getNoiseRadius()),
+		noiseMinNeighbors_(window->_preferencesDialog->getNoiseMinNeighbors()),
+		normalK_(window->_preferencesDialog->getNormalKSearch()),
+		normalRadius_(window->_preferencesDialog->getNormalRadiusSearch()),
+		scanDownsamplingStep_(window->_preferencesDialog->getDownsamplingStepScan(0)),
+		scanMinRange_(window->_preferencesDialog->getScanMinRange(0)),
+		scanMaxRange_(window->_preferencesDialog->getScanMaxRange(0)),
+		scanVoxel_(window->_preferencesDialog->getCloudVoxelSizeScan(0)),
+		scanFloorHeight_(window->_preferencesDialog->getScanFloorFilteringHeight()),
+		scanCeilingHeight_(window->_preferencesDialog->getScanCeilingFilteringHeight()),
+		scanNormalK_(window->_preferencesDialog->getScanNormalKSearch()),
+		scanNormalRadius_(window->_preferencesDialog->getScanNormalRadiusSearch())
+	{
+		if(type_ == MainWindow::GeneratedCloud::kFeatures)
+		{
+			// only the features need more than the sensor data
+			node_ = node;
+		}
+		this->setAutoDelete(true);
+	}
+
+	virtual void run()
+	{
+		UTimer timer;
+		MainWindow::GeneratedCloud generated;
+		generated.type = type_;
+		generated.generation = generation_;
+		generated.nodeId = nodeId_;
+		generated.mapId = mapId_;
+
+		if(type_ == MainWindow::GeneratedCloud::kScan)
+		{
+			generated.scan = filterMapScan(data_, pose_, scanDownsamplingStep_, scanMinRange_, scanMaxRange_, scanVoxel_, scanFloorHeight_, scanCeilingHeight_, scanNormalK_, scanNormalRadius_);
+			UDEBUG("Generated scan %d with %d points (%fs)", nodeId_, generated.scan.size(), timer.ticks());
+		}
+		else if(type_ == MainWindow::GeneratedCloud::kFeatures)
+		{
+			generated.featuresCloud = createFeaturesCloud(node_, maxDepth_);
+			UDEBUG("Generated features cloud %d with %d points (%fs)", nodeId_, (int)generated.featuresCloud->size(), timer.ticks());
+		}
+		else
+		{
+			generateCloud(generated);
+			UDEBUG("Generated cloud %d with %d points (%fs)", nodeId_, generated.indices.get()?(int)generated.indices->size():0, timer.ticks());
+		}
+
+		window_->_generatedCloudsMutex.lock();
+		window_->_generatedClouds.push_back(generated);
+		window_->_generatedCloudsMutex.unlock();
+		QMetaObject::invokeMethod(window_, "processGeneratedClouds", Qt::QueuedConnection);
+	}
+
+private:
+	void generateCloud(MainWindow::GeneratedCloud & generated)
+	{
+		cv::Mat image, depth;
+		data_.uncompressData(&image, &depth, 0);
+		pcl::IndicesPtr indices(new std::vector<int>);
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = util3d::cloudRGBFromSensorData(data_,
+				decimation_,
+				maxDepth_,
+				minDepth_,
+				indices.get(),
+				parameters_,
+				roiRatios_);
+
+		cloud = filterMapCloud(cloud, indices, pose_, voxel_, floorHeight_, ceilingHeight_, noiseRadius_, noiseMinNeighbors_);
+
+		if(indices->size())
+		{
+			if(normalK_ > 0)
+			{
+				Eigen::Vector3f viewPoint(0.0f,0.0f,0.0f);
+				if(data_.cameraModels().size() && !data_.cameraModels()[0].localTransform().isNull())
+				{
+					viewPoint[0] = data_.cameraModels()[0].localTransform().x();
+					viewPoint[1] = data_.cameraModels()[0].localTransform().y();
+					viewPoint[2] = data_.cameraModels()[0].localTransform().z();
+				}
+				else if(!data_.stereoCameraModel().localTransform().isNull())
+				{
+					viewPoint[0] = data_.stereoCameraModel().localTransform().x();
+					viewPoint[1] = data_.stereoCameraModel().localTransform().y();
+					viewPoint[2] = data_.stereoCameraModel().localTransform().z();
+				}
+				pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals(cloud, indices, normalK_, normalRadius_, viewPoint);
+				pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudWithNormals(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+				pcl::concatenateFields(*cloud, *normals, *cloudWithNormals);
+				generated.cloudWithNormals = util3d::extractIndices(cloudWithNormals, indices, false, false);
+			}
+			generated.cloud = util3d::extractIndices(cloud, indices, false, true);
+		}
+		generated.indices = indices;
+	}
+
+	MainWindow * window_;
+	MainWindow::GeneratedCloud::Type type_;
+	int generation_;
+	int nodeId_;
+	int mapId_;
+	SensorData data_;
+	Signature node_;
+	Transform pose_;
+	int decimation_;
+	double maxDepth_;
+	double minDepth_;
+	std::vector<float> roiRatios_;
+	ParametersMap parameters_;
+	double voxel_;
+	double floorHeight_;
+	double ceilingHeight_;
+	double noiseRadius_;
+	int noiseMinNeighbors_;
+	int normalK_;
+	double normalRadius_;
+	int scanDownsamplingStep_;
+	double scanMinRange_;
+	double scanMaxRange_;
+	double scanVoxel_;
+	double scanFloorHeight_;
+	double scanCeilingHeight_;
+	int scanNormalK_;
+	double scanNormalRadius_;
+};
+
 MainWindow::MainWindow(PreferencesDialog * prefDialog, QWidget * parent, bool showSplashScreen) :
 	QMainWindow(parent),
 	_ui(0),
@@ -162,6 +684,8 @@ MainWindow::MainWindow(PreferencesDialog * prefDialog, QWidget * parent, bool sh
 	_waypointsIndex(0),
 	_cachedMemoryUsage(0),
 	_createdCloudsMemoryUsage(0),
+	_cloudGenerationPool(0),
+	_cloudGeneration(0),
 	_occupancyGrid(0),
 	_octomap(0),
 	_odometryCorrection(Transform::getIdentity()),
@@ -205,6 +729,8 @@ MainWindow::MainWindow(PreferencesDialog * prefDialog, QWidget * parent, bool sh
 	_depthCalibrationDialog = new DepthCalibrationDialog(this);
 	_depthCalibrationDialog->setObjectName("DepthCalibrationDialog");
 
+	_cloudGenerationPool = new QThreadPool(this);
+
 	_ui = new Ui_mainWindow();
 	UDEBUG("Setup ui...");
 	_ui->setupUi(this);
@@ -674,6 +1200,8 @@ MainWindow::~MainWindow()
 {
 	UDEBUG("");
 	this->stopDetection();
+	_cloudGenerationPool->clear();
+	_cloudGenerationPool->waitForDone();
 	delete _ui;
 	delete _elapsedTime;
 #ifdef RTABMAP_OCTOMAP
@@ -969,6 +1497,8 @@ void MainWindow::processCameraInfo(const rtabmap::CameraInfo & info)
 	_ui->statsToolBox->updateStat("Camera/Time mirroring/ms", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.timeMirroring*1000.0f, _preferencesDialog->isCacheSavedInFigures());
 	_ui->statsToolBox->updateStat("Camera/Time exposure compensation/ms", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.timeStereoExposureCompensation*1000.0f, _preferencesDialog->isCacheSavedInFigures());
 	_ui->statsToolBox->updateStat("Camera/Time scan from depth/ms", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.timeScanFromDepth*1000.0f, _preferencesDialog->isCacheSavedInFigures());
+	_ui->statsToolBox->updateStat("Camera/Time decoding/ms", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.timeDecoding*1000.0f, _preferencesDialog->isCacheSavedInFigures());
+	_ui->statsToolBox->updateStat("Camera/Buffered frames/", _preferencesDialog->isTimeUsedInFigures()?info.stamp-_firstStamp:(float)info.id, info.bufferedFrames, _preferencesDialog->isCacheSavedInFigures());
 
 	Q_EMIT(cameraInfoProcessed());
 }
@@ -2354,6 +2884,7 @@ void MainWindow::updateMapCloud(
 	UDEBUG("Update map with %d locations", poses.size());
 	QMap<std::string, Transform> viewerClouds = _cloudViewer->getAddedClouds();
 	std::set<std::string> viewerLines = _cloudViewer->getAddedLines();
+	ParametersMap allParameters = _preferencesDialog->getAllParameters(); // for background cloud generation
 	int i=1;
 	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 	{
@@ -2374,6 +2905,21 @@ void MainWindow::updateMapCloud(
 				// update cloud
 				if(viewerClouds.contains(cloudName))
 				{
+					// Update the level of detail if the node moved relative to the current pose
+					std::map<int, int>::iterator lodIter = _cloudLods.find(iter->first);
+					if(lodIter != _cloudLods.end() && _cachedClouds.find(iter->first) != _cachedClouds.end())
+					{
+						int lod = getCloudLod(iter->second);
+						if(lod != lodIter->second)
+						{
+							const std::pair<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, pcl::IndicesPtr> & cached = _cachedClouds.at(iter->first);
+							std::map<int, pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr>::iterator nter = _cachedCloudsWithNormals.find(iter->first);
+							addLodCloudToMap(iter->first, iter->second, uValue(mapIds, iter->first, -1), cached.first, cached.second,
+									nter!=_cachedCloudsWithNormals.end()?nter->second:pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr(),
+									lod);
+						}
+					}
+
 					// Update only if the pose has changed
 					Transform tCloud;
 					_cloudViewer->getPose(cloudName, tCloud);
@@ -2391,7 +2937,8 @@ void MainWindow::updateMapCloud(
 				}
 				else if(_cachedEmptyClouds.find(iter->first) == _cachedEmptyClouds.end() &&
 						_cachedClouds.find(iter->first) == _cachedClouds.end() &&
-						_cachedSignatures.contains(iter->first))
+						_cachedSignatures.contains(iter->first) &&
+						!this->createCloudInBackground(iter->first, iter->second, uValue(mapIds, iter->first, -1), allParameters))
 				{
 					std::pair<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, pcl::IndicesPtr> createdCloud = this->createAndAddCloudToMap(iter->first, iter->second, uValue(mapIds, iter->first, -1));
 					if(_cloudViewer->getAddedClouds().contains(cloudName))
@@ -2434,7 +2981,8 @@ void MainWindow::updateMapCloud(
 				else if(_cachedSignatures.contains(iter->first))
 				{
 					QMap<int, Signature>::iterator jter = _cachedSignatures.find(iter->first);
-					if(!jter->sensorData().laserScanCompressed().isEmpty() || !jter->sensorData().laserScanRaw().isEmpty())
+					if((!jter->sensorData().laserScanCompressed().isEmpty() || !jter->sensorData().laserScanRaw().isEmpty()) &&
+					   !this->createScanInBackground(iter->first, iter->second, uValue(mapIds, iter->first, -1)))
 					{
 						this->createAndAddScanToMap(iter->first, iter->second, uValue(mapIds, iter->first, -1));
 					}
@@ -2515,7 +3063,8 @@ void MainWindow::updateMapCloud(
 				else if(_cachedSignatures.contains(iter->first))
 				{
 					QMap<int, Signature>::iterator jter = _cachedSignatures.find(iter->first);
-					if(!jter->getWords3().empty())
+					if(!jter->getWords3().empty() &&
+					   !this->createFeaturesInBackground(iter->first, iter->second, uValue(mapIds, iter->first, -1)))
 					{
 						this->createAndAddFeaturesToMap(iter->first, iter->second, uValue(mapIds, iter->first, -1));
 					}
@@ -3096,43 +3645,15 @@ std::pair<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, pcl::IndicesPtr> MainWindow::c
 		}
 
 		// filtering pipeline
-		if(indices->size() && _preferencesDialog->getVoxel() > 0.0)
-		{
-			cloud = util3d::voxelize(cloud, indices, _preferencesDialog->getVoxel());
-			//generate indices for all points (they are all valid)
-			indices->resize(cloud->size());
-			for(unsigned int i=0; i<cloud->size(); ++i)
-			{
-				indices->at(i) = i;
-			}
-		}
-
-		// Do ceiling/floor filtering
-		if(indices->size() &&
-		   (_preferencesDialog->getFloorFilteringHeight() != 0.0 ||
-		   _preferencesDialog->getCeilingFilteringHeight() != 0.0))
-		{
-			// perform in /map frame
-			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudTransformed = util3d::transformPointCloud(cloud, pose);
-			indices = rtabmap::util3d::passThrough(
-					cloudTransformed,
-					indices,
-					"z",
-					_preferencesDialog->getFloorFilteringHeight()==0.0?(float)std::numeric_limits<int>::min():_preferencesDialog->getFloorFilteringHeight(),
-					_preferencesDialog->getCeilingFilteringHeight()==0.0?(float)std::numeric_limits<int>::max():_preferencesDialog->getCeilingFilteringHeight());
-		}
-
-		// Do radius filtering after voxel filtering ( a lot faster)
-		if(indices->size() &&
-		   _preferencesDialog->getNoiseRadius() > 0.0 &&
-		   _preferencesDialog->getNoiseMinNeighbors() > 0)
-		{
-			indices = rtabmap::util3d::radiusFiltering(
-					cloud,
-					indices,
-					_preferencesDialog->getNoiseRadius(),
-					_preferencesDialog->getNoiseMinNeighbors());
-		}
+		cloud = filterMapCloud(
+				cloud,
+				indices,
+				pose,
+				_preferencesDialog->getVoxel(),
+				_preferencesDialog->getFloorFilteringHeight(),
+				_preferencesDialog->getCeilingFilteringHeight(),
+				_preferencesDialog->getNoiseRadius(),
+				_preferencesDialog->getNoiseMinNeighbors());
 
 		pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudWithNormals(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
 		if(_preferencesDialog->isSubtractFiltering() &&
@@ -3364,317 +3885,344 @@ std::pair<pcl::PointCloud<pcl::PointXYZRGB>::Ptr, pcl::IndicesPtr> MainWindow::c
 	return outputPair;
 }
 
-void MainWindow::createAndAddScanToMap(int nodeId, const Transform & pose, int mapId)
+bool MainWindow::createCloudInBackground(int nodeId, const Transform & pose, int mapId, const ParametersMap & parameters)
 {
-	std::string scanName = uFormat("scan%d", nodeId);
-	if(_cloudViewer->getAddedClouds().contains(scanName))
+	UASSERT(!pose.isNull());
+	if(_pendingClouds.find(nodeId) != _pendingClouds.end())
 	{
-		UERROR("Scan %d already added to map.", nodeId);
-		return;
+		// already being created
+		return true;
+	}
+
+	// Only the steps not depending on previous clouds or on the
+	// viewer are done in background, otherwise fall back on createAndAddCloudToMap()
+	bool rectifyOnlyFeatures = Parameters::defaultRtabmapRectifyOnlyFeatures();
+	bool imagesAlreadyRectified = Parameters::defaultRtabmapImagesAlreadyRectified();
+	Parameters::parse(parameters, Parameters::kRtabmapRectifyOnlyFeatures(), rectifyOnlyFeatures);
+	Parameters::parse(parameters, Parameters::kRtabmapImagesAlreadyRectified(), imagesAlreadyRectified);
+	if(nodeId <= 0 ||
+	   !_preferencesDialog->isCloudsBackgroundGenerated() ||
+	   _preferencesDialog->isCloudMeshing() ||
+	   (_preferencesDialog->isSubtractFiltering() && _preferencesDialog->getSubtractFilteringRadius() > 0.0) ||
+	   (rectifyOnlyFeatures && !imagesAlreadyRectified))
+	{
+		return false;
 	}
 
 	QMap<int, Signature>::iterator iter = _cachedSignatures.find(nodeId);
 	if(iter == _cachedSignatures.end())
 	{
-		UERROR("Node %d is not in the cache.", nodeId);
-		return;
+		return false;
 	}
-
-	if(!iter->sensorData().laserScanCompressed().isEmpty() || !iter->sensorData().laserScanRaw().isEmpty())
+	if((iter->sensorData().imageCompressed().empty() && iter->sensorData().imageRaw().empty()) ||
+	   (iter->sensorData().depthOrRightCompressed().empty() && iter->sensorData().depthOrRightRaw().empty()))
 	{
-		LaserScan scan;
-		iter->sensorData().uncompressData(0, 0, &scan);
+		_cachedEmptyClouds.insert(nodeId);
+		return true;
+	}
 
-		if(_preferencesDialog->getDownsamplingStepScan(0) > 1 ||
-			_preferencesDialog->getScanMaxRange(0) > 0.0f ||
-			_preferencesDialog->getScanMinRange(0) > 0.0f)
-		{
-			scan = util3d::commonFiltering(scan,
-					_preferencesDialog->getDownsamplingStepScan(0),
-					_preferencesDialog->getScanMinRange(0),
-					_preferencesDialog->getScanMaxRange(0));
-		}
+	_pendingClouds.insert(nodeId);
+	_cloudGenerationPool->start(new CloudGenerationTask(this, GeneratedCloud::kCloud, _cloudGeneration, nodeId, mapId, iter.value(), pose, parameters));
+	return true;
+}
 
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudRGB;
-		pcl::PointCloud<pcl::PointXYZI>::Ptr cloudI;
-		pcl::PointCloud<pcl::PointNormal>::Ptr cloudWithNormals;
-		pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudRGBWithNormals;
-		pcl::PointCloud<pcl::PointXYZINormal>::Ptr cloudIWithNormals;
-		if(scan.hasNormals() && scan.hasRGB() && _preferencesDialog->getCloudVoxelSizeScan(0) <= 0.0)
-		{
-			cloudRGBWithNormals = util3d::laserScanToPointCloudRGBNormal(scan, scan.localTransform());
-		}
-		else if(scan.hasNormals() && scan.hasIntensity() && _preferencesDialog->getCloudVoxelSizeScan(0) <= 0.0)
-		{
-			cloudIWithNormals = util3d::laserScanToPointCloudINormal(scan, scan.localTransform());
-		}
-		else if((scan.hasNormals()) && _preferencesDialog->getCloudVoxelSizeScan(0) <= 0.0)
-		{
-			cloudWithNormals = util3d::laserScanToPointCloudNormal(scan, scan.localTransform());
-		}
-		else if(scan.hasRGB())
-		{
-			cloudRGB = util3d::laserScanToPointCloudRGB(scan, scan.localTransform());
-		}
-		else if(scan.hasIntensity())
-		{
-			cloudI = util3d::laserScanToPointCloudI(scan, scan.localTransform());
-		}
-		else
-		{
-			cloud = util3d::laserScanToPointCloud(scan, scan.localTransform());
-		}
+int MainWindow::getCloudLod(const Transform & pose) const
+{
+	double lodDistance = _preferencesDialog->getCloudLodDistance();
+	if(lodDistance <= 0.0 ||
+	   _currentPosesMap.empty())
+	{
+		return 0;
+	}
+	float distance = pose.getDistance(_currentPosesMap.rbegin()->second);
+	int lod = 0;
+	while(lod < 3 && distance > lodDistance)
+	{
+		++lod;
+		lodDistance *= 2.0;
+	}
+	return lod;
+}
 
-		if(_preferencesDialog->getCloudVoxelSizeScan(0) > 0.0)
+bool MainWindow::addLodCloudToMap(
+		int nodeId,
+		const Transform & pose,
+		int mapId,
+		const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud,
+		const pcl::IndicesPtr & indices,
+		const pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr & cloudWithNormals,
+		int lod)
+{
+	std::string cloudName = uFormat("cloud%d", nodeId);
+	QColor color = Qt::gray;
+	if(mapId >= 0)
+	{
+		color = (Qt::GlobalColor)(mapId+3 % 12 + 7 );
+	}
+	// keep 1 point every 2^lod points
+	int step = 1 << lod;
+	bool added = false;
+	if(cloudWithNormals.get() && cloudWithNormals->size())
+	{
+		pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr output = cloudWithNormals;
+		if(lod > 0)
 		{
-			if(cloud.get())
+			output.reset(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+			output->reserve(cloudWithNormals->size()/step+1);
+			for(unsigned int i=0; i<cloudWithNormals->size(); i+=step)
 			{
-				cloud = util3d::voxelize(cloud, _preferencesDialog->getCloudVoxelSizeScan(0));
-			}
-			if(cloudRGB.get())
-			{
-				cloudRGB = util3d::voxelize(cloudRGB, _preferencesDialog->getCloudVoxelSizeScan(0));
-			}
-			if(cloudI.get())
-			{
-				cloudI = util3d::voxelize(cloudI, _preferencesDialog->getCloudVoxelSizeScan(0));
+				output->push_back(cloudWithNormals->at(i));
 			}
 		}
-
-		// Do ceiling/floor filtering
-		if((!scan.is2d()) && // don't filter 2D scans
-		   (_preferencesDialog->getScanFloorFilteringHeight() != 0.0 ||
-		   _preferencesDialog->getScanCeilingFilteringHeight() != 0.0))
+		added = _cloudViewer->addCloud(cloudName, output, pose, color);
+	}
+	else
+	{
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr output = cloud;
+		if(lod > 0)
 		{
-			if(cloudRGBWithNormals.get())
-			{
-				// perform in /map frame
-				pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudTransformed = util3d::transformPointCloud(cloudRGBWithNormals, pose);
-				cloudTransformed = rtabmap::util3d::passThrough(
-						cloudTransformed,
-						"z",
-						_preferencesDialog->getScanFloorFilteringHeight()==0.0?(float)std::numeric_limits<int>::min():_preferencesDialog->getScanFloorFilteringHeight(),
-						_preferencesDialog->getScanCeilingFilteringHeight()==0.0?(float)std::numeric_limits<int>::max():_preferencesDialog->getScanCeilingFilteringHeight());
-
-				//transform back in sensor frame
-				cloudRGBWithNormals = util3d::transformPointCloud(cloudTransformed, pose.inverse());
-			}
-			if(cloudIWithNormals.get())
-			{
-				// perform in /map frame
-				pcl::PointCloud<pcl::PointXYZINormal>::Ptr cloudTransformed = util3d::transformPointCloud(cloudIWithNormals, pose);
-				cloudTransformed = rtabmap::util3d::passThrough(
-						cloudTransformed,
-						"z",
-						_preferencesDialog->getScanFloorFilteringHeight()==0.0?(float)std::numeric_limits<int>::min():_preferencesDialog->getScanFloorFilteringHeight(),
-						_preferencesDialog->getScanCeilingFilteringHeight()==0.0?(float)std::numeric_limits<int>::max():_preferencesDialog->getScanCeilingFilteringHeight());
-
-				//transform back in sensor frame
-				cloudIWithNormals = util3d::transformPointCloud(cloudTransformed, pose.inverse());
-			}
-			if(cloudWithNormals.get())
+			output.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+			output->reserve(indices->size()/step+1);
+			for(unsigned int i=0; i<indices->size(); i+=step)
 			{
-				// perform in /map frame
-				pcl::PointCloud<pcl::PointNormal>::Ptr cloudTransformed = util3d::transformPointCloud(cloudWithNormals, pose);
-				cloudTransformed = rtabmap::util3d::passThrough(
-						cloudTransformed,
-						"z",
-						_preferencesDialog->getScanFloorFilteringHeight()==0.0?(float)std::numeric_limits<int>::min():_preferencesDialog->getScanFloorFilteringHeight(),
-						_preferencesDialog->getScanCeilingFilteringHeight()==0.0?(float)std::numeric_limits<int>::max():_preferencesDialog->getScanCeilingFilteringHeight());
-
-				//transform back in sensor frame
-				cloudWithNormals = util3d::transformPointCloud(cloudTransformed, pose.inverse());
+				output->push_back(cloud->at(indices->at(i)));
 			}
-			if(cloudRGB.get())
-			{
-				// perform in /map frame
-				pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudTransformed = util3d::transformPointCloud(cloudRGB, pose);
-				cloudTransformed = rtabmap::util3d::passThrough(
-						cloudTransformed,
-						"z",
-						_preferencesDialog->getScanFloorFilteringHeight()==0.0?(float)std::numeric_limits<int>::min():_preferencesDialog->getScanFloorFilteringHeight(),
-						_preferencesDialog->getScanCeilingFilteringHeight()==0.0?(float)std::numeric_limits<int>::max():_preferencesDialog->getScanCeilingFilteringHeight());
+		}
+		added = _cloudViewer->addCloud(cloudName, output, pose, color);
+	}
+	if(!added)
+	{
+		UERROR("Adding cloud %d to viewer failed!", nodeId);
+		return false;
+	}
+	_cloudLods[nodeId] = lod;
+	_cloudViewer->setCloudColorIndex(cloudName, _preferencesDialog->getCloudColorScheme(0));
+	_cloudViewer->setCloudOpacity(cloudName, _preferencesDialog->getCloudOpacity(0));
+	_cloudViewer->setCloudPointSize(cloudName, _preferencesDialog->getCloudPointSize(0));
+	_cloudViewer->setCloudVisibility(cloudName, _cloudViewer->isVisible() && _preferencesDialog->isCloudsShown(0));
+	return true;
+}
 
-				//transform back in sensor frame
-				cloudRGB = util3d::transformPointCloud(cloudTransformed, pose.inverse());
-			}
-			if(cloudI.get())
-			{
-				// perform in /map frame
-				pcl::PointCloud<pcl::PointXYZI>::Ptr cloudTransformed = util3d::transformPointCloud(cloudI, pose);
-				cloudTransformed = rtabmap::util3d::passThrough(
-						cloudTransformed,
-						"z",
-						_preferencesDialog->getScanFloorFilteringHeight()==0.0?(float)std::numeric_limits<int>::min():_preferencesDialog->getScanFloorFilteringHeight(),
-						_preferencesDialog->getScanCeilingFilteringHeight()==0.0?(float)std::numeric_limits<int>::max():_preferencesDialog->getScanCeilingFilteringHeight());
+void MainWindow::processGeneratedClouds()
+{
+	std::list<GeneratedCloud> generatedClouds;
+	_generatedCloudsMutex.lock();
+	generatedClouds.swap(_generatedClouds);
+	_generatedCloudsMutex.unlock();
 
-				//transform back in sensor frame
-				cloudI = util3d::transformPointCloud(cloudTransformed, pose.inverse());
-			}
-			if(cloud.get())
-			{
-				// perform in /map frame
-				pcl::PointCloud<pcl::PointXYZ>::Ptr cloudTransformed = util3d::transformPointCloud(cloud, pose);
-				cloudTransformed = rtabmap::util3d::passThrough(
-						cloudTransformed,
-						"z",
-						_preferencesDialog->getScanFloorFilteringHeight()==0.0?(float)std::numeric_limits<int>::min():_preferencesDialog->getScanFloorFilteringHeight(),
-						_preferencesDialog->getScanCeilingFilteringHeight()==0.0?(float)std::numeric_limits<int>::max():_preferencesDialog->getScanCeilingFilteringHeight());
+	if(generatedClouds.empty())
+	{
+		return;
+	}
 
-				//transform back in sensor frame
-				cloud = util3d::transformPointCloud(cloudTransformed, pose.inverse());
-			}
+	UTimer timer;
+	int added = 0;
+	for(std::list<GeneratedCloud>::iterator iter=generatedClouds.begin(); iter!=generatedClouds.end(); ++iter)
+	{
+		if(iter->generation != _cloudGeneration)
+		{
+			// the cache has been cleared since
+			continue;
 		}
 
-		if(	(cloud.get() || cloudRGB.get() || cloudI.get()) &&
-		   (_preferencesDialog->getScanNormalKSearch() > 0 || _preferencesDialog->getScanNormalRadiusSearch() > 0.0))
+		// use latest pose of the node, it may have changed after the generation,
+		// null if the node is not in the map anymore
+		Transform pose;
+		std::map<int, Transform>::iterator pter = _currentPosesMap.find(iter->nodeId);
+		if(pter != _currentPosesMap.end())
 		{
-			Eigen::Vector3f scanViewpoint(
-					scan.localTransform().x(),
-					scan.localTransform().y(),
-					scan.localTransform().z());
-
-			pcl::PointCloud<pcl::Normal>::Ptr normals;
-			if(cloud.get() && cloud->size())
-			{
-				if(scan.is2d())
-				{
-					normals = util3d::computeFastOrganizedNormals2D(cloud, _preferencesDialog->getScanNormalKSearch(), _preferencesDialog->getScanNormalRadiusSearch(), scanViewpoint);
-				}
-				else
-				{
-					normals = util3d::computeNormals(cloud, _preferencesDialog->getScanNormalKSearch(), _preferencesDialog->getScanNormalRadiusSearch(), scanViewpoint);
-				}
-				cloudWithNormals.reset(new pcl::PointCloud<pcl::PointNormal>);
-				pcl::concatenateFields(*cloud, *normals, *cloudWithNormals);
-				cloud.reset();
-			}
-			else if(cloudRGB.get() && cloudRGB->size())
-			{
-				// Assuming 3D
-				normals = util3d::computeNormals(cloudRGB, _preferencesDialog->getScanNormalKSearch(), _preferencesDialog->getScanNormalRadiusSearch(), scanViewpoint);
-				cloudRGBWithNormals.reset(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
-				pcl::concatenateFields(*cloudRGB, *normals, *cloudRGBWithNormals);
-				cloudRGB.reset();
-			}
-			else if(cloudI.get())
+			pose = pter->second;
+			std::map<int, Transform>::iterator gtIter = _currentGTPosesMap.find(iter->nodeId);
+			if(_ui->actionAnchor_clouds_to_ground_truth->isChecked() && gtIter != _currentGTPosesMap.end())
 			{
-				if(scan.is2d())
-				{
-					normals = util3d::computeFastOrganizedNormals2D(cloudI, _preferencesDialog->getScanNormalKSearch(), _preferencesDialog->getScanNormalRadiusSearch(), scanViewpoint);
-				}
-				else
-				{
-					normals = util3d::computeNormals(cloudI, _preferencesDialog->getScanNormalKSearch(), _preferencesDialog->getScanNormalRadiusSearch(), scanViewpoint);
-				}
-				cloudIWithNormals.reset(new pcl::PointCloud<pcl::PointXYZINormal>);
-				pcl::concatenateFields(*cloudI, *normals, *cloudIWithNormals);
-				cloudI.reset();
+				pose = gtIter->second;
 			}
 		}
 
-		QColor color = Qt::gray;
-		if(mapId >= 0)
+		if(iter->type == GeneratedCloud::kScan)
 		{
-			color = (Qt::GlobalColor)(mapId+3 % 12 + 7 );
-		}
-		bool added = false;
-		if(cloudRGBWithNormals.get())
-		{
-			added = _cloudViewer->addCloud(scanName, cloudRGBWithNormals, pose, color);
-			if(added && nodeId > 0)
+			_pendingScans.erase(iter->nodeId);
+			std::string scanName = uFormat("scan%d", iter->nodeId);
+			if(!pose.isNull() &&
+			   !iter->scan.isEmpty() &&
+			   !_cloudViewer->getAddedClouds().contains(scanName) &&
+			   addScanToMap(iter->nodeId, pose, iter->mapId, iter->scan))
 			{
-				scan = LaserScan(util3d::laserScanFromPointCloud(*cloudRGBWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZRGBNormal, scan.localTransform());
+				_cloudViewer->setCloudVisibility(scanName, _cloudViewer->isVisible() && _preferencesDialog->isScansShown(0));
+				++added;
 			}
+			continue;
 		}
-		else if(cloudIWithNormals.get())
+		else if(iter->type == GeneratedCloud::kFeatures)
 		{
-			added = _cloudViewer->addCloud(scanName, cloudIWithNormals, pose, color);
-			if(added && nodeId > 0)
+			_pendingFeatures.erase(iter->nodeId);
+			std::string featuresName = uFormat("features%d", iter->nodeId);
+			if(!pose.isNull() &&
+			   iter->featuresCloud.get() &&
+			   !_cloudViewer->getAddedClouds().contains(featuresName) &&
+			   _createdFeatures.find(iter->nodeId) == _createdFeatures.end() &&
+			   addFeaturesToMap(iter->nodeId, pose, iter->mapId, iter->featuresCloud))
 			{
-				if(scan.is2d())
-				{
-					scan = LaserScan(util3d::laserScan2dFromPointCloud(*cloudIWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYINormal, scan.localTransform());
-				}
-				else
-				{
-					scan = LaserScan(util3d::laserScanFromPointCloud(*cloudIWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZINormal, scan.localTransform());
-				}
+				_cloudViewer->setCloudVisibility(featuresName, _cloudViewer->isVisible() && _preferencesDialog->isFeaturesShown(0));
+				++added;
 			}
+			continue;
 		}
-		else if(cloudWithNormals.get())
+
+		_pendingClouds.erase(iter->nodeId);
+		std::string cloudName = uFormat("cloud%d", iter->nodeId);
+		if(_cloudViewer->getAddedClouds().contains(cloudName) ||
+		   _cachedClouds.find(iter->nodeId) != _cachedClouds.end())
 		{
-			added = _cloudViewer->addCloud(scanName, cloudWithNormals, pose, color);
-			if(added && nodeId > 0)
-			{
-				if(scan.is2d())
-				{
-					scan = LaserScan(util3d::laserScan2dFromPointCloud(*cloudWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYNormal, scan.localTransform());
-				}
-				else
-				{
-					scan = LaserScan(util3d::laserScanFromPointCloud(*cloudWithNormals, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZNormal, scan.localTransform());
-				}
-			}
+			continue;
 		}
-		else if(cloudRGB.get())
+		if(iter->cloud.get() == 0 || iter->indices->empty())
 		{
-			added = _cloudViewer->addCloud(scanName, cloudRGB, pose, color);
-			if(added && nodeId > 0)
-			{
-				scan = LaserScan(util3d::laserScanFromPointCloud(*cloudRGB, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZRGB, scan.localTransform());
-			}
+			_cachedEmptyClouds.insert(iter->nodeId);
+			continue;
 		}
-		else if(cloudI.get())
+
+		if(_preferencesDialog->isCloudsKept())
 		{
-			added = _cloudViewer->addCloud(scanName, cloudI, pose, color);
-			if(added && nodeId > 0)
+			_cachedClouds.insert(std::make_pair(iter->nodeId, std::make_pair(iter->cloud, iter->indices)));
+			_createdCloudsMemoryUsage += (long)(iter->cloud->size() * sizeof(pcl::PointXYZRGB) + iter->indices->size()*sizeof(int));
+			if(iter->cloudWithNormals.get() && iter->cloudWithNormals->size())
 			{
-				if(scan.is2d())
-				{
-					scan = LaserScan(util3d::laserScan2dFromPointCloud(*cloudI, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYI, scan.localTransform());
-				}
-				else
-				{
-					scan = LaserScan(util3d::laserScanFromPointCloud(*cloudI, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZI, scan.localTransform());
-				}
+				_cachedCloudsWithNormals.insert(std::make_pair(iter->nodeId, iter->cloudWithNormals));
+				_createdCloudsMemoryUsage += (long)(iter->cloudWithNormals->size() * sizeof(pcl::PointXYZRGBNormal));
 			}
 		}
-		else
+
+		if(pose.isNull())
 		{
-			UASSERT(cloud.get());
-			added = _cloudViewer->addCloud(scanName, cloud, pose, color);
-			if(added && nodeId > 0)
-			{
-				if(scan.is2d())
-				{
-					scan = LaserScan(util3d::laserScan2dFromPointCloud(*cloud, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXY, scan.localTransform());
-				}
-				else
-				{
-					scan = LaserScan(util3d::laserScanFromPointCloud(*cloud, scan.localTransform().inverse()), scan.maxPoints(), scan.rangeMax(), LaserScan::kXYZ, scan.localTransform());
-				}
-			}
+			// not in the map anymore, it will be added from the cache if it comes back
+			continue;
 		}
-		if(!added)
+
+		if(!addLodCloudToMap(iter->nodeId, pose, iter->mapId, iter->cloud, iter->indices, iter->cloudWithNormals, getCloudLod(pose)))
 		{
-			UERROR("Adding cloud %d to viewer failed!", nodeId);
+			continue;
 		}
-		else
-		{
-			if(nodeId > 0)
-			{
-				_createdScans.insert(std::make_pair(nodeId, scan)); // keep scan in scan frame
-			}
+		++added;
+	}
+
+	if(added)
+	{
+		_cloudViewer->update();
+	}
+	UDEBUG("Added %d/%d clouds generated in background (%fs)", added, (int)generatedClouds.size(), timer.ticks());
+}
+
+void MainWindow::createAndAddScanToMap(int nodeId, const Transform & pose, int mapId)
+{
+	std::string scanName = uFormat("scan%d", nodeId);
+	if(_cloudViewer->getAddedClouds().contains(scanName))
+	{
+		UERROR("Scan %d already added to map.", nodeId);
+		return;
+	}
 
-			_cloudViewer->setCloudColorIndex(scanName, _preferencesDialog->getScanColorScheme(0)==0 && scan.is2d()?2:_preferencesDialog->getScanColorScheme(0));
-			_cloudViewer->setCloudOpacity(scanName, _preferencesDialog->getScanOpacity(0));
-			_cloudViewer->setCloudPointSize(scanName, _preferencesDialog->getScanPointSize(0));
+	QMap<int, Signature>::iterator iter = _cachedSignatures.find(nodeId);
+	if(iter == _cachedSignatures.end())
+	{
+		UERROR("Node %d is not in the cache.", nodeId);
+		return;
+	}
+
+	if(!iter->sensorData().laserScanCompressed().isEmpty() || !iter->sensorData().laserScanRaw().isEmpty())
+	{
+		LaserScan scan = filterMapScan(
+				iter->sensorData(),
+				pose,
+				_preferencesDialog->getDownsamplingStepScan(0),
+				_preferencesDialog->getScanMinRange(0),
+				_preferencesDialog->getScanMaxRange(0),
+				_preferencesDialog->getCloudVoxelSizeScan(0),
+				_preferencesDialog->getScanFloorFilteringHeight(),
+				_preferencesDialog->getScanCeilingFilteringHeight(),
+				_preferencesDialog->getScanNormalKSearch(),
+				_preferencesDialog->getScanNormalRadiusSearch());
+		if(!scan.isEmpty())
+		{
+			addScanToMap(nodeId, pose, mapId, scan);
 		}
 	}
 }
 
+bool MainWindow::createScanInBackground(int nodeId, const Transform & pose, int mapId)
+{
+	UASSERT(!pose.isNull());
+	if(_pendingScans.find(nodeId) != _pendingScans.end())
+	{
+		// already being created
+		return true;
+	}
+	if(nodeId <= 0 || !_preferencesDialog->isCloudsBackgroundGenerated())
+	{
+		return false;
+	}
+
+	QMap<int, Signature>::iterator iter = _cachedSignatures.find(nodeId);
+	if(iter == _cachedSignatures.end())
+	{
+		return false;
+	}
+
+	_pendingScans.insert(nodeId);
+	_cloudGenerationPool->start(new CloudGenerationTask(this, GeneratedCloud::kScan, _cloudGeneration, nodeId, mapId, iter.value(), pose, ParametersMap()));
+	return true;
+}
+
+bool MainWindow::addScanToMap(int nodeId, const Transform & pose, int mapId, const LaserScan & scan)
+{
+	std::string scanName = uFormat("scan%d", nodeId);
+	QColor color = Qt::gray;
+	if(mapId >= 0)
+	{
+		color = (Qt::GlobalColor)(mapId+3 % 12 + 7 );
+	}
+	bool added = false;
+	if(scan.hasNormals() && scan.hasRGB())
+	{
+		added = _cloudViewer->addCloud(scanName, util3d::laserScanToPointCloudRGBNormal(scan, scan.localTransform()), pose, color);
+	}
+	else if(scan.hasNormals() && scan.hasIntensity())
+	{
+		added = _cloudViewer->addCloud(scanName, util3d::laserScanToPointCloudINormal(scan, scan.localTransform()), pose, color);
+	}
+	else if(scan.hasNormals())
+	{
+		added = _cloudViewer->addCloud(scanName, util3d::laserScanToPointCloudNormal(scan, scan.localTransform()), pose, color);
+	}
+	else if(scan.hasRGB())
+	{
+		added = _cloudViewer->addCloud(scanName, util3d::laserScanToPointCloudRGB(scan, scan.localTransform()), pose, color);
+	}
+	else if(scan.hasIntensity())
+	{
+		added = _cloudViewer->addCloud(scanName, util3d::laserScanToPointCloudI(scan, scan.localTransform()), pose, color);
+	}
+	else
+	{
+		added = _cloudViewer->addCloud(scanName, util3d::laserScanToPointCloud(scan, scan.localTransform()), pose, color);
+	}
+	if(!added)
+	{
+		UERROR("Adding cloud %d to viewer failed!", nodeId);
+		return false;
+	}
+
+	if(nodeId > 0)
+	{
+		_createdScans.insert(std::make_pair(nodeId, scan)); // keep scan in scan frame
+	}
+
+	_cloudViewer->setCloudColorIndex(scanName, _preferencesDialog->getScanColorScheme(0)==0 && scan.is2d()?2:_preferencesDialog->getScanColorScheme(0));
+	_cloudViewer->setCloudOpacity(scanName, _preferencesDialog->getScanOpacity(0));
+	_cloudViewer->setCloudPointSize(scanName, _preferencesDialog->getScanPointSize(0));
+	return true;
+}
+
 void MainWindow::createAndAddFeaturesToMap(int nodeId, const Transform & pose, int mapId)
 {
 	UDEBUG("");
@@ -3702,93 +4250,55 @@ void MainWindow::createAndAddFeaturesToMap(int nodeId, const Transform & pose, i
 	if(iter->getWords3().size())
 	{
 		UINFO("Create cloud from 3D words");
-		QColor color = Qt::gray;
-		if(mapId >= 0)
-		{
-			color = (Qt::GlobalColor)(mapId+3 % 12 + 7 );
-		}
+		addFeaturesToMap(nodeId, pose, mapId, createFeaturesCloud(iter.value(), _preferencesDialog->getCloudMaxDepth(0)));
+	}
+	UDEBUG("");
+}
 
-		cv::Mat rgb;
-		if(!iter->sensorData().imageCompressed().empty() || !iter->sensorData().imageRaw().empty())
-		{
-			SensorData data = iter->sensorData();
-			data.uncompressData(&rgb, 0, 0);
-		}
+bool MainWindow::createFeaturesInBackground(int nodeId, const Transform & pose, int mapId)
+{
+	UASSERT(!pose.isNull());
+	if(_pendingFeatures.find(nodeId) != _pendingFeatures.end() ||
+	   _createdFeatures.find(nodeId) != _createdFeatures.end())
+	{
+		// already being created or created
+		return true;
+	}
+	if(nodeId <= 0 || !_preferencesDialog->isCloudsBackgroundGenerated())
+	{
+		return false;
+	}
 
-		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-		cloud->resize(iter->getWords3().size());
-		int oi=0;
-		UASSERT(iter->getWords().size() == iter->getWords3().size());
-		float maxDepth = _preferencesDialog->getCloudMaxDepth(0);
-		UDEBUG("rgb.channels()=%d");
-		if(!iter->getWords3().empty() && !iter->getWordsKpts().empty())
-		{
-			Transform invLocalTransform = Transform::getIdentity();
-			if(iter.value().sensorData().cameraModels().size() == 1 && iter.value().sensorData().cameraModels().at(0).isValidForProjection())
-			{
-				invLocalTransform = iter.value().sensorData().cameraModels()[0].localTransform().inverse();
-			}
-			else if(iter.value().sensorData().stereoCameraModel().isValidForProjection())
-			{
-				invLocalTransform = iter.value().sensorData().stereoCameraModel().left().localTransform().inverse();
-			}
+	QMap<int, Signature>::iterator iter = _cachedSignatures.find(nodeId);
+	if(iter == _cachedSignatures.end())
+	{
+		return false;
+	}
 
-			for(std::multimap<int, int>::const_iterator jter=iter->getWords().begin(); jter!=iter->getWords().end(); ++jter)
-			{
-				const cv::Point3f & pt = iter->getWords3()[jter->second];
-				if(util3d::isFinite(pt) &&
-					(maxDepth == 0.0f ||
-							//move back point in camera frame (to get depth along z), ignore for multi-camera
-							(iter.value().sensorData().cameraModels().size()<=1 &&
-							 util3d::transformPoint(pt, invLocalTransform).z < maxDepth)))
-				{
-					(*cloud)[oi].x = pt.x;
-					(*cloud)[oi].y = pt.y;
-					(*cloud)[oi].z = pt.z;
-					const cv::KeyPoint & kpt = iter->getWordsKpts()[jter->second];
-					int u = kpt.pt.x+0.5;
-					int v = kpt.pt.y+0.5;
-					if(!rgb.empty() &&
-						uIsInBounds(u, 0, rgb.cols-1) &&
-						uIsInBounds(v, 0, rgb.rows-1))
-					{
-						if(rgb.channels() == 1)
-						{
-							(*cloud)[oi].r = (*cloud)[oi].g = (*cloud)[oi].b = rgb.at<unsigned char>(v, u);
-						}
-						else
-						{
-							cv::Vec3b bgr = rgb.at<cv::Vec3b>(v, u);
-							(*cloud)[oi].b = bgr.val[0];
-							(*cloud)[oi].g = bgr.val[1];
-							(*cloud)[oi].r = bgr.val[2];
-						}
-					}
-					else
-					{
-						(*cloud)[oi].r = (*cloud)[oi].g = (*cloud)[oi].b = 255;
-					}
-					++oi;
-				}
-			}
-		}
-		cloud->resize(oi);
-		if(!_cloudViewer->addCloud(cloudName, cloud, pose, color))
-		{
-			UERROR("Adding features cloud %d to viewer failed!", nodeId);
-		}
-		else if(nodeId > 0)
-		{
-			_createdFeatures.insert(std::make_pair(nodeId, cloud));
-		}
+	_pendingFeatures.insert(nodeId);
+	_cloudGenerationPool->start(new CloudGenerationTask(this, GeneratedCloud::kFeatures, _cloudGeneration, nodeId, mapId, iter.value(), pose, ParametersMap()));
+	return true;
+}
+
+bool MainWindow::addFeaturesToMap(int nodeId, const Transform & pose, int mapId, const pcl::PointCloud<pcl::PointXYZRGB>::Ptr & cloud)
+{
+	std::string cloudName = uFormat("features%d", nodeId);
+	QColor color = Qt::gray;
+	if(mapId >= 0)
+	{
+		color = (Qt::GlobalColor)(mapId+3 % 12 + 7 );
 	}
-	else
+	if(!_cloudViewer->addCloud(cloudName, cloud, pose, color))
 	{
-		return;
+		UERROR("Adding features cloud %d to viewer failed!", nodeId);
+		return false;
+	}
+	if(nodeId > 0)
+	{
+		_createdFeatures.insert(std::make_pair(nodeId, cloud));
 	}
-
 	_cloudViewer->setCloudPointSize(cloudName, _preferencesDialog->getFeaturesPointSize(0));
-	UDEBUG("");
+	return true;
 }
 
 Transform MainWindow::alignPosesToGroundTruth(
@@ -6659,8 +7169,15 @@ void MainWindow::clearTheCache()
 	_cachedMemoryUsage = 0;
 	_cachedWordsCount.clear();
 	_cachedClouds.clear();
+	_cachedCloudsWithNormals.clear();
 	_createdCloudsMemoryUsage = 0;
 	_cachedEmptyClouds.clear();
+	_cloudGenerationPool->clear();
+	++_cloudGeneration;
+	_pendingClouds.clear();
+	_pendingScans.clear();
+	_pendingFeatures.clear();
+	_cloudLods.clear();
 	_previousCloud.first = 0;
 	_previousCloud.second.first.first.reset();
 	_previousCloud.second.first.second.reset();
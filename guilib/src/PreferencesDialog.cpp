@@ -420,6 +420,8 @@ PreferencesDialog::PreferencesDialog(QWidget * parent) :
 	// General panel
 	connect(_ui->general_checkBox_imagesKept, SIGNAL(stateChanged(int)), this, SLOT(makeObsoleteGeneralPanel()));
 	connect(_ui->general_checkBox_cloudsKept, SIGNAL(stateChanged(int)), this, SLOT(makeObsoleteGeneralPanel()));
+	connect(_ui->general_checkBox_cloudsBackground, SIGNAL(stateChanged(int)), this, SLOT(makeObsoleteGeneralPanel()));
+	connect(_ui->general_doubleSpinBox_cloudsLodDistance, SIGNAL(valueChanged(double)), this, SLOT(makeObsoleteGeneralPanel()));
 	connect(_ui->checkBox_verticalLayoutUsed, SIGNAL(stateChanged(int)), this, SLOT(makeObsoleteGeneralPanel()));
 	connect(_ui->checkBox_imageRejectedShown, SIGNAL(stateChanged(int)), this, SLOT(makeObsoleteGeneralPanel()));
 	connect(_ui->checkBox_imageHighestHypShown, SIGNAL(stateChanged(int)), this, SLOT(makeObsoleteGeneralPanel()));
@@ -1701,6 +1703,8 @@ void PreferencesDialog::resetSettings(QGroupBox * groupBox)
 	{
 		_ui->general_checkBox_imagesKept->setChecked(true);
 		_ui->general_checkBox_cloudsKept->setChecked(true);
+		_ui->general_checkBox_cloudsBackground->setChecked(true);
+		_ui->general_doubleSpinBox_cloudsLodDistance->setValue(0.0);
 		_ui->checkBox_beep->setChecked(false);
 		_ui->checkBox_stamps->setChecked(true);
 		_ui->checkBox_cacheStatistics->setChecked(true);
@@ -2159,6 +2163,8 @@ void PreferencesDialog::readGuiSettings(const QString & filePath)
 	settings.beginGroup("General");
 	_ui->general_checkBox_imagesKept->setChecked(settings.value("imagesKept", _ui->general_checkBox_imagesKept->isChecked()).toBool());
 	_ui->general_checkBox_cloudsKept->setChecked(settings.value("cloudsKept", _ui->general_checkBox_cloudsKept->isChecked()).toBool());
+	_ui->general_checkBox_cloudsBackground->setChecked(settings.value("cloudsBackground", _ui->general_checkBox_cloudsBackground->isChecked()).toBool());
+	_ui->general_doubleSpinBox_cloudsLodDistance->setValue(settings.value("cloudsLodDistance", _ui->general_doubleSpinBox_cloudsLodDistance->value()).toDouble());
 	_ui->comboBox_loggerLevel->setCurrentIndex(settings.value("loggerLevel", _ui->comboBox_loggerLevel->currentIndex()).toInt());
 	_ui->comboBox_loggerEventLevel->setCurrentIndex(settings.value("loggerEventLevel", _ui->comboBox_loggerEventLevel->currentIndex()).toInt());
 	_ui->comboBox_loggerPauseLevel->setCurrentIndex(settings.value("loggerPauseLevel", _ui->comboBox_loggerPauseLevel->currentIndex()).toInt());
@@ -2638,6 +2644,8 @@ void PreferencesDialog::writeGuiSettings(const QString & filePath) const
 	settings.remove("");
 	settings.setValue("imagesKept",           _ui->general_checkBox_imagesKept->isChecked());
 	settings.setValue("cloudsKept",           _ui->general_checkBox_cloudsKept->isChecked());
+	settings.setValue("cloudsBackground",     _ui->general_checkBox_cloudsBackground->isChecked());
+	settings.setValue("cloudsLodDistance",    _ui->general_doubleSpinBox_cloudsLodDistance->value());
 	settings.setValue("loggerLevel",          _ui->comboBox_loggerLevel->currentIndex());
 	settings.setValue("loggerEventLevel",     _ui->comboBox_loggerEventLevel->currentIndex());
 	settings.setValue("loggerPauseLevel",     _ui->comboBox_loggerPauseLevel->currentIndex());
@@ -6077,6 +6085,14 @@ bool PreferencesDialog::isCloudsKept() const
 {
 	return _ui->general_checkBox_cloudsKept->isChecked();
 }
+bool PreferencesDialog::isCloudsBackgroundGenerated() const
+{
+	return _ui->general_checkBox_cloudsBackground->isChecked();
+}
+double PreferencesDialog::getCloudLodDistance() const
+{
+	return _ui->general_doubleSpinBox_cloudsLodDistance->value();
+}
 float PreferencesDialog::getTimeLimit() const
 {
 	return _ui->general_doubleSpinBox_timeThr->value();
@@ -0,0 +1,1606 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/Rtabmap.h"
+#include "rtabmap/core/Odometry.h"
+#include "rtabmap/core/OdometryInfo.h"
+#include "rtabmap/core/OdometryEvent.h"
+#include "rtabmap/core/CameraRGBD.h"
+#include "rtabmap/core/CameraStereo.h"
+#include "rtabmap/core/CameraThread.h"
+#include "rtabmap/core/DBReader.h"
+#include "rtabmap/core/DBDriverSqlite3.h"
+#include "rtabmap/core/Memory.h"
+#include "rtabmap/core/Optimizer.h"
+#include "rtabmap/core/Graph.h"
+#include "rtabmap/core/util3d.h"
+#include "rtabmap/core/util3d_filtering.h"
+#include "rtabmap/core/util3d_surface.h"
+#include "rtabmap/utilite/UConversion.h"
+#include "rtabmap/utilite/UDirectory.h"
+#include "rtabmap/utilite/UFile.h"
+#include "rtabmap/utilite/UStl.h"
+#include "rtabmap/utilite/UTimer.h"
+#include "rtabmap/utilite/UProcessInfo.h"
+#include <pcl/common/io.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"rtabmap-benchmark [options] database.db\n"
+			"rtabmap-benchmark [options] --rgbd rgb_path depth_path\n"
+			"rtabmap-benchmark [options] --stereo left_path right_path\n"
+			"  Replay a database or a sequence of images through odometry and RTAB-Map\n"
+			"  with a fixed set of parameters, then report latency percentiles of each\n"
+			"  processing stage, throughput, peak RSS and CPU utilization.\n"
+			"Options:\n"
+			"  --rgbd rgb depth     Replay RGB-D images (see --calib and --depth_scale).\n"
+			"  --stereo left right  Replay rectified stereo images (see --calib).\n"
+			"  --calib file.yaml    Calibration file of the images.\n"
+			"  --depth_scale #      Depth scale factor of the depth images (default 1).\n"
+			"  --db_odom            Use odometry saved in the database instead of computing it.\n"
+			"  --max_frames #       Stop after X frames (default 0=all).\n"
+			"  --warmup #           Don't include the first X frames in statistics (default 0).\n"
+			"  --output_db path     Save the resulting map in this database (default in memory).\n"
+			"  --json path          Write results in JSON to this file (default stdout only).\n"
+			"  --baseline path      Compare results with a JSON file previously written by this tool.\n"
+			"                       Exit code is 2 if a regression is detected. Stages of the\n"
+			"                       baseline missing from the current run are regressions.\n"
+			"  --latency_thr #      Maximum latency increase of p50/p95/p99 in %% (default 10).\n"
+			"  --latency_min #      Ignore stages with baseline p50 under X ms (default 1).\n"
+			"  --throughput_thr #   Maximum throughput decrease in %% (default 10).\n"
+			"  --rss_thr #          Maximum peak RSS increase in %% (default 10).\n"
+			"  --stages \"a;b\"       Only compare these stages (default all).\n"
+			"  --no_db_queries      Don't replay the per-node database queries with and without\n"
+			"                       the statement cache (done on --output_db or the input database).\n"
+			"  --neighbors #        Get the neighbors of the last node of --output_db or of the input\n"
+			"                       database loading up to X nodes from LTM, with and without the\n"
+			"                       statement cache (default 1000, 0=disabled). Only nodes in LTM are\n"
+			"                       loaded, see Rtabmap/MemoryThr.\n"
+			"  --optimizer_nodes #  Replay the graph of the first X nodes (of --output_db or the input\n"
+			"                       database) node by node, optimizing it with the persistent graph of\n"
+			"                       the optimizer (%s) at each node and also in batch on\n"
+			"                       loop closures (default 10000, 0=disabled).\n"
+			"  --optimizer_synthetic #  Same as --optimizer_nodes on a generated graph of X nodes with\n"
+			"                       loop closures, e.g. 10000 for the size of KITTI 00 (default 0=disabled).\n"
+			"  --localization #     Relocalize the first X frames of --output_db or of the input database\n"
+			"                       on itself, with and without Mem/LocalizationFastPath (default 0=disabled).\n"
+			"  --transfer_wm #      Compare selection of nodes to transfer from a working memory of\n"
+			"                       X nodes using the transfer index and a linear scan (default 10000,\n"
+			"                       0=disabled).\n"
+			"  --map_clouds #       Generate the clouds with normals of the first X nodes of --output_db\n"
+			"                       or of the input database like the 3D Map of the GUI, then update\n"
+			"                       their level of detail at each node of the trajectory like at 30 Hz\n"
+			"                       (default 0=disabled, rendering is not included).\n"
+			"  --quiet              Don't show log messages and iteration updates.\n"
+			"%s\n"
+			"Example:\n\n"
+			"   $ rtabmap-benchmark --json current.json --baseline baseline.json \\\n"
+			"       --Mem/STMSize 30 \\\n"
+			"       rtabmap.db\n\n", rtabmap::Parameters::kOptimizerIncremental().c_str(), rtabmap::Parameters::showUsage());
+	exit(1);
+}
+
+// catch ctrl-c
+bool g_forever = true;
+void sighandler(int sig)
+{
+	printf("\nSignal %d caught...\n", sig);
+	g_forever = false;
+}
+
+struct StageStats
+{
+	StageStats() :
+		count(0),
+		mean(0.0f),
+		p50(0.0f),
+		p95(0.0f),
+		p99(0.0f),
+		max(0.0f)
+	{}
+	int count;
+	float mean;
+	float p50;
+	float p95;
+	float p99;
+	float max;
+};
+
+// Nearest-rank percentile, values should be sorted
+float percentile(const std::vector<float> & values, float p)
+{
+	if(values.empty())
+	{
+		return 0.0f;
+	}
+	int rank = (int)std::ceil(p/100.0f * float(values.size()));
+	rank = rank<1?1:rank>(int)values.size()?(int)values.size():rank;
+	return values[rank-1];
+}
+
+StageStats computeStats(std::vector<float> values)
+{
+	StageStats stats;
+	if(values.size())
+	{
+		std::sort(values.begin(), values.end());
+		stats.count = (int)values.size();
+		double sum = 0.0;
+		for(size_t i=0; i<values.size(); ++i)
+		{
+			sum += values[i];
+		}
+		stats.mean = float(sum / double(values.size()));
+		stats.p50 = percentile(values, 50.0f);
+		stats.p95 = percentile(values, 95.0f);
+		stats.p99 = percentile(values, 99.0f);
+		stats.max = values.back();
+	}
+	return stats;
+}
+
+// Minimal JSON reader for baseline files: only "throughput_fps", "peak_rss_mb"
+// and "stages" are extracted, other values are skipped whatever their type.
+// Keys can be in any order and the file can be reformatted.
+class BaselineParser
+{
+public:
+	BaselineParser(const std::string & text) : text_(text), pos_(0) {}
+
+	bool parse(
+			std::map<std::string, StageStats> & stages,
+			float & throughput,
+			float & peakRss)
+	{
+		if(!consume('{'))
+		{
+			return false;
+		}
+		if(consume('}'))
+		{
+			return true;
+		}
+		do
+		{
+			std::string key;
+			if(!parseString(key) || !consume(':'))
+			{
+				return false;
+			}
+			if(key == "throughput_fps" || key == "peak_rss_mb")
+			{
+				double value = 0.0;
+				if(!parseNumber(value))
+				{
+					return false;
+				}
+				(key == "throughput_fps"?throughput:peakRss) = (float)value;
+			}
+			else if(key == "stages")
+			{
+				if(!consume('{'))
+				{
+					return false;
+				}
+				if(!consume('}'))
+				{
+					do
+					{
+						std::string name;
+						StageStats stats;
+						if(!parseString(name) || !consume(':') || !parseStage(stats))
+						{
+							return false;
+						}
+						stages[name] = stats;
+					}
+					while(consume(','));
+					if(!consume('}'))
+					{
+						return false;
+					}
+				}
+			}
+			else if(!skipValue())
+			{
+				return false;
+			}
+		}
+		while(consume(','));
+		return consume('}');
+	}
+
+private:
+	void skipSpaces()
+	{
+		while(pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\n' || text_[pos_] == '\r'))
+		{
+			++pos_;
+		}
+	}
+	bool consume(char c)
+	{
+		skipSpaces();
+		if(pos_ < text_.size() && text_[pos_] == c)
+		{
+			++pos_;
+			return true;
+		}
+		return false;
+	}
+	bool consumeLiteral(const char * literal)
+	{
+		skipSpaces();
+		size_t size = strlen(literal);
+		if(text_.compare(pos_, size, literal) == 0)
+		{
+			pos_ += size;
+			return true;
+		}
+		return false;
+	}
+	bool parseString(std::string & value)
+	{
+		if(!consume('"'))
+		{
+			return false;
+		}
+		value.clear();
+		while(pos_ < text_.size())
+		{
+			char c = text_[pos_++];
+			if(c == '"')
+			{
+				return true;
+			}
+			if(c != '\\')
+			{
+				value += c;
+				continue;
+			}
+			if(pos_ >= text_.size())
+			{
+				return false;
+			}
+			c = text_[pos_++];
+			switch(c)
+			{
+			case 'b': value += '\b'; break;
+			case 'f': value += '\f'; break;
+			case 'n': value += '\n'; break;
+			case 'r': value += '\r'; break;
+			case 't': value += '\t'; break;
+			case 'u':
+			{
+				if(pos_ + 4 > text_.size())
+				{
+					return false;
+				}
+				char * end = 0;
+				std::string hex = text_.substr(pos_, 4);
+				unsigned long code = strtoul(hex.c_str(), &end, 16);
+				if(end != hex.c_str() + 4)
+				{
+					return false;
+				}
+				pos_ += 4;
+				// UTF-8, surrogate pairs are not combined
+				if(code < 0x80)
+				{
+					value += (char)code;
+				}
+				else if(code < 0x800)
+				{
+					value += (char)(0xC0 | (code >> 6));
+					value += (char)(0x80 | (code & 0x3F));
+				}
+				else
+				{
+					value += (char)(0xE0 | (code >> 12));
+					value += (char)(0x80 | ((code >> 6) & 0x3F));
+					value += (char)(0x80 | (code & 0x3F));
+				}
+				break;
+			}
+			default: value += c; break; // '"', '\\' and '/'
+			}
+		}
+		return false;
+	}
+	bool parseNumber(double & value)
+	{
+		skipSpaces();
+		const char * start = text_.c_str() + pos_;
+		char * end = 0;
+		value = strtod(start, &end);
+		if(end == start)
+		{
+			return false;
+		}
+		pos_ += end - start;
+		return true;
+	}
+	bool parseStage(StageStats & stats)
+	{
+		if(!consume('{'))
+		{
+			return false;
+		}
+		if(consume('}'))
+		{
+			return true;
+		}
+		do
+		{
+			std::string key;
+			if(!parseString(key) || !consume(':'))
+			{
+				return false;
+			}
+			double value = 0.0;
+			if(key == "count" || key == "mean" || key == "p50" || key == "p95" || key == "p99" || key == "max")
+			{
+				if(!parseNumber(value))
+				{
+					return false;
+				}
+				if(key == "count") stats.count = (int)value;
+				else if(key == "mean") stats.mean = (float)value;
+				else if(key == "p50") stats.p50 = (float)value;
+				else if(key == "p95") stats.p95 = (float)value;
+				else if(key == "p99") stats.p99 = (float)value;
+				else stats.max = (float)value;
+			}
+			else if(!skipValue())
+			{
+				return false;
+			}
+		}
+		while(consume(','));
+		return consume('}');
+	}
+	bool skipValue()
+	{
+		skipSpaces();
+		if(pos_ >= text_.size())
+		{
+			return false;
+		}
+		char c = text_[pos_];
+		if(c == '{' || c == '[')
+		{
+			char close = c=='{'?'}':']';
+			++pos_;
+			if(consume(close))
+			{
+				return true;
+			}
+			do
+			{
+				std::string key;
+				if((c == '{' && (!parseString(key) || !consume(':'))) || !skipValue())
+				{
+					return false;
+				}
+			}
+			while(consume(','));
+			return consume(close);
+		}
+		if(c == '"')
+		{
+			std::string value;
+			return parseString(value);
+		}
+		if(consumeLiteral("true") || consumeLiteral("false") || consumeLiteral("null"))
+		{
+			return true;
+		}
+		double value;
+		return parseNumber(value);
+	}
+
+	const std::string & text_;
+	size_t pos_;
+};
+
+bool readBaseline(
+		const std::string & path,
+		std::map<std::string, StageStats> & stages,
+		float & throughput,
+		float & peakRss)
+{
+	FILE * file = fopen(path.c_str(), "rb");
+	if(!file)
+	{
+		return false;
+	}
+	std::string text;
+	char buffer[4096];
+	size_t size;
+	while((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		text.append(buffer, size);
+	}
+	fclose(file);
+
+	BaselineParser parser(text);
+	if(!parser.parse(stages, throughput, peakRss))
+	{
+		UERROR("Baseline \"%s\" is not a valid JSON file.", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Replay the per-node queries done when nodes are reactivated from LTM,
+// with and without cached prepared statements.
+void benchmarkDatabaseQueries(
+		const std::string & url,
+		std::map<std::string, std::vector<float> > & stageValues)
+{
+	ParametersMap parameters;
+	parameters.insert(ParametersPair(Parameters::kDbSqlite3ReadOnly(), "true"));
+	DBDriverSqlite3 driver(parameters);
+	if(!driver.openConnection(url, false))
+	{
+		UERROR("Cannot open database \"%s\" for query benchmark.", url.c_str());
+		return;
+	}
+	std::set<int> ids;
+	driver.getAllNodeIds(ids);
+
+	const char * names[3] = {0, "Database/StatementCache/ms", "Database/NoStatementCache/ms"};
+	for(int pass=0; pass<3; ++pass) // first pass is to warm up the OS cache
+	{
+		driver.setStatementCache(pass != 2);
+		for(std::set<int>::iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+		{
+			UTimer timer;
+			Transform pose, groundTruth;
+			int mapId, weight, ni;
+			std::string label;
+			double stamp;
+			std::vector<float> velocity;
+			GPS gps;
+			EnvSensors sensors;
+			std::multimap<int, Link> links;
+			driver.getNodeInfo(*iter, pose, mapId, weight, label, stamp, groundTruth, velocity, gps, sensors);
+			driver.getWeight(*iter, weight);
+			driver.getInvertedIndexNi(*iter, ni);
+			driver.loadLinks(*iter, links);
+			if(names[pass])
+			{
+				stageValues[names[pass]].push_back(timer.ticks()*1000.0f);
+			}
+		}
+	}
+	UINFO("Statement cache: hits=%ld misses=%ld", driver.getStatementCacheHits(), driver.getStatementCacheMisses());
+	driver.closeConnection(false);
+}
+
+// Traverse the graph from the last node of the database with Memory::getNeighborsId(),
+// loading the links of up to maxCheckedInDatabase nodes from LTM, with and without
+// cached prepared statements.
+void benchmarkNeighbors(
+		const std::string & url,
+		const ParametersMap & parameters,
+		int maxCheckedInDatabase,
+		std::map<std::string, std::vector<float> > & stageValues)
+{
+	const int iterations = 10;
+	const char * names[3] = {0, "Memory/GetNeighborsId/StatementCache/", "Memory/GetNeighborsId/NoStatementCache/"};
+	for(int pass=0; pass<3; ++pass) // first pass is to warm up the OS cache
+	{
+		ParametersMap memoryParameters = parameters;
+		uInsert(memoryParameters, ParametersPair(Parameters::kDbSqlite3ReadOnly(), "true"));
+		uInsert(memoryParameters, ParametersPair(Parameters::kDbSqlite3StatementCache(), uBool2Str(pass != 2)));
+		uInsert(memoryParameters, ParametersPair(Parameters::kMemInitWMWithAllNodes(), "false"));
+		Memory memory(memoryParameters);
+		if(!memory.init(url, false, memoryParameters))
+		{
+			UERROR("Cannot open database \"%s\" for neighbors benchmark.", url.c_str());
+			return;
+		}
+		int rootId = memory.getLastSignatureId();
+		for(int i=0; i<iterations && rootId>0 && g_forever; ++i)
+		{
+			double dbAccessTime = 0.0;
+			UTimer timer;
+			std::map<int, int> neighbors = memory.getNeighborsId(rootId, 0, maxCheckedInDatabase, true, false, false, false, std::set<int>(), &dbAccessTime);
+			if(names[pass])
+			{
+				stageValues[std::string(names[pass]) + "ms"].push_back(timer.ticks()*1000.0f);
+				stageValues[std::string(names[pass]) + "db_ms"].push_back(dbAccessTime*1000.0f);
+			}
+			if(i == 0 && pass == 0)
+			{
+				UINFO("Neighbors of %d: %d nodes (max LTM checked=%d)", rootId, (int)neighbors.size(), maxCheckedInDatabase);
+				if(dbAccessTime == 0.0)
+				{
+					UWARN("No neighbor of %d was loaded from LTM, all nodes of \"%s\" are in WM "
+						  "(use a map created with Rtabmap/MemoryThr or Rtabmap/TimeThr).", rootId, url.c_str());
+				}
+			}
+		}
+		memory.close(false);
+	}
+}
+
+// Replay a graph node by node like in mapping mode. The persistent graph of the
+// optimizer is updated at each node, and when loop closures are added, the
+// persistent and batch optimizations are both timed on the same graph.
+void replayGraphOptimization(
+		const std::map<int, Transform> & odomPoses,
+		const std::multimap<int, Link> & allLinks,
+		const ParametersMap & parameters,
+		std::map<std::string, std::vector<float> > & stageValues)
+{
+	// Links between replayed nodes, indexed by their most recent node.
+	// Priors and gravity links are ignored as they are optimized in batch anyway.
+	std::multimap<int, Link> links;
+	std::multimap<int, Link> uniqueLinks;
+	for(std::multimap<int, Link>::const_iterator iter=allLinks.begin(); iter!=allLinks.end(); ++iter)
+	{
+		const Link & link = iter->second;
+		if(link.from() != link.to() &&
+		   odomPoses.find(link.from()) != odomPoses.end() &&
+		   odomPoses.find(link.to()) != odomPoses.end() &&
+		   graph::findLink(uniqueLinks, link.from(), link.to(), true) == uniqueLinks.end())
+		{
+			uniqueLinks.insert(*iter);
+			links.insert(std::make_pair(link.from()>link.to()?link.from():link.to(), link));
+		}
+	}
+	if(odomPoses.size() < 2 || links.empty())
+	{
+		return;
+	}
+
+	ParametersMap optimizerParameters = parameters;
+	uInsert(optimizerParameters, ParametersPair(Parameters::kOptimizerIncremental(), "true"));
+	Optimizer * persistent = Optimizer::create(optimizerParameters);
+	uInsert(optimizerParameters, ParametersPair(Parameters::kOptimizerIncremental(), "false"));
+	Optimizer * batch = Optimizer::create(optimizerParameters);
+
+	int rootId = odomPoses.begin()->first;
+	std::map<int, Transform> poses;
+	std::multimap<int, Link> graphLinks;
+	std::map<int, Transform>::const_iterator previous = odomPoses.end();
+	int loopClosures = 0;
+	for(std::map<int, Transform>::const_iterator iter=odomPoses.begin(); iter!=odomPoses.end() && g_forever; ++iter)
+	{
+		// new pose from odometry, relative to the last optimized pose of the previous node
+		if(previous == odomPoses.end())
+		{
+			poses.insert(*iter);
+		}
+		else
+		{
+			poses.insert(std::make_pair(iter->first, poses.at(previous->first) * previous->second.inverse() * iter->second));
+		}
+		previous = iter;
+		bool loopClosure = false;
+		std::pair<std::multimap<int, Link>::iterator, std::multimap<int, Link>::iterator> range = links.equal_range(iter->first);
+		for(std::multimap<int, Link>::iterator jter=range.first; jter!=range.second; ++jter)
+		{
+			graphLinks.insert(std::make_pair(jter->second.from(), jter->second));
+			loopClosure = loopClosure || jter->second.type() != Link::kNeighbor;
+		}
+		if(graphLinks.empty())
+		{
+			continue;
+		}
+
+		std::map<int, Transform> posesIn;
+		std::multimap<int, Link> linksIn;
+		batch->getConnectedGraph(rootId, poses, graphLinks, posesIn, linksIn);
+		if(posesIn.size() < 2)
+		{
+			continue;
+		}
+
+		cv::Mat covariance;
+		UTimer timer;
+		std::map<int, Transform> optimizedPoses = persistent->optimizePersistent(rootId, posesIn, linksIn, covariance);
+		float persistentTime = timer.ticks()*1000.0f;
+		stageValues["Optimizer/Persistent/ms"].push_back(persistentTime);
+		stageValues["Optimizer/PersistentUpdate/ms"].push_back(persistent->persistentUpdateTime()*1000.0f);
+		if(loopClosure)
+		{
+			// batch optimization is only timed on loop closures, it would be too long on every node of large graphs
+			stageValues["Optimizer/PersistentLoopClosure/ms"].push_back(persistentTime);
+			batch->optimize(rootId, posesIn, linksIn, covariance);
+			stageValues["Optimizer/Batch/ms"].push_back(timer.ticks()*1000.0f);
+			++loopClosures;
+		}
+
+		for(std::map<int, Transform>::iterator jter=optimizedPoses.begin(); jter!=optimizedPoses.end(); ++jter)
+		{
+			poses.at(jter->first) = jter->second;
+		}
+	}
+	printf("Graph optimization: %d nodes, %d links, %d loop closures replayed.\n",
+			(int)poses.size(), (int)graphLinks.size(), loopClosures);
+	delete persistent;
+	delete batch;
+}
+
+// Replay the graph of the first nodes of the database.
+void benchmarkGraphOptimization(
+		const std::string & url,
+		const ParametersMap & parameters,
+		int maxNodes,
+		std::map<std::string, std::vector<float> > & stageValues)
+{
+	ParametersMap dbParameters;
+	dbParameters.insert(ParametersPair(Parameters::kDbSqlite3ReadOnly(), "true"));
+	DBDriverSqlite3 driver(dbParameters);
+	if(!driver.openConnection(url, false))
+	{
+		UERROR("Cannot open database \"%s\" for optimization benchmark.", url.c_str());
+		return;
+	}
+	std::set<int> ids;
+	driver.getAllNodeIds(ids, true, true);
+	std::map<int, Transform> odomPoses;
+	for(std::set<int>::iterator iter=ids.begin(); iter!=ids.end() && (int)odomPoses.size()<maxNodes; ++iter)
+	{
+		Transform pose, groundTruth;
+		int mapId, weight;
+		std::string label;
+		double stamp;
+		std::vector<float> velocity;
+		GPS gps;
+		EnvSensors sensors;
+		if(driver.getNodeInfo(*iter, pose, mapId, weight, label, stamp, groundTruth, velocity, gps, sensors) && !pose.isNull())
+		{
+			odomPoses.insert(std::make_pair(*iter, pose));
+		}
+	}
+	std::multimap<int, Link> allLinks;
+	driver.getAllLinks(allLinks, true, false);
+	driver.closeConnection(false);
+
+	replayGraphOptimization(odomPoses, allLinks, parameters, stageValues);
+}
+
+// Replay a graph of the size of KITTI or TUM sequences: a car driving along the
+// streets of a row of blocks (1 m between nodes), going up, across and down each
+// block, then coming back the other way, with drifting odometry. A loop closure
+// is added every 50 nodes when a node older than 100 nodes is closer than 2 m.
+void benchmarkGraphOptimizationSynthetic(
+		int nodes,
+		const ParametersMap & parameters,
+		std::map<std::string, std::vector<float> > & stageValues)
+{
+	const int blockSize = 100;
+	const int blocks = 3;
+	srand(0);
+	std::vector<Transform> groundTruth(nodes);
+	std::map<int, Transform> odomPoses;
+	std::multimap<int, Link> links;
+	cv::Mat odomInformation = cv::Mat::eye(6,6,CV_64FC1)*100.0;
+	cv::Mat loopInformation = cv::Mat::eye(6,6,CV_64FC1)*1000.0;
+	for(int i=0; i<nodes; ++i)
+	{
+		int lap = i / (3*blockSize);
+		int pass = lap / blocks;
+		int side = (i % (3*blockSize)) / blockSize;
+		float d = float(i % blockSize);
+		float direction = pass%2==0?1.0f:-1.0f;
+		float x0 = float(pass%2==0?lap%blocks:blocks-lap%blocks) * float(blockSize);
+		if(side == 0)
+		{
+			groundTruth[i] = Transform(x0, d, 0.0f, 0.0f, 0.0f, float(M_PI/2.0));
+		}
+		else if(side == 1)
+		{
+			groundTruth[i] = Transform(x0 + direction*d, float(blockSize), 0.0f, 0.0f, 0.0f, direction>0.0f?0.0f:float(M_PI));
+		}
+		else
+		{
+			groundTruth[i] = Transform(x0 + direction*float(blockSize), float(blockSize)-d, 0.0f, 0.0f, 0.0f, float(-M_PI/2.0));
+		}
+
+		if(i == 0)
+		{
+			odomPoses.insert(std::make_pair(i+1, groundTruth[i]));
+		}
+		else
+		{
+			Transform motion = groundTruth[i-1].inverse() * groundTruth[i];
+			float noise = 0.01f * (float(rand())/float(RAND_MAX) - 0.5f);
+			Transform odomMotion = motion * Transform(noise, 0.0f, 0.0f, 0.0f, 0.0f, noise*0.1f);
+			odomPoses.insert(std::make_pair(i+1, odomPoses.at(i) * odomMotion));
+			links.insert(std::make_pair(i, Link(i, i+1, Link::kNeighbor, odomMotion, odomInformation)));
+		}
+
+		if(i % 50 == 0)
+		{
+			for(int j=0; j<i-100; ++j)
+			{
+				if(groundTruth[j].getDistance(groundTruth[i]) < 2.0f)
+				{
+					links.insert(std::make_pair(j+1, Link(j+1, i+1, Link::kGlobalClosure, groundTruth[j].inverse() * groundTruth[i], loopInformation)));
+					break;
+				}
+			}
+		}
+	}
+
+	replayGraphOptimization(odomPoses, links, parameters, stageValues);
+}
+
+// Replay the first frames of the database in localization mode on the map of the
+// same database, with the normal path and with Mem/LocalizationFastPath. Stages
+// updated by the fast path are recorded for both, and the loop closures found
+// are compared frame by frame.
+void benchmarkLocalizationFastPath(
+		const std::string & url,
+		const ParametersMap & parameters,
+		int maxFrames,
+		std::map<std::string, std::vector<float> > & stageValues)
+{
+	const char * names[2] = {"Localization/Normal/", "Localization/FastPath/"};
+	std::string timings[4] = {
+			Statistics::kTimingMemAdd_new_words(),
+			Statistics::kTimingMemCompressing_data(),
+			Statistics::kTimingLikelihood_computation(),
+			Statistics::kTimingMemSignature_creation()};
+	std::vector<int> loopIds[2];
+	for(int pass=0; pass<2; ++pass)
+	{
+		ParametersMap localizationParameters = parameters;
+		uInsert(localizationParameters, ParametersPair(Parameters::kMemIncrementalMemory(), "false"));
+		uInsert(localizationParameters, ParametersPair(Parameters::kMemLocalizationDataSaved(), "false"));
+		uInsert(localizationParameters, ParametersPair(Parameters::kMemLocalizationFastPath(), uBool2Str(pass==1)));
+
+		DBReader reader(url, 0.0f, false);
+		if(!reader.init())
+		{
+			UERROR("Cannot open database \"%s\" for localization benchmark.", url.c_str());
+			return;
+		}
+		Rtabmap rtabmap;
+		rtabmap.init(localizationParameters, url);
+		CameraInfo info;
+		SensorData data = reader.takeImage(&info);
+		for(int i=0; data.isValid() && g_forever && i<maxFrames; ++i)
+		{
+			UTimer timer;
+			rtabmap.process(data, info.odomPose, info.odomCovariance);
+			stageValues[std::string(names[pass]) + "Process/ms"].push_back(timer.ticks()*1000.0f);
+			const std::map<std::string, float> & stats = rtabmap.getStatistics().data();
+			for(int j=0; j<4; ++j)
+			{
+				std::map<std::string, float>::const_iterator iter = stats.find(timings[j]);
+				if(iter != stats.end())
+				{
+					stageValues[std::string(names[pass]) + timings[j]].push_back(iter->second);
+				}
+			}
+			loopIds[pass].push_back(rtabmap.getLoopClosureId());
+			info = CameraInfo();
+			data = reader.takeImage(&info);
+		}
+		rtabmap.close(false);
+	}
+
+	int differences = 0;
+	for(size_t i=0; i<loopIds[0].size() && i<loopIds[1].size(); ++i)
+	{
+		differences += loopIds[0][i] != loopIds[1][i]?1:0;
+	}
+	printf("Localization fast path: %d/%d frames localized differently than the normal path.\n",
+			differences, (int)std::min(loopIds[0].size(), loopIds[1].size()));
+}
+
+// Generate the clouds of the first nodes of the database like the 3D Map of the
+// GUI with its default options (decimation 4, max depth 4 m, normals with K=10),
+// then replay the map updates of a robot going along the trajectory: at each
+// update, the level of detail of all clouds is recomputed relative to the current
+// pose (LOD distance of 2 m) and the clouds changing of level are decimated again,
+// which is what MainWindow does in the GUI thread. VTK rendering is not included.
+// To bound memory, the clouds of the first 500 nodes are reused for the others.
+void benchmarkMapClouds(
+		const std::string & url,
+		const ParametersMap & parameters,
+		int maxNodes,
+		std::map<std::string, std::vector<float> > & stageValues)
+{
+	const unsigned int maxClouds = 500;
+	const double lodDistance = 2.0;
+	const float updatePeriod = 1000.0f/30.0f;
+
+	ParametersMap dbParameters;
+	dbParameters.insert(ParametersPair(Parameters::kDbSqlite3ReadOnly(), "true"));
+	DBDriverSqlite3 driver(dbParameters);
+	if(!driver.openConnection(url, false))
+	{
+		UERROR("Cannot open database \"%s\" for map clouds benchmark.", url.c_str());
+		return;
+	}
+	std::set<int> ids;
+	driver.getAllNodeIds(ids, true, true);
+	std::vector<Transform> poses;
+	std::vector<pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr> clouds;
+	long points = 0;
+	for(std::set<int>::iterator iter=ids.begin(); iter!=ids.end() && (int)poses.size()<maxNodes && g_forever; ++iter)
+	{
+		Transform pose, groundTruth;
+		int mapId, weight;
+		std::string label;
+		double stamp;
+		std::vector<float> velocity;
+		GPS gps;
+		EnvSensors sensors;
+		if(!driver.getNodeInfo(*iter, pose, mapId, weight, label, stamp, groundTruth, velocity, gps, sensors) || pose.isNull())
+		{
+			continue;
+		}
+		SensorData data;
+		driver.getNodeData(*iter, data, true, false, false, false);
+
+		UTimer timer;
+		cv::Mat image, depth;
+		data.uncompressData(&image, &depth, 0);
+		pcl::IndicesPtr indices(new std::vector<int>);
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = util3d::cloudRGBFromSensorData(data, 4, 4.0f, 0.0f, indices.get(), parameters);
+		if(indices->empty())
+		{
+			continue;
+		}
+		Eigen::Vector3f viewPoint(0.0f,0.0f,0.0f);
+		if(data.cameraModels().size() && !data.cameraModels()[0].localTransform().isNull())
+		{
+			viewPoint[0] = data.cameraModels()[0].localTransform().x();
+			viewPoint[1] = data.cameraModels()[0].localTransform().y();
+			viewPoint[2] = data.cameraModels()[0].localTransform().z();
+		}
+		pcl::PointCloud<pcl::Normal>::Ptr normals = util3d::computeNormals(cloud, indices, 10, 0.0f, viewPoint);
+		pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudWithNormals(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+		pcl::concatenateFields(*cloud, *normals, *cloudWithNormals);
+		cloudWithNormals = util3d::extractIndices(cloudWithNormals, indices, false, false);
+		stageValues["MapClouds/Generation/ms"].push_back(timer.ticks()*1000.0f);
+
+		poses.push_back(pose);
+		clouds.push_back(clouds.size()<maxClouds?cloudWithNormals:clouds[clouds.size()%maxClouds]);
+		points += (long)clouds.back()->size();
+	}
+	driver.closeConnection(false);
+	if(poses.size() < 2)
+	{
+		return;
+	}
+
+	std::vector<int> lods(clouds.size(), 0);
+	std::vector<pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr> shown = clouds;
+	int late = 0;
+	long shownPoints = 0;
+	for(size_t i=0; i<poses.size() && g_forever; ++i)
+	{
+		UTimer timer;
+		for(size_t j=0; j<clouds.size(); ++j)
+		{
+			// same as MainWindow::getCloudLod() and MainWindow::addLodCloudToMap()
+			float distance = poses[j].getDistance(poses[i]);
+			double lodDistanceLevel = lodDistance;
+			int lod = 0;
+			while(lod < 3 && distance > lodDistanceLevel)
+			{
+				++lod;
+				lodDistanceLevel *= 2.0;
+			}
+			if(lod != lods[j])
+			{
+				if(lod > 0)
+				{
+					int step = 1 << lod;
+					shown[j].reset(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+					shown[j]->reserve(clouds[j]->size()/step+1);
+					for(unsigned int k=0; k<clouds[j]->size(); k+=step)
+					{
+						shown[j]->push_back(clouds[j]->at(k));
+					}
+				}
+				else
+				{
+					shown[j] = clouds[j];
+				}
+				lods[j] = lod;
+			}
+		}
+		float time = timer.ticks()*1000.0f;
+		stageValues["MapClouds/LodUpdate/ms"].push_back(time);
+		if(time > updatePeriod)
+		{
+			++late;
+		}
+	}
+	for(size_t j=0; j<shown.size(); ++j)
+	{
+		shownPoints += (long)shown[j]->size();
+	}
+	printf("Map clouds: %d nodes, %d/%d updates over the 30 Hz period, %ld/%ld points shown at the last update (rendering not included).\n",
+			(int)poses.size(), late, (int)poses.size(), shownPoints, points);
+}
+
+// Transfer priority of WM nodes, same order as in Memory:
+// less weighted first, then oldest, then smallest id
+struct TransferKey
+{
+	TransferKey(int w, int a, int i) :
+		weight(w),
+		age(a),
+		id(i){}
+	bool operator<(const TransferKey & k) const
+	{
+		return weight < k.weight || (weight == k.weight && (age < k.age || (age == k.age && id < k.id)));
+	}
+	int weight, age, id;
+};
+
+// Simulate transfers of a WM of wmSize nodes: at each iteration, some nodes
+// are rehearsed (weight and age updated), the lowest priority nodes are selected
+// and transferred, then new nodes are added. Selection is done with the ordered
+// index updated incrementally (as in Memory) and with the previous linear scan
+// sorting all WM.
+void benchmarkTransferSelection(
+		int wmSize,
+		std::map<std::string, std::vector<float> > & stageValues)
+{
+	const int iterations = 200;
+	const int rehearsed = 10;
+	const int transferred = 10;
+
+	srand(0);
+	std::map<int, std::pair<int, int> > workingMem; // <id, <weight, age> >
+	std::set<TransferKey> index;
+	std::map<int, std::set<TransferKey>::iterator> indexIters;
+	int nextId = 1;
+	int time = 0;
+	for(; nextId<=wmSize; ++nextId)
+	{
+		int weight = rand()%10;
+		workingMem.insert(std::make_pair(nextId, std::make_pair(weight, time)));
+		indexIters.insert(std::make_pair(nextId, index.insert(TransferKey(weight, time, nextId)).first));
+	}
+
+	for(int i=0; i<iterations; ++i)
+	{
+		++time;
+		std::vector<int> rehearsedIds(rehearsed);
+		for(int j=0; j<rehearsed; ++j)
+		{
+			std::map<int, std::pair<int, int> >::iterator iter = workingMem.lower_bound(nextId - 1 - rand()%wmSize);
+			if(iter == workingMem.end())
+			{
+				--iter;
+			}
+			rehearsedIds[j] = iter->first;
+			++iter->second.first;
+			iter->second.second = time;
+		}
+
+		// Previous implementation: sort all WM, then take the first ones
+		UTimer timer;
+		std::map<TransferKey, int> sorted;
+		for(std::map<int, std::pair<int, int> >::iterator iter=workingMem.begin(); iter!=workingMem.end(); ++iter)
+		{
+			sorted.insert(std::make_pair(TransferKey(iter->second.first, iter->second.second, iter->first), iter->first));
+		}
+		std::vector<int> selectedScan;
+		for(std::map<TransferKey, int>::iterator iter=sorted.begin(); iter!=sorted.end() && (int)selectedScan.size()<transferred; ++iter)
+		{
+			selectedScan.push_back(iter->second);
+		}
+		stageValues["Memory/TransferLinearScan/ms"].push_back(timer.ticks()*1000.0f);
+
+		// Transfer index: update rehearsed nodes, then take the first ones
+		for(int j=0; j<rehearsed; ++j)
+		{
+			std::map<int, std::set<TransferKey>::iterator>::iterator iter = indexIters.find(rehearsedIds[j]);
+			const std::pair<int, int> & value = workingMem.at(rehearsedIds[j]);
+			index.erase(iter->second);
+			iter->second = index.insert(TransferKey(value.first, value.second, rehearsedIds[j])).first;
+		}
+		std::vector<int> selectedIndex;
+		for(std::set<TransferKey>::iterator iter=index.begin(); iter!=index.end() && (int)selectedIndex.size()<transferred; ++iter)
+		{
+			selectedIndex.push_back(iter->id);
+		}
+		stageValues["Memory/TransferIndex/ms"].push_back(timer.ticks()*1000.0f);
+		UASSERT(selectedScan == selectedIndex);
+
+		// Transfer selected nodes and add new ones
+		for(size_t j=0; j<selectedIndex.size(); ++j)
+		{
+			workingMem.erase(selectedIndex[j]);
+			std::map<int, std::set<TransferKey>::iterator>::iterator iter = indexIters.find(selectedIndex[j]);
+			index.erase(iter->second);
+			indexIters.erase(iter);
+		}
+		for(int j=0; j<transferred; ++j, ++nextId)
+		{
+			workingMem.insert(std::make_pair(nextId, std::make_pair(0, time)));
+			indexIters.insert(std::make_pair(nextId, index.insert(TransferKey(0, time, nextId)).first));
+		}
+	}
+}
+
+std::string jsonEscape(const std::string & str)
+{
+	std::string escaped;
+	escaped.reserve(str.size());
+	for(size_t i=0; i<str.size(); ++i)
+	{
+		unsigned char c = (unsigned char)str[i];
+		switch(c)
+		{
+		case '"': escaped += "\\\""; break;
+		case '\\': escaped += "\\\\"; break;
+		case '\b': escaped += "\\b"; break;
+		case '\f': escaped += "\\f"; break;
+		case '\n': escaped += "\\n"; break;
+		case '\r': escaped += "\\r"; break;
+		case '\t': escaped += "\\t"; break;
+		default:
+			if(c < 0x20)
+			{
+				escaped += uFormat("\\u%04x", (int)c);
+			}
+			else
+			{
+				escaped += (char)c;
+			}
+			break;
+		}
+	}
+	return escaped;
+}
+
+void writeJson(
+		FILE * file,
+		const std::string & input,
+		const ParametersMap & parameters,
+		int frames,
+		int nodes,
+		double wallTime,
+		float throughput,
+		float peakRss,
+		float cpuUtilization,
+		const std::map<std::string, StageStats> & stages)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "  \"rtabmap_version\": \"%s\",\n", RTABMAP_VERSION);
+	fprintf(file, "  \"input\": \"%s\",\n", jsonEscape(input).c_str());
+	fprintf(file, "  \"frames\": %d,\n", frames);
+	fprintf(file, "  \"nodes\": %d,\n", nodes);
+	fprintf(file, "  \"wall_time_s\": %f,\n", wallTime);
+	fprintf(file, "  \"throughput_fps\": %f,\n", throughput);
+	fprintf(file, "  \"peak_rss_mb\": %f,\n", peakRss);
+	fprintf(file, "  \"cpu_utilization\": %f,\n", cpuUtilization);
+	fprintf(file, "  \"parameters\": {");
+	for(ParametersMap::const_iterator iter=parameters.begin(); iter!=parameters.end(); ++iter)
+	{
+		fprintf(file, "%s\n    \"%s\": \"%s\"", iter==parameters.begin()?"":",", jsonEscape(iter->first).c_str(), jsonEscape(iter->second).c_str());
+	}
+	fprintf(file, "\n  },\n");
+	fprintf(file, "  \"stages\": {");
+	for(std::map<std::string, StageStats>::const_iterator iter=stages.begin(); iter!=stages.end(); ++iter)
+	{
+		fprintf(file, "%s\n    \"%s\": {\"count\": %d, \"mean\": %f, \"p50\": %f, \"p95\": %f, \"p99\": %f, \"max\": %f}",
+				iter==stages.begin()?"":",",
+				jsonEscape(iter->first).c_str(),
+				iter->second.count,
+				iter->second.mean,
+				iter->second.p50,
+				iter->second.p95,
+				iter->second.p99,
+				iter->second.max);
+	}
+	fprintf(file, "\n  }\n");
+	fprintf(file, "}\n");
+}
+
+int main(int argc, char * argv[])
+{
+	signal(SIGABRT, &sighandler);
+	signal(SIGTERM, &sighandler);
+	signal(SIGINT, &sighandler);
+
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	if(argc < 2)
+	{
+		showUsage();
+	}
+
+	std::string input;
+	std::string rgbdPath[2];
+	std::string stereoPath[2];
+	std::string calibPath;
+	float depthScale = 1.0f;
+	bool dbOdom = false;
+	int maxFrames = 0;
+	int warmup = 0;
+	std::string outputDb;
+	std::string jsonPath;
+	std::string baselinePath;
+	float latencyThr = 10.0f;
+	float latencyMin = 1.0f;
+	float throughputThr = 10.0f;
+	float rssThr = 10.0f;
+	std::list<std::string> comparedStages;
+	bool quiet = false;
+	bool dbQueries = true;
+	int optimizerNodes = 10000;
+	int optimizerSynthetic = 0;
+	int transferWm = 10000;
+	int localizationFrames = 0;
+	int mapClouds = 0;
+	int neighbors = 1000;
+	for(int i=1; i<argc; ++i)
+	{
+		if(std::strcmp(argv[i], "--rgbd") == 0 && i+2 < argc)
+		{
+			rgbdPath[0] = argv[++i];
+			rgbdPath[1] = argv[++i];
+		}
+		else if(std::strcmp(argv[i], "--stereo") == 0 && i+2 < argc)
+		{
+			stereoPath[0] = argv[++i];
+			stereoPath[1] = argv[++i];
+		}
+		else if(std::strcmp(argv[i], "--calib") == 0 && i+1 < argc)
+		{
+			calibPath = uReplaceChar(argv[++i], '~', UDirectory::homeDir());
+		}
+		else if(std::strcmp(argv[i], "--depth_scale") == 0 && i+1 < argc)
+		{
+			depthScale = uStr2Float(argv[++i]);
+			UASSERT(depthScale > 0.0f);
+		}
+		else if(std::strcmp(argv[i], "--db_odom") == 0)
+		{
+			dbOdom = true;
+		}
+		else if(std::strcmp(argv[i], "--max_frames") == 0 && i+1 < argc)
+		{
+			maxFrames = atoi(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--warmup") == 0 && i+1 < argc)
+		{
+			warmup = atoi(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--output_db") == 0 && i+1 < argc)
+		{
+			outputDb = uReplaceChar(argv[++i], '~', UDirectory::homeDir());
+		}
+		else if(std::strcmp(argv[i], "--json") == 0 && i+1 < argc)
+		{
+			jsonPath = uReplaceChar(argv[++i], '~', UDirectory::homeDir());
+		}
+		else if(std::strcmp(argv[i], "--baseline") == 0 && i+1 < argc)
+		{
+			baselinePath = uReplaceChar(argv[++i], '~', UDirectory::homeDir());
+		}
+		else if(std::strcmp(argv[i], "--latency_thr") == 0 && i+1 < argc)
+		{
+			latencyThr = uStr2Float(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--latency_min") == 0 && i+1 < argc)
+		{
+			latencyMin = uStr2Float(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--throughput_thr") == 0 && i+1 < argc)
+		{
+			throughputThr = uStr2Float(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--rss_thr") == 0 && i+1 < argc)
+		{
+			rssThr = uStr2Float(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--stages") == 0 && i+1 < argc)
+		{
+			comparedStages = uSplit(argv[++i], ';');
+		}
+		else if(std::strcmp(argv[i], "--quiet") == 0)
+		{
+			quiet = true;
+		}
+		else if(std::strcmp(argv[i], "--no_db_queries") == 0)
+		{
+			dbQueries = false;
+		}
+		else if(std::strcmp(argv[i], "--neighbors") == 0 && i+1 < argc)
+		{
+			neighbors = atoi(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--optimizer_nodes") == 0 && i+1 < argc)
+		{
+			optimizerNodes = atoi(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--optimizer_synthetic") == 0 && i+1 < argc)
+		{
+			optimizerSynthetic = atoi(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--localization") == 0 && i+1 < argc)
+		{
+			localizationFrames = atoi(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--transfer_wm") == 0 && i+1 < argc)
+		{
+			transferWm = atoi(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--map_clouds") == 0 && i+1 < argc)
+		{
+			mapClouds = atoi(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0)
+		{
+			showUsage();
+		}
+	}
+	ParametersMap parameters = Parameters::parseArguments(argc, argv);
+
+	Camera * camera = 0;
+	std::string calibFolder = ".";
+	std::string calibName;
+	if(!calibPath.empty())
+	{
+		calibFolder = UDirectory::getDir(calibPath);
+		calibName = UFile::getName(calibPath);
+		if(UFile::getExtension(calibName).compare("yaml") == 0)
+		{
+			calibName = calibName.substr(0, calibName.size()-5);
+		}
+	}
+	if(!rgbdPath[0].empty())
+	{
+		input = rgbdPath[0] + ";" + rgbdPath[1];
+		camera = new CameraRGBDImages(
+				uReplaceChar(rgbdPath[0], '~', UDirectory::homeDir()),
+				uReplaceChar(rgbdPath[1], '~', UDirectory::homeDir()),
+				depthScale);
+	}
+	else if(!stereoPath[0].empty())
+	{
+		input = stereoPath[0] + ";" + stereoPath[1];
+		camera = new CameraStereoImages(
+				uReplaceChar(stereoPath[0], '~', UDirectory::homeDir()),
+				uReplaceChar(stereoPath[1], '~', UDirectory::homeDir()));
+	}
+	else
+	{
+		input = uReplaceChar(argv[argc-1], '~', UDirectory::homeDir());
+		if(!UFile::exists(input) || UFile::getExtension(input).compare("db") != 0)
+		{
+			printf("Database \"%s\" doesn't exist or is not a database.\n", input.c_str());
+			showUsage();
+		}
+		camera = new DBReader(input, 0.0f, !dbOdom);
+	}
+	if(dbOdom && dynamic_cast<DBReader*>(camera) == 0)
+	{
+		printf("--db_odom can only be used with a database input.\n");
+		delete camera;
+		showUsage();
+	}
+
+	if(quiet)
+	{
+		ULogger::setLevel(ULogger::kError);
+	}
+
+	printf("Input: %s\n", input.c_str());
+	if(!parameters.empty())
+	{
+		printf("Parameters:\n");
+		for(ParametersMap::iterator iter=parameters.begin(); iter!=parameters.end(); ++iter)
+		{
+			printf("   %s=%s\n", iter->first.c_str(), iter->second.c_str());
+		}
+	}
+	printf("RTAB-Map version: %s\n", RTABMAP_VERSION);
+
+	CameraThread cameraThread(camera, parameters);
+	if(!cameraThread.camera()->init(calibFolder, calibName))
+	{
+		UERROR("Camera init failed!");
+		return 1;
+	}
+
+	if(!outputDb.empty())
+	{
+		UFile::erase(outputDb);
+	}
+	ParametersMap odomParameters = parameters;
+	odomParameters.erase(Parameters::kRtabmapPublishRAMUsage()); // as odometry is in the same process than rtabmap, don't get RAM usage in odometry.
+	Odometry * odom = dbOdom?0:Odometry::create(odomParameters);
+	Rtabmap rtabmap;
+	rtabmap.init(parameters, outputDb);
+
+	std::map<std::string, std::vector<float> > stageValues;
+	long int peakMemory = UProcessInfo::getMemoryUsage();
+	int frames = 0;
+	int processed = 0;
+	double processingTime = 0.0;
+
+#ifndef _WIN32
+	struct rusage usageStart;
+	getrusage(RUSAGE_SELF, &usageStart);
+#endif
+
+	/////////////////////////////
+	// Replay begin
+	/////////////////////////////
+	UTimer totalTime;
+	UTimer frameTime;
+	CameraInfo cameraInfo;
+	SensorData data = cameraThread.camera()->takeImage(&cameraInfo);
+	while(data.isValid() && g_forever && (maxFrames <= 0 || frames < maxFrames))
+	{
+		cameraThread.postUpdate(&data, &cameraInfo);
+		cameraInfo.timeTotal = frameTime.ticks();
+
+		OdometryInfo odomInfo;
+		Transform pose;
+		cv::Mat covariance;
+		if(odom)
+		{
+			pose = odom->process(data, &odomInfo);
+			covariance = odomInfo.reg.covariance;
+		}
+		else
+		{
+			pose = cameraInfo.odomPose;
+			covariance = cameraInfo.odomCovariance;
+		}
+		double odomTime = frameTime.ticks();
+
+		OdometryEvent e(SensorData(), Transform(), odomInfo);
+		bool added = rtabmap.process(data, pose, covariance, e.velocity());
+		double slamTime = frameTime.ticks();
+
+		if(frames >= warmup)
+		{
+			double frameTotal = cameraInfo.timeTotal + odomTime + slamTime;
+			processingTime += frameTotal;
+			++processed;
+			stageValues["Frame/Total/ms"].push_back(frameTotal*1000.0f);
+			stageValues["Camera/TotalTime/ms"].push_back(cameraInfo.timeTotal*1000.0f);
+			stageValues["Camera/Capture/ms"].push_back(cameraInfo.timeCapture*1000.0f);
+			if(odom)
+			{
+				stageValues["Odometry/TotalTime/ms"].push_back(odomInfo.timeEstimation*1000.0f);
+				stageValues["Odometry/Registration/ms"].push_back(odomInfo.reg.totalTime*1000.0f);
+				if(odomInfo.localBundleTime > 0.0f)
+				{
+					stageValues["Odometry/LocalBundle/ms"].push_back(odomInfo.localBundleTime*1000.0f);
+				}
+			}
+			if(added)
+			{
+				stageValues["Rtabmap/Process/ms"].push_back(slamTime*1000.0f);
+				const std::map<std::string, float> & stats = rtabmap.getStatistics().data();
+				for(std::map<std::string, float>::const_iterator iter=stats.begin(); iter!=stats.end(); ++iter)
+				{
+					if(uStrContains(iter->first, "Timing/") || uStrContains(iter->first, "TimingMem/"))
+					{
+						stageValues[iter->first].push_back(iter->second);
+					}
+				}
+			}
+		}
+
+		long int memory = UProcessInfo::getMemoryUsage();
+		if(memory > peakMemory)
+		{
+			peakMemory = memory;
+		}
+
+		++frames;
+		if(!quiet)
+		{
+			printf("Frame %d: camera=%dms, odom=%dms, slam=%dms%s\n",
+					frames,
+					int(cameraInfo.timeTotal*1000.0f),
+					int(odomTime*1000.0f),
+					int(slamTime*1000.0f),
+					rtabmap.getLoopClosureId()>0?" *":"");
+		}
+
+		cameraInfo = CameraInfo();
+		frameTime.restart();
+		data = cameraThread.camera()->takeImage(&cameraInfo);
+	}
+	double wallTime = totalTime.ticks();
+	/////////////////////////////
+	// Replay end
+	/////////////////////////////
+
+	float cpuUtilization = -1.0f;
+#ifndef _WIN32
+	struct rusage usageEnd;
+	getrusage(RUSAGE_SELF, &usageEnd);
+	double cpuTime =
+			double(usageEnd.ru_utime.tv_sec - usageStart.ru_utime.tv_sec) + double(usageEnd.ru_utime.tv_usec - usageStart.ru_utime.tv_usec)/1000000.0 +
+			double(usageEnd.ru_stime.tv_sec - usageStart.ru_stime.tv_sec) + double(usageEnd.ru_stime.tv_usec - usageStart.ru_stime.tv_usec)/1000000.0;
+	cpuUtilization = wallTime>0.0?float(cpuTime/wallTime):0.0f;
+#ifdef __APPLE__
+	long int maxRss = usageEnd.ru_maxrss; // bytes
+#else
+	long int maxRss = usageEnd.ru_maxrss*1024; // kilobytes
+#endif
+	if(maxRss > peakMemory)
+	{
+		peakMemory = maxRss;
+	}
+#endif
+	int nodes = rtabmap.getMemory()?(int)rtabmap.getMemory()->getAllSignatureIds().size():0;
+	delete odom;
+	rtabmap.close(!outputDb.empty());
+
+	std::string benchmarkDb = outputDb;
+	if(benchmarkDb.empty() && dynamic_cast<DBReader*>(cameraThread.camera()) != 0)
+	{
+		benchmarkDb = input;
+	}
+	if(!benchmarkDb.empty())
+	{
+		if(dbQueries)
+		{
+			benchmarkDatabaseQueries(benchmarkDb, stageValues);
+		}
+		if(neighbors > 0)
+		{
+			benchmarkNeighbors(benchmarkDb, parameters, neighbors, stageValues);
+		}
+		if(optimizerNodes > 0)
+		{
+			benchmarkGraphOptimization(benchmarkDb, parameters, optimizerNodes, stageValues);
+		}
+		if(localizationFrames > 0)
+		{
+			benchmarkLocalizationFastPath(benchmarkDb, parameters, localizationFrames, stageValues);
+		}
+		if(mapClouds > 0)
+		{
+			benchmarkMapClouds(benchmarkDb, parameters, mapClouds, stageValues);
+		}
+	}
+	if(optimizerSynthetic > 0)
+	{
+		benchmarkGraphOptimizationSynthetic(optimizerSynthetic, parameters, stageValues);
+	}
+	if(transferWm > 0)
+	{
+		benchmarkTransferSelection(transferWm, stageValues);
+	}
+
+	std::map<std::string, StageStats> stages;
+	for(std::map<std::string, std::vector<float> >::iterator iter=stageValues.begin(); iter!=stageValues.end(); ++iter)
+	{
+		stages.insert(std::make_pair(iter->first, computeStats(iter->second)));
+	}
+	float throughput = processingTime>0.0?float(double(processed)/processingTime):0.0f;
+	float peakRss = float(double(peakMemory)/(1024.0*1024.0));
+
+	writeJson(stdout, input, parameters, frames, nodes, wallTime, throughput, peakRss, cpuUtilization, stages);
+	if(!jsonPath.empty())
+	{
+		FILE * file = fopen(jsonPath.c_str(), "w");
+		if(file)
+		{
+			writeJson(file, input, parameters, frames, nodes, wallTime, throughput, peakRss, cpuUtilization, stages);
+			fclose(file);
+			printf("Results saved to \"%s\".\n", jsonPath.c_str());
+		}
+		else
+		{
+			UERROR("Cannot write results to \"%s\".", jsonPath.c_str());
+		}
+	}
+
+	if(!baselinePath.empty())
+	{
+		std::map<std::string, StageStats> baselineStages;
+		float baselineThroughput = 0.0f;
+		float baselinePeakRss = 0.0f;
+		if(!readBaseline(baselinePath, baselineStages, baselineThroughput, baselinePeakRss))
+		{
+			UERROR("Cannot read baseline \"%s\".", baselinePath.c_str());
+			return 1;
+		}
+
+		int regressions = 0;
+		printf("Comparison with baseline \"%s\":\n", baselinePath.c_str());
+		for(std::map<std::string, StageStats>::iterator iter=baselineStages.begin(); iter!=baselineStages.end(); ++iter)
+		{
+			if(!comparedStages.empty() && std::find(comparedStages.begin(), comparedStages.end(), iter->first) == comparedStages.end())
+			{
+				continue;
+			}
+			std::map<std::string, StageStats>::iterator jter = stages.find(iter->first);
+			if(jter == stages.end())
+			{
+				printf("   [REGRESSION] %s: missing from the current run\n", iter->first.c_str());
+				++regressions;
+				continue;
+			}
+			if(iter->second.p50 < latencyMin)
+			{
+				continue;
+			}
+			const float baseline[3] = {iter->second.p50, iter->second.p95, iter->second.p99};
+			const float current[3] = {jter->second.p50, jter->second.p95, jter->second.p99};
+			const char * names[3] = {"p50", "p95", "p99"};
+			for(int i=0; i<3; ++i)
+			{
+				if(current[i] > baseline[i]*(1.0f+latencyThr/100.0f))
+				{
+					printf("   [REGRESSION] %s %s: %f ms -> %f ms (+%.1f%%)\n",
+							iter->first.c_str(), names[i], baseline[i], current[i], (current[i]/baseline[i]-1.0f)*100.0f);
+					++regressions;
+				}
+			}
+		}
+		if(baselineThroughput > 0.0f && throughput < baselineThroughput*(1.0f-throughputThr/100.0f))
+		{
+			printf("   [REGRESSION] throughput: %f fps -> %f fps (%.1f%%)\n",
+					baselineThroughput, throughput, (throughput/baselineThroughput-1.0f)*100.0f);
+			++regressions;
+		}
+		if(baselinePeakRss > 0.0f && peakRss > baselinePeakRss*(1.0f+rssThr/100.0f))
+		{
+			printf("   [REGRESSION] peak RSS: %f MB -> %f MB (+%.1f%%)\n",
+					baselinePeakRss, peakRss, (peakRss/baselinePeakRss-1.0f)*100.0f);
+			++regressions;
+		}
+		printf("%d regression(s) detected.\n", regressions);
+		if(regressions)
+		{
+			return 2;
+		}
+	}
+
+	return 0;
+}
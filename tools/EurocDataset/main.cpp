@@ -60,6 +60,7 @@ void showUsage()
 			"  --output           Output directory. By default, results are saved in \"path\".\n"
 			"  --output_name      Output database name (default \"rtabmap\").\n"
 			"  --quiet            Don't show log messages and iteration updates.\n"
+			"  --read_ahead #     Decode images in # threads ahead of processing (default 0=disabled).\n"
 			"  --exposure_comp    Do exposure compensation between left and right images.\n"
 			"  --disp             Generate full disparity.\n"
 			"  --raw              Use raw images (not rectified, this only works with okvis, msckf or vins odometry).\n"
@@ -102,6 +103,7 @@ int main(int argc, char * argv[])
 	bool exposureCompensation = false;
 	bool quiet = false;
 	int imuFilter = 1;
+	int readAheadThreads = 0;
 	if(argc < 2)
 	{
 		showUsage();
@@ -122,6 +124,11 @@ int main(int argc, char * argv[])
 			{
 				quiet = true;
 			}
+			else if(std::strcmp(argv[i], "--read_ahead") == 0)
+			{
+				readAheadThreads = atoi(argv[++i]);
+				UASSERT(readAheadThreads >= 0);
+			}
 			else if(std::strcmp(argv[i], "--disp") == 0)
 			{
 				disp = true;
@@ -293,6 +300,7 @@ int main(int argc, char * argv[])
 	printf("imuToCam0=%s\n", models[0].localTransform().prettyPrint().c_str());
 	printf("imuToCam1=%s\n", models[1].localTransform().prettyPrint().c_str());
 	((CameraStereoImages*)cameraThread.camera())->setTimestamps(true, "", false);
+	((CameraStereoImages*)cameraThread.camera())->setReadAhead(readAheadThreads);
 	if(exposureCompensation)
 	{
 		cameraThread.setStereoExposureCompensation(true);
@@ -31,6 +31,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/util3d_filtering.h>
 #include <rtabmap/core/util3d_transforms.h>
 #include <rtabmap/core/util3d_surface.h>
+#include <rtabmap/core/CloudTileAssembler.h>
+#include <rtabmap/core/TSDFVolume.h>
+#include <rtabmap/core/Memory.h>
 #include <rtabmap/core/optimizer/OptimizerG2O.h>
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UTimer.h>
@@ -61,12 +64,20 @@ void showUsage()
 			"    --no_clean            Disable cleaning colorless polygons.\n"
 			"    --multiband           Enable multiband texturing (AliceVision dependency required).\n"
 			"    --poisson_depth #     Set Poisson depth for mesh reconstruction.\n"
+			"    --tsdf                Use TSDF volume integration of the depth images (with marching cubes)\n"
+			"                            instead of Poisson for mesh reconstruction. --voxel is the TSDF voxel size.\n"
+			"    --tsdf_trunc    #     TSDF truncation distance (default 4 x voxel size).\n"
 			"    --max_polygons  #     Maximum polygons when creating a mesh (default 500000, set 0 for no limit).\n"
 			"    --max_range     #     Maximum range of the created clouds (default 4 m).\n"
 			"    --decimation    #     Depth image decimation before creating the clouds (default 4).\n"
 			"    --voxel         #     Voxel size of the created clouds (default 0.01 m).\n"
 			"    --color_radius  #     Radius used to colorize polygons (default 0.05 m, set 0 for nearest color).\n"
 			"    --save_in_db          Save resulting assembled point cloud or mesh in the database.\n"
+			"    --stream        #     Out-of-core assembly of the point cloud with a memory budget (MB). Nodes\n"
+			"                            are loaded one at a time and voxels are accumulated in spatial tiles\n"
+			"                            spilled to disk when over budget. The cloud is written tile by tile.\n"
+			"                            Not compatible with --mesh, --texture, --ba and --save_in_db.\n"
+			"    --tile_size     #     Tile size used by --stream (default 10 m).\n"
 			"\n%s", Parameters::showUsage());
 	;
 	exit(1);
@@ -99,6 +110,10 @@ int main(int argc, char * argv[])
 	bool multiband = false;
 	float colorRadius = 0.05;
 	bool saveInDb = false;
+	int streamBudget = 0;
+	float tileSize = 10.0f;
+	bool tsdf = false;
+	float tsdfTruncation = 0.0f;
 	for(int i=1; i<argc-1; ++i)
 	{
 		if(std::strcmp(argv[i], "--help") == 0)
@@ -186,6 +201,23 @@ int main(int argc, char * argv[])
 				showUsage();
 			}
 		}
+		else if(std::strcmp(argv[i], "--tsdf") == 0)
+		{
+			tsdf = true;
+		}
+		else if(std::strcmp(argv[i], "--tsdf_trunc") == 0)
+		{
+			++i;
+			if(i<argc-1)
+			{
+				tsdfTruncation = uStr2Float(argv[i]);
+				UASSERT(tsdfTruncation>=0.0f);
+			}
+			else
+			{
+				showUsage();
+			}
+		}
 		else if(std::strcmp(argv[i], "--max_polygons") == 0)
 		{
 			++i;
@@ -250,6 +282,38 @@ int main(int argc, char * argv[])
 		{
 			saveInDb = true;
 		}
+		else if(std::strcmp(argv[i], "--stream") == 0)
+		{
+			++i;
+			if(i<argc-1)
+			{
+				streamBudget = uStr2Int(argv[i]);
+				UASSERT(streamBudget>=0);
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+		else if(std::strcmp(argv[i], "--tile_size") == 0)
+		{
+			++i;
+			if(i<argc-1)
+			{
+				tileSize = uStr2Float(argv[i]);
+				UASSERT(tileSize>0.0f);
+			}
+			else
+			{
+				showUsage();
+			}
+		}
+	}
+
+	if(streamBudget>0 && (mesh || texture || ba || saveInDb))
+	{
+		printf("Option --stream is not supported with --mesh, --texture, --ba or --save_in_db options, disabling streaming...\n");
+		streamBudget = 0;
 	}
 
 	if(saveInDb)
@@ -304,12 +368,68 @@ int main(int argc, char * argv[])
 	std::map<int, Transform> optimizedPoses;
 	std::multimap<int, Link> links;
 	printf("Optimizing the map...\n");
-	rtabmap.getGraph(optimizedPoses, links, true, true, &nodes, true, true, true, true);
+	// when streaming, node data are loaded one at a time below
+	rtabmap.getGraph(optimizedPoses, links, true, true, streamBudget>0?0:&nodes, true, true, true, true);
 	printf("Optimizing the map... done (%fs).\n", timer.ticks());
 
 	std::string outputDirectory = UDirectory::getDir(dbPath);
 	std::string baseName = uSplit(UFile::getName(dbPath), '.').front();
 
+	if(streamBudget>0)
+	{
+		printf("Create and assemble the clouds by tiles (memory budget=%d MB, tile size=%f m)...\n", streamBudget, tileSize);
+		CloudTileAssembler assembler(voxelSize, tileSize, streamBudget, outputDirectory);
+		int processed = 0;
+		for(std::map<int, Transform>::iterator iter=optimizedPoses.lower_bound(1); iter!=optimizedPoses.end(); ++iter)
+		{
+			SensorData data = rtabmap.getMemory()->getNodeData(iter->first, true, false, false, false);
+			data.uncompressData();
+
+			pcl::IndicesPtr indices(new std::vector<int>);
+			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = util3d::cloudRGBFromSensorData(
+					data,
+					decimation,      // image decimation before creating the clouds
+					maxRange,        // maximum depth of the cloud
+					0.0f,
+					indices.get());
+
+			pcl::PointCloud<pcl::PointXYZRGB>::Ptr transformedCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+			transformedCloud = rtabmap::util3d::voxelize(cloud, indices, voxelSize);
+			transformedCloud = rtabmap::util3d::transformPointCloud(transformedCloud, iter->second);
+
+			Eigen::Vector3f viewpoint( iter->second.x(),  iter->second.y(),  iter->second.z());
+			pcl::PointCloud<pcl::Normal>::Ptr normals = rtabmap::util3d::computeNormals(transformedCloud, 10, 0.0f, viewpoint);
+
+			pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudWithNormals(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+			pcl::concatenateFields(*transformedCloud, *normals, *cloudWithNormals);
+
+			assembler.addCloud(*cloudWithNormals);
+			if(assembler.spillFailed())
+			{
+				printf("Export failed! Tiles cannot be spilled to \"%s\".\n", outputDirectory.c_str());
+				return -1;
+			}
+
+			if(++processed % 100 == 0)
+			{
+				printf("Processed %d/%d nodes (%d tiles, %d spilled, %d MB in RAM)\n",
+						processed, (int)optimizedPoses.size(), assembler.tiles(), assembler.spilledTiles(), int(assembler.memoryUsed()/(1024*1024)));
+			}
+		}
+		printf("Create and assemble the clouds... done (%fs, %d tiles, %d spilled).\n", timer.ticks(), assembler.tiles(), assembler.spilledTiles());
+
+		std::string outputPath=outputDirectory+"/"+baseName+"_cloud.ply";
+		printf("Saving %s...\n", outputPath.c_str());
+		long points = assembler.writePLY(outputPath);
+		if(points <= 0)
+		{
+			printf("Export failed! The cloud is empty.\n");
+			return points<0?-1:0;
+		}
+		printf("Saving %s... done! (%fs, %ld points)\n", outputPath.c_str(), timer.ticks(), points);
+		return 0;
+	}
+
 	if(ba)
 	{
 		printf("Global bundle adjustment...\n");
@@ -334,6 +454,7 @@ int main(int argc, char * argv[])
 	std::map<int, rtabmap::Transform> cameraPoses;
 	std::map<int, std::vector<rtabmap::CameraModel> > cameraModels;
 	std::map<int, cv::Mat> cameraDepths;
+	TSDFVolume tsdfVolume(voxelSize, tsdfTruncation, maxRange);
 
 	for(std::map<int, Transform>::iterator iter=optimizedPoses.lower_bound(1); iter!=optimizedPoses.end(); ++iter)
 	{
@@ -362,6 +483,11 @@ int main(int argc, char * argv[])
 		pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudWithNormals(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
 		pcl::concatenateFields(*transformedCloud, *normals, *cloudWithNormals);
 
+		if(tsdf && (mesh || texture))
+		{
+			tsdfVolume.integrate(node.sensorData(), iter->second);
+		}
+
 		if(mergedClouds->size() == 0)
 		{
 			*mergedClouds = *cloudWithNormals;
@@ -435,12 +561,21 @@ int main(int argc, char * argv[])
 			}
 
 			// Mesh reconstruction
-			printf("Mesh reconstruction... depth=%d\n", optimizedDepth);
 			pcl::PolygonMesh::Ptr mesh(new pcl::PolygonMesh);
-			pcl::Poisson<pcl::PointXYZRGBNormal> poisson;
-			poisson.setDepth(optimizedDepth);
-			poisson.setInputCloud(mergedClouds);
-			poisson.reconstruct(*mesh);
+			if(tsdf)
+			{
+				printf("Mesh reconstruction (TSDF, %d integrations, %d blocks, %lu MB)...\n", tsdfVolume.integrations(), tsdfVolume.blocks(), tsdfVolume.memoryUsed()/(1024*1024));
+				mesh = tsdfVolume.extractMesh();
+				tsdfVolume.clear();
+			}
+			else
+			{
+				printf("Mesh reconstruction... depth=%d\n", optimizedDepth);
+				pcl::Poisson<pcl::PointXYZRGBNormal> poisson;
+				poisson.setDepth(optimizedDepth);
+				poisson.setInputCloud(mergedClouds);
+				poisson.reconstruct(*mesh);
+			}
 			printf("Mesh reconstruction... done (%fs, %d polygons).\n", timer.ticks(), (int)mesh->polygons.size());
 
 			if(mesh->polygons.size())
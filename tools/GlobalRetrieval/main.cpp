@@ -0,0 +1,162 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/GlobalDescriptorIndex.h>
+#include <rtabmap/core/Parameters.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"rtabmap-global_retrieval [options]\n"
+			"  Measure the latency of the global descriptor index used by %s\n"
+			"  with random descriptors: adding nodes, top-k search (one query and\n"
+			"  batches of queries), scoring all nodes and removing nodes.\n"
+			"  Options:\n"
+			"     --nodes #                Number of indexed nodes (default 100000).\n"
+			"     --dim #                  Descriptor size (default 4096, like NetVLAD).\n"
+			"     --queries #              Number of queries (default 64).\n"
+			"     --k #                    Number of results per query (default %d).\n"
+			"     --l2                     Use squared L2 distance instead of inner product.\n"
+			"     --debug                  Show debug log.\n"
+			"\n",
+			Parameters::kMemGlobalDescriptorLikelihood().c_str(),
+			Parameters::defaultMemGlobalDescriptorTopK());
+	exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	int nodes = 100000;
+	int dim = 4096;
+	int queriesCount = 64;
+	int k = Parameters::defaultMemGlobalDescriptorTopK();
+	bool l2 = false;
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "--nodes") == 0 && i+1<argc)
+		{
+			nodes = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--dim") == 0 && i+1<argc)
+		{
+			dim = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--queries") == 0 && i+1<argc)
+		{
+			queriesCount = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--k") == 0 && i+1<argc)
+		{
+			k = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--l2") == 0)
+		{
+			l2 = true;
+		}
+		else if(strcmp(argv[i], "--debug") == 0)
+		{
+			ULogger::setLevel(ULogger::kDebug);
+		}
+		else
+		{
+			showUsage();
+		}
+	}
+	if(nodes <= 0 || dim <= 0 || queriesCount <= 0 || k <= 0)
+	{
+		showUsage();
+	}
+
+	cv::RNG rng(0);
+	GlobalDescriptorIndex index(l2?GlobalDescriptorIndex::kL2:GlobalDescriptorIndex::kInnerProduct, true);
+	printf("Index of %d nodes with descriptors of size %d (%s)...\n", nodes, dim, l2?"L2":"inner product");
+
+	UTimer timer;
+	double addTime = 0.0;
+	cv::Mat descriptor(1, dim, CV_32FC1);
+	for(int i=0; i<nodes; ++i)
+	{
+		rng.fill(descriptor, cv::RNG::UNIFORM, -1.0f, 1.0f);
+		timer.restart();
+		index.add(i+1, descriptor);
+		addTime += timer.ticks();
+	}
+	printf("  %-24s %10.3f us/node (index=%.2f MB)\n", "Add", addTime*1000000.0/nodes, double(index.memoryUsed())/(1024.0*1024.0));
+
+	cv::Mat queries(queriesCount, dim, CV_32FC1);
+	rng.fill(queries, cv::RNG::UNIFORM, -1.0f, 1.0f);
+	cv::Mat ids;
+	cv::Mat scores;
+
+	timer.restart();
+	for(int i=0; i<queries.rows; ++i)
+	{
+		index.knnSearch(queries.row(i), ids, scores, k);
+	}
+	printf("  %-24s %10.3f ms/query\n", "Search (one query)", timer.ticks()*1000.0/queries.rows);
+
+	index.knnSearch(queries, ids, scores, k);
+	printf("  %-24s %10.3f ms/query\n", "Search (batch)", timer.ticks()*1000.0/queries.rows);
+
+	std::list<int> all;
+	for(int i=0; i<nodes; ++i)
+	{
+		all.push_back(i+1);
+	}
+	timer.restart();
+	index.scores(queries.row(0), all);
+	printf("  %-24s %10.3f ms/query\n", "Scores of all nodes", timer.ticks()*1000.0);
+
+	// Remove and add back 10% of the nodes, like nodes transferred to LTM and retrieved
+	int transferred = nodes/10>0?nodes/10:1;
+	timer.restart();
+	for(int i=0; i<transferred; ++i)
+	{
+		index.remove(i*10+1);
+	}
+	double removeTime = timer.ticks();
+	for(int i=0; i<transferred; ++i)
+	{
+		rng.fill(descriptor, cv::RNG::UNIFORM, -1.0f, 1.0f);
+		index.add(i*10+1, descriptor);
+	}
+	double addBackTime = timer.ticks();
+	printf("  %-24s %10.3f us/node\n", "Remove", removeTime*1000000.0/transferred);
+	printf("  %-24s %10.3f us/node\n", "Add back", addBackTime*1000000.0/transferred);
+
+	return 0;
+}
@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Graph.h"
 #include "rtabmap/core/OdometryInfo.h"
 #include "rtabmap/core/OdometryEvent.h"
+#include "rtabmap/core/OdometryPipeline.h"
 #include "rtabmap/core/Memory.h"
 #include "rtabmap/core/util3d_registration.h"
 #include "rtabmap/utilite/UConversion.h"
@@ -57,6 +58,9 @@ void showUsage()
 			"  --output_name      Output database name (default \"rtabmap\").\n"
 			"  --gt \"path\"        Ground truth path (e.g., ~/KITTI/devkit/cpp/data/odometry/poses/07.txt)\n"
 			"  --quiet            Don't show log messages and iteration updates.\n"
+			"  --pipeline #       Run image loading and odometry on their own threads, with up to\n"
+			"                        # frames waiting between stages (default 0=disabled).\n"
+			"  --read_ahead #     Decode images in # threads ahead of processing (default 0=disabled).\n"
 			"  --color            Use color images for stereo (image_2 and image_3 folders).\n"
 			"  --height           Add car's height to camera local transform (1.67m).\n"
 			"  --disp             Generate full disparity.\n"
@@ -117,6 +121,8 @@ int main(int argc, char * argv[])
 	float scanNormalRadius = 0.0f;
 	std::string gtPath;
 	bool quiet = false;
+	int pipelineSize = 0;
+	int readAheadThreads = 0;
 	if(argc < 2)
 	{
 		showUsage();
@@ -137,6 +143,16 @@ int main(int argc, char * argv[])
 			{
 				quiet = true;
 			}
+			else if(std::strcmp(argv[i], "--pipeline") == 0)
+			{
+				pipelineSize = atoi(argv[++i]);
+				UASSERT(pipelineSize >= 0);
+			}
+			else if(std::strcmp(argv[i], "--read_ahead") == 0)
+			{
+				readAheadThreads = atoi(argv[++i]);
+				UASSERT(readAheadThreads >= 0);
+			}
 			else if(std::strcmp(argv[i], "--scan_step") == 0)
 			{
 				scanStep = atoi(argv[++i]);
@@ -362,6 +378,7 @@ int main(int argc, char * argv[])
 				0.0f,
 				opticalRotation), parameters);
 	((CameraStereoImages*)cameraThread.camera())->setTimestamps(false, pathTimes, false);
+	((CameraStereoImages*)cameraThread.camera())->setReadAhead(readAheadThreads);
 	if(exposureCompensation)
 	{
 		cameraThread.setStereoExposureCompensation(true);
@@ -419,10 +436,26 @@ int main(int argc, char * argv[])
 		Rtabmap rtabmap;
 		rtabmap.init(parameters, databasePath);
 
+		OdometryPipeline * pipeline = 0;
+		OdometryPipeline::Frame frame;
+		if(pipelineSize > 0)
+		{
+			pipeline = new OdometryPipeline(&cameraThread, odom, pipelineSize);
+		}
+
 		UTimer totalTime;
 		UTimer timer;
 		CameraInfo cameraInfo;
-		SensorData data = cameraThread.camera()->takeImage(&cameraInfo);
+		SensorData data;
+		if(pipeline)
+		{
+			pipeline->start();
+			data = pipeline->take(frame)?frame.data:SensorData();
+		}
+		else
+		{
+			data = cameraThread.camera()->takeImage(&cameraInfo);
+		}
 		int iteration = 0;
 
 		/////////////////////////////
@@ -432,12 +465,23 @@ int main(int argc, char * argv[])
 		int odomKeyFrames = 0;
 		while(data.isValid() && g_forever)
 		{
-			cameraThread.postUpdate(&data, &cameraInfo);
-			cameraInfo.timeTotal = timer.ticks();
-
-
 			OdometryInfo odomInfo;
-			Transform pose = odom->process(data, &odomInfo);
+			Transform pose;
+			if(pipeline)
+			{
+				// frames already post-processed and sent to odometry
+				cameraInfo = frame.cameraInfo;
+				odomInfo = frame.odomInfo;
+				pose = frame.pose;
+				timer.restart();
+			}
+			else
+			{
+				cameraThread.postUpdate(&data, &cameraInfo);
+				cameraInfo.timeTotal = timer.ticks();
+
+				pose = odom->process(data, &odomInfo);
+			}
 			float speed = 0.0f;
 			if(odomInfo.interval>0.0)
 				speed = odomInfo.transform.x()/odomInfo.interval*3.6;
@@ -557,7 +601,23 @@ int main(int argc, char * argv[])
 
 			cameraInfo = CameraInfo();
 			timer.restart();
-			data = cameraThread.camera()->takeImage(&cameraInfo);
+			if(pipeline)
+			{
+				data = pipeline->take(frame)?frame.data:SensorData();
+			}
+			else
+			{
+				data = cameraThread.camera()->takeImage(&cameraInfo);
+			}
+		}
+		if(pipeline)
+		{
+			std::map<std::string, float> utilization = pipeline->getUtilization();
+			printf("Pipeline utilization: loading=%.0f%% odometry=%.0f%% mapping=%.0f%%\n",
+					uValue(utilization, std::string("Acquisition"), 0.0f)*100.0f,
+					uValue(utilization, std::string("Odometry"), 0.0f)*100.0f,
+					uValue(utilization, std::string("Mapping"), 0.0f)*100.0f);
+			delete pipeline;
 		}
 		delete odom;
 		printf("Total time=%fs\n", totalTime.ticks());
@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/Memory.h>
+#include <rtabmap/core/DBDriver.h>
+#include <rtabmap/core/Parameters.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UDirectory.h>
+#include <rtabmap/utilite/UStl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"rtabmap-localization_snapshot [options] \"map.db\" \"output.snapshot\"\n"
+			"  Generate a localization snapshot of the database. Set \"%s\" to the\n"
+			"  snapshot path to use it when localizing in that database.\n"
+			"  Options:\n"
+			"     --all                    Snapshot all nodes (%s=true),\n"
+			"                              otherwise the value saved in the database is used.\n"
+			"     --debug                  Show debug log.\n"
+			"\n%s\n"
+			"\n",
+			Parameters::kMemLocalizationSnapshot().c_str(),
+			Parameters::kMemInitWMWithAllNodes().c_str(),
+			Parameters::showUsage());
+	exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	ParametersMap customParameters = Parameters::parseArguments(argc, argv);
+
+	if(argc < 3)
+	{
+		showUsage();
+	}
+
+	for(int i=1; i<argc-2; ++i)
+	{
+		if(strcmp(argv[i], "--all") == 0)
+		{
+			uInsert(customParameters, ParametersPair(Parameters::kMemInitWMWithAllNodes(), "true"));
+		}
+		else if(strcmp(argv[i], "--debug") == 0)
+		{
+			ULogger::setLevel(ULogger::kDebug);
+		}
+		else if(strcmp(argv[i], "--help") == 0)
+		{
+			showUsage();
+		}
+	}
+
+	std::string databasePath = uReplaceChar(argv[argc-2], '~', UDirectory::homeDir());
+	std::string outputPath = uReplaceChar(argv[argc-1], '~', UDirectory::homeDir());
+	if(!UFile::exists(databasePath))
+	{
+		printf("Database \"%s\" doesn't exist!\n", databasePath.c_str());
+		return -1;
+	}
+
+	DBDriver * driver = DBDriver::create();
+	if(!driver->openConnection(databasePath))
+	{
+		printf("Cannot open database \"%s\".\n", databasePath.c_str());
+		delete driver;
+		return -1;
+	}
+	ParametersMap parameters = driver->getLastParameters();
+	driver->closeConnection(false);
+	delete driver;
+
+	uInsert(parameters, customParameters);
+	// Load the database like it would be in localization mode, without modifying it
+	uInsert(parameters, ParametersPair(Parameters::kMemIncrementalMemory(), "false"));
+	uInsert(parameters, ParametersPair(Parameters::kMemLocalizationSnapshot(), ""));
+
+	UTimer timer;
+	printf("Loading database \"%s\"...\n", databasePath.c_str());
+	Memory memory(parameters);
+	if(!memory.init(databasePath, false, parameters))
+	{
+		printf("Failed to load database \"%s\".\n", databasePath.c_str());
+		return -1;
+	}
+	printf("Loading database... done (%fs, %d nodes, %d words).\n",
+			timer.ticks(),
+			(int)memory.getWorkingMem().size()-1, // ignore virtual node
+			(int)memory.getVWDictionary()->getVisualWords().size());
+
+	printf("Saving snapshot \"%s\"...\n", outputPath.c_str());
+	bool success = memory.saveLocalizationSnapshot(outputPath);
+	memory.close(false);
+	if(!success)
+	{
+		printf("Failed to save snapshot \"%s\".\n", outputPath.c_str());
+		return -1;
+	}
+	printf("Saving snapshot... done (%fs, %ld MB).\n", timer.ticks(), UFile::length(outputPath)/(1024*1024));
+
+	return 0;
+}
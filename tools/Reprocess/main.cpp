@@ -35,6 +35,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/Graph.h>
 #include <rtabmap/core/Memory.h>
 #include <rtabmap/core/CameraThread.h>
+#include <rtabmap/core/OdometryPipeline.h>
 #include <rtabmap/utilite/UFile.h>
 #include <rtabmap/utilite/UDirectory.h>
 #include <rtabmap/utilite/UTimer.h>
@@ -64,6 +65,13 @@ void showUsage()
 			"                       arguments, they overwrite those in config file and the database.\n"
 			"     -start #    Start from this node ID.\n"
 			"     -stop #     Last node to process.\n"
+			"     -mmap #     Open input databases read-only with # MB memory-mapped.\n"
+			"     -prefetch # Load # nodes ahead of processing on a background thread.\n"
+			"     -decode #   With -prefetch, decompress loaded nodes with # threads.\n"
+			"     -pipeline # Load and post-process nodes on their own thread, with up to # nodes\n"
+			"                 waiting to be processed. With -r, the oldest waiting nodes are\n"
+			"                 dropped when processing is slower than the input rate (except\n"
+			"                 nodes on which odometry has been reset).\n"
 			"     -g2         Assemble 2D occupancy grid map and save it to \"[output]_map.pgm\".\n"
 			"     -g3         Assemble 3D cloud map and save it to \"[output]_map.pcd\".\n"
 			"     -o2         Assemble OctoMap 2D projection and save it to \"[output]_octomap.pgm\".\n"
@@ -105,6 +113,18 @@ std::multimap<int, Link> odomTrajectoryLinks;
 std::map<int, Transform> localizationPoses;
 bool exportPoses = false;
 int sessionCount = 0;
+
+SensorData takeFrame(OdometryPipeline * pipeline, CameraInfo & info)
+{
+	OdometryPipeline::Frame frame;
+	if(pipeline->take(frame))
+	{
+		info = frame.cameraInfo;
+		return frame.data;
+	}
+	info = CameraInfo();
+	return SensorData();
+}
 void showLocalizationStats(const std::string & outputDatabasePath)
 {
 	printf("Total localizations on previous session = %d/%d (Loop=%d, Prox=%d, In Motion=%d/%d)\n", loopCount+proxCount, totalFrames, loopCount, proxCount, loopCountMotion, totalFramesMotion);
@@ -215,6 +235,10 @@ int main(int argc, char * argv[])
 	int startId = 0;
 	int stopId = 0;
 	int framesToSkip = 0;
+	int mmapSize = -1;
+	int prefetchSize = 0;
+	int decodeThreads = 0;
+	int pipelineSize = 0;
 	bool scanFromDepth = false;
 	int scanDecimation = 1;
 	float scanRangeMin = 0.0f;
@@ -291,6 +315,62 @@ int main(int argc, char * argv[])
 				showUsage();
 			}
 		}
+		else if (strcmp(argv[i], "-mmap") == 0 || strcmp(argv[i], "--mmap") == 0)
+		{
+			++i;
+			if(i < argc - 2)
+			{
+				mmapSize = atoi(argv[i]);
+				printf("Input databases will be opened read-only (mmap=%d MB).\n", mmapSize);
+			}
+			else
+			{
+				printf("-mmap option requires a value\n");
+				showUsage();
+			}
+		}
+		else if (strcmp(argv[i], "-prefetch") == 0 || strcmp(argv[i], "--prefetch") == 0)
+		{
+			++i;
+			if(i < argc - 2)
+			{
+				prefetchSize = atoi(argv[i]);
+				printf("Prefetch %d nodes.\n", prefetchSize);
+			}
+			else
+			{
+				printf("-prefetch option requires a value\n");
+				showUsage();
+			}
+		}
+		else if (strcmp(argv[i], "-decode") == 0 || strcmp(argv[i], "--decode") == 0)
+		{
+			++i;
+			if(i < argc - 2)
+			{
+				decodeThreads = atoi(argv[i]);
+				printf("Decompress prefetched nodes with %d threads.\n", decodeThreads);
+			}
+			else
+			{
+				printf("-decode option requires a value\n");
+				showUsage();
+			}
+		}
+		else if (strcmp(argv[i], "-pipeline") == 0 || strcmp(argv[i], "--pipeline") == 0)
+		{
+			++i;
+			if(i < argc - 2 && atoi(argv[i]) >= 0)
+			{
+				pipelineSize = atoi(argv[i]);
+				printf("Pipelined processing with %d nodes buffered.\n", pipelineSize);
+			}
+			else
+			{
+				printf("-pipeline option requires a value >= 0\n");
+				showUsage();
+			}
+		}
 		else if(strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--p") == 0)
 		{
 			exportPoses = true;
@@ -557,6 +637,11 @@ int main(int argc, char * argv[])
 	Parameters::parse(parameters, Parameters::kRGBDEnabled(), rgbdEnabled);
 	bool odometryIgnored = !rgbdEnabled;
 	DBReader * dbReader = new DBReader(inputDatabasePath, useDatabaseRate?-1:0, odometryIgnored, false, false, startId, -1, stopId);
+	if(mmapSize >= 0)
+	{
+		dbReader->setReadOnly(true, mmapSize);
+	}
+	dbReader->setPrefetchSize(prefetchSize, decodeThreads);
 	dbReader->init();
 
 	OccupancyGrid grid(parameters);
@@ -573,15 +658,28 @@ int main(int argc, char * argv[])
 	printf("Reprocessing data of \"%s\"...\n", inputDatabasePath.c_str());
 	std::map<std::string, float> globalMapStats;
 	int processed = 0;
-	CameraInfo info;
-	SensorData data = dbReader->takeImage(&info);
 	CameraThread camThread(dbReader, parameters); // take ownership of dbReader
 	camThread.setScanParameters(scanFromDepth, scanDecimation, scanRangeMin, scanRangeMax, scanVoxelSize, scanNormalK, scanNormalRadius);
-	if(scanFromDepth)
+	OdometryPipeline * pipeline = 0;
+	CameraInfo info;
+	SensorData data;
+	if(pipelineSize > 0)
 	{
-		data.setLaserScan(LaserScan());
+		// Odometry is read from the database, only loading and post-processing are done on another thread
+		pipeline = new OdometryPipeline(&camThread, 0, pipelineSize, !useDatabaseRate);
+		pipeline->setLaserScanRegenerated(scanFromDepth);
+		pipeline->start();
+		data = takeFrame(pipeline, info);
+	}
+	else
+	{
+		data = dbReader->takeImage(&info);
+		if(scanFromDepth)
+		{
+			data.setLaserScan(LaserScan());
+		}
+		camThread.postUpdate(&data, &info);
 	}
-	camThread.postUpdate(&data, &info);
 	Transform lastLocalizationOdomPose = info.odomPose;
 	bool inMotion = true;
 	while(data.isValid() && g_loopForever)
@@ -769,7 +867,7 @@ int main(int argc, char * argv[])
 			int skippedFrames = framesToSkip;
 			while(skippedFrames-- > 0)
 			{
-				data = dbReader->takeImage(&info);
+				data = pipeline?takeFrame(pipeline, info):dbReader->takeImage(&info);
 				if(!odometryIgnored && !info.odomCovariance.empty() && info.odomCovariance.at<double>(0,0)>=9999)
 				{
 					printf("High variance detected, triggering a new map...\n");
@@ -783,12 +881,19 @@ int main(int argc, char * argv[])
 			}
 		}
 
-		data = dbReader->takeImage(&info);
-		if(scanFromDepth)
+		if(pipeline)
 		{
-			data.setLaserScan(LaserScan());
+			data = takeFrame(pipeline, info);
+		}
+		else
+		{
+			data = dbReader->takeImage(&info);
+			if(scanFromDepth)
+			{
+				data.setLaserScan(LaserScan());
+			}
+			camThread.postUpdate(&data, &info);
 		}
-		camThread.postUpdate(&data, &info);
 
 		inMotion = true;
 		if(!incrementalMemory &&
@@ -805,6 +910,16 @@ int main(int argc, char * argv[])
 		}
 	}
 
+	if(pipeline)
+	{
+		std::map<std::string, float> utilization = pipeline->getUtilization();
+		printf("Pipeline utilization: loading=%.0f%% mapping=%.0f%% (%d nodes dropped)\n",
+				uValue(utilization, std::string("Acquisition"), 0.0f)*100.0f,
+				uValue(utilization, std::string("Mapping"), 0.0f)*100.0f,
+				pipeline->getDroppedFrames());
+		delete pipeline;
+	}
+
 	int databasesMerged = 0;
 	if(!incrementalMemory)
 	{
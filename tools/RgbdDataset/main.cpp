@@ -32,6 +32,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Graph.h"
 #include "rtabmap/core/OdometryInfo.h"
 #include "rtabmap/core/OdometryEvent.h"
+#include "rtabmap/core/OdometryPipeline.h"
 #include "rtabmap/core/Memory.h"
 #include "rtabmap/core/util3d_registration.h"
 #include "rtabmap/utilite/UConversion.h"
@@ -58,6 +59,9 @@ void showUsage()
 			"  --output           Output directory. By default, results are saved in \"path\".\n"
 			"  --output_name      Output database name (default \"rtabmap\").\n"
 			"  --skip #           Skip X frames.\n"
+			"  --pipeline #       Run image loading and odometry on their own threads, with up to\n"
+			"                        # frames waiting between stages (default 0=disabled).\n"
+			"  --read_ahead #     Decode images in # threads ahead of processing (default 0=disabled).\n"
 			"  --quiet            Don't show log messages and iteration updates.\n"
 			"%s\n"
 			"Example:\n\n"
@@ -92,6 +96,8 @@ int main(int argc, char * argv[])
 	std::string output;
 	std::string outputName = "rtabmap";
 	int skipFrames = 0;
+	int pipelineSize = 0;
+	int readAheadThreads = 0;
 	bool quiet = false;
 	if(argc < 2)
 	{
@@ -114,6 +120,16 @@ int main(int argc, char * argv[])
 				skipFrames = atoi(argv[++i]);
 				UASSERT(skipFrames > 0);
 			}
+			else if(std::strcmp(argv[i], "--pipeline") == 0)
+			{
+				pipelineSize = atoi(argv[++i]);
+				UASSERT(pipelineSize >= 0);
+			}
+			else if(std::strcmp(argv[i], "--read_ahead") == 0)
+			{
+				readAheadThreads = atoi(argv[++i]);
+				UASSERT(readAheadThreads >= 0);
+			}
 			else if(std::strcmp(argv[i], "--quiet") == 0)
 			{
 				quiet = true;
@@ -208,6 +224,7 @@ int main(int argc, char * argv[])
 				0.0f,
 				opticalRotation), parameters);
 	((CameraRGBDImages*)cameraThread.camera())->setTimestamps(true, "", false);
+	((CameraRGBDImages*)cameraThread.camera())->setReadAhead(readAheadThreads);
 	if(!pathGt.empty())
 	{
 		((CameraRGBDImages*)cameraThread.camera())->setGroundTruthPath(pathGt, 1);
@@ -238,10 +255,27 @@ int main(int argc, char * argv[])
 		Rtabmap rtabmap;
 		rtabmap.init(parameters, databasePath);
 
+		OdometryPipeline * pipeline = 0;
+		OdometryPipeline::Frame frame;
+		if(pipelineSize > 0)
+		{
+			pipeline = new OdometryPipeline(&cameraThread, odom, pipelineSize);
+			pipeline->setFramesSkipped(skipFrames);
+		}
+
 		UTimer totalTime;
 		UTimer timer;
 		CameraInfo cameraInfo;
-		SensorData data = cameraThread.camera()->takeImage(&cameraInfo);
+		SensorData data;
+		if(pipeline)
+		{
+			pipeline->start();
+			data = pipeline->take(frame)?frame.data:SensorData();
+		}
+		else
+		{
+			data = cameraThread.camera()->takeImage(&cameraInfo);
+		}
 		int iteration = 0;
 
 		/////////////////////////////
@@ -253,22 +287,34 @@ int main(int argc, char * argv[])
 		int skipCount = 0;
 		while(data.isValid() && g_forever)
 		{
-			if(skipCount < skipFrames)
+			OdometryInfo odomInfo;
+			Transform pose;
+			if(pipeline)
 			{
-				++skipCount;
-
-				cameraInfo = CameraInfo();
+				// frames already skipped, post-processed and sent to odometry
+				cameraInfo = frame.cameraInfo;
+				odomInfo = frame.odomInfo;
+				pose = frame.pose;
 				timer.restart();
-				data = cameraThread.camera()->takeImage(&cameraInfo);
-				continue;
 			}
-			skipCount = 0;
+			else
+			{
+				if(skipCount < skipFrames)
+				{
+					++skipCount;
+
+					cameraInfo = CameraInfo();
+					timer.restart();
+					data = cameraThread.camera()->takeImage(&cameraInfo);
+					continue;
+				}
+				skipCount = 0;
 
-			cameraThread.postUpdate(&data, &cameraInfo);
-			cameraInfo.timeTotal = timer.ticks();
+				cameraThread.postUpdate(&data, &cameraInfo);
+				cameraInfo.timeTotal = timer.ticks();
 
-			OdometryInfo odomInfo;
-			Transform pose = odom->process(data, &odomInfo);
+				pose = odom->process(data, &odomInfo);
+			}
 
 			if(odomStrategy == 2)
 			{
@@ -379,7 +425,23 @@ int main(int argc, char * argv[])
 
 			cameraInfo = CameraInfo();
 			timer.restart();
-			data = cameraThread.camera()->takeImage(&cameraInfo);
+			if(pipeline)
+			{
+				data = pipeline->take(frame)?frame.data:SensorData();
+			}
+			else
+			{
+				data = cameraThread.camera()->takeImage(&cameraInfo);
+			}
+		}
+		if(pipeline)
+		{
+			std::map<std::string, float> utilization = pipeline->getUtilization();
+			printf("Pipeline utilization: loading=%.0f%% odometry=%.0f%% mapping=%.0f%%\n",
+					uValue(utilization, std::string("Acquisition"), 0.0f)*100.0f,
+					uValue(utilization, std::string("Odometry"), 0.0f)*100.0f,
+					uValue(utilization, std::string("Mapping"), 0.0f)*100.0f);
+			delete pipeline;
 		}
 		delete odom;
 		printf("Total time=%fs\n", totalTime.ticks());
@@ -0,0 +1,325 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/DBDriver.h>
+#include <rtabmap/core/VWDictionary.h>
+#include <rtabmap/core/VisualWord.h>
+#include <rtabmap/core/FlannIndex.h>
+#include <rtabmap/core/ProductQuantizer.h>
+#include <rtabmap/core/Parameters.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UDirectory.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <opencv2/features2d/features2d.hpp>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"rtabmap-vocabulary_recall [options] \"map.db\"\n"
+			"  Compare nearest neighbor search of the visual words of the database\n"
+			"  with the kd-tree (%s=1) and with product quantization (%s).\n"
+			"  Query words are held out from the dictionary, recall@k is the ratio of\n"
+			"  queries for which the exact nearest neighbor is in the k first results.\n"
+			"  Options:\n"
+			"     --queries #              Number of query words (default 1000).\n"
+			"     --k #                    Maximum k of recall@k (default 10).\n"
+			"     --sub #                  Product quantization sub-quantizers (default 16).\n"
+			"     --centroids #            Product quantization centroids (default %d).\n"
+			"     --coarse #               Coarse centroids (inverted lists), 0 for exhaustive search (default %d).\n"
+			"     --nprobe #               Inverted lists searched per query (default %d).\n"
+			"     --rerank #               Candidates re-ranked with exact distances (default %d).\n"
+			"     --checks #               Kd-tree checks (default 32).\n"
+			"     --debug                  Show debug log.\n"
+			"\n",
+			Parameters::kKpNNStrategy().c_str(),
+			Parameters::kKpPQSubQuantizers().c_str(),
+			Parameters::defaultKpPQCentroids(),
+			Parameters::defaultKpPQCoarseCentroids(),
+			Parameters::defaultKpPQNProbe(),
+			Parameters::defaultKpPQRerank());
+	exit(1);
+}
+
+// indices: one row of sorted base indices per query, -1 if none
+void printRecall(const char * name, const cv::Mat & indices, const std::vector<int> & groundTruth, int k, double buildTime, double searchTime, unsigned long memory)
+{
+	std::vector<int> found(k, 0);
+	for(int i=0; i<indices.rows; ++i)
+	{
+		for(int j=0; j<k && j<indices.cols; ++j)
+		{
+			if(indices.at<int>(i,j) == groundTruth[i])
+			{
+				for(int l=j; l<k; ++l)
+				{
+					++found[l];
+				}
+				break;
+			}
+		}
+	}
+	printf("%-22s build=%8.3fs search=%8.3fs (%7.3f ms/query) index=%9.2f MB  R@1=%.3f R@2=%.3f R@%d=%.3f\n",
+			name,
+			buildTime,
+			searchTime,
+			indices.rows?searchTime*1000.0/indices.rows:0.0,
+			double(memory)/(1024.0*1024.0),
+			indices.rows?double(found[0])/indices.rows:0.0,
+			indices.rows?double(found[k>1?1:0])/indices.rows:0.0,
+			k,
+			indices.rows?double(found[k-1])/indices.rows:0.0);
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	if(argc < 2)
+	{
+		showUsage();
+	}
+
+	int queriesCount = 1000;
+	int k = 10;
+	int subQuantizers = 16;
+	int centroids = Parameters::defaultKpPQCentroids();
+	int coarseCentroids = Parameters::defaultKpPQCoarseCentroids();
+	int nprobe = Parameters::defaultKpPQNProbe();
+	int rerank = Parameters::defaultKpPQRerank();
+	int checks = 32;
+	for(int i=1; i<argc-1; ++i)
+	{
+		if(strcmp(argv[i], "--queries") == 0 && i+1<argc-1)
+		{
+			queriesCount = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--k") == 0 && i+1<argc-1)
+		{
+			k = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--sub") == 0 && i+1<argc-1)
+		{
+			subQuantizers = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--centroids") == 0 && i+1<argc-1)
+		{
+			centroids = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--coarse") == 0 && i+1<argc-1)
+		{
+			coarseCentroids = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--nprobe") == 0 && i+1<argc-1)
+		{
+			nprobe = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--rerank") == 0 && i+1<argc-1)
+		{
+			rerank = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--checks") == 0 && i+1<argc-1)
+		{
+			checks = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--debug") == 0)
+		{
+			ULogger::setLevel(ULogger::kDebug);
+		}
+		else
+		{
+			showUsage();
+		}
+	}
+	if(queriesCount <= 0 || k <= 0 || subQuantizers <= 0 || coarseCentroids < 0 || nprobe <= 0 || rerank < 0 || checks <= 0)
+	{
+		showUsage();
+	}
+
+	std::string databasePath = uReplaceChar(argv[argc-1], '~', UDirectory::homeDir());
+	if(!UFile::exists(databasePath))
+	{
+		printf("Database \"%s\" doesn't exist!\n", databasePath.c_str());
+		return -1;
+	}
+
+	UTimer timer;
+	printf("Loading words of \"%s\"...\n", databasePath.c_str());
+	DBDriver * driver = DBDriver::create();
+	if(!driver->openConnection(databasePath))
+	{
+		printf("Cannot open database \"%s\".\n", databasePath.c_str());
+		delete driver;
+		return -1;
+	}
+	VWDictionary dictionary;
+	driver->load(&dictionary, false);
+	driver->closeConnection(false);
+	delete driver;
+
+	const std::map<int, VisualWord *> & words = dictionary.getVisualWords();
+	if(words.empty() || words.begin()->second->getDescriptor().type() != CV_32F)
+	{
+		printf("The database should contain visual words with float descriptors (words=%d).\n", (int)words.size());
+		dictionary.clear(false);
+		return -1;
+	}
+	int dim = words.begin()->second->getDescriptor().cols;
+	if(queriesCount*2 > (int)words.size())
+	{
+		queriesCount = (int)words.size()/2;
+	}
+	if(queriesCount == 0)
+	{
+		printf("Not enough visual words (%d) in the database.\n", (int)words.size());
+		dictionary.clear(false);
+		return -1;
+	}
+	if(dim % subQuantizers != 0)
+	{
+		printf("Descriptor size (%d) should be a multiple of the number of sub-quantizers (%d).\n", dim, subQuantizers);
+		dictionary.clear(false);
+		return -1;
+	}
+
+	// Hold out uniformly distributed query words from the dictionary
+	int step = (int)words.size()/queriesCount;
+	cv::Mat queries(queriesCount, dim, CV_32F);
+	cv::Mat base((int)words.size()-queriesCount, dim, CV_32F);
+	int q = 0;
+	int b = 0;
+	int n = 0;
+	for(std::map<int, VisualWord *>::const_iterator iter=words.begin(); iter!=words.end(); ++iter, ++n)
+	{
+		if(q < queriesCount && n % step == 0)
+		{
+			iter->second->getDescriptor().copyTo(queries.row(q++));
+		}
+		else
+		{
+			iter->second->getDescriptor().copyTo(base.row(b++));
+		}
+	}
+	UASSERT(q == queries.rows && b == base.rows);
+	dictionary.clear(false);
+	printf("Loading words... done (%fs, %d words, %d queries, dim=%d, raw descriptors=%.2f MB).\n",
+			timer.ticks(), base.rows, queries.rows, dim, double(base.total()*base.elemSize())/(1024.0*1024.0));
+
+	// Ground truth
+	std::vector<int> groundTruth(queries.rows, -1);
+	{
+		std::vector<std::vector<cv::DMatch> > matches;
+		cv::BFMatcher matcher(cv::NORM_L2SQR);
+		matcher.knnMatch(queries, base, matches, 1);
+		for(unsigned int i=0; i<matches.size(); ++i)
+		{
+			if(matches[i].size())
+			{
+				groundTruth[i] = matches[i][0].trainIdx;
+			}
+		}
+		printf("Exact search (brute force): %fs\n", timer.ticks());
+	}
+
+	// Kd-tree, same parameters than VWDictionary
+	{
+		FlannIndex index;
+		index.buildKDTreeIndex(base, 4, false, 1);
+		double buildTime = timer.ticks();
+		cv::Mat results;
+		cv::Mat dists;
+		index.knnSearch(queries, results, dists, k, checks);
+		double searchTime = timer.ticks();
+		cv::Mat indices(queries.rows, k, CV_32SC1, cv::Scalar::all(-1));
+		for(int i=0; i<results.rows; ++i)
+		{
+			for(int j=0; j<results.cols; ++j)
+			{
+				if (sizeof(size_t) == 8)
+				{
+					indices.at<int>(i,j) = *((size_t*)&results.at<double>(i, j));
+				}
+				else
+				{
+					indices.at<int>(i,j) = *((size_t*)&results.at<int>(i, j));
+				}
+			}
+		}
+		printRecall("KD-TREE", indices, groundTruth, k, buildTime, searchTime, index.memoryUsed());
+	}
+
+	// Product quantization
+	{
+		ProductQuantizer pq;
+		if(!pq.train(base, subQuantizers, centroids, 10, 65536, coarseCentroids))
+		{
+			printf("Failed to train product quantization.\n");
+			return -1;
+		}
+		pq.addPoints(base);
+		double buildTime = timer.ticks();
+		cv::Mat indices;
+		cv::Mat dists;
+		pq.knnSearch(queries, indices, dists, k, nprobe);
+		double searchTime = timer.ticks();
+		std::string method = coarseCentroids>0?uFormat("IVF-ADC %d/%d", nprobe, coarseCentroids):std::string("ADC");
+		printRecall(uFormat("PQ (%s)", method.c_str()).c_str(), indices, groundTruth, k, buildTime, searchTime, pq.memoryUsed());
+
+		if(rerank > 0)
+		{
+			pq.knnSearch(queries, indices, dists, rerank>k?rerank:k, nprobe);
+			cv::Mat reranked(queries.rows, k, CV_32SC1, cv::Scalar::all(-1));
+			for(int i=0; i<indices.rows; ++i)
+			{
+				std::vector<cv::DMatch> candidates;
+				for(int j=0; j<indices.cols && indices.at<int>(i,j)>=0; ++j)
+				{
+					int index = indices.at<int>(i,j);
+					candidates.push_back(cv::DMatch(i, index, (float)cv::norm(queries.row(i), base.row(index), cv::NORM_L2SQR)));
+				}
+				std::sort(candidates.begin(), candidates.end());
+				for(int j=0; j<k && j<(int)candidates.size(); ++j)
+				{
+					reranked.at<int>(i,j) = candidates[j].trainIdx;
+				}
+			}
+			searchTime = timer.ticks();
+			printRecall(uFormat("PQ (%s+rerank %d)", method.c_str(), rerank).c_str(), reranked, groundTruth, k, buildTime, searchTime, pq.memoryUsed());
+		}
+	}
+
+	return 0;
+}
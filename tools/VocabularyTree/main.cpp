@@ -0,0 +1,270 @@
+/*
+Copyright (c) 2010-2016, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <rtabmap/core/DBDriver.h>
+#include <rtabmap/core/VWDictionary.h>
+#include <rtabmap/core/VisualWord.h>
+#include <rtabmap/core/FlannIndex.h>
+#include <rtabmap/core/VocabularyTree.h>
+#include <rtabmap/core/Parameters.h>
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UDirectory.h>
+#include <rtabmap/utilite/UStl.h>
+#include <opencv2/features2d/features2d.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("\nUsage:\n"
+			"rtabmap-vocabulary_tree [options] \"input.db\" \"output.db\"\n"
+			"  Train a vocabulary tree (hierarchical k-means) on the visual words of\n"
+			"  \"input.db\". The leaves of the tree are saved as the words of the fixed\n"
+			"  dictionary \"output.db\" and the tree is saved in \"output.db.tree\". Set\n"
+			"  %s to \"output.db\" and %s=%d to use it.\n"
+			"  Options:\n"
+			"     --branching #            Children per node (default 10).\n"
+			"     --depth #                Maximum depth, up to branching^depth words (default 5).\n"
+			"     --iterations #           K-means iterations per node (default 10).\n"
+			"     --queries #              Input words quantized to compare the tree with\n"
+			"                              exact and kd-tree search (default 1000).\n"
+			"     --debug                  Show debug log.\n"
+			"  Example, comparing the tree with the FLANN kd-tree (%s=%d) on the\n"
+			"  replay of a dataset with the same fixed dictionary:\n"
+			"   $ rtabmap-vocabulary_tree map.db voc.db\n"
+			"   $ rtabmap-benchmark --json kdtree.json --Kp/IncrementalDictionary false \\\n"
+			"       --Kp/DictionaryPath voc.db --Kp/NNStrategy %d dataset.db\n"
+			"   $ rtabmap-benchmark --json tree.json --baseline kdtree.json \\\n"
+			"       --stages \"TimingMem/Add_new_words/ms;Rtabmap/Process/ms\" \\\n"
+			"       --Kp/IncrementalDictionary false \\\n"
+			"       --Kp/DictionaryPath voc.db --Kp/NNStrategy %d dataset.db\n"
+			"\n",
+			Parameters::kKpDictionaryPath().c_str(),
+			Parameters::kKpNNStrategy().c_str(),
+			(int)VWDictionary::kNNVocabularyTree,
+			Parameters::kKpNNStrategy().c_str(),
+			(int)VWDictionary::kNNFlannKdTree,
+			(int)VWDictionary::kNNFlannKdTree,
+			(int)VWDictionary::kNNVocabularyTree);
+	exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	if(argc < 3)
+	{
+		showUsage();
+	}
+
+	int branching = 10;
+	int depth = 5;
+	int iterations = 10;
+	int queriesCount = 1000;
+	for(int i=1; i<argc-2; ++i)
+	{
+		if(strcmp(argv[i], "--branching") == 0 && i+1<argc-2)
+		{
+			branching = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--depth") == 0 && i+1<argc-2)
+		{
+			depth = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--iterations") == 0 && i+1<argc-2)
+		{
+			iterations = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--queries") == 0 && i+1<argc-2)
+		{
+			queriesCount = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--debug") == 0)
+		{
+			ULogger::setLevel(ULogger::kDebug);
+		}
+		else
+		{
+			showUsage();
+		}
+	}
+	if(branching < 2 || depth <= 0 || iterations <= 0 || queriesCount < 0)
+	{
+		showUsage();
+	}
+
+	std::string inputPath = uReplaceChar(argv[argc-2], '~', UDirectory::homeDir());
+	std::string outputPath = uReplaceChar(argv[argc-1], '~', UDirectory::homeDir());
+	if(!UFile::exists(inputPath))
+	{
+		printf("Database \"%s\" doesn't exist!\n", inputPath.c_str());
+		return -1;
+	}
+	if(UFile::getExtension(outputPath).compare("db") != 0)
+	{
+		printf("Output \"%s\" should be a database (*.db).\n", outputPath.c_str());
+		return -1;
+	}
+	if(inputPath.compare(outputPath) == 0)
+	{
+		printf("Output database should not be the input database.\n");
+		return -1;
+	}
+
+	UTimer timer;
+	printf("Loading words of \"%s\"...\n", inputPath.c_str());
+	DBDriver * driver = DBDriver::create();
+	if(!driver->openConnection(inputPath))
+	{
+		printf("Cannot open database \"%s\".\n", inputPath.c_str());
+		delete driver;
+		return -1;
+	}
+	VWDictionary dictionary;
+	driver->load(&dictionary, false);
+	driver->closeConnection(false);
+	delete driver;
+
+	const std::map<int, VisualWord *> & words = dictionary.getVisualWords();
+	if(words.empty())
+	{
+		printf("No visual words found in \"%s\".\n", inputPath.c_str());
+		return -1;
+	}
+	int dim = words.begin()->second->getDescriptor().cols;
+	int type = words.begin()->second->getDescriptor().type();
+	if(type != CV_32F && type != CV_8U)
+	{
+		printf("Visual words should have float or binary descriptors.\n");
+		dictionary.clear(false);
+		return -1;
+	}
+	cv::Mat features((int)words.size(), dim, type);
+	int n = 0;
+	for(std::map<int, VisualWord *>::const_iterator iter=words.begin(); iter!=words.end(); ++iter, ++n)
+	{
+		if(iter->second->getDescriptor().cols != dim || iter->second->getDescriptor().type() != type)
+		{
+			printf("Visual word %d has not the same descriptor size or type than the other words.\n", iter->first);
+			dictionary.clear(false);
+			return -1;
+		}
+		iter->second->getDescriptor().copyTo(features.row(n));
+	}
+	dictionary.clear(false);
+	printf("Loading words... done (%fs, %d words, dim=%d, %s).\n",
+			timer.ticks(), features.rows, dim, type==CV_8U?"binary":"float");
+
+	printf("Training vocabulary tree (branching=%d depth=%d iterations=%d)...\n", branching, depth, iterations);
+	VocabularyTree tree;
+	tree.build(features, branching, 1, depth, iterations);
+	cv::Mat leaves = tree.convertLeavesToWords();
+	printf("Training vocabulary tree... done (%fs, %d words, depth=%d, tree=%.2f MB).\n",
+			timer.ticks(), leaves.rows, tree.depth(), double(tree.memoryUsed())/(1024.0*1024.0));
+
+	printf("Saving dictionary \"%s\"...\n", outputPath.c_str());
+	driver = DBDriver::create();
+	if(!driver->openConnection(outputPath, true))
+	{
+		printf("Cannot create database \"%s\".\n", outputPath.c_str());
+		delete driver;
+		return -1;
+	}
+	for(int i=0; i<leaves.rows; ++i)
+	{
+		// Ids follow the leaf order, like the rows of the dictionary search index
+		driver->asyncSave(new VisualWord(VWDictionary::ID_START+i, leaves.row(i).clone()));
+	}
+	driver->emptyTrashes();
+	driver->closeConnection(true);
+	delete driver;
+	if(!tree.save(outputPath + ".tree"))
+	{
+		printf("Cannot save vocabulary tree \"%s\".\n", (outputPath + ".tree").c_str());
+		return -1;
+	}
+	printf("Saving dictionary... done (%fs).\n", timer.ticks());
+
+	if(queriesCount > 0)
+	{
+		// Quantize uniformly distributed input words
+		if(queriesCount > features.rows)
+		{
+			queriesCount = features.rows;
+		}
+		int step = features.rows/queriesCount;
+		cv::Mat queries(queriesCount, dim, type);
+		for(int i=0; i<queriesCount; ++i)
+		{
+			features.row(i*step).copyTo(queries.row(i));
+		}
+		timer.restart();
+
+		std::vector<std::vector<cv::DMatch> > treeMatches;
+		tree.knnSearch(queries, treeMatches, 1);
+		double treeTime = timer.ticks();
+
+		std::vector<std::vector<cv::DMatch> > exactMatches;
+		cv::BFMatcher matcher(type==CV_8U?cv::NORM_HAMMING:cv::NORM_L2SQR);
+		matcher.knnMatch(queries, leaves, exactMatches, 1);
+		double exactTime = timer.ticks();
+
+		int agreement = 0;
+		for(int i=0; i<queriesCount; ++i)
+		{
+			if(treeMatches[i].size() && exactMatches[i].size() &&
+			   (treeMatches[i][0].trainIdx == exactMatches[i][0].trainIdx ||
+				treeMatches[i][0].distance == exactMatches[i][0].distance))
+			{
+				++agreement;
+			}
+		}
+		printf("Quantization of %d words:\n", queriesCount);
+		printf("  %-16s %8.3f ms/word\n", "Brute force", exactTime*1000.0/queriesCount);
+		printf("  %-16s %8.3f ms/word (same word as brute force: %.1f%%)\n", "Vocabulary tree", treeTime*1000.0/queriesCount, 100.0*double(agreement)/queriesCount);
+		if(type == CV_32F)
+		{
+			// Same parameters than VWDictionary
+			FlannIndex index;
+			index.buildKDTreeIndex(leaves, 4, false, 1);
+			timer.restart();
+			cv::Mat results;
+			cv::Mat dists;
+			index.knnSearch(queries, results, dists, 1, 32);
+			printf("  %-16s %8.3f ms/word\n", "FLANN kd-tree", timer.ticks()*1000.0/queriesCount);
+		}
+	}
+
+	return 0;
+}
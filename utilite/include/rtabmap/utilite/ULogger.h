@@ -48,7 +48,8 @@
 /*
  * Convenient macros for logging...
  */
-#define ULOGGER_LOG(level, ...) ULogger::write(level, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+// The level is checked inline so that filtered out messages cost only a comparison
+#define ULOGGER_LOG(level, ...) (ULogger::isLogged(level)?ULogger::write(level, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__):(void)0)
 
 #define ULOGGER_DEBUG(...)   ULOGGER_LOG(ULogger::kDebug,   __VA_ARGS__)
 #define ULOGGER_INFO(...)    ULOGGER_LOG(ULogger::kInfo,    __VA_ARGS__)
@@ -325,6 +326,32 @@ public:
     static void setBuffered(bool buffered);
     static bool isBuffered() {return buffered_;}
 
+    /**
+     * Set if the logger writes messages asynchronously, default false. When true,
+     * the calling thread only formats the message body in a per-thread ring buffer
+     * (without taking the logger's mutex), and a background thread adds the
+     * header (level, time, where...) and writes it to console/file. If the ring buffer
+     * of a thread is full, the message is dropped (see getAsyncDroppedMessages()).
+     * Messages too long for a slot of the ring buffer, fatal messages and those sent
+     * as ULogEvent are written synchronously, after pending messages are flushed.
+     * @param async true to write messages in a background thread, otherwise set to false.
+     * @param bufferSize number of messages that can be pending per thread.
+     */
+    static void setAsync(bool async, int bufferSize = 256);
+    static bool isAsync();
+
+    /**
+     * Number of messages dropped since the beginning because a ring buffer was full.
+     * @see setAsync()
+     */
+    static unsigned long getAsyncDroppedMessages();
+
+    /**
+     * Number of messages written by the asynchronous writer since the beginning.
+     * @see setAsync()
+     */
+    static unsigned long getAsyncWrittenMessages();
+
     /**
      * Set logger level: default kInfo. All messages over the severity set
      * are printed, other are ignored. The severity is from the lowest to
@@ -339,6 +366,16 @@ public:
     static void setLevel(ULogger::Level level) {level_ = level;}
     static ULogger::Level level() {return level_;}
 
+    /**
+     * Return true if a message at this level would be written to
+     * the logger or sent as ULogEvent. Used by the logging macros
+     * to skip formatting of filtered messages.
+     */
+    static bool isLogged(ULogger::Level level)
+    {
+    	return level >= eventLevel_ || (level >= level_ && (type_ != kTypeNoLog || level >= kFatal));
+    }
+
 	/**
 	 * An ULogEvent is sent on each message logged at the specified level.
 	 * Note : On message with level >= exitLevel, the event is sent synchronously (see UEventsManager::post()).
@@ -444,6 +481,7 @@ protected:
      * @see Destroyer
      */
     friend class UDestroyer<ULogger>;
+    friend class UAsyncLogWriter;
     
     /*
      * The log file name.
@@ -475,6 +513,24 @@ private:
     virtual void _write(const char*, va_list) {} // Do nothing by default
     virtual void _writeStr(const char*) {} // Do nothing by default
 
+    /*
+     * Header of a message: "[level] {thread id} (time) file:line::function() ".
+     * Must be protected by loggerMutex_.
+     */
+    static std::string formatHeader(
+    		ULogger::Level level,
+    		const char * file,
+    		int line,
+    		const char * function,
+    		unsigned long threadId,
+    		const std::string & time);
+
+    /*
+     * Write all messages pending in the asynchronous ring buffers.
+     * Must NOT be called with loggerMutex_ locked.
+     */
+    static void drainAsync();
+
 private:
     /*
      * The Logger instance pointer.
@@ -568,6 +624,8 @@ private:
 
 	static std::string bufferedMsgs_;
 
+	static int asyncBufferSize_;
+
 	static std::set<unsigned long> threadIdFilter_;
 	static std::map<std::string, unsigned long> registeredThreads_;
 };
@@ -0,0 +1,195 @@
+/*
+*  utilite is a cross-platform library with
+*  useful utilities for fast and small developing.
+*  Copyright (C) 2010  Mathieu Labbe
+*
+*  utilite is free library: you can redistribute it and/or modify
+*  it under the terms of the GNU Lesser General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  utilite is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef UPROFILER_H
+#define UPROFILER_H
+
+#include "rtabmap/utilite/UtiLiteExp.h" // DLL export/import defines
+
+#include "rtabmap/utilite/UMutex.h"
+#include "rtabmap/utilite/UTimer.h"
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+
+/**
+ * \file UProfiler.h
+ * \brief UProfiler class and convenient macro
+ *
+ * Scoped zones are recorded from their construction to the end of
+ * the scope, with the thread in which they are created. Zones of the
+ * same thread are nested by their time interval, so no call stack has to be maintained.
+ * @code
+ * void Foo::bar()
+ * {
+ *    UPROFILER_ZONE("Foo::bar");
+ *    ...
+ *    {
+ *       UPROFILER_ZONE("Foo::bar/matching");
+ *       ...
+ *    }
+ * }
+ * ...
+ * UProfiler::setEnabled(true);
+ * foo.bar();
+ * UProfiler::exportChromeTrace("trace.json");
+ * @endcode
+ */
+
+#define UPROFILER_CONCAT_(a, b) a##b
+#define UPROFILER_CONCAT(a, b) UPROFILER_CONCAT_(a, b)
+
+/**
+ * \def UPROFILER_ZONE(name)
+ * Record the current scope as a zone. The name must be a string
+ * literal (only its pointer is kept). When the profiler is disabled,
+ * the cost is a boolean check.
+ */
+#define UPROFILER_ZONE(name) UProfilerZone UPROFILER_CONCAT(uProfilerZone, __LINE__)(name)
+
+/**
+ * Global recorder of zones. Zones are accumulated in memory until they
+ * are exported or cleared. When the maximum number of zones is
+ * reached, new zones are dropped. Many owners can share the recorder:
+ * enabling is reference counted and each owner can export only the
+ * zones of the threads it runs in (see setThreadOwned() and exportTrace()).
+ */
+class UTILITE_EXP UProfiler
+{
+public:
+	/**
+	 * Enable/disable the recording of zones, default disabled. Calls are
+	 * counted: zones are recorded until setEnabled(false) has been called as
+	 * many times as setEnabled(true).
+	 */
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	/**
+	 * Set a thread as owned by an owner exporting its zones with exportTrace().
+	 * Calls are counted like setEnabled(). Zones of threads not owned
+	 * (e.g., worker threads) are exported by the next owner exporting.
+	 */
+	static void setThreadOwned(unsigned long threadId, bool owned);
+
+	/**
+	 * Maximum number of zones kept in memory, default 1000000.
+	 */
+	static void setMaxZones(unsigned int maxZones);
+
+	/**
+	 * Remove all recorded zones.
+	 */
+	static void clear();
+
+	/**
+	 * Number of zones recorded.
+	 */
+	static unsigned int size();
+
+	/**
+	 * Number of zones dropped because the maximum was reached.
+	 */
+	static unsigned long droppedZones();
+
+	/**
+	 * Export zones in Chrome trace event format (JSON), which can be opened
+	 * in chrome://tracing or https://ui.perfetto.dev. Threads registered
+	 * with ULogger::registerCurrentThread() are named.
+	 * @param path the output file
+	 * @param clear remove exported zones
+	 * @return false if the file cannot be written
+	 */
+	static bool exportChromeTrace(const std::string & path, bool clear = false);
+
+	/**
+	 * Export zones as folded stacks ("thread;zone;child self_time_us" per line), the
+	 * input format of flamegraph.pl and speedscope.
+	 * @param path the output file
+	 * @param clear remove exported zones
+	 * @return false if the file cannot be written
+	 */
+	static bool exportFoldedStacks(const std::string & path, bool clear = false);
+
+	/**
+	 * Export the same zones in both formats above.
+	 * @param chromeTracePath the Chrome trace output file, not written if empty
+	 * @param foldedStacksPath the folded stacks output file, not written if empty
+	 * @param clear remove exported zones
+	 * @param threadIds if not null, only zones recorded in these threads and in threads
+	 *        not owned (see setThreadOwned()) are exported (and removed)
+	 * @return false if a file cannot be written
+	 */
+	static bool exportTrace(
+			const std::string & chromeTracePath,
+			const std::string & foldedStacksPath,
+			bool clear = false,
+			const std::set<unsigned long> * threadIds = 0);
+
+	/*
+	 * Called by UProfilerZone.
+	 */
+	static void addZone(const char * name, double start, double end);
+
+private:
+	struct Zone
+	{
+		const char * name;
+		unsigned long threadId;
+		double start; // s
+		double end;   // s
+	};
+	static std::vector<Zone> takeZones(bool clear, const std::set<unsigned long> * threadIds = 0);
+	static bool writeChromeTrace(const std::string & path, const std::vector<Zone> & zones);
+	static bool writeFoldedStacks(const std::string & path, const std::vector<Zone> & zones);
+
+private:
+	static unsigned int maxZones_;
+	static unsigned long dropped_;
+	static std::vector<Zone> zones_;
+	static std::map<unsigned long, int> ownedThreads_; // <thread id, owners>
+	static UMutex mutex_;
+};
+
+/**
+ * Zone recorded from construction to destruction. Use UPROFILER_ZONE().
+ */
+class UTILITE_EXP UProfilerZone
+{
+public:
+	UProfilerZone(const char * name) :
+		name_(name),
+		start_(UProfiler::isEnabled()?UTimer::now():0.0)
+	{}
+	~UProfilerZone()
+	{
+		if(start_ > 0.0)
+		{
+			UProfiler::addZone(name_, start_, UTimer::now());
+		}
+	}
+
+private:
+	const char * name_;
+	double start_;
+};
+
+#endif /* UPROFILER_H */
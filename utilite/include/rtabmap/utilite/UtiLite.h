@@ -163,6 +163,10 @@
   * \section processinfo UProcessInfo
   * This class can be used to get the process memory usage: UProcessInfo::getMemoryUsage().
   *
+  * \section profiler UProfiler
+  * Use macro UPROFILER_ZONE() to record scoped zones, then export them with
+  * UProfiler::exportChromeTrace() or UProfiler::exportFoldedStacks() (flame graphs).
+  *
   * \section qtLib Qt Widgets (libutilite_qt.so : OPTIONAL)
   * If Qt is found on the system, the UtiLite Qt library (libutilite_qt.so, libutilite_qt.dll) with
   * useful widgets is built. Use class UPlot to create a plot like MATLAB, and incrementally add
@@ -243,6 +247,7 @@
 #include "rtabmap/utilite/UEventsHandler.h"
 #include "rtabmap/utilite/UEvent.h"
 #include "rtabmap/utilite/UProcessInfo.h"
+#include "rtabmap/utilite/UProfiler.h"
 #include "rtabmap/utilite/UMutex.h"
 #include "rtabmap/utilite/USemaphore.h"
 #include "rtabmap/utilite/UThreadNode.h"
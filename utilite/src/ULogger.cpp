@@ -22,9 +22,18 @@
 #include "rtabmap/utilite/UFile.h"
 #include "rtabmap/utilite/UStl.h"
 #include "rtabmap/utilite/UEventsManager.h"
+#include "rtabmap/utilite/UThread.h"
+#include "rtabmap/utilite/USemaphore.h"
 #include <fstream>
 #include <string>
 #include <string.h>
+#include <list>
+#include <vector>
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#define ULOGGER_ASYNC_SUPPORTED
+#include <atomic>
+#endif
 
 #ifndef _WIN32
 #include <sys/time.h>
@@ -43,6 +52,29 @@
 #define COLOR_YELLOW "\033[33m"
 #endif
 
+#ifdef _WIN32
+typedef int UColor;
+#else
+typedef const char * UColor;
+#endif
+
+static UColor levelColor(ULogger::Level level)
+{
+	switch(level)
+	{
+	case ULogger::kDebug:
+		return COLOR_GREEN;
+	case ULogger::kWarning:
+		return COLOR_YELLOW;
+	case ULogger::kError:
+	case ULogger::kFatal:
+		return COLOR_RED;
+	default:
+		break;
+	}
+	return COLOR_NORMAL;
+}
+
 bool ULogger::append_ = true;
 bool ULogger::printTime_ = true;
 bool ULogger::printLevel_ = true;
@@ -65,6 +97,15 @@ std::string ULogger::logFileName_;
 std::string ULogger::bufferedMsgs_;
 std::set<unsigned long> ULogger::threadIdFilter_;
 std::map<std::string, unsigned long> ULogger::registeredThreads_;
+// If the logger writes messages in a background thread, read by the
+// logging threads without taking the logger's mutex. Kept out of the
+// header so that its type doesn't depend on the includer's C++ standard.
+#ifdef ULOGGER_ASYNC_SUPPORTED
+static std::atomic<bool> asyncEnabled(false);
+#else
+static bool asyncEnabled = false;
+#endif
+int ULogger::asyncBufferSize_ = 256;
 
 /**
  * This class is used to write logs in the console. This class cannot
@@ -173,6 +214,227 @@ private:
     std::string bufferedMsgs_;
 };
 
+#ifdef ULOGGER_ASYNC_SUPPORTED
+/*
+ * A message logged asynchronously. The file and function
+ * strings come from __FILE__ and __FUNCTION__, so only
+ * their pointers are kept.
+ */
+struct UAsyncLogRecord
+{
+	enum {kMessageSize = 512};
+	ULogger::Level level;
+	const char * file;
+	int line;
+	const char * function;
+	unsigned long threadId;
+	time_t sec;
+	int usec;
+	char msg[kMessageSize];
+};
+
+/*
+ * Single producer (the thread owning the buffer) / single
+ * consumer (the writer, serialized by asyncDrainMutex) ring buffer.
+ */
+class UAsyncLogBuffer
+{
+public:
+	UAsyncLogBuffer(int size) :
+		records_(size),
+		head_(0),
+		tail_(0),
+		dropped_(0),
+		orphaned_(false)
+	{}
+
+	// Producer side
+	UAsyncLogRecord * reserve()
+	{
+		unsigned long head = head_.load(std::memory_order_relaxed);
+		if(head - tail_.load(std::memory_order_acquire) >= records_.size())
+		{
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			return 0;
+		}
+		return &records_[head % records_.size()];
+	}
+	void commit()
+	{
+		head_.store(head_.load(std::memory_order_relaxed)+1, std::memory_order_release);
+	}
+	void setOrphaned()
+	{
+		orphaned_.store(true, std::memory_order_release);
+	}
+
+	// Consumer side
+	const UAsyncLogRecord * front() const
+	{
+		unsigned long tail = tail_.load(std::memory_order_relaxed);
+		if(tail == head_.load(std::memory_order_acquire))
+		{
+			return 0;
+		}
+		return &records_[tail % records_.size()];
+	}
+	void pop()
+	{
+		tail_.store(tail_.load(std::memory_order_relaxed)+1, std::memory_order_release);
+	}
+	bool isOrphaned() const {return orphaned_.load(std::memory_order_acquire);}
+	unsigned long dropped() const {return dropped_.load(std::memory_order_relaxed);}
+
+private:
+	std::vector<UAsyncLogRecord> records_;
+	std::atomic<unsigned long> head_;
+	std::atomic<unsigned long> tail_;
+	std::atomic<unsigned long> dropped_;
+	std::atomic<bool> orphaned_;
+};
+
+/*
+ * Owns the reference of the thread on its buffer. When the
+ * thread exits, the buffer is flagged orphaned and the writer
+ * deletes it once emptied.
+ */
+struct UAsyncLogBufferHolder
+{
+	UAsyncLogBufferHolder() : buffer(0) {}
+	~UAsyncLogBufferHolder()
+	{
+		if(buffer)
+		{
+			buffer->setOrphaned();
+		}
+	}
+	UAsyncLogBuffer * buffer;
+};
+
+static thread_local UAsyncLogBufferHolder asyncLocalBuffer;
+static UMutex asyncBuffersMutex; // protects asyncBuffers and asyncRemovedDropped
+static std::list<UAsyncLogBuffer*> asyncBuffers;
+static unsigned long asyncRemovedDropped = 0;
+static UMutex asyncDrainMutex; // a single consumer at a time, protects the counters below
+static unsigned long asyncWritten = 0;
+static unsigned long asyncReportedDropped = 0;
+
+enum UAsyncPushStatus {kAsyncPushed, kAsyncDropped, kAsyncTooLong};
+
+static UAsyncPushStatus pushAsync(
+		int bufferSize,
+		ULogger::Level level,
+		const char * file,
+		int line,
+		const char * function,
+		const char * msg,
+		va_list args)
+{
+	if(asyncLocalBuffer.buffer == 0)
+	{
+		asyncLocalBuffer.buffer = new UAsyncLogBuffer(bufferSize);
+		asyncBuffersMutex.lock();
+		asyncBuffers.push_back(asyncLocalBuffer.buffer);
+		asyncBuffersMutex.unlock();
+	}
+
+	UAsyncLogRecord * record = asyncLocalBuffer.buffer->reserve();
+	if(record == 0)
+	{
+		return kAsyncDropped;
+	}
+
+	int size = vsnprintf(record->msg, UAsyncLogRecord::kMessageSize, msg, args);
+	if(size < 0 || size >= UAsyncLogRecord::kMessageSize)
+	{
+		// The slot is not committed, it will be reused.
+		return kAsyncTooLong;
+	}
+	record->level = level;
+	record->file = file;
+	record->line = line;
+	record->function = function;
+	record->threadId = UThread::currentThreadId();
+#ifdef _WIN32
+	record->sec = time(0);
+	record->usec = 0;
+#else
+	struct timeval rawtime;
+	gettimeofday(&rawtime, NULL);
+	record->sec = rawtime.tv_sec;
+	record->usec = (int)rawtime.tv_usec;
+#endif
+	asyncLocalBuffer.buffer->commit();
+	return kAsyncPushed;
+}
+
+static void formatTime(std::string & timeStr, time_t sec, int usec)
+{
+	struct tm timeinfo;
+#ifdef _MSC_VER
+	localtime_s(&timeinfo, &sec);
+#elif defined(_WIN32)
+	timeinfo = *localtime(&sec);
+#else
+	localtime_r(&sec, &timeinfo);
+#endif
+	timeStr.append(uFormat("%d-%02d-%02d %02d:%02d:%02d.%03d",
+		timeinfo.tm_year+1900,
+		timeinfo.tm_mon+1,
+		timeinfo.tm_mday,
+		timeinfo.tm_hour,
+		timeinfo.tm_min,
+		timeinfo.tm_sec,
+		usec/1000));
+}
+
+/*
+ * Background thread writing messages of the ring buffers. It wakes
+ * up periodically, or when the logger is flushed or stopped.
+ */
+class UAsyncLogWriter : public UThread
+{
+public:
+	UAsyncLogWriter(int periodMs) : periodMs_(periodMs) {}
+	virtual ~UAsyncLogWriter()
+	{
+		this->join(true);
+	}
+
+private:
+	virtual void mainLoopKill()
+	{
+		wakeUp_.release();
+	}
+	virtual void mainLoop()
+	{
+		wakeUp_.acquire(1, periodMs_);
+		if(!this->isKilled())
+		{
+			ULogger::drainAsync();
+		}
+	}
+
+private:
+	int periodMs_;
+	USemaphore wakeUp_;
+};
+
+static UMutex asyncWriterMutex;
+static UAsyncLogWriter * asyncWriter = 0;
+
+/*
+ * Defined after ULogger::destroyer_, so it is destroyed before
+ * the logger instance: pending messages are written at exit.
+ */
+class UAsyncLogShutdown
+{
+public:
+	~UAsyncLogShutdown() {ULogger::setAsync(false);}
+};
+static UAsyncLogShutdown asyncShutdown;
+#endif // ULOGGER_ASYNC_SUPPORTED
+
 void ULogger::setType(Type type, const std::string &fileName, bool append)
 {
 	ULogger::flush();
@@ -254,6 +516,7 @@ std::map<std::string, unsigned long> ULogger::getRegisteredThreads()
 
 void ULogger::reset()
 {
+	ULogger::setAsync(false);
 	ULogger::setType(ULogger::kTypeNoLog);
 	append_ = true;
 	printTime_ = true;
@@ -277,9 +540,179 @@ void ULogger::setBuffered(bool buffered)
 	buffered_ = buffered;
 }
 
+void ULogger::setAsync(bool async, int bufferSize)
+{
+#ifdef ULOGGER_ASYNC_SUPPORTED
+	UASSERT(bufferSize > 0);
+	asyncWriterMutex.lock();
+	if(async)
+	{
+		asyncBufferSize_ = bufferSize;
+		if(asyncWriter == 0)
+		{
+			asyncWriter = new UAsyncLogWriter(10);
+			asyncWriter->start();
+		}
+		asyncEnabled = true;
+	}
+	else if(asyncWriter)
+	{
+		asyncEnabled = false;
+		asyncWriter->join(true);
+		delete asyncWriter;
+		asyncWriter = 0;
+		drainAsync();
+	}
+	asyncWriterMutex.unlock();
+#else
+	if(async)
+	{
+		UWARN("Asynchronous logging requires C++11, messages will be written synchronously.");
+	}
+#endif
+}
+
+bool ULogger::isAsync()
+{
+	return asyncEnabled;
+}
+
+unsigned long ULogger::getAsyncDroppedMessages()
+{
+	unsigned long dropped = 0;
+#ifdef ULOGGER_ASYNC_SUPPORTED
+	asyncBuffersMutex.lock();
+	dropped = asyncRemovedDropped;
+	for(std::list<UAsyncLogBuffer*>::iterator iter=asyncBuffers.begin(); iter!=asyncBuffers.end(); ++iter)
+	{
+		dropped += (*iter)->dropped();
+	}
+	asyncBuffersMutex.unlock();
+#endif
+	return dropped;
+}
+
+unsigned long ULogger::getAsyncWrittenMessages()
+{
+	unsigned long written = 0;
+#ifdef ULOGGER_ASYNC_SUPPORTED
+	asyncDrainMutex.lock();
+	written = asyncWritten;
+	asyncDrainMutex.unlock();
+#endif
+	return written;
+}
+
+void ULogger::drainAsync()
+{
+#ifdef ULOGGER_ASYNC_SUPPORTED
+	asyncDrainMutex.lock();
+
+	asyncBuffersMutex.lock();
+	std::list<UAsyncLogBuffer*> buffers = asyncBuffers;
+	asyncBuffersMutex.unlock();
+
+	std::list<UAsyncLogBuffer*> orphaned;
+	unsigned long dropped = 0;
+	loggerMutex_.lock();
+	for(std::list<UAsyncLogBuffer*>::iterator iter=buffers.begin(); iter!=buffers.end(); ++iter)
+	{
+		// Check before draining: nothing can be added after the flag is set
+		if((*iter)->isOrphaned())
+		{
+			orphaned.push_back(*iter);
+		}
+		const UAsyncLogRecord * record;
+		while((record = (*iter)->front()) != 0)
+		{
+			if(instance_ &&
+				(threadIdFilter_.empty() || threadIdFilter_.find(record->threadId) != threadIdFilter_.end()))
+			{
+				std::string time;
+				if(printTime_)
+				{
+					time.append("(");
+					formatTime(time, record->sec, record->usec);
+					time.append(") ");
+				}
+				std::string msg = formatHeader(record->level, record->file, record->line, record->function, record->threadId, time);
+				msg.append(record->msg);
+				if(printEndline_)
+				{
+					msg.append("\r\n");
+				}
+
+				if(type_ == ULogger::kTypeConsole && printColored_)
+				{
+#ifdef _WIN32
+					HANDLE H = GetStdHandle(STD_OUTPUT_HANDLE);
+					SetConsoleTextAttribute(H, levelColor(record->level));
+#else
+					msg.insert(0, levelColor(record->level));
+					msg.append(COLOR_NORMAL);
+#endif
+				}
+
+				if(buffered_)
+				{
+					bufferedMsgs_.append(msg);
+				}
+				else
+				{
+					instance_->_writeStr(msg.c_str());
+				}
+#ifdef _WIN32
+				if(type_ == ULogger::kTypeConsole && printColored_)
+				{
+					SetConsoleTextAttribute(H, COLOR_NORMAL);
+				}
+#endif
+			}
+			(*iter)->pop();
+			++asyncWritten;
+		}
+		dropped += (*iter)->dropped();
+	}
+
+	if(orphaned.size())
+	{
+		asyncBuffersMutex.lock();
+		for(std::list<UAsyncLogBuffer*>::iterator iter=orphaned.begin(); iter!=orphaned.end(); ++iter)
+		{
+			asyncRemovedDropped += (*iter)->dropped();
+			asyncBuffers.remove(*iter);
+			delete *iter;
+		}
+		asyncBuffersMutex.unlock();
+	}
+
+	dropped += asyncRemovedDropped;
+	if(dropped > asyncReportedDropped && instance_ && type_ != kTypeNoLog)
+	{
+		std::string msg = uFormat("[ WARN] ULogger: %lu messages dropped (asynchronous buffer full, %lu dropped in total).%s",
+				dropped - asyncReportedDropped, dropped, printEndline_?"\r\n":"");
+		if(buffered_)
+		{
+			bufferedMsgs_.append(msg);
+		}
+		else
+		{
+			instance_->_writeStr(msg.c_str());
+		}
+	}
+	asyncReportedDropped = dropped;
+	loggerMutex_.unlock();
+
+	asyncDrainMutex.unlock();
+#endif
+}
+
 
 void ULogger::flush()
 {
+	// Drain even if asynchronous logging has just been disabled,
+	// messages pushed before can still be pending
+	drainAsync();
 	loggerMutex_.lock();
 	if(!instance_ || bufferedMsgs_.size()==0)
 	{
@@ -364,6 +797,29 @@ void ULogger::write(ULogger::Level level,
 		const char* msg,
 		...)
 {
+	if(asyncEnabled)
+	{
+		if(level < kFatal && level < eventLevel_)
+		{
+			if(type_ == kTypeNoLog || level < level_ || (strlen(msg) == 0 && !printWhere_))
+			{
+				return;
+			}
+#ifdef ULOGGER_ASYNC_SUPPORTED
+			va_list args;
+			va_start(args, msg);
+			UAsyncPushStatus status = pushAsync(asyncBufferSize_, level, file, line, function, msg, args);
+			va_end(args);
+			if(status != kAsyncTooLong)
+			{
+				return;
+			}
+#endif
+		}
+		// Written synchronously below, keep the order with pending messages
+		drainAsync();
+	}
+
 	loggerMutex_.lock();
 	if(type_ == kTypeNoLog && level < kFatal && level < eventLevel_)
 	{
@@ -386,29 +842,7 @@ void ULogger::write(ULogger::Level level,
 
     if(level >= level_ || level >= eventLevel_)
     {
-#ifdef _WIN32
-    	int color = 0;
-#else
-    	const char* color = NULL;
-#endif
-    	switch(level)
-    	{
-    	case kDebug:
-    		color = COLOR_GREEN;
-    		break;
-    	case kInfo:
-    		color = COLOR_NORMAL;
-    		break;
-    	case kWarning:
-    		color = COLOR_YELLOW;
-    		break;
-    	case kError:
-    	case kFatal:
-    		color = COLOR_RED;
-    		break;
-    	default:
-    		break;
-    	}
+    	UColor color = levelColor(level);
 
 		std::string endline = "";
 		if(printEndline_) {
@@ -423,65 +857,7 @@ void ULogger::write(ULogger::Level level,
 			time.append(") ");
 		}
 
-		std::string levelStr = "";
-		if(printLevel_ || level == kFatal)
-		{
-			const int bufSize = 30;
-			char buf[bufSize] = {0};
-
-#ifdef _MSC_VER
-			sprintf_s(buf, bufSize, "[%s]", levelName_[level]);
-#else
-			snprintf(buf, bufSize, "[%s]", levelName_[level]);
-#endif
-			levelStr = buf;
-			levelStr.append(" ");
-		}
-
-		std::string pidStr;
-		if(printThreadID_)
-		{
-			pidStr = uFormat("{%lu} ", UThread::currentThreadId());
-		}
-
-		std::string whereStr = "";
-		if(printWhere_ || level == kFatal)
-		{
-			whereStr.append("");
-			//File
-			if(printWhereFullPath_)
-			{
-				whereStr.append(file);
-			}
-			else
-			{
-				std::string fileName = UFile::getName(file);
-				if(limitWhereLength_ && fileName.size() > 8)
-				{
-					fileName.erase(8);
-					fileName.append("~");
-				}
-				whereStr.append(fileName);
-			}
-
-			//Line
-			whereStr.append(":");
-			std::string lineStr = uNumber2Str(line);
-			whereStr.append(lineStr);
-
-			//Function
-			whereStr.append("::");
-			std::string funcStr = function;
-			if(!printWhereFullPath_ && limitWhereLength_ && funcStr.size() > 8)
-			{
-				funcStr.erase(8);
-				funcStr.append("~");
-			}
-			funcStr.append("()");
-			whereStr.append(funcStr);
-
-			whereStr.append(" ");
-		}
+		std::string header = formatHeader(level, file, line, function, UThread::currentThreadId(), time);
 
 		va_list args;
 
@@ -509,18 +885,12 @@ void ULogger::write(ULogger::Level level,
 
 			if(buffered_)
 			{
-				bufferedMsgs_.append(levelStr.c_str());
-				bufferedMsgs_.append(pidStr.c_str());
-				bufferedMsgs_.append(time.c_str());
-				bufferedMsgs_.append(whereStr.c_str());
+				bufferedMsgs_.append(header);
 				bufferedMsgs_.append(uFormatv(msg, args));
 			}
 			else
 			{
-				ULogger::getInstance()->_writeStr(levelStr.c_str());
-				ULogger::getInstance()->_writeStr(pidStr.c_str());
-				ULogger::getInstance()->_writeStr(time.c_str());
-				ULogger::getInstance()->_writeStr(whereStr.c_str());
+				ULogger::getInstance()->_writeStr(header.c_str());
 				ULogger::getInstance()->_write(msg, args);
 			}
 			if(type_ == ULogger::kTypeConsole && printColored_)
@@ -551,7 +921,7 @@ void ULogger::write(ULogger::Level level,
 
 		if(level >= eventLevel_)
 		{
-			std::string fullMsg = uFormat("%s%s%s%s", levelStr.c_str(), pidStr.c_str(), time.c_str(), whereStr.c_str());
+			std::string fullMsg = header;
 			va_start(args, msg);
 			fullMsg.append(uFormatv(msg, args));
 			va_end(args);
@@ -569,7 +939,7 @@ void ULogger::write(ULogger::Level level,
 
 		if(level >= kFatal)
 		{
-			std::string fullMsg = uFormat("%s%s%s%s", levelStr.c_str(), pidStr.c_str(), time.c_str(), whereStr.c_str());
+			std::string fullMsg = header;
 			va_start(args, msg);
 			fullMsg.append(uFormatv(msg, args));
 			va_end(args);
@@ -590,6 +960,77 @@ void ULogger::write(ULogger::Level level,
     loggerMutex_.unlock();
 }
 
+std::string ULogger::formatHeader(
+		ULogger::Level level,
+		const char * file,
+		int line,
+		const char * function,
+		unsigned long threadId,
+		const std::string & time)
+{
+	std::string levelStr = "";
+	if(printLevel_ || level == kFatal)
+	{
+		const int bufSize = 30;
+		char buf[bufSize] = {0};
+
+#ifdef _MSC_VER
+		sprintf_s(buf, bufSize, "[%s]", levelName_[level]);
+#else
+		snprintf(buf, bufSize, "[%s]", levelName_[level]);
+#endif
+		levelStr = buf;
+		levelStr.append(" ");
+	}
+
+	std::string pidStr;
+	if(printThreadID_)
+	{
+		pidStr = uFormat("{%lu} ", threadId);
+	}
+
+	std::string whereStr = "";
+	if(printWhere_ || level == kFatal)
+	{
+		whereStr.append("");
+		//File
+		if(printWhereFullPath_)
+		{
+			whereStr.append(file);
+		}
+		else
+		{
+			std::string fileName = UFile::getName(file);
+			if(limitWhereLength_ && fileName.size() > 8)
+			{
+				fileName.erase(8);
+				fileName.append("~");
+			}
+			whereStr.append(fileName);
+		}
+
+		//Line
+		whereStr.append(":");
+		std::string lineStr = uNumber2Str(line);
+		whereStr.append(lineStr);
+
+		//Function
+		whereStr.append("::");
+		std::string funcStr = function;
+		if(!printWhereFullPath_ && limitWhereLength_ && funcStr.size() > 8)
+		{
+			funcStr.erase(8);
+			funcStr.append("~");
+		}
+		funcStr.append("()");
+		whereStr.append(funcStr);
+
+		whereStr.append(" ");
+	}
+
+	return levelStr + pidStr + time + whereStr;
+}
+
 int ULogger::getTime(std::string &timeStr)
 {
     struct tm timeinfo;
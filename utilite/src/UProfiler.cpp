@@ -0,0 +1,330 @@
+/*
+*  utilite is a cross-platform library with
+*  useful utilities for fast and small developing.
+*  Copyright (C) 2010  Mathieu Labbe
+*
+*  utilite is free library: you can redistribute it and/or modify
+*  it under the terms of the GNU Lesser General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  utilite is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "rtabmap/utilite/UProfiler.h"
+#include "rtabmap/utilite/ULogger.h"
+#include "rtabmap/utilite/UConversion.h"
+#include "rtabmap/utilite/UThread.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string.h>
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#include <atomic>
+// Read by every zone without taking the mutex. Kept out of the
+// header so that its type doesn't depend on the includer's C++ standard.
+static std::atomic<int> enabledCount(0);
+#else
+static int enabledCount = 0;
+#endif
+
+unsigned int UProfiler::maxZones_ = 1000000;
+unsigned long UProfiler::dropped_ = 0;
+std::vector<UProfiler::Zone> UProfiler::zones_;
+std::map<unsigned long, int> UProfiler::ownedThreads_;
+UMutex UProfiler::mutex_;
+
+void UProfiler::setEnabled(bool enabled)
+{
+	mutex_.lock();
+	if(enabled)
+	{
+		++enabledCount;
+	}
+	else if(enabledCount > 0)
+	{
+		--enabledCount;
+	}
+	mutex_.unlock();
+}
+
+bool UProfiler::isEnabled()
+{
+	return enabledCount > 0;
+}
+
+void UProfiler::setThreadOwned(unsigned long threadId, bool owned)
+{
+	mutex_.lock();
+	if(owned)
+	{
+		++ownedThreads_[threadId];
+	}
+	else
+	{
+		std::map<unsigned long, int>::iterator iter = ownedThreads_.find(threadId);
+		if(iter != ownedThreads_.end() && --iter->second <= 0)
+		{
+			ownedThreads_.erase(iter);
+		}
+	}
+	mutex_.unlock();
+}
+
+void UProfiler::setMaxZones(unsigned int maxZones)
+{
+	mutex_.lock();
+	maxZones_ = maxZones;
+	mutex_.unlock();
+}
+
+void UProfiler::clear()
+{
+	mutex_.lock();
+	zones_.clear();
+	dropped_ = 0;
+	mutex_.unlock();
+}
+
+unsigned int UProfiler::size()
+{
+	mutex_.lock();
+	unsigned int size = (unsigned int)zones_.size();
+	mutex_.unlock();
+	return size;
+}
+
+unsigned long UProfiler::droppedZones()
+{
+	mutex_.lock();
+	unsigned long dropped = dropped_;
+	mutex_.unlock();
+	return dropped;
+}
+
+void UProfiler::addZone(const char * name, double start, double end)
+{
+	Zone zone;
+	zone.name = name;
+	zone.threadId = UThread::currentThreadId();
+	zone.start = start;
+	zone.end = end;
+	mutex_.lock();
+	if(zones_.size() < maxZones_)
+	{
+		zones_.push_back(zone);
+	}
+	else
+	{
+		++dropped_;
+	}
+	mutex_.unlock();
+}
+
+std::vector<UProfiler::Zone> UProfiler::takeZones(bool clear, const std::set<unsigned long> * threadIds)
+{
+	std::vector<Zone> zones;
+	mutex_.lock();
+	if(threadIds)
+	{
+		std::vector<Zone> kept;
+		// Zones of threads not owned are taken too, otherwise nobody would
+		// remove them and they would fill the recorder
+		for(unsigned int i=0; i<zones_.size(); ++i)
+		{
+			if(threadIds->find(zones_[i].threadId) != threadIds->end() ||
+			   ownedThreads_.find(zones_[i].threadId) == ownedThreads_.end())
+			{
+				zones.push_back(zones_[i]);
+			}
+			else if(clear)
+			{
+				kept.push_back(zones_[i]);
+			}
+		}
+		if(clear)
+		{
+			zones_.swap(kept);
+		}
+	}
+	else if(clear)
+	{
+		zones.swap(zones_);
+		dropped_ = 0;
+	}
+	else
+	{
+		zones = zones_;
+	}
+	mutex_.unlock();
+	return zones;
+}
+
+static std::map<unsigned long, std::string> threadNames()
+{
+	std::map<unsigned long, std::string> names;
+	std::map<std::string, unsigned long> registered = ULogger::getRegisteredThreads();
+	for(std::map<std::string, unsigned long>::iterator iter=registered.begin(); iter!=registered.end(); ++iter)
+	{
+		names.insert(std::make_pair(iter->second, iter->first));
+	}
+	return names;
+}
+
+static std::string escapeJson(const char * str)
+{
+	std::string out;
+	for(; *str; ++str)
+	{
+		if(*str == '"' || *str == '\\')
+		{
+			out += '\\';
+		}
+		out += *str;
+	}
+	return out;
+}
+
+bool UProfiler::exportChromeTrace(const std::string & path, bool clear)
+{
+	return writeChromeTrace(path, takeZones(clear));
+}
+
+bool UProfiler::exportFoldedStacks(const std::string & path, bool clear)
+{
+	return writeFoldedStacks(path, takeZones(clear));
+}
+
+bool UProfiler::exportTrace(
+		const std::string & chromeTracePath,
+		const std::string & foldedStacksPath,
+		bool clear,
+		const std::set<unsigned long> * threadIds)
+{
+	std::vector<Zone> zones = takeZones(clear, threadIds);
+	bool success = true;
+	if(!chromeTracePath.empty())
+	{
+		success = writeChromeTrace(chromeTracePath, zones);
+	}
+	if(!foldedStacksPath.empty())
+	{
+		success = writeFoldedStacks(foldedStacksPath, zones) && success;
+	}
+	return success;
+}
+
+bool UProfiler::writeChromeTrace(const std::string & path, const std::vector<Zone> & zones)
+{
+	std::ofstream file(path.c_str());
+	if(!file.is_open())
+	{
+		UERROR("Cannot open \"%s\" to export the profiler trace.", path.c_str());
+		return false;
+	}
+
+	double origin = 0.0;
+	for(unsigned int i=0; i<zones.size(); ++i)
+	{
+		if(origin == 0.0 || zones[i].start < origin)
+		{
+			origin = zones[i].start;
+		}
+	}
+
+	file << "{\"traceEvents\":[";
+	std::map<unsigned long, std::string> names = threadNames();
+	std::map<unsigned long, int> tids; // Chrome expects small integers
+	for(unsigned int i=0; i<zones.size(); ++i)
+	{
+		std::map<unsigned long, int>::iterator iter = tids.find(zones[i].threadId);
+		if(iter == tids.end())
+		{
+			iter = tids.insert(std::make_pair(zones[i].threadId, (int)tids.size()+1)).first;
+			std::map<unsigned long, std::string>::iterator jter = names.find(zones[i].threadId);
+			file << (i==0?"\n":",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << iter->second
+				 << ",\"args\":{\"name\":\"" << escapeJson(jter!=names.end()?jter->second.c_str():uFormat("%lu", zones[i].threadId).c_str()) << "\"}}";
+		}
+		file << ",\n" << uFormat("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				escapeJson(zones[i].name).c_str(),
+				iter->second,
+				(zones[i].start - origin)*1000000.0,
+				(zones[i].end - zones[i].start)*1000000.0);
+	}
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	file.close();
+	UINFO("Exported %d profiler zones to \"%s\".", (int)zones.size(), path.c_str());
+	return true;
+}
+
+static bool zoneOrder(const std::pair<double, std::pair<double, const char *> > & a, const std::pair<double, std::pair<double, const char *> > & b)
+{
+	// parents (earlier start, later end) first
+	return a.first < b.first || (a.first == b.first && a.second.first > b.second.first);
+}
+
+bool UProfiler::writeFoldedStacks(const std::string & path, const std::vector<Zone> & zones)
+{
+	std::ofstream file(path.c_str());
+	if(!file.is_open())
+	{
+		UERROR("Cannot open \"%s\" to export the profiler stacks.", path.c_str());
+		return false;
+	}
+
+	// start, (end, name) per thread
+	std::map<unsigned long, std::vector<std::pair<double, std::pair<double, const char *> > > > threads;
+	for(unsigned int i=0; i<zones.size(); ++i)
+	{
+		threads[zones[i].threadId].push_back(std::make_pair(zones[i].start, std::make_pair(zones[i].end, zones[i].name)));
+	}
+
+	std::map<unsigned long, std::string> names = threadNames();
+	std::map<std::string, double> selfTimes;
+	for(std::map<unsigned long, std::vector<std::pair<double, std::pair<double, const char *> > > >::iterator iter=threads.begin(); iter!=threads.end(); ++iter)
+	{
+		std::sort(iter->second.begin(), iter->second.end(), zoneOrder);
+		std::map<unsigned long, std::string>::iterator jter = names.find(iter->first);
+		std::string root = jter!=names.end()?jter->second:uFormat("%lu", iter->first);
+
+		// stack of (end, path)
+		std::vector<std::pair<double, std::string> > stack;
+		for(unsigned int i=0; i<iter->second.size(); ++i)
+		{
+			double start = iter->second[i].first;
+			double end = iter->second[i].second.first;
+			while(stack.size() && stack.back().first <= start)
+			{
+				stack.pop_back();
+			}
+			std::string parent = stack.size()?stack.back().second:root;
+			std::string zonePath = parent + ";" + iter->second[i].second.second;
+			double duration = (end - start)*1000000.0;
+			selfTimes[zonePath] += duration;
+			if(stack.size())
+			{
+				selfTimes[parent] -= duration;
+			}
+			stack.push_back(std::make_pair(end, zonePath));
+		}
+	}
+
+	for(std::map<std::string, double>::iterator iter=selfTimes.begin(); iter!=selfTimes.end(); ++iter)
+	{
+		if(iter->second >= 1.0)
+		{
+			file << iter->first << " " << (long)iter->second << "\n";
+		}
+	}
+	file.close();
+	UINFO("Exported %d profiler zones to \"%s\".", (int)zones.size(), path.c_str());
+	return true;
+}